@@ -11,21 +11,52 @@ out vec3 Normal;
 out vec2 TexCoord;
 out vec3 FragTangent;
 
-uniform mat4 projection;
-uniform mat4 view;
-uniform mat4 model;
+// Set once per frame; matches FrameBlock in shader/uniform_blocks.h
+layout (std140) uniform Frame
+{
+    mat4 projection;
+    mat4 view;
+    mat4 lightProjection;
+    vec3 cameraPosition;
+    float time;
+};
+
+// One per entity drawn, computed on the CPU once a frame; matches ObjectBlock in shader/uniform_blocks.h
+layout (std140) uniform Object
+{
+    mat4 model;
+    mat3 normalMatrix; // transpose of the inverse of the upper 3x3 of model
+    mat4 modelViewProjection;
+    vec3 Tint;
+    float Shininess;
+    float Opacity;
+    float AlphaClip;
+    float BreathingSpeed;
+};
 
-uniform float time;
-uniform float BreathingSpeed;
+// Decoding for packed vertex formats (see mesh/vertex_format.h); the defaults leave full float vertices untouched
+uniform vec3 vertexPositionScale = vec3(1.0);
+uniform vec3 vertexPositionBias = vec3(0.0);
+uniform vec4 vertexUvScaleBias = vec4(1.0, 1.0, 0.0, 0.0);
+uniform bool vertexOctEncoded = false;
 
 float Wave(float amp, float freq, float axis, float xOffset, float yOffset)
 {
     return amp * sin(freq * (axis + xOffset)) + yOffset;
 }
 
+vec3 OctDecode(vec2 e)
+{
+	e *= 1.0 / 32767.0;
+	vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	if (v.z < 0.0)
+		v.xy = (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+	return normalize(v);
+}
+
 void main()
 {
-    vec3 pos = aPos;
+    vec3 pos = aPos * vertexPositionScale + vertexPositionBias;
 	vec3 dir = normalize(pos);
 
 	if(BreathingSpeed > 0)
@@ -43,13 +74,13 @@ void main()
 	FragWorldPos = worldPos.xyz;
 
     // to fix normal to point at the correct direction,
-	// the normal needs to be multiplied with a normal matrix
-	// which is the transpose of the inverse of the upper 3x3 part of the model matrix
-	mat3 normalMatrix = mat3(transpose(inverse(model)));
-	Normal = normalMatrix * aNormal;
-	FragTangent = normalMatrix * aTangent;    
+	// the normal needs to be multiplied with the normal matrix of the Object block
+	vec3 normal = vertexOctEncoded ? OctDecode(aNormal.xy) : aNormal;
+	vec3 tangent = vertexOctEncoded ? OctDecode(aTangent.xy) : aTangent;
+	Normal = normalMatrix * normal;
+	FragTangent = normalMatrix * tangent;
 
-    TexCoord = aTexCoord;
+    TexCoord = aTexCoord * vertexUvScaleBias.xy + vertexUvScaleBias.zw;
 
-    gl_Position = projection * view * worldPos;
+    gl_Position = modelViewProjection * vec4(pos, 1.0);
 }
\ No newline at end of file
@@ -8,22 +8,24 @@ in vec2 TexCoord;
 in vec3 FragTangent;
 in vec4 fragPosLight;
 
-uniform vec3 cameraPosition;
+// Set once per frame; matches FrameBlock in shader/uniform_blocks.h
+layout (std140) uniform Frame
+{
+    mat4 projection;
+    mat4 view;
+    mat4 lightProjection;
+    vec3 cameraPosition;
+    float time;
+};
 
 #define MAX_LIGHTS 30
 
-uniform int NUM_DIRECTIONAL_LIGHTS;
-
 struct DirectionalLight
 {
     vec3 col;
     vec3 dir;    
 };
 
-uniform DirectionalLight DirectionalLights[MAX_LIGHTS];
-
-uniform int NUM_POINT_LIGHTS;
-
 struct PointLight
 {
     vec3 col;
@@ -31,34 +33,85 @@ struct PointLight
     vec3 pos;
 };
 
-uniform PointLight PointLights[MAX_LIGHTS];
-
-uniform int NUM_SPOT_LIGHTS;
-
 struct SpotLight
 {
     vec3 col;
+    float range;
     vec3 dir;
     vec3 pos;
-    float range;
     vec2 angles;
 };
 
-uniform SpotLight SpotLights[MAX_LIGHTS];
+// Active lights only, set when they change; matches LightsBlock in shader/uniform_blocks.h
+layout (std140) uniform Lights
+{
+    int NUM_DIRECTIONAL_LIGHTS;
+    int NUM_POINT_LIGHTS;
+    int NUM_SPOT_LIGHTS;
+    bool EnableShadow;
+    float ShadowStrength;
+    float ShadowBias; // 0.0005
+    DirectionalLight DirectionalLights[MAX_LIGHTS];
+    PointLight PointLights[MAX_LIGHTS];
+    SpotLight SpotLights[MAX_LIGHTS];
+};
+
+// ShaderVariants defines these to constants, fixing the shadow branch and the light loop bounds at compile time;
+// a plain load reads them from the Lights block
+#ifndef SHADOW
+#define SHADOW EnableShadow
+#endif
+#ifndef DIRECTIONAL_LIGHTS
+#define DIRECTIONAL_LIGHTS NUM_DIRECTIONAL_LIGHTS
+#endif
+#ifndef POINT_LIGHTS
+#define POINT_LIGHTS NUM_POINT_LIGHTS
+#endif
+#ifndef SPOT_LIGHTS
+#define SPOT_LIGHTS NUM_SPOT_LIGHTS
+#endif
 
 
 uniform sampler2D DiffuseTexture;
-uniform sampler2D SpecularTexture;
+uniform sampler2D MaterialTexture;	// specular, AO and emissive in r, g and b
 uniform sampler2D NormalTexture;
-uniform sampler2D EmissiveTexture;
-uniform sampler2D AOTexture;
 uniform sampler2D shadowMap;
+uniform vec3 TopDownMaps;	// 1 for each of the three maps above whose rows are stored top first (see Texture2D::isTopDown)
+
+// Entities packed into shared arrays read the same three maps from their layer instead
+uniform bool UseMaterialArrays;
+uniform int MaterialLayer;
+uniform sampler2DArray DiffuseArray;
+uniform sampler2DArray MaterialArray;
+uniform sampler2DArray NormalArray;
+uniform vec2 ArrayMask;	// 1 for the diffuse and normal arrays in use; off they read as white, like the 2D fallbacks
+
+// A virtual diffuse map is read through its page table from whichever pages are in the cache
+// (see texture/virtual_texture.h)
+uniform bool UseVirtualTexture;
+uniform sampler2D PageTable;
+uniform sampler2D PageCache;
+uniform vec2 VirtualSize;		// texels of the finest level
+uniform float VirtualPageSize;
+uniform float VirtualBorder;
+uniform float VirtualTileSize;	// a page and its border
+uniform int VirtualLevels;
+uniform vec2 VirtualCacheSize;	// texels
+
+// One per entity drawn, computed on the CPU once a frame; matches ObjectBlock in shader/uniform_blocks.h
+layout (std140) uniform Object
+{
+    mat4 model;
+    mat3 normalMatrix; // transpose of the inverse of the upper 3x3 of model
+    mat4 modelViewProjection;
+    vec3 Tint;
+    float Shininess;
+    float Opacity;
+    float AlphaClip;
+    float BreathingSpeed;
+};
 
-uniform float Shininess;
-uniform float AlphaClip;
-
-uniform vec3 Tint;
-uniform float Opacity;
+uniform vec3 MaterialMask;	// 1 for each channel of MaterialTexture in use
 
 float square(float n)
 {
@@ -72,6 +125,30 @@ float clamp01(float n)
     return clamp(n, 0, 1);
 }
 
+// Where a map stored top row first has the texel an upright one has at uv
+vec2 Upright(vec2 uv, float topDown)
+{
+    return vec2(uv.x, mix(uv.y, 1.0 - uv.y, topDown));
+}
+
+// Picks the level from the screen space derivatives as the feedback pass does, then samples whatever page the
+// table has for it, which may be a coarser one until the right page loads
+vec4 SampleVirtual(vec2 uv)
+{
+    vec2 texel = uv * VirtualSize;
+    vec2 dx = dFdx(texel), dy = dFdy(texel);
+    float level = clamp(floor(0.5 * log2(max(dot(dx, dx), dot(dy, dy)))), 0.0, float(VirtualLevels - 1));
+
+    vec2 wrapped = fract(uv);
+    ivec2 page = ivec2(wrapped * max(VirtualSize / exp2(level), vec2(1.0)) / VirtualPageSize);
+    vec4 entry = floor(texelFetch(PageTable, page, int(level)) * 255.0 + 0.5);
+
+    vec2 residentTexel = wrapped * max(VirtualSize / exp2(entry.z), vec2(1.0));
+    vec2 inPage = residentTexel - floor(residentTexel / VirtualPageSize) * VirtualPageSize;
+    vec2 cacheTexel = entry.xy * VirtualTileSize + VirtualBorder + inPage;
+    return textureLod(PageCache, cacheTexel / VirtualCacheSize, 0.0);
+}
+
 struct Surface
 {
     vec3 worldPos;
@@ -92,21 +169,39 @@ Surface MakeSurface()
 
     surf.worldPos = FragWorldPos;
 
-    vec4 diffuse = texture(DiffuseTexture, TexCoord);
+    vec4 diffuse, materialTex, normalTex;
+    if (UseMaterialArrays)
+    {
+        vec3 coord = vec3(TexCoord, float(MaterialLayer));
+        diffuse = mix(vec4(1.0), texture(DiffuseArray, coord), ArrayMask.x);
+        materialTex = texture(MaterialArray, coord);
+        normalTex = mix(vec4(1.0), texture(NormalArray, coord), ArrayMask.y);
+    }
+    else
+    {
+        diffuse = UseVirtualTexture ? SampleVirtual(TexCoord) : texture(DiffuseTexture, Upright(TexCoord, TopDownMaps.x));
+        materialTex = texture(MaterialTexture, Upright(TexCoord, TopDownMaps.y));
+        normalTex = texture(NormalTexture, Upright(TexCoord, TopDownMaps.z));
+    }
+
     surf.diffuse = diffuse.rgb;
     surf.alpha = diffuse.a;
-    surf.specular = texture(SpecularTexture, TexCoord).r;
-    vec4 normalTex = texture(NormalTexture, TexCoord);
+    // Channels switched off in MaterialMask fall back to full specular, no occlusion and no emission
+    vec3 material = mix(vec3(1.0, 1.0, 0.0), materialTex.rgb, MaterialMask);
+    surf.specular = material.r;
 
     vec3 normal = normalize(Normal);
     vec3 tangent = normalize(FragTangent);
     vec3 bitangent = normalize(cross(normal, tangent));
 
     mat3 TBN = mat3(tangent, bitangent, normal);
-    surf.normal = normalize(TBN * (2.0 * normalTex.rgb - 1.0));
+    // BC5 normal maps only store xy and read back z as 0; rebuild it from the unit length
+    vec3 tangentNormal = 2.0 * normalTex.rgb - 1.0;
+    if (normalTex.b == 0.0) tangentNormal.z = sqrt(max(0.0, 1.0 - dot(tangentNormal.xy, tangentNormal.xy)));
+    surf.normal = normalize(TBN * tangentNormal);
 
-    surf.emissive = texture(EmissiveTexture, TexCoord).r;
-    surf.ao = texture(AOTexture, TexCoord).r;
+    surf.emissive = material.b;
+    surf.ao = material.g;
 
     surf.shininess = Shininess;
 
@@ -169,13 +264,11 @@ vec3 GetSpecularBlinn(Surface surf, vec3 lightDir, vec3 lightCol)
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 // SHADOW
 
-uniform bool EnableShadow;
-uniform float ShadowStrength;
-uniform float ShadowBias; // 0.0005
+// SHADOW, ShadowStrength and ShadowBias come with the Lights block
 
 float GetShadow(vec3 lightDir)
 {
-    if(!EnableShadow) return 0;
+    if(!bool(SHADOW)) return 0;
     
     float shadow = 0.0f;
 
@@ -327,21 +420,21 @@ void main()
 
     vec3 directionalLightContribution = vec3(0);
 
-    for (int i = 0; i < NUM_DIRECTIONAL_LIGHTS; i++)
+    for (int i = 0; i < DIRECTIONAL_LIGHTS; i++)
     {
         directionalLightContribution += MakeDirectionalLight(DirectionalLights[i].col, DirectionalLights[i].dir, surf);
     }
 
     vec3 pointLightContribution = vec3(0);
 
-    for (int i = 0; i < NUM_POINT_LIGHTS; i++)
+    for (int i = 0; i < POINT_LIGHTS; i++)
     {
         pointLightContribution += MakePointLight(PointLights[i].col, PointLights[i].range, PointLights[i].pos, surf);
     }
 
     vec3 spotLightContribution = vec3(0);
 
-    for (int i = 0; i < NUM_SPOT_LIGHTS; i++)
+    for (int i = 0; i < SPOT_LIGHTS; i++)
     {   
         spotLightContribution += MakeSpotLight(SpotLights[i].col, SpotLights[i].dir, SpotLights[i].pos, SpotLights[i].range, SpotLights[i].angles, surf);
     }
@@ -7,6 +7,21 @@ uniform sampler2D scanline;
 
 uniform float time;
 
+// Effects are compiled in or out by ShaderVariants, set when post processing and the effect are both on;
+// a plain load has them all off
+#ifndef SPHERIZE
+#define SPHERIZE 0
+#endif
+#ifndef GRAYSCALE
+#define GRAYSCALE 0
+#endif
+#ifndef SCANLINES
+#define SCANLINES 0
+#endif
+#ifndef VIGNETTE
+#define VIGNETTE 0
+#endif
+
 
 vec4 Invert(vec4 layer)
 {
@@ -93,37 +108,33 @@ vec4 ApplyVignette(vec4 toLayer, vec2 uv, float strength, vec3 color)
 }
 
 
-uniform bool EnablePostProcess;
-
-uniform bool EnableSpherize;
 uniform float SpherizeStrength; //2
 uniform float ZoomScale; //.75
 
 vec2 TryGetUVSpherize(vec2 inputUV)
 {
-    if(!EnablePostProcess) return inputUV;
-    if(!EnableSpherize) return inputUV;
-
+#if SPHERIZE
     vec2 uvSpherize = Spherize(inputUV, vec2(0.5), SpherizeStrength, vec2(0));
 
     uvSpherize = Zoom(uvSpherize, vec2(0.5), ZoomScale);
 
     return fract(uvSpherize);
+#else
+    return inputUV;
+#endif
 }
 
 
-uniform bool EnableGrayscale;
-
 vec4 TryGrayscale(vec4 inputLayer)
 {
-    if(!EnablePostProcess) return inputLayer;
-    if(!EnableGrayscale) return inputLayer;
-    
+#if GRAYSCALE
     return Grayscale(inputLayer);
+#else
+    return inputLayer;
+#endif
 }
 
 
-uniform bool EnableScanlines;
 uniform int ScanlineTiling; //3
 uniform float ScanlineScroll; //0.1
 
@@ -143,25 +154,26 @@ vec4 GetScanlines()
 
 vec4 TryScanlines(vec4 inputLayer)
 {
-    if(!EnablePostProcess) return inputLayer;
-    if(!EnableScanlines) return inputLayer;
-
+#if SCANLINES
     vec4 blendScanline = Blend(inputLayer, GetScanlines());
 
     return blendScanline;
+#else
+    return inputLayer;
+#endif
 }
 
 
-uniform bool EnableVignette;
 uniform float VignetteStrength; //15
 uniform vec3 VignetteColor; //black
 
 vec4 TryVignette(vec4 inputLayer)
 {
-    if(!EnablePostProcess) return inputLayer;
-    if(!EnableVignette) return inputLayer;
-
+#if VIGNETTE
     return ApplyVignette(inputLayer, TexCoord, VignetteStrength, VignetteColor);
+#else
+    return inputLayer;
+#endif
 }
 
 
@@ -4,7 +4,11 @@ layout (location = 0) in vec3 aPos;
 uniform mat4 lightProjection;
 uniform mat4 model;
 
+// Packed vertex positions (see mesh/vertex_format.h); the defaults leave full float vertices untouched
+uniform vec3 vertexPositionScale = vec3(1.0);
+uniform vec3 vertexPositionBias = vec3(0.0);
+
 void main()
 {
-    gl_Position = lightProjection * model * vec4(aPos, 1);
+    gl_Position = lightProjection * model * vec4(aPos * vertexPositionScale + vertexPositionBias, 1);
 }
\ No newline at end of file
@@ -7,13 +7,21 @@ in vec3 Normal;
 in vec2 TexCoord;
 in vec3 FragTangent;
 
-uniform vec3 cameraPosition;
-
 uniform sampler2D DiffuseTexture;
+uniform vec3 TopDownMaps;	// x is 1 when DiffuseTexture's rows are stored top first (see Texture2D::isTopDown)
 
-uniform float AlphaClip;
-uniform vec3 Tint;
-uniform float Opacity;
+// One per entity drawn, computed on the CPU once a frame; matches ObjectBlock in shader/uniform_blocks.h
+layout (std140) uniform Object
+{
+    mat4 model;
+    mat3 normalMatrix; // transpose of the inverse of the upper 3x3 of model
+    mat4 modelViewProjection;
+    vec3 Tint;
+    float Shininess;
+    float Opacity;
+    float AlphaClip;
+    float BreathingSpeed;
+};
 
 struct Surface
 {
@@ -29,7 +37,8 @@ Surface MakeSurface()
 
     surf.worldPos = FragWorldPos;
 
-    vec4 diffuse = texture(DiffuseTexture, TexCoord);
+    vec2 uv = vec2(TexCoord.x, mix(TexCoord.y, 1.0 - TexCoord.y, TopDownMaps.x));
+    vec4 diffuse = texture(DiffuseTexture, uv);
     surf.diffuse = diffuse.rgb;
     surf.alpha = diffuse.a;
 
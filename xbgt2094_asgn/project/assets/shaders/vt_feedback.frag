@@ -0,0 +1,30 @@
+#version 330 core
+layout (location = 0) out vec4 FragColor;
+
+in vec2 TexCoord;
+
+// Entities without a virtual texture still draw, so they hide what is behind them, and write no request
+uniform bool UseVirtualTexture;
+uniform vec2 VirtualSize;
+uniform float VirtualPageSize;
+uniform int VirtualLevels;
+uniform float FeedbackBias;	// log2 of how many times smaller than the screen this pass is
+
+void main()
+{
+    if (!UseVirtualTexture)
+    {
+        FragColor = vec4(0.0);
+        return;
+    }
+
+    // The same level lit.frag samples at full resolution
+    vec2 texel = TexCoord * VirtualSize;
+    vec2 dx = dFdx(texel), dy = dFdy(texel);
+    float level = clamp(floor(0.5 * log2(max(dot(dx, dx), dot(dy, dy))) - FeedbackBias), 0.0, float(VirtualLevels - 1));
+
+    ivec2 page = ivec2(fract(TexCoord) * max(VirtualSize / exp2(level), vec2(1.0)) / VirtualPageSize);
+
+    // As VirtualPageManager::decodeFeedback reads it
+    FragColor = vec4(page & 255, (page.x >> 8) | ((page.y >> 8) << 4), level + 1.0) / 255.0;
+}
\ No newline at end of file
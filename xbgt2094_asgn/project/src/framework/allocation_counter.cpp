@@ -0,0 +1,101 @@
+#include "allocation_counter.h"
+
+#ifdef XBGT2094_COUNT_ALLOCATIONS
+#include <cstdlib>
+#include <new>
+
+static thread_local size_t threadAllocations = 0;
+
+bool AllocationCounter::isEnabled()
+{
+	return true;
+}
+
+size_t AllocationCounter::getThreadCount()
+{
+	return threadAllocations;
+}
+
+// Replaces the global allocation functions the standard library would otherwise provide. The nothrow and
+// array forms go through the counting one; aligned allocations keep the standard library's own.
+void* operator new(size_t size)
+{
+	threadAllocations++;
+	if (size == 0) size = 1;
+
+	while (true)
+	{
+		void* ptr = malloc(size);
+		if (ptr) return ptr;
+
+		std::new_handler handler = std::get_new_handler();
+		if (!handler) throw std::bad_alloc();
+		handler();
+	}
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	try
+	{
+		return operator new(size);
+	}
+	catch (...)
+	{
+		return nullptr;
+	}
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	return operator new(size, std::nothrow);
+}
+
+void operator delete(void* ptr) noexcept
+{
+	free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+	free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+	free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept
+{
+	free(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept
+{
+	free(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept
+{
+	free(ptr);
+}
+
+#else
+
+bool AllocationCounter::isEnabled()
+{
+	return false;
+}
+
+size_t AllocationCounter::getThreadCount()
+{
+	return 0;
+}
+
+#endif
\ No newline at end of file
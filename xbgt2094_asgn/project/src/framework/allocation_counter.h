@@ -0,0 +1,14 @@
+#pragma once
+#include <cstddef>
+
+// Counts heap allocations through operator new per thread, to check that a hot path allocates nothing.
+// Counting replaces the global operator new and delete for the whole program, so it is an instrumentation build
+// only: define XBGT2094_COUNT_ALLOCATIONS to turn it on. Without it every count is 0.
+class AllocationCounter
+{
+public:
+	// Whether this build counts
+	static bool isEnabled();
+	// Allocations made on the calling thread since it started; take the difference around the code to check
+	static size_t getThreadCount();
+};
\ No newline at end of file
@@ -0,0 +1,64 @@
+#include "bench_utils.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdarg>
+#include <cstdio>
+#include <filesystem>
+#include <thread>
+
+double BenchUtils::getElapsedMs(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+std::vector<std::string> BenchUtils::findFiles(const std::string& directory, std::initializer_list<const char*> extensions)
+{
+	std::vector<std::string> filePaths;
+
+	std::error_code error;
+	for (std::filesystem::recursive_directory_iterator it(directory, error), end; !error && it != end; it.increment(error))
+	{
+		if (!it->is_regular_file()) continue;
+
+		std::string extension = it->path().extension().string();
+		std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+
+		for (const char* wanted : extensions)
+		{
+			if (extension == wanted)
+			{
+				filePaths.push_back(it->path().generic_string());
+				break;
+			}
+		}
+	}
+	std::sort(filePaths.begin(), filePaths.end());
+	return filePaths;
+}
+
+std::vector<std::string> BenchUtils::findImages(const std::string& directory)
+{
+	return findFiles(directory, { ".jpg", ".jpeg", ".png", ".tga" });
+}
+
+std::string BenchUtils::getRelativePath(const std::string& path, const std::string& directory)
+{
+	return std::filesystem::relative(path, directory).generic_string();
+}
+
+void BenchUtils::printTitle(const char* format, ...)
+{
+	printf("\n");
+
+	va_list args;
+	va_start(args, format);
+	vprintf(format, args);
+	va_end(args);
+
+	printf("\n");
+}
+
+std::string BenchUtils::getThreadsNote()
+{
+	return ", " + std::to_string(std::max(1u, std::thread::hardware_concurrency())) + " hardware threads";
+}
\ No newline at end of file
@@ -0,0 +1,28 @@
+#pragma once
+#include <chrono>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+// What the offline --bench-* modes share, and the load timings that are logged the same way
+namespace BenchUtils
+{
+	// Milliseconds since start
+	double getElapsedMs(std::chrono::steady_clock::time_point start);
+
+	// Every file under directory, in any subdirectory, whose extension is one of extensions in any case, such as
+	// ".obj". Generic paths, sorted, so runs list them in the same order.
+	std::vector<std::string> findFiles(const std::string& directory, std::initializer_list<const char*> extensions);
+
+	// The images the texture benchmarks decode: .jpg, .jpeg, .png and .tga
+	std::vector<std::string> findImages(const std::string& directory);
+
+	// path as the benchmarks print it, relative to the asset directory they searched
+	std::string getRelativePath(const std::string& path, const std::string& directory);
+
+	// Blank line, then the title of a benchmark's table, with printf arguments
+	void printTitle(const char* format, ...);
+
+	// ", N hardware threads", for titles of benchmarks that spread across cores
+	std::string getThreadsNote();
+}
\ No newline at end of file
@@ -0,0 +1,150 @@
+#include "file_utils.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace FileUtils
+{
+#ifdef _WIN32
+	MappedFile::MappedFile() : bytes(nullptr), length(0), fileHandle(INVALID_HANDLE_VALUE), mappingHandle(nullptr) {}
+#else
+	MappedFile::MappedFile() : bytes(nullptr), length(0) {}
+#endif
+
+	MappedFile::~MappedFile()
+	{
+		close();
+	}
+
+	bool MappedFile::open(const std::string& path)
+	{
+		close();
+
+#ifdef _WIN32
+		HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (file == INVALID_HANDLE_VALUE) return false;
+
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+		{
+			CloseHandle(file);
+			return false;
+		}
+
+		HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mapping == NULL)
+		{
+			CloseHandle(file);
+			return false;
+		}
+
+		void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (view == NULL)
+		{
+			CloseHandle(mapping);
+			CloseHandle(file);
+			return false;
+		}
+
+		fileHandle = file;
+		mappingHandle = mapping;
+		bytes = static_cast<const unsigned char*>(view);
+		length = (size_t)fileSize.QuadPart;
+#else
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0) return false;
+
+		struct stat st;
+		if (fstat(fd, &st) != 0 || st.st_size == 0)
+		{
+			::close(fd);
+			return false;
+		}
+
+		void* view = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		::close(fd); // the mapping keeps its own reference to the file
+
+		if (view == MAP_FAILED) return false;
+
+		bytes = static_cast<const unsigned char*>(view);
+		length = (size_t)st.st_size;
+#endif
+
+		return true;
+	}
+
+	void MappedFile::close()
+	{
+		if (bytes == nullptr) return;
+
+#ifdef _WIN32
+		UnmapViewOfFile(bytes);
+		CloseHandle(mappingHandle);
+		CloseHandle(fileHandle);
+		mappingHandle = nullptr;
+		fileHandle = INVALID_HANDLE_VALUE;
+#else
+		munmap(const_cast<unsigned char*>(bytes), length);
+#endif
+
+		bytes = nullptr;
+		length = 0;
+	}
+
+	bool MappedFile::isOpen() const
+	{
+		return bytes != nullptr;
+	}
+
+	const unsigned char* MappedFile::data() const
+	{
+		return bytes;
+	}
+
+	size_t MappedFile::size() const
+	{
+		return length;
+	}
+
+	bool getModifiedTime(const std::string& path, uint64_t* modifiedTime)
+	{
+#ifdef _WIN32
+		WIN32_FILE_ATTRIBUTE_DATA attributes;
+		if (!GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &attributes)) return false;
+
+		*modifiedTime = ((uint64_t)attributes.ftLastWriteTime.dwHighDateTime << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+#else
+		struct stat st;
+		if (stat(path.c_str(), &st) != 0) return false;
+
+#if defined(__APPLE__)
+		*modifiedTime = (uint64_t)st.st_mtimespec.tv_sec * 1000000000ull + (uint64_t)st.st_mtimespec.tv_nsec;
+#else
+		*modifiedTime = (uint64_t)st.st_mtim.tv_sec * 1000000000ull + (uint64_t)st.st_mtim.tv_nsec;
+#endif
+#endif
+		return true;
+	}
+
+	uint64_t hashBytes(const void* data, size_t size, uint64_t seed)
+	{
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		uint64_t hash = seed;
+
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= bytes[i];
+			hash *= 1099511628211ull;
+		}
+
+		return hash;
+	}
+}
\ No newline at end of file
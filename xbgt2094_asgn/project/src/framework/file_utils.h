@@ -0,0 +1,41 @@
+#pragma once
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+namespace FileUtils
+{
+	// Read-only memory mapping of a whole file.
+	// The mapping is released when the object is closed or destroyed.
+	class MappedFile
+	{
+	private:
+		const unsigned char* bytes;
+		size_t length;
+
+#ifdef _WIN32
+		void* fileHandle;
+		void* mappingHandle;
+#endif
+
+	public:
+		MappedFile();
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		bool open(const std::string& path);
+		void close();
+
+		bool isOpen() const;
+		const unsigned char* data() const;
+		size_t size() const;
+	};
+
+	// Last write time of a file in an OS specific unit; only meant for equality checks.
+	bool getModifiedTime(const std::string& path, uint64_t* modifiedTime);
+
+	// 64-bit FNV-1a. Pass a previous result as seed to hash several blocks in sequence.
+	uint64_t hashBytes(const void* data, size_t size, uint64_t seed = 14695981039346656037ull);
+}
\ No newline at end of file
@@ -2,8 +2,16 @@
 #include <glad/glad.h>
 #include "simplerenderer.h"
 #include "simpleapp.h"
+#include "allocation_counter.h"
+#include "load_arena.h"
 #include "../shader/shader_utils.h"
+#include "../shader/shader_variants.h"
+#include "../shader/uniform_buffer.h"
+#include "../shader/uniform_blocks.h"
 #include "../texture/texture_utils.h"
+#include "../texture/texture_streaming.h"
+#include "../texture/virtual_texture.h"
 #include "../mesh/mesh_utils.h"
+#include "../mesh/mesh_cache.h"
 #include "../lighting/light_utils.h"
 #include "../fbo/fbo_utils.h"
\ No newline at end of file
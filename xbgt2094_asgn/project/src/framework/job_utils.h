@@ -0,0 +1,37 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace JobUtils
+{
+	// Runs fn(i) for every i below count on up to threadCount threads, the calling thread included. Each thread
+	// takes the next index as it finishes one, so uneven jobs still spread out.
+	template <typename Fn>
+	void run(size_t count, unsigned int threadCount, Fn fn)
+	{
+		std::atomic<size_t> next(0);
+		auto work = [&]()
+		{
+			for (size_t i = next++; i < count; i = next++)
+			{
+				fn(i);
+			}
+		};
+
+		std::vector<std::thread> workers;
+		for (size_t i = 1; i < std::min<size_t>(threadCount, count); i++)
+		{
+			workers.emplace_back(work);
+		}
+
+		work();
+
+		for (std::thread& worker : workers)
+		{
+			worker.join();
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,311 @@
+#include "load_arena.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <new>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+static const size_t ALIGNMENT = 16;
+
+// In front of every STBI_MALLOC allocation
+struct alignas(16) ScopedHeader
+{
+	size_t size;
+	LoadArena* arena;	// nullptr when it came from the heap
+};
+
+static std::atomic<size_t> requestCount(0);
+static std::atomic<size_t> heapCallCount(0);
+static std::atomic<size_t> blockCount(0);
+static std::atomic<size_t> peakBytes(0);
+
+static bool enabled = true;
+
+thread_local LoadArena* LoadArena::currentArena = nullptr;
+
+static size_t alignUp(size_t size)
+{
+	return std::max(ALIGNMENT, (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1));
+}
+
+static void updatePeak(size_t bytes)
+{
+	size_t peak = peakBytes.load(std::memory_order_relaxed);
+	while (bytes > peak && !peakBytes.compare_exchange_weak(peak, bytes, std::memory_order_relaxed)) {}
+}
+
+LoadArena::LoadArena() : current(0), used(0), heldBytes(0), last(nullptr), depth(0)
+{
+}
+
+LoadArena::~LoadArena()
+{
+	for (Block& block : blocks)
+	{
+		::operator delete(block.bytes);
+	}
+}
+
+void* LoadArena::allocate(size_t size)
+{
+	size = alignUp(size);
+
+	unsigned char* ptr;
+	if (current < blocks.size() && used + size <= blocks[current].size)
+	{
+		ptr = blocks[current].bytes + used;
+		used += size;
+	}
+	else
+	{
+		ptr = static_cast<unsigned char*>(allocateSlow(size));
+	}
+
+	last = ptr;
+	updatePeak(heldBytes + used);
+	return ptr;
+}
+
+// Moves on to the next block, reusing it when a rewind left one big enough
+void* LoadArena::allocateSlow(size_t size)
+{
+	size_t next = blocks.empty() ? 0 : current + 1;
+
+	if (next >= blocks.size() || blocks[next].size < size)
+	{
+		Block block;
+		block.size = std::max(BLOCK_SIZE, size);
+		block.bytes = static_cast<unsigned char*>(::operator new(block.size));
+		blocks.insert(blocks.begin() + next, block);
+
+		heapCallCount++;
+		blockCount++;
+	}
+
+	if (next > current) heldBytes += used;
+	current = next;
+	used = size;
+	return blocks[current].bytes;
+}
+
+void LoadArena::release(void* ptr, size_t size)
+{
+	if (ptr == nullptr || ptr != last) return;
+	// A size that does not end where the block's bump pointer is was not this allocation's; leave it to the scope
+	if (last + alignUp(size) != blocks[current].bytes + used) return;
+
+	used = last - blocks[current].bytes;
+	last = nullptr;
+}
+
+void* LoadArena::reallocate(void* ptr, size_t oldSize, size_t newSize)
+{
+	if (ptr == nullptr) return allocate(newSize);
+
+	if (ptr == last)
+	{
+		size_t offset = last - blocks[current].bytes;
+		if (offset + alignUp(newSize) <= blocks[current].size)
+		{
+			used = offset + alignUp(newSize);
+			updatePeak(heldBytes + used);
+			return ptr;
+		}
+	}
+
+	void* moved = allocate(newSize);
+	memcpy(moved, ptr, std::min(oldSize, newSize));
+	return moved;
+}
+
+LoadArena::Mark LoadArena::getMark() const
+{
+	Mark mark;
+	mark.block = current;
+	mark.used = used;
+	mark.heldBytes = heldBytes;
+	return mark;
+}
+
+void LoadArena::rewind(const Mark& mark)
+{
+	current = mark.block;
+	used = mark.used;
+	heldBytes = mark.heldBytes;
+	last = nullptr;
+}
+
+// Only between scopes, when nothing is allocated
+void LoadArena::trim()
+{
+	for (size_t i = 1; i < blocks.size(); i++)
+	{
+		::operator delete(blocks[i].bytes);
+	}
+	if (blocks.size() > 1) blocks.resize(1);
+}
+
+LoadArena& LoadArena::forThread()
+{
+	thread_local LoadArena arena;
+	return arena;
+}
+
+LoadArena* LoadArena::getCurrent()
+{
+	return currentArena;
+}
+
+void LoadArena::setEnabled(bool enable)
+{
+	enabled = enable;
+}
+
+bool LoadArena::isEnabled()
+{
+	return enabled;
+}
+
+void* LoadArena::allocateFrom(LoadArena* arena, size_t size)
+{
+	requestCount++;
+	if (arena) return arena->allocate(size);
+
+	heapCallCount++;
+	return ::operator new(size);
+}
+
+void LoadArena::releaseTo(LoadArena* arena, void* ptr, size_t size)
+{
+	if (arena)
+	{
+		arena->release(ptr, size);
+	}
+	else
+	{
+		::operator delete(ptr);
+	}
+}
+
+void* LoadArena::mallocScoped(size_t size)
+{
+	requestCount++;
+
+	ScopedHeader* header;
+	if (currentArena)
+	{
+		header = static_cast<ScopedHeader*>(currentArena->allocate(sizeof(ScopedHeader) + size));
+	}
+	else
+	{
+		heapCallCount++;
+		header = static_cast<ScopedHeader*>(malloc(sizeof(ScopedHeader) + size));
+		if (!header) return nullptr;
+	}
+
+	header->size = size;
+	header->arena = currentArena;
+	return header + 1;
+}
+
+void* LoadArena::reallocScoped(void* ptr, size_t size)
+{
+	if (ptr == nullptr) return mallocScoped(size);
+
+	requestCount++;
+
+	ScopedHeader* header = static_cast<ScopedHeader*>(ptr) - 1;
+	if (header->arena)
+	{
+		header = static_cast<ScopedHeader*>(header->arena->reallocate(header, sizeof(ScopedHeader) + header->size, sizeof(ScopedHeader) + size));
+	}
+	else
+	{
+		heapCallCount++;
+		header = static_cast<ScopedHeader*>(realloc(header, sizeof(ScopedHeader) + size));
+		if (!header) return nullptr;
+	}
+
+	header->size = size;
+	return header + 1;
+}
+
+void LoadArena::freeScoped(void* ptr)
+{
+	if (ptr == nullptr) return;
+
+	ScopedHeader* header = static_cast<ScopedHeader*>(ptr) - 1;
+	if (header->arena)
+	{
+		header->arena->release(header, sizeof(ScopedHeader) + header->size);
+	}
+	else
+	{
+		free(header);
+	}
+}
+
+LoadArenaStats LoadArena::getStats()
+{
+	LoadArenaStats stats;
+	stats.requests = requestCount;
+	stats.heapCalls = heapCallCount;
+	stats.blocks = blockCount;
+	stats.peakBytes = peakBytes;
+	return stats;
+}
+
+size_t LoadArena::getPeakResidentBytes()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+	return counters.PeakWorkingSetSize;
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+	return (size_t)usage.ru_maxrss * 1024;
+#endif
+}
+
+void LoadArena::printStats()
+{
+	LoadArenaStats stats = getStats();
+
+	std::cout << "Load arena: " << (enabled ? "on" : "off") << ", " << stats.requests << " allocation calls, " << stats.heapCalls << " went to the heap";
+	if (enabled) std::cout << " (" << stats.blocks << " arena blocks), " << stats.peakBytes / 1024 << " KB peak in one arena";
+	std::cout << ", " << getPeakResidentBytes() / (1024 * 1024) << " MB peak resident memory" << std::endl;
+}
+
+LoadArenaScope::LoadArenaScope(LoadArena& arena) : arena(nullptr), previous(nullptr)
+{
+	if (!enabled) return;
+
+	this->arena = &arena;
+	previous = LoadArena::currentArena;
+	LoadArena::currentArena = &arena;
+
+	mark = arena.getMark();
+	arena.depth++;
+}
+
+LoadArenaScope::~LoadArenaScope()
+{
+	if (!arena) return;
+
+	arena->rewind(mark);
+	if (--arena->depth == 0) arena->trim();
+
+	LoadArena::currentArena = previous;
+}
\ No newline at end of file
@@ -0,0 +1,139 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+struct LoadArenaStats
+{
+	size_t requests;		// allocations asked of the hooked paths; each was a heap call before the arena
+	size_t heapCalls;		// heap allocations they still make: arena blocks, plus requests outside any scope
+	size_t blocks;			// of those, arena blocks
+	size_t peakBytes;		// most any one arena held at once
+};
+
+// Linear allocator for the scratch memory of loading one asset: stb_image buffers, OBJ parser arrays and the
+// weld lookup of mesh construction. Allocations bump a pointer through blocks of BLOCK_SIZE, or one of their own
+// when bigger, and are given back all at once when the scope that made them ends; freeing the last allocation
+// also takes it back at once, which covers the alloc/free pairs stb_image and the ear clipper make per call.
+// Each thread has its own arena, so loading on workers takes no lock. Outside a scope, or with the arena
+// disabled, every request goes to the heap as before, and is still counted.
+class LoadArena
+{
+public:
+	static constexpr size_t BLOCK_SIZE = 4 * 1024 * 1024;
+
+	LoadArena();
+	~LoadArena();
+
+	LoadArena(const LoadArena&) = delete;
+	LoadArena& operator=(const LoadArena&) = delete;
+
+	// 16 byte aligned; lives until the scope it was made in ends
+	void* allocate(size_t size);
+	// Only takes the bytes back when ptr is the last allocation, of size bytes; the rest wait for the scope
+	void release(void* ptr, size_t size);
+	// Grows the last allocation in place when the block has room, else copies
+	void* reallocate(void* ptr, size_t oldSize, size_t newSize);
+
+	// This thread's arena, made on first use and freed with the thread. Between scopes it keeps its first
+	// block, so the next asset allocates nothing.
+	static LoadArena& forThread();
+	// The arena of the innermost scope on this thread, or nullptr outside any
+	static LoadArena* getCurrent();
+
+	// On by default. Off, scopes do nothing, to measure what loading costs without the arena.
+	static void setEnabled(bool enabled);
+	static bool isEnabled();
+
+	// For ArenaAllocator: arena, or the heap when it is nullptr
+	static void* allocateFrom(LoadArena* arena, size_t size);
+	static void releaseTo(LoadArena* arena, void* ptr, size_t size);
+
+	// STBI_MALLOC, STBI_REALLOC and STBI_FREE. Each allocation carries a header saying which arena it came
+	// from, if any, so buffers made outside a scope can be freed anywhere as before.
+	static void* mallocScoped(size_t size);
+	static void* reallocScoped(void* ptr, size_t size);
+	static void freeScoped(void* ptr);
+
+	static LoadArenaStats getStats();
+	// Peak working set of the process so far, in bytes; 0 where it cannot be read
+	static size_t getPeakResidentBytes();
+	static void printStats();
+
+private:
+	friend class LoadArenaScope;
+
+	struct Block
+	{
+		unsigned char* bytes;
+		size_t size;
+	};
+
+	// Position to rewind to when a scope ends
+	struct Mark
+	{
+		size_t block;
+		size_t used;
+		size_t heldBytes;
+	};
+
+	std::vector<Block> blocks;
+	size_t current;			// block being bumped through
+	size_t used;			// bytes of it taken
+	size_t heldBytes;		// taken in the blocks before current
+	unsigned char* last;	// start of the last allocation, while it can still be taken back
+	unsigned int depth;		// scopes open on this arena
+
+	static thread_local LoadArena* currentArena;
+
+	void* allocateSlow(size_t size);
+	Mark getMark() const;
+	void rewind(const Mark& mark);
+	void trim();
+};
+
+// Makes arena the one hooked allocations on this thread use until the scope ends, then gives back everything
+// allocated in it. Nothing allocated inside may outlive the scope. The outermost scope also trims the arena
+// to one block, so a large asset does not keep its memory once it is loaded.
+class LoadArenaScope
+{
+public:
+	explicit LoadArenaScope(LoadArena& arena);
+	~LoadArenaScope();
+
+	LoadArenaScope(const LoadArenaScope&) = delete;
+	LoadArenaScope& operator=(const LoadArenaScope&) = delete;
+
+private:
+	LoadArena* arena;		// nullptr while the arena is disabled
+	LoadArena* previous;
+	LoadArena::Mark mark;
+};
+
+// Standard allocator over the arena current when it was made, or the heap outside a scope
+template <typename T>
+class ArenaAllocator
+{
+public:
+	using value_type = T;
+
+	ArenaAllocator() : arena(LoadArena::getCurrent()) {}
+	explicit ArenaAllocator(LoadArena* arena) : arena(arena) {}
+	template <typename U>
+	ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.getArena()) {}
+
+	T* allocate(size_t n) { return static_cast<T*>(LoadArena::allocateFrom(arena, n * sizeof(T))); }
+	void deallocate(T* ptr, size_t n) { LoadArena::releaseTo(arena, ptr, n * sizeof(T)); }
+
+	LoadArena* getArena() const { return arena; }
+
+	template <typename U>
+	bool operator==(const ArenaAllocator<U>& other) const { return arena == other.getArena(); }
+	template <typename U>
+	bool operator!=(const ArenaAllocator<U>& other) const { return arena != other.getArena(); }
+
+private:
+	LoadArena* arena;
+};
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
\ No newline at end of file
@@ -2,6 +2,7 @@
 #include <GLFW/glfw3.h>
 #include "simpleapp.h"
 #include "../camera/camera_base.h"
+#include "../shader/shader_utils.h"
 
 // READ!
 // Scene lifecycle:
@@ -43,6 +44,7 @@ public:
 	inline void step_loadShaders()
 	{
 		loadShaders();
+		ShaderUtils::printProgramCacheStats();
 	}
 
 	void step_update();
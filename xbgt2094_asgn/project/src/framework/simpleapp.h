@@ -10,7 +10,7 @@ typedef void (*AppKeyFunc)(int key, int scancode, int action);
 class App
 {
 	// Allow main() entry function to call private member functions
-	friend int main();
+	friend int main(int argc, char** argv);
 
 	// All functions are static because internally it uses
 	// the singleton.
@@ -2,9 +2,22 @@
 #include "simpleapp.h"
 #include <glad/glad.h>
 #include <iostream>
+#include "../mesh/vertex_format.h"
+#include "../texture/texture_streaming.h"
 
 static Shader* currentShader;
 static unsigned int handle;
+static UniformStats uniformStats;
+
+// From the bound shader's table of active uniforms; -1, which glUniform* ignores, when it has no such uniform
+static int getLocation(UniformId name)
+{
+	uniformStats.sets++;
+
+	int location = currentShader ? currentShader->getUniformLocation(name) : -1;
+	if (location < 0) uniformStats.inactive++;
+	return location;
+}
 
 void SimpleRenderer::bindShader(Shader* shader)
 {
@@ -22,117 +35,127 @@ void SimpleRenderer::bindShader(Shader* shader)
 	currentShader = shader;
 }
 
-void SimpleRenderer::setShaderProp_Bool(const std::string& name, bool v)
+const UniformStats& SimpleRenderer::getUniformStats()
 {
-	glUniform1i(glGetUniformLocation(handle, name.c_str()), (int)v);
+	return uniformStats;
 }
 
-void SimpleRenderer::setShaderProp_Integer(const std::string& name, int i)
+void SimpleRenderer::resetUniformStats()
 {
-	glUniform1i(glGetUniformLocation(handle, name.c_str()), i);
+	uniformStats = {};
 }
 
-void SimpleRenderer::setShaderProp_UnsignedInteger(const std::string& name, unsigned int i)
+void SimpleRenderer::setShaderProp_Bool(UniformId name, bool v)
 {
-	glUniform1ui(glGetUniformLocation(handle, name.c_str()), i);
+	glUniform1i(getLocation(name), (int)v);
 }
 
-void SimpleRenderer::setShaderProp_Float(const std::string& name, float f)
+void SimpleRenderer::setShaderProp_Integer(UniformId name, int i)
 {
-	glUniform1f(glGetUniformLocation(handle, name.c_str()), f);
+	glUniform1i(getLocation(name), i);
 }
 
-void SimpleRenderer::setShaderProp_Vec2(const std::string& name, const glm::vec2& v)
+void SimpleRenderer::setShaderProp_UnsignedInteger(UniformId name, unsigned int i)
 {
-	glUniform2fv(glGetUniformLocation(handle, name.c_str()), 1, &v[0]);
+	glUniform1ui(getLocation(name), i);
 }
 
-void SimpleRenderer::setShaderProp_Vec2(const std::string& name, float x, float y)
+void SimpleRenderer::setShaderProp_Float(UniformId name, float f)
 {
-	glUniform2f(glGetUniformLocation(handle, name.c_str()), x, y);
+	glUniform1f(getLocation(name), f);
 }
 
-void SimpleRenderer::setShaderProp_Vec3(const std::string& name, const glm::vec3& v)
+void SimpleRenderer::setShaderProp_Vec2(UniformId name, const glm::vec2& v)
 {
-	glUniform3fv(glGetUniformLocation(handle, name.c_str()), 1, &v[0]);
+	glUniform2fv(getLocation(name), 1, &v[0]);
 }
 
-void SimpleRenderer::setShaderProp_Vec3(const std::string& name, float x, float y, float z)
+void SimpleRenderer::setShaderProp_Vec2(UniformId name, float x, float y)
 {
-	glUniform3f(glGetUniformLocation(handle, name.c_str()), x, y, z);
+	glUniform2f(getLocation(name), x, y);
 }
 
-void SimpleRenderer::setShaderProp_Vec4(const std::string& name, const glm::vec4 v)
+void SimpleRenderer::setShaderProp_Vec3(UniformId name, const glm::vec3& v)
 {
-	glUniform4fv(glGetUniformLocation(handle, name.c_str()), 1, &v[0]);
+	glUniform3fv(getLocation(name), 1, &v[0]);
 }
 
-void SimpleRenderer::setShaderProp_Vec4(const std::string& name, float x, float y, float z, float w)
+void SimpleRenderer::setShaderProp_Vec3(UniformId name, float x, float y, float z)
 {
-	glUniform4f(glGetUniformLocation(handle, name.c_str()), x, y, z, w);
+	glUniform3f(getLocation(name), x, y, z);
 }
 
-void SimpleRenderer::setShaderProp_Mat2(const std::string& name, const glm::mat2& mat)
+void SimpleRenderer::setShaderProp_Vec4(UniformId name, const glm::vec4 v)
 {
-	glUniformMatrix2fv(glGetUniformLocation(handle, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+	glUniform4fv(getLocation(name), 1, &v[0]);
 }
 
-void SimpleRenderer::setShaderProp_Mat3(const std::string& name, const glm::mat3& mat)
+void SimpleRenderer::setShaderProp_Vec4(UniformId name, float x, float y, float z, float w)
 {
-	glUniformMatrix3fv(glGetUniformLocation(handle, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+	glUniform4f(getLocation(name), x, y, z, w);
 }
 
-void SimpleRenderer::setShaderProp_Mat4(const std::string& name, const glm::mat4& mat)
+void SimpleRenderer::setShaderProp_Mat2(UniformId name, const glm::mat2& mat)
 {
-	glUniformMatrix4fv(glGetUniformLocation(handle, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+	glUniformMatrix2fv(getLocation(name), 1, GL_FALSE, &mat[0][0]);
 }
 
-void SimpleRenderer::setTexture_0(Texture2D* texture)
+void SimpleRenderer::setShaderProp_Mat3(UniformId name, const glm::mat3& mat)
 {
-	glActiveTexture(GL_TEXTURE0);
+	glUniformMatrix3fv(getLocation(name), 1, GL_FALSE, &mat[0][0]);
+}
+
+void SimpleRenderer::setShaderProp_Mat4(UniformId name, const glm::mat4& mat)
+{
+	glUniformMatrix4fv(getLocation(name), 1, GL_FALSE, &mat[0][0]);
+}
+
+// Every 2D texture bind goes through here, so residency knows what was used last
+static void bindTexture(GLenum unit, Texture2D* texture)
+{
+	glActiveTexture(unit);
 	glBindTexture(GL_TEXTURE_2D, texture->getNativeHandle());
+	TextureStreaming::markBound(texture);
+}
+
+void SimpleRenderer::setTexture_0(Texture2D* texture)
+{
+	bindTexture(GL_TEXTURE0, texture);
 }
 
 void SimpleRenderer::setTexture_1(Texture2D* texture)
 {
-	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_2D, texture->getNativeHandle());
+	bindTexture(GL_TEXTURE1, texture);
 }
 
 void SimpleRenderer::setTexture_2(Texture2D* texture)
 {
-	glActiveTexture(GL_TEXTURE2);
-	glBindTexture(GL_TEXTURE_2D, texture->getNativeHandle());
+	bindTexture(GL_TEXTURE2, texture);
 }
 
 void SimpleRenderer::setTexture_3(Texture2D* texture)
 {
-	glActiveTexture(GL_TEXTURE3);
-	glBindTexture(GL_TEXTURE_2D, texture->getNativeHandle());
+	bindTexture(GL_TEXTURE3, texture);
 }
 
 void SimpleRenderer::setTexture_4(Texture2D* texture)
 {
-	glActiveTexture(GL_TEXTURE4);
-	glBindTexture(GL_TEXTURE_2D, texture->getNativeHandle());
+	bindTexture(GL_TEXTURE4, texture);
 }
 
 void SimpleRenderer::setTexture_5(Texture2D* texture)
 {
-	glActiveTexture(GL_TEXTURE5);
-	glBindTexture(GL_TEXTURE_2D, texture->getNativeHandle());
+	bindTexture(GL_TEXTURE5, texture);
 }
 
 void SimpleRenderer::setTexture_6(Texture2D* texture)
 {
-	glActiveTexture(GL_TEXTURE6);
-	glBindTexture(GL_TEXTURE_2D, texture->getNativeHandle());
+	bindTexture(GL_TEXTURE6, texture);
 }
 
 void SimpleRenderer::setTexture_7(Texture2D* texture)
 {
-	glActiveTexture(GL_TEXTURE7);
-	glBindTexture(GL_TEXTURE_2D, texture->getNativeHandle());
+	bindTexture(GL_TEXTURE7, texture);
 }
 
 void SimpleRenderer::setTexture_X(int id, Texture2D* texture)
@@ -143,8 +166,7 @@ void SimpleRenderer::setTexture_X(int id, Texture2D* texture)
 		return;
 	}
 
-	glActiveTexture(GL_TEXTURE0 + id);
-	glBindTexture(GL_TEXTURE_2D, texture->getNativeHandle());
+	bindTexture(GL_TEXTURE0 + id, texture);
 }
 
 void SimpleRenderer::setTexture_X(int id, DepthFBO* depthFBO)
@@ -159,6 +181,32 @@ void SimpleRenderer::setTexture_X(int id, DepthFBO* depthFBO)
 	glBindTexture(GL_TEXTURE_2D, depthFBO->getNativeHandle());
 }
 
+void SimpleRenderer::setTextureArray_X(int id, TextureArray* textureArray)
+{
+	// Ensure the index is within the valid range for texture units (0 to GL_TEXTURE31)
+	if (id < 0 || id > 31) {
+		std::cerr << "Error: Texture unit index out of range (0-31)." << std::endl;
+		return;
+	}
+
+	glActiveTexture(GL_TEXTURE0 + id);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, textureArray->getNativeHandle());
+}
+
+void SimpleRenderer::setVirtualTexture_X(int pageTableId, int cacheId, VirtualTexture* virtualTexture)
+{
+	// Ensure the index is within the valid range for texture units (0 to GL_TEXTURE31)
+	if (pageTableId < 0 || pageTableId > 31 || cacheId < 0 || cacheId > 31) {
+		std::cerr << "Error: Texture unit index out of range (0-31)." << std::endl;
+		return;
+	}
+
+	glActiveTexture(GL_TEXTURE0 + pageTableId);
+	glBindTexture(GL_TEXTURE_2D, virtualTexture->getPageTableHandle());
+	glActiveTexture(GL_TEXTURE0 + cacheId);
+	glBindTexture(GL_TEXTURE_2D, virtualTexture->getCacheHandle());
+}
+
 void SimpleRenderer::setTexture_skybox(Cubemap* cubemap)
 {
 	if (cubemap == 0)
@@ -171,24 +219,56 @@ void SimpleRenderer::setTexture_skybox(Cubemap* cubemap)
 	glBindTexture(GL_TEXTURE_CUBE_MAP, cubemap->getNativeHandle());
 }
 
-void SimpleRenderer::drawMesh(Mesh* mesh)
+// Sets the per-mesh vertex decoding and binds the VAO; false when there is nothing to draw
+bool SimpleRenderer::bindMesh(Mesh* mesh)
 {
-	unsigned int VAO = 0;
-
-	if (mesh != nullptr)
+	if (mesh == nullptr || mesh->VAO == 0)
 	{
-		VAO = mesh->VAO;
+		std::cout << "Mesh not set!" << std::endl;
+		return false;
 	}
 
-	if (VAO != 0) {
-		unsigned int vSize = mesh->vertices.size();
-		glBindVertexArray(VAO);
-		glDrawArrays(GL_TRIANGLES, 0, vSize);
-		glBindVertexArray(0);
+	// Decoding for packed vertex formats; identity for full float vertices
+	if (handle != 0)
+	{
+		glUniform3fv(getLocation("vertexPositionScale"), 1, &mesh->decode.positionScale[0]);
+		glUniform3fv(getLocation("vertexPositionBias"), 1, &mesh->decode.positionBias[0]);
+		glUniform4fv(getLocation("vertexUvScaleBias"), 1, &mesh->decode.uvScaleBias[0]);
+		glUniform1i(getLocation("vertexOctEncoded"), mesh->format != VertexFormat::Full);
 	}
-	else {
-		std::cout << "Mesh not set!" << std::endl;
+
+	// Formats without colour read the current generic attribute value instead
+	if (!VertexFormatUtils::hasColour(mesh->format))
+	{
+		glVertexAttrib4f(3, 1.0f, 1.0f, 1.0f, 1.0f);
 	}
+
+	glBindVertexArray(mesh->VAO);
+	return true;
+}
+
+void SimpleRenderer::drawMesh(Mesh* mesh, unsigned int lod)
+{
+	if (!bindMesh(mesh)) return;
+
+	// Every level of detail is a range of the same index buffer
+	const MeshLod& range = mesh->getLod(lod);
+	glDrawElements(GL_TRIANGLES, range.indexCount, GL_UNSIGNED_INT, (void*)(range.indexOffset * sizeof(unsigned int)));
+
+	glBindVertexArray(0);
+}
+
+// One call for every visible run of meshlets
+void SimpleRenderer::drawMesh(Mesh* mesh, const MeshletDrawList& drawList)
+{
+	static_assert(sizeof(GLsizei) == sizeof(int), "MeshletDrawList counts are passed as GLsizei");
+
+	if (drawList.counts.empty()) return;
+	if (!bindMesh(mesh)) return;
+
+	glMultiDrawElements(GL_TRIANGLES, drawList.counts.data(), GL_UNSIGNED_INT, drawList.offsets.data(), (GLsizei)drawList.counts.size());
+
+	glBindVertexArray(0);
 }
 
 void SimpleRenderer::bindFBO(FBO* fbo)
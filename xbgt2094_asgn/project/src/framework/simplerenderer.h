@@ -1,10 +1,19 @@
 #pragma once
 #include "../shader/shader.h"
 #include "../mesh/mesh.h"
+#include "../mesh/meshlet.h"
 #include "../texture/texture2d.h"
 #include "../texture/cubemap.h"
+#include "../texture/texture_array.h"
+#include "../texture/virtual_texture.h"
 #include "../fbo/fbo.h"
 
+struct UniformStats
+{
+	unsigned int sets;		// setShaderProp_* calls, and the vertex decoding set per mesh
+	unsigned int inactive;	// of those, names the bound shader has no active uniform for
+};
+
 class SimpleRenderer
 {
 public:
@@ -12,21 +21,26 @@ public:
 
 	static void bindShader(Shader* shader);
 
-	static void setShaderProp_Bool(const std::string& name, bool v);
-	static void setShaderProp_Integer(const std::string& name, int i);
-	static void setShaderProp_UnsignedInteger(const std::string& name, unsigned int i);
-	static void setShaderProp_Float(const std::string& name, float f);
+	// Names are looked up in the bound shader's location table, so a literal costs a hash known at compile time
+	// and no string. Since the last reset; the scene resets them every frame.
+	static const UniformStats& getUniformStats();
+	static void resetUniformStats();
 
-	static void setShaderProp_Vec2(const std::string& name, const glm::vec2& v);
-	static void setShaderProp_Vec2(const std::string& name, float x, float y);
-	static void setShaderProp_Vec3(const std::string& name, const glm::vec3& v);
-	static void setShaderProp_Vec3(const std::string& name, float x, float y, float z);
-	static void setShaderProp_Vec4(const std::string& name, const glm::vec4 v);
-	static void setShaderProp_Vec4(const std::string& name, float x, float y, float z, float w);
+	static void setShaderProp_Bool(UniformId name, bool v);
+	static void setShaderProp_Integer(UniformId name, int i);
+	static void setShaderProp_UnsignedInteger(UniformId name, unsigned int i);
+	static void setShaderProp_Float(UniformId name, float f);
 
-	static void setShaderProp_Mat2(const std::string& name, const glm::mat2& mat);
-	static void setShaderProp_Mat3(const std::string& name, const glm::mat3& mat);
-	static void setShaderProp_Mat4(const std::string& name, const glm::mat4& mat);
+	static void setShaderProp_Vec2(UniformId name, const glm::vec2& v);
+	static void setShaderProp_Vec2(UniformId name, float x, float y);
+	static void setShaderProp_Vec3(UniformId name, const glm::vec3& v);
+	static void setShaderProp_Vec3(UniformId name, float x, float y, float z);
+	static void setShaderProp_Vec4(UniformId name, const glm::vec4 v);
+	static void setShaderProp_Vec4(UniformId name, float x, float y, float z, float w);
+
+	static void setShaderProp_Mat2(UniformId name, const glm::mat2& mat);
+	static void setShaderProp_Mat3(UniformId name, const glm::mat3& mat);
+	static void setShaderProp_Mat4(UniformId name, const glm::mat4& mat);
 
 	static void setTexture_0(Texture2D* texture);
 	static void setTexture_1(Texture2D* texture);
@@ -38,11 +52,18 @@ public:
 	static void setTexture_7(Texture2D* texture);
 	static void setTexture_X(int id, Texture2D* texture);
 	static void setTexture_X(int id, DepthFBO* depthFBO);
+	static void setTextureArray_X(int id, TextureArray* textureArray);
+	// The page table on one unit and the page cache on another
+	static void setVirtualTexture_X(int pageTableId, int cacheId, VirtualTexture* virtualTexture);
 
 	static void setTexture_skybox(Cubemap* cubemap);
 
-	static void drawMesh(Mesh* mesh);
+	static void drawMesh(Mesh* mesh, unsigned int lod = 0);
+	static void drawMesh(Mesh* mesh, const MeshletDrawList& drawList);
 
 	static void bindFBO(FBO* fbo);
 	static void bindFBO_Default();
+
+private:
+	static bool bindMesh(Mesh* mesh);
 };
@@ -6,6 +6,7 @@
 #include "../framework/simplerenderer.h"
 #include "../shader/shader_utils.h"
 #include "../mesh/mesh_utils.h"
+#include "../mesh/mesh_cache.h"
 #include "../mesh/debugmesh.h"
 #include "../camera/camera_base.h"
 
@@ -49,9 +50,10 @@ static glm::mat4 getRotation(glm::vec3 dir)
 
 void LightDebug::drawDebug(LightBase* light)
 {
-	static Mesh* ico = MeshUtils::loadObjFile("../assets/app/models/icosphere.obj");
-	static Mesh* tip = MeshUtils::loadObjFile("../assets/app/models/arrowtip.obj");
-	static Mesh* body = MeshUtils::loadObjFile("../assets/app/models/arrowbody.obj");
+	// lightV reads raw float positions and colours
+	static Mesh* ico = MeshCache::acquire("../assets/app/models/icosphere.obj", VertexFormat::Full);
+	static Mesh* tip = MeshCache::acquire("../assets/app/models/arrowtip.obj", VertexFormat::Full);
+	static Mesh* body = MeshCache::acquire("../assets/app/models/arrowbody.obj", VertexFormat::Full);
 
 	switch (light->getType())
 	{
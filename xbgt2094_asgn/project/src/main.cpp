@@ -1,3 +1,8 @@
+#include "framework/load_arena.h"
+// stb_image's buffers come from the load arena while an asset is being loaded
+#define STBI_MALLOC(size) LoadArena::mallocScoped(size)
+#define STBI_REALLOC(ptr, size) LoadArena::reallocScoped(ptr, size)
+#define STBI_FREE(ptr) LoadArena::freeScoped(ptr)
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image/stb_image.h>
 #include <glad/glad.h>
@@ -5,8 +10,18 @@
 #include <GLFW/glfw3.h>
 
 #include <iostream>
+#include <cstring>
 
 #include "camera/camera_flying.h"
+#include "mesh/meshlet.h"
+#include "mesh/obj_parser.h"
+#include "mesh/tangent_space.h"
+#include "mesh/vertex_format.h"
+#include "texture/mip_chain.h"
+#include "texture/texture_compressor.h"
+#include "texture/texture_container.h"
+#include "texture/texture_utils.h"
+#include "texture/virtual_texture.h"
 #include "scene_asgn.h"
 
 const unsigned int SCREEN_WIDTH = 1024;
@@ -21,8 +36,76 @@ void mouse_button_callback(int button, int action);
 void scroll_callback(double xoffset, double yoffset);
 void key_callback(int key, int scancode, int action);
 
-int main(void)
+int main(int argc, char** argv)
 {
+	// Offline OBJ parser comparison; does not need a window or GL context
+	if (argc > 1 && strcmp(argv[1], "--bench-obj") == 0)
+	{
+		ObjParserUtils::runBenchmark("../assets", 10000000);
+		return EXIT_SUCCESS;
+	}
+
+	// Offline meshlet culling measurement, also without a window
+	if (argc > 1 && strcmp(argv[1], "--bench-meshlets") == 0)
+	{
+		MeshletUtils::runBenchmark("../assets");
+		return EXIT_SUCCESS;
+	}
+
+	// Offline tangent generation timing and bit-identity check
+	if (argc > 1 && strcmp(argv[1], "--bench-tangents") == 0)
+	{
+		TangentSpaceUtils::runBenchmark("../assets");
+		return EXIT_SUCCESS;
+	}
+
+	// Offline quantisation check of every mesh in each vertex format; fails past the error limits
+	if (argc > 1 && strcmp(argv[1], "--bench-vertex-formats") == 0)
+	{
+		return VertexFormatUtils::runBenchmark("../assets") ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	// Offline image decode scaling across cores
+	if (argc > 1 && strcmp(argv[1], "--bench-textures") == 0)
+	{
+		TextureUtils::runDecodeBenchmark("../assets");
+		return EXIT_SUCCESS;
+	}
+
+	// Offline BCn cook of every texture: size, PSNR and encode time
+	if (argc > 1 && strcmp(argv[1], "--bench-bcn") == 0)
+	{
+		TextureCompressorUtils::runBenchmark("../assets");
+		return EXIT_SUCCESS;
+	}
+
+	// Offline DDS and KTX2 write and parse of every cooked texture, checked byte for byte
+	if (argc > 1 && strcmp(argv[1], "--bench-containers") == 0)
+	{
+		TextureContainerUtils::runBenchmark("../assets");
+		return EXIT_SUCCESS;
+	}
+
+	// Offline mip filter timing and alpha tested coverage down the chain
+	if (argc > 1 && strcmp(argv[1], "--bench-mips") == 0)
+	{
+		MipChainUtils::runBenchmark("../assets");
+		return EXIT_SUCCESS;
+	}
+
+	// Offline virtual texture tile bake and page manager check
+	if (argc > 1 && strcmp(argv[1], "--bench-vt") == 0)
+	{
+		VirtualTextureUtils::runBenchmark("../assets");
+		return EXIT_SUCCESS;
+	}
+
+	// Load without the arena, for the before numbers of the allocation counts printed after loading
+	if (argc > 1 && strcmp(argv[1], "--no-load-arena") == 0)
+	{
+		LoadArena::setEnabled(false);
+	}
+
 	int result = App::init(SCREEN_WIDTH, SCREEN_HEIGHT, WINDOW_TITLE);
 
 	if (!result)
@@ -1,34 +1,33 @@
 #include "mesh.h"
 #include <glad/glad.h>
 #include <iostream>
-#include "mikktspace.h"
+#include <cstring>
+#include <unordered_map>
+#include "tangent_space.h"
+#include "vertex_format.h"
 #include <glm/gtx/string_cast.hpp>
+#include "../framework/file_utils.h"
+#include "../framework/load_arena.h"
 
-static SMikkTSpaceContext context;
-static SMikkTSpaceInterface iface;
+// Vertex is welded by comparing its raw bytes, so it must not contain padding.
+static_assert(sizeof(Vertex) == sizeof(float) * 15, "Vertex must be tightly packed");
 
-static int get_num_faces_fn(const SMikkTSpaceContext* context);
-static int get_num_vertices_of_face_fn(const SMikkTSpaceContext* context, int iFace);
-static void get_position_fn(const SMikkTSpaceContext* context, float outpos[], int iFace, int iVert);
-static void get_normal_fn(const SMikkTSpaceContext* context, float outnormal[], int iFace, int iVert);
-static void get_uv_fn(const SMikkTSpaceContext* context, float outuv[], int iFace, int iVert);
-static void set_tspace_basic_fn(const SMikkTSpaceContext* context, const float tangentu[], float fSign, int iFace, int iVert);
-
-static void calcTangents(Mesh* mesh)
+// FNV-1a over the vertex bytes. Only bit-identical vertices are merged.
+struct VertexHash
 {
-	iface.m_getNumFaces = get_num_faces_fn;
-	iface.m_getNumVerticesOfFace = get_num_vertices_of_face_fn;
-	iface.m_getNormal = get_normal_fn;
-	iface.m_getPosition = get_position_fn;
-	iface.m_getTexCoord = get_uv_fn;
-
-	iface.m_setTSpaceBasic = set_tspace_basic_fn;
-
-	context.m_pInterface = &iface;
-	context.m_pUserData = mesh;
+	size_t operator()(const Vertex& vertex) const
+	{
+		return (size_t)FileUtils::hashBytes(&vertex, sizeof(Vertex));
+	}
+};
 
-	genTangSpaceDefault(&context);
-}
+struct VertexEqual
+{
+	bool operator()(const Vertex& a, const Vertex& b) const
+	{
+		return std::memcmp(&a, &b, sizeof(Vertex)) == 0;
+	}
+};
 
 Vertex::Vertex()
 	: position(0.0f), normal(0.0f), uv(0.0f), colour(1.0f), tangent(0.0f) {}
@@ -41,116 +40,160 @@ Vertex::Vertex(glm::vec3 position, glm::vec3 normal, glm::vec2 uv)
 Vertex::Vertex(glm::vec3 position, glm::vec3 normal, glm::vec2 uv, glm::vec3 colour)
 	: position(position), normal(normal), uv(uv), colour(colour), tangent(0.0f) {}
 
-Mesh::Mesh(std::vector<Vertex> vertices) : vertices(vertices)
+// vertices is a triangle list with one entry per face corner.
+// Tangents are generated per corner first, then identical corners are welded.
+Mesh::Mesh(std::vector<Vertex> vertices) : vertices(vertices), VAO(0), VBO(0), EBO(0), vertexCount(0), indexCount(0), format(VertexFormat::Full), boundsCenter(0.0f), boundsRadius(0.0f)
 {
-	calcTangents(this);
+	prepare();
 	setup();
 }
 
-Mesh::Mesh()
+Mesh::Mesh() : VAO(0), VBO(0), EBO(0), vertexCount(0), indexCount(0), format(VertexFormat::Full), boundsCenter(0.0f), boundsRadius(0.0f)
 {
 }
 
 Mesh::~Mesh()
 {
+	// Never uploaded, e.g. processed on the CPU only
+	if (VAO == 0) return;
+
+	glDeleteBuffers(1, &EBO);
 	glDeleteBuffers(1, &VBO);
 	glDeleteVertexArrays(1, &VAO);
 }
 
-void Mesh::setup()
+VertexFormat Mesh::getVertexFormat() const
 {
-	// Create VAO and VBO
-	// VAO: Vertex Array Object
-	// VBO: Vertex Buffer Object
-	glGenVertexArrays(1, &VAO);
-	glGenBuffers(1, &VBO);
-
-	glBindVertexArray(VAO);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-
-	// Upload mesh data to the GPU
-	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
-
-	// Specify the layout of the vertices we just uploaded
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, uv));
-	glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, colour));
-	glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, tangent));
-
-	glEnableVertexAttribArray(0);
-	glEnableVertexAttribArray(1);
-	glEnableVertexAttribArray(2);
-	glEnableVertexAttribArray(3);
-	glEnableVertexAttribArray(4);
-
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindVertexArray(0);
+	return format;
 }
 
-static int get_num_faces_fn(const SMikkTSpaceContext* context)
+unsigned int Mesh::getLodCount() const
 {
-	Mesh* mesh = static_cast<Mesh*>(context->m_pUserData);
-
-	float f_size = (float)mesh->vertices.size() / 3.f;
-	int i_size = (int)mesh->vertices.size() / 3;
-
-	assert((f_size - (float)i_size) == 0.f);
-
-	return i_size;
+	return (unsigned int)lods.size();
 }
 
-static int get_num_vertices_of_face_fn(const SMikkTSpaceContext* context, int iFace)
+const MeshLod& Mesh::getLod(unsigned int lod) const
 {
-	//Mesh* mesh = static_cast<Mesh*>(context->m_pUserData);
+	return lods[lod < lods.size() ? lod : lods.size() - 1];
+}
 
-	return 3;
+size_t Mesh::getGpuBytes() const
+{
+	return (size_t)vertexCount * VertexFormatUtils::getStride(format) + (size_t)indexCount * sizeof(unsigned int);
 }
 
-static void get_position_fn(const SMikkTSpaceContext* context, float outpos[], int iFace, int iVert)
+glm::vec3 Mesh::getBoundsCenter() const
 {
-	Mesh* mesh = static_cast<Mesh*>(context->m_pUserData);
+	return boundsCenter;
+}
 
-	auto index = iFace * 3 + iVert;
-	auto vertex = mesh->vertices[index];
+float Mesh::getBoundsRadius() const
+{
+	return boundsRadius;
+}
 
-	outpos[0] = vertex.position.x;
-	outpos[1] = vertex.position.y;
-	outpos[2] = vertex.position.z;
+const std::vector<Meshlet>& Mesh::getMeshlets() const
+{
+	return meshlets;
 }
 
-static void get_normal_fn(const SMikkTSpaceContext* context, float outnormal[], int iFace, int iVert)
+// Turns the triangle list in vertices into welded vertices and indices, ready to upload.
+void Mesh::prepare()
 {
-	Mesh* mesh = static_cast<Mesh*>(context->m_pUserData);
+	TangentSpaceUtils::generate(vertices);
+	weld();
+}
 
-	auto index = iFace * 3 + iVert;
-	auto vertex = mesh->vertices[index];
+void Mesh::weld()
+{
+	// Merge identical position/normal/uv/colour/tangent tuples into one vertex
+	// and replace the triangle list with indices into the unique vertices.
+	// One node per unique vertex, all dropped at the end, so they come from the load arena when there is one
+	std::unordered_map<Vertex, unsigned int, VertexHash, VertexEqual, ArenaAllocator<std::pair<const Vertex, unsigned int>>> lookup;
+	lookup.reserve(vertices.size());
+
+	std::vector<Vertex> unique;
+	unique.reserve(vertices.size());
+
+	indices.clear();
+	indices.reserve(vertices.size());
+
+	for (const Vertex& vertex : vertices)
+	{
+		auto result = lookup.emplace(vertex, (unsigned int)unique.size());
+		if (result.second)
+		{
+			unique.push_back(vertex);
+		}
+		indices.push_back(result.first->second);
+	}
+
+	unique.shrink_to_fit();
+	vertices.swap(unique);
+}
 
-	outnormal[0] = vertex.normal.x;
-	outnormal[1] = vertex.normal.y;
-	outnormal[2] = vertex.normal.z;
+void Mesh::setup()
+{
+	setup(vertices.data(), (unsigned int)vertices.size(), indices.data(), (unsigned int)indices.size());
 }
 
-static void get_uv_fn(const SMikkTSpaceContext* context, float outuv[], int iFace, int iVert)
+void Mesh::setup(const Vertex* vertexData, unsigned int numVertices, const unsigned int* indexData, unsigned int numIndices)
 {
-	Mesh* mesh = static_cast<Mesh*>(context->m_pUserData);
+	vertexCount = numVertices;
+	indexCount = numIndices;
+
+	// Without a LOD chain the whole index buffer is the only level
+	if (lods.empty())
+	{
+		lods.push_back({ 0, numIndices, 0.0f });
+	}
+
+	// Bounding sphere around the box, for picking a level by screen size
+	if (numVertices > 0)
+	{
+		glm::vec3 minPosition = vertexData[0].position, maxPosition = vertexData[0].position;
+		for (unsigned int i = 1; i < numVertices; i++)
+		{
+			minPosition = glm::min(minPosition, vertexData[i].position);
+			maxPosition = glm::max(maxPosition, vertexData[i].position);
+		}
+		boundsCenter = (minPosition + maxPosition) * 0.5f;
+		boundsRadius = glm::length(maxPosition - minPosition) * 0.5f;
+	}
+
+	// Convert to the requested storage format; format must be set before calling setup
+	format = VertexFormatUtils::resolve(format, vertexData, numVertices);
+	std::vector<unsigned char> packed;
+	const void* bufferData = vertexData;
+	decode = VertexFormatUtils::getIdentityDecode();
+
+	if (format != VertexFormat::Full)
+	{
+		decode = VertexFormatUtils::pack(format, vertexData, numVertices, packed);
+		bufferData = packed.data();
+	}
+
+	// Create VAO, VBO and EBO
+	// VAO: Vertex Array Object
+	// VBO: Vertex Buffer Object
+	// EBO: Element Buffer Object (indices)
+	glGenVertexArrays(1, &VAO);
+	glGenBuffers(1, &VBO);
+	glGenBuffers(1, &EBO);
 
-	auto index = iFace * 3 + iVert;
-	auto vertex = mesh->vertices[index];
+	glBindVertexArray(VAO);
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
 
-	outuv[0] = vertex.uv.x;
-	outuv[1] = vertex.uv.y;
-}
+	// Upload mesh data to the GPU
+	glBufferData(GL_ARRAY_BUFFER, numVertices * VertexFormatUtils::getStride(format), bufferData, GL_STATIC_DRAW);
 
-static void set_tspace_basic_fn(const SMikkTSpaceContext* context, const float tangentu[], float fSign, int iFace, int iVert)
-{
-	Mesh* mesh = static_cast<Mesh*>(context->m_pUserData);
+	// The element buffer binding is stored in the VAO, so it stays bound below
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, numIndices * sizeof(unsigned int), indexData, GL_STATIC_DRAW);
 
-	auto index = iFace * 3 + iVert;
-	auto* vertex = &mesh->vertices[index];
+	// Specify the layout of the vertices we just uploaded
+	VertexFormatUtils::setupAttributes(format);
 
-	vertex->tangent.x = tangentu[0];
-	vertex->tangent.y = tangentu[1];
-	vertex->tangent.z = tangentu[2];
-	vertex->tangent.w = fSign;
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindVertexArray(0);
 }
\ No newline at end of file
@@ -18,19 +18,84 @@ struct Vertex {
 	Vertex(glm::vec3 position, glm::vec3 normal, glm::vec2 uv, glm::vec3 colour);
 };
 
+// How a mesh's vertices are stored in its VBO. The CPU side always keeps full Vertex data.
+enum class VertexFormat
+{
+	Full,			// Vertex as is, 60 bytes
+	Packed,			// PackedVertex, 20 bytes; becomes PackedColour when the mesh has non-white colours
+	PackedColour	// PackedColourVertex, 24 bytes
+};
+
+// Maps stored attribute values back to model space; identity for VertexFormat::Full
+struct VertexDecode
+{
+	glm::vec3 positionScale;
+	glm::vec3 positionBias;
+	glm::vec4 uvScaleBias;	// xy scale, zw bias
+};
+
+// One level of detail: a range of the mesh's index buffer over the shared vertices
+struct MeshLod
+{
+	unsigned int indexOffset;
+	unsigned int indexCount;
+	float error;	// largest model space distance from the full mesh
+};
+
+// Cluster of neighbouring LOD 0 triangles that is culled as a whole
+struct Meshlet
+{
+	unsigned int indexOffset;	// first index in the mesh's index buffer
+	unsigned int triangleCount;
+	unsigned int vertexCount;
+	glm::vec3 center;			// bounding sphere
+	float radius;
+	glm::vec3 coneAxis;			// average triangle normal
+	float coneCutoff;			// sine of the angle between the axis and the furthest normal; 1 when it can never be backfacing
+};
+
 class Mesh
 {
 	friend class SimpleRenderer;
 	friend class MeshUtils;
+	friend class MeshBinaryUtils;
+	friend class MeshletUtils;
+	friend class VertexFormatUtils;
 public:
 	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
 
 	~Mesh();
 
+	VertexFormat getVertexFormat() const;
+
+	// Level 0 is the full mesh; later levels are coarser
+	unsigned int getLodCount() const;
+	const MeshLod& getLod(unsigned int lod) const;
+
+	// VBO and EBO size as uploaded
+	size_t getGpuBytes() const;
+
+	glm::vec3 getBoundsCenter() const;
+	float getBoundsRadius() const;
+
+	// Clusters covering LOD 0; empty when the mesh was not split
+	const std::vector<Meshlet>& getMeshlets() const;
+
 private:
-	unsigned int VAO, VBO;
+	unsigned int VAO, VBO, EBO;
+	unsigned int vertexCount, indexCount;	// what was uploaded; CPU copies may be empty
+	VertexFormat format;
+	VertexDecode decode;
+	std::vector<MeshLod> lods;	// set before setup; ranges of indices, or just the whole buffer
+	std::vector<Meshlet> meshlets;
+	glm::vec3 boundsCenter;
+	float boundsRadius;
 
 	Mesh();
 	Mesh(std::vector<Vertex> vertices);
+	void prepare();
+	void weld();
 	void setup();
+	void setup(const Vertex* vertexData, unsigned int numVertices, const unsigned int* indexData, unsigned int numIndices);
 };
@@ -0,0 +1,155 @@
+#include "mesh_binary.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include "../framework/file_utils.h"
+
+// Bump whenever the processing that produces the cached data changes.
+static const uint32_t MESH_BINARY_VERSION = 5;
+static const char MESH_BINARY_MAGIC[4] = { 'M', 'S', 'H', 'B' };
+
+// File layout: header, vertexCount * Vertex, indexCount * unsigned int, lodCount * MeshLod, meshletCount * Meshlet
+struct MeshBinaryHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t vertexSize;
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	uint32_t lodCount;
+	uint32_t meshletCount;
+	uint32_t reserved;
+	uint64_t sourceModifiedTime;
+	uint64_t sourceSize;
+	uint64_t sourceHash;
+};
+
+// LOD ranges and meshlets are stored as is
+static_assert(sizeof(MeshLod) == sizeof(uint32_t) * 3, "MeshLod must be tightly packed");
+static_assert(sizeof(Meshlet) == sizeof(uint32_t) * 11, "Meshlet must be tightly packed");
+
+static bool hashSource(const std::string& sourcePath, uint64_t* size, uint64_t* hash)
+{
+	FileUtils::MappedFile source;
+	if (!source.open(sourcePath)) return false;
+
+	*size = source.size();
+	*hash = FileUtils::hashBytes(source.data(), source.size());
+	return true;
+}
+
+static void refreshModifiedTime(const std::string& cachePath, uint64_t modifiedTime)
+{
+	std::fstream file(cachePath, std::ios::in | std::ios::out | std::ios::binary);
+	if (!file) return;
+
+	file.seekp(offsetof(MeshBinaryHeader, sourceModifiedTime));
+	file.write(reinterpret_cast<const char*>(&modifiedTime), sizeof(modifiedTime));
+}
+
+std::string MeshBinaryUtils::getCachePath(const std::string& sourcePath)
+{
+	return sourcePath + ".meshcache";
+}
+
+Mesh* MeshBinaryUtils::load(const std::string& sourcePath, VertexFormat format)
+{
+	std::string cachePath = getCachePath(sourcePath);
+
+	FileUtils::MappedFile cache;
+	if (!cache.open(cachePath)) return nullptr;
+	if (cache.size() < sizeof(MeshBinaryHeader)) return nullptr;
+
+	MeshBinaryHeader header;
+	std::memcpy(&header, cache.data(), sizeof(MeshBinaryHeader));
+
+	if (std::memcmp(header.magic, MESH_BINARY_MAGIC, sizeof(MESH_BINARY_MAGIC)) != 0 ||
+		header.version != MESH_BINARY_VERSION ||
+		header.vertexSize != sizeof(Vertex) ||
+		header.lodCount == 0)
+	{
+		return nullptr;
+	}
+
+	size_t expectedSize = sizeof(MeshBinaryHeader) + (size_t)header.vertexCount * sizeof(Vertex) + (size_t)header.indexCount * sizeof(unsigned int) + (size_t)header.lodCount * sizeof(MeshLod) + (size_t)header.meshletCount * sizeof(Meshlet);
+	if (cache.size() != expectedSize) return nullptr;
+
+	// Same modified time: trust the cache without touching the source.
+	// Otherwise the source may only have been touched (e.g. checked out again), so compare its content.
+	uint64_t modifiedTime = 0;
+	bool sourceExists = FileUtils::getModifiedTime(sourcePath, &modifiedTime);
+	bool refreshTime = false;
+
+	if (sourceExists && modifiedTime != header.sourceModifiedTime)
+	{
+		uint64_t size, hash;
+		if (!hashSource(sourcePath, &size, &hash)) return nullptr;
+		if (size != header.sourceSize || hash != header.sourceHash) return nullptr;
+
+		refreshTime = true;
+	}
+
+	// Upload straight from the mapped pages, no intermediate copy.
+	const Vertex* vertexData = reinterpret_cast<const Vertex*>(cache.data() + sizeof(MeshBinaryHeader));
+	const unsigned int* indexData = reinterpret_cast<const unsigned int*>(vertexData + header.vertexCount);
+	const MeshLod* lodData = reinterpret_cast<const MeshLod*>(indexData + header.indexCount);
+	const Meshlet* meshletData = reinterpret_cast<const Meshlet*>(lodData + header.lodCount);
+
+	for (uint32_t i = 0; i < header.lodCount; i++)
+	{
+		if ((uint64_t)lodData[i].indexOffset + lodData[i].indexCount > header.indexCount) return nullptr;
+	}
+	for (uint32_t i = 0; i < header.meshletCount; i++)
+	{
+		if ((uint64_t)meshletData[i].indexOffset + (uint64_t)meshletData[i].triangleCount * 3 > header.indexCount) return nullptr;
+	}
+
+	Mesh* mesh = new Mesh();
+	mesh->format = format;
+	mesh->lods.assign(lodData, lodData + header.lodCount);
+	mesh->meshlets.assign(meshletData, meshletData + header.meshletCount);
+	mesh->setup(vertexData, header.vertexCount, indexData, header.indexCount);
+
+	cache.close();
+
+	if (refreshTime)
+	{
+		refreshModifiedTime(cachePath, modifiedTime);
+	}
+
+	return mesh;
+}
+
+bool MeshBinaryUtils::save(const std::string& sourcePath, const Mesh* mesh)
+{
+	MeshBinaryHeader header;
+	std::memcpy(header.magic, MESH_BINARY_MAGIC, sizeof(MESH_BINARY_MAGIC));
+	header.version = MESH_BINARY_VERSION;
+	header.vertexSize = sizeof(Vertex);
+	header.vertexCount = (uint32_t)mesh->vertices.size();
+	header.indexCount = (uint32_t)mesh->indices.size();
+	header.lodCount = (uint32_t)mesh->lods.size();
+	header.meshletCount = (uint32_t)mesh->meshlets.size();
+	header.reserved = 0;
+
+	if (!FileUtils::getModifiedTime(sourcePath, &header.sourceModifiedTime)) return false;
+	if (!hashSource(sourcePath, &header.sourceSize, &header.sourceHash)) return false;
+
+	std::string cachePath = getCachePath(sourcePath);
+	std::ofstream file(cachePath, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!file)
+	{
+		std::cout << "Failed to write mesh cache: " << cachePath << std::endl;
+		return false;
+	}
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(mesh->vertices.data()), mesh->vertices.size() * sizeof(Vertex));
+	file.write(reinterpret_cast<const char*>(mesh->indices.data()), mesh->indices.size() * sizeof(unsigned int));
+	file.write(reinterpret_cast<const char*>(mesh->lods.data()), mesh->lods.size() * sizeof(MeshLod));
+	file.write(reinterpret_cast<const char*>(mesh->meshlets.data()), mesh->meshlets.size() * sizeof(Meshlet));
+
+	return (bool)file;
+}
\ No newline at end of file
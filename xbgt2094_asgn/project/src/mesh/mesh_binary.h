@@ -0,0 +1,19 @@
+#pragma once
+#include <string>
+#include "mesh.h"
+
+// Versioned binary copy of a fully processed mesh (welded vertices with tangents, indices of every LOD),
+// stored next to its source file so OBJ parsing and MikkTSpace can be skipped on later runs.
+// The cache is rejected when the version or Vertex layout changes, or when the source file
+// changed: a matching modified time is trusted, otherwise the source size and content hash decide.
+class MeshBinaryUtils
+{
+public:
+	static std::string getCachePath(const std::string& sourcePath);
+
+	// Returns a mesh uploaded in format directly from the memory-mapped cache, or nullptr if there is no valid cache.
+	static Mesh* load(const std::string& sourcePath, VertexFormat format);
+
+	// Writes the CPU side data of mesh as the cache for sourcePath.
+	static bool save(const std::string& sourcePath, const Mesh* mesh);
+};
\ No newline at end of file
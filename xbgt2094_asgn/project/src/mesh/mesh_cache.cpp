@@ -0,0 +1,246 @@
+#include "mesh_cache.h"
+#include "mesh_utils.h"
+#include "vertex_format.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <set>
+#include <thread>
+#include "../framework/bench_utils.h"
+
+std::map<MeshCache::Key, MeshCache::Entry> MeshCache::entries;
+MeshCacheStats MeshCache::stats = {};
+
+// "a/../b.obj" and "b.obj" are the same file
+MeshCache::Key MeshCache::makeKey(const std::string& filePath, VertexFormat format)
+{
+	return Key(std::filesystem::path(filePath).lexically_normal().generic_string(), format);
+}
+
+Mesh* MeshCache::acquire(const std::string& filePath, VertexFormat format)
+{
+	Key key = makeKey(filePath, format);
+
+	auto it = entries.find(key);
+	if (it != entries.end())
+	{
+		it->second.references++;
+		stats.hits++;
+		stats.gpuBytesSaved += it->second.mesh->getGpuBytes();
+		return it->second.mesh;
+	}
+
+	stats.misses++;
+
+	Mesh* mesh = MeshUtils::loadObjFile(filePath, format);
+	if (!mesh) return 0;
+
+	return insert(key, mesh);
+}
+
+Mesh* MeshCache::insert(const Key& key, Mesh* mesh)
+{
+	entries[key] = { mesh, 1 };
+	stats.gpuBytes += mesh->getGpuBytes();
+	return mesh;
+}
+
+void MeshCache::release(Mesh* mesh)
+{
+	for (auto& entry : entries)
+	{
+		if (entry.second.mesh == mesh)
+		{
+			if (entry.second.references > 0) entry.second.references--;
+			return;
+		}
+	}
+
+	std::cout << "MeshCache: released a mesh it does not hold" << std::endl;
+}
+
+unsigned int MeshCache::getReferenceCount(const Mesh* mesh)
+{
+	for (const auto& entry : entries)
+	{
+		if (entry.second.mesh == mesh) return entry.second.references;
+	}
+	return 0;
+}
+
+void MeshCache::erase(std::map<Key, Entry>::iterator it)
+{
+	stats.gpuBytes -= it->second.mesh->getGpuBytes();
+	stats.evictions++;
+
+	delete it->second.mesh;
+	entries.erase(it);
+}
+
+bool MeshCache::evict(const std::string& filePath, VertexFormat format)
+{
+	auto it = entries.find(makeKey(filePath, format));
+	if (it == entries.end() || it->second.references > 0) return false;
+
+	erase(it);
+	return true;
+}
+
+unsigned int MeshCache::evictUnused()
+{
+	unsigned int count = 0;
+	for (auto it = entries.begin(); it != entries.end();)
+	{
+		auto next = std::next(it);
+		if (it->second.references == 0)
+		{
+			erase(it);
+			count++;
+		}
+		it = next;
+	}
+	return count;
+}
+
+const MeshCacheStats& MeshCache::getStats()
+{
+	return stats;
+}
+
+size_t MeshCache::getMeshCount()
+{
+	return entries.size();
+}
+
+void MeshCache::printStats()
+{
+	std::cout << "Mesh cache: " << entries.size() << " meshes, " << stats.hits << " hits, " << stats.misses << " misses, "
+		<< stats.gpuBytes / 1024 << " KB on the GPU, " << stats.gpuBytesSaved / 1024 << " KB saved" << std::endl;
+}
+
+#pragma region Batch
+
+void MeshBatch::add(Mesh** target, const std::string& filePath, VertexFormat format)
+{
+	requests.push_back({ target, filePath, format });
+}
+
+size_t MeshBatch::size() const
+{
+	return requests.size();
+}
+
+void MeshBatch::load(unsigned int threadCount)
+{
+	if (requests.empty()) return;
+	if (threadCount == 0) threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+	auto start = std::chrono::steady_clock::now();
+
+	// Only the first request of each mesh not cached yet loads; the rest are hits once it is in
+	std::vector<bool> missed(requests.size(), false);
+	std::set<MeshCache::Key> missedKeys;
+	for (size_t i = 0; i < requests.size(); i++)
+	{
+		MeshCache::Key key = MeshCache::makeKey(requests[i].filePath, requests[i].format);
+		if (MeshCache::entries.count(key) == 0 && missedKeys.insert(key).second) missed[i] = true;
+	}
+
+	// Warm meshes upload straight from their mapped binary cache, so only the cold ones go to the workers
+	std::vector<Mesh*> loaded(requests.size(), nullptr);
+	std::vector<size_t> coldRequests;
+	for (size_t i = 0; i < requests.size(); i++)
+	{
+		if (!missed[i]) continue;
+
+		loaded[i] = MeshUtils::loadCachedObjFile(requests[i].filePath, requests[i].format);
+		if (!loaded[i]) coldRequests.push_back(i);
+	}
+
+	// Biggest files first, so one large mesh does not finish last on its own
+	std::vector<size_t> order(coldRequests.size());
+	std::vector<uintmax_t> fileSizes(coldRequests.size(), 0);
+	for (size_t j = 0; j < coldRequests.size(); j++)
+	{
+		std::error_code error;
+		uintmax_t fileSize = std::filesystem::file_size(requests[coldRequests[j]].filePath, error);
+		fileSizes[j] = error ? 0 : fileSize;
+		order[j] = j;
+	}
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return fileSizes[a] > fileSizes[b]; });
+
+	// Workers process the cold meshes, each whole on one thread, while this thread, which owns the GL context,
+	// uploads each as soon as it and every one before it are ready
+	std::vector<ColdMeshLoad> cold(coldRequests.size());
+	std::vector<bool> processed(coldRequests.size(), false);
+	std::mutex mutex;
+	std::condition_variable processedSignal;
+	std::atomic<size_t> next(0);
+
+	auto process = [&]()
+	{
+		for (size_t k = next++; k < order.size(); k = next++)
+		{
+			size_t j = order[k];
+			ColdMeshLoad load = MeshUtils::processObjFile(requests[coldRequests[j]].filePath);
+
+			std::lock_guard<std::mutex> lock(mutex);
+			cold[j] = load;
+			processed[j] = true;
+			processedSignal.notify_all();
+		}
+	};
+
+	std::vector<std::thread> workers;
+	for (size_t i = 0; i < std::min<size_t>(threadCount, coldRequests.size()); i++)
+	{
+		workers.emplace_back(process);
+	}
+
+	double processMs = 0.0;
+	for (size_t j = 0; j < coldRequests.size(); j++)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			processedSignal.wait(lock, [&]() { return processed[j]; });
+		}
+
+		const MeshRequest& request = requests[coldRequests[j]];
+		processMs += cold[j].processMs;
+		loaded[coldRequests[j]] = MeshUtils::finishObjFile(request.filePath, request.format, cold[j]);
+	}
+
+	for (std::thread& worker : workers)
+	{
+		worker.join();
+	}
+
+	// Every request holds one reference, as if each had called acquire in turn
+	std::set<MeshCache::Key> failedKeys;
+	for (size_t i = 0; i < requests.size(); i++)
+	{
+		const MeshRequest& request = requests[i];
+		MeshCache::Key key = MeshCache::makeKey(request.filePath, request.format);
+
+		if (missed[i] || failedKeys.count(key))
+		{
+			MeshCache::stats.misses++;
+			*request.target = loaded[i] ? MeshCache::insert(key, loaded[i]) : 0;
+			if (!loaded[i]) failedKeys.insert(key);
+			continue;
+		}
+
+		*request.target = MeshCache::acquire(request.filePath, request.format);
+	}
+
+	std::cout << "Loaded " << requests.size() << " meshes (" << coldRequests.size() << " cold) in " << BenchUtils::getElapsedMs(start) << " ms, "
+		<< processMs << " ms processing on " << std::min<size_t>(threadCount, std::max<size_t>(1, coldRequests.size())) << " threads" << std::endl;
+
+	requests.clear();
+}
+
+#pragma endregion
\ No newline at end of file
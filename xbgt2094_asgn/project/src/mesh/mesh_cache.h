@@ -0,0 +1,80 @@
+#pragma once
+#include <cstddef>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include "mesh.h"
+
+struct MeshCacheStats
+{
+	unsigned int hits;
+	unsigned int misses;
+	unsigned int evictions;
+	size_t gpuBytes;		// VBO and EBO bytes of every mesh currently cached
+	size_t gpuBytesSaved;	// bytes the hits would have uploaded again without the cache
+};
+
+// One loaded mesh per OBJ path and vertex format, shared by everything that draws it.
+// acquire adds a reference and release drops one. A mesh nobody holds stays loaded until it is evicted,
+// so respawning a prop does not parse or upload it again.
+class MeshCache
+{
+	friend class MeshBatch;
+public:
+	// Loads through MeshUtils::loadObjFile on a miss; null if that fails
+	static Mesh* acquire(const std::string& filePath, VertexFormat format = VertexFormat::Packed);
+	static void release(Mesh* mesh);
+
+	static unsigned int getReferenceCount(const Mesh* mesh);
+
+	// Deletes one mesh if nothing holds it; returns whether it was deleted
+	static bool evict(const std::string& filePath, VertexFormat format = VertexFormat::Packed);
+	// Deletes every mesh nothing holds; returns how many
+	static unsigned int evictUnused();
+
+	static const MeshCacheStats& getStats();
+	static size_t getMeshCount();
+	static void printStats();
+
+private:
+	typedef std::pair<std::string, VertexFormat> Key;
+
+	struct Entry
+	{
+		Mesh* mesh;
+		unsigned int references;
+	};
+
+	static std::map<Key, Entry> entries;
+	static MeshCacheStats stats;
+
+	static Key makeKey(const std::string& filePath, VertexFormat format);
+	// A loaded mesh that was not cached yet, with its first reference
+	static Mesh* insert(const Key& key, Mesh* mesh);
+	static void erase(std::map<Key, Entry>::iterator it);
+};
+
+// Acquires many meshes at once. Those with a valid binary cache load on the calling thread, which must own the
+// GL context; the cold ones are parsed and processed on worker threads, one mesh per job, and uploaded on the
+// calling thread in the order they were added. Each target is set when load returns, to null if its file
+// failed, exactly as acquire would have.
+class MeshBatch
+{
+public:
+	void add(Mesh** target, const std::string& filePath, VertexFormat format = VertexFormat::Packed);
+
+	// threadCount 0 uses every hardware thread
+	void load(unsigned int threadCount = 0);
+	size_t size() const;
+
+private:
+	struct MeshRequest
+	{
+		Mesh** target;
+		std::string filePath;
+		VertexFormat format;
+	};
+
+	std::vector<MeshRequest> requests;
+};
\ No newline at end of file
@@ -0,0 +1,324 @@
+#include "mesh_optimizer.h"
+#include <algorithm>
+#include <climits>
+#include <unordered_map>
+#include <glm/glm.hpp>
+#include "../framework/file_utils.h"
+
+// Post-transform cache size assumed by the optimiser and the statistics
+static const unsigned int VERTEX_CACHE_SIZE = 16;
+
+// How much worse than the Tipsify order the overdraw order's ACMR may get
+static const float OVERDRAW_THRESHOLD = 1.05f;
+
+// Simulates a FIFO cache: a vertex stays cached until VERTEX_CACHE_SIZE newer vertices have been loaded.
+// Returns how many vertices of the triangle had to be transformed.
+static unsigned int simulateTriangle(const unsigned int* triangle, std::vector<unsigned int>& cachedAt, unsigned int& time)
+{
+	unsigned int misses = 0;
+
+	for (int k = 0; k < 3; k++)
+	{
+		unsigned int vertex = triangle[k];
+		if (time - cachedAt[vertex] >= VERTEX_CACHE_SIZE)
+		{
+			cachedAt[vertex] = time++;
+			misses++;
+		}
+	}
+
+	return misses;
+}
+
+VertexCacheStats MeshOptimizerUtils::analyzeVertexCache(const std::vector<unsigned int>& indices, size_t vertexCount)
+{
+	VertexCacheStats stats = { 0.0f, 0.0f };
+	if (indices.size() < 3) return stats;
+
+	std::vector<unsigned int> cachedAt(vertexCount, 0);
+	std::vector<bool> used(vertexCount, false);
+	unsigned int time = VERTEX_CACHE_SIZE;
+	size_t misses = 0, usedCount = 0;
+
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		misses += simulateTriangle(&indices[i], cachedAt, time);
+
+		for (int k = 0; k < 3; k++)
+		{
+			if (!used[indices[i + k]])
+			{
+				used[indices[i + k]] = true;
+				usedCount++;
+			}
+		}
+	}
+
+	stats.acmr = (float)misses / (float)(indices.size() / 3);
+	stats.atvr = (float)misses / (float)usedCount;
+	return stats;
+}
+
+// Tipsify (Sander, Nehab, Barczak 2007): fan around a vertex, then continue from the most recently
+// cached neighbour that will still be in the cache once its remaining triangles are emitted.
+void MeshOptimizerUtils::optimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount)
+{
+	size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0) return;
+
+	// Triangles around each vertex
+	std::vector<unsigned int> liveTriangles(vertexCount, 0);
+	for (size_t i = 0; i < triangleCount * 3; i++) liveTriangles[indices[i]]++;
+
+	std::vector<unsigned int> adjacencyOffsets(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; v++) adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+
+	std::vector<unsigned int> adjacency(triangleCount * 3);
+	std::vector<unsigned int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+	for (size_t i = 0; i < triangleCount * 3; i++) adjacency[fill[indices[i]]++] = (unsigned int)(i / 3);
+
+	std::vector<unsigned int> cachedAt(vertexCount, 0);
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<unsigned int> deadEnd;
+	std::vector<unsigned int> candidates;
+	std::vector<unsigned int> result;
+	deadEnd.reserve(triangleCount * 3);
+	result.reserve(triangleCount * 3);
+
+	unsigned int time = VERTEX_CACHE_SIZE + 1;
+	size_t cursor = 0;
+
+	// Most recently touched vertex that still has triangles, else the next one in index order
+	auto skipDeadEnd = [&]() -> long long
+	{
+		while (!deadEnd.empty())
+		{
+			unsigned int vertex = deadEnd.back();
+			deadEnd.pop_back();
+			if (liveTriangles[vertex] > 0) return vertex;
+		}
+
+		for (; cursor < vertexCount; cursor++)
+		{
+			if (liveTriangles[cursor] > 0) return (long long)cursor;
+		}
+
+		return -1;
+	};
+
+	long long fanning = skipDeadEnd();
+	while (fanning >= 0)
+	{
+		candidates.clear();
+
+		for (unsigned int a = adjacencyOffsets[fanning]; a < adjacencyOffsets[fanning + 1]; a++)
+		{
+			unsigned int triangle = adjacency[a];
+			if (emitted[triangle]) continue;
+
+			for (int k = 0; k < 3; k++)
+			{
+				unsigned int vertex = indices[triangle * 3 + k];
+				result.push_back(vertex);
+				deadEnd.push_back(vertex);
+				candidates.push_back(vertex);
+				liveTriangles[vertex]--;
+
+				if (time - cachedAt[vertex] > VERTEX_CACHE_SIZE)
+				{
+					cachedAt[vertex] = time++;
+				}
+			}
+
+			emitted[triangle] = true;
+		}
+
+		long long next = -1;
+		long long bestPriority = -1;
+		for (unsigned int vertex : candidates)
+		{
+			if (liveTriangles[vertex] == 0) continue;
+
+			// Prefer the oldest candidate that survives fanning its remaining triangles
+			long long priority = 0;
+			if (time - cachedAt[vertex] + 2 * liveTriangles[vertex] <= VERTEX_CACHE_SIZE)
+			{
+				priority = time - cachedAt[vertex];
+			}
+
+			if (priority > bestPriority)
+			{
+				bestPriority = priority;
+				next = vertex;
+			}
+		}
+
+		fanning = next >= 0 ? next : skipDeadEnd();
+	}
+
+	indices.swap(result);
+}
+
+// Linear-time overdraw ordering from the same paper. The cache-ordered triangles are split into
+// clusters wherever Tipsify restarted, and again wherever a cluster's own ACMR is within threshold
+// of its parent's, so reordering clusters costs little cache efficiency. Clusters then draw in order
+// of occlusion potential: those far out from the mesh centre and facing away from it cover the
+// rest from most view directions, so drawing them first lets early-Z reject what is behind them.
+void MeshOptimizerUtils::optimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<Vertex>& vertices, float threshold)
+{
+	size_t triangleCount = indices.size() / 3;
+	if (triangleCount < 2) return;
+
+	std::vector<unsigned int> cachedAt(vertices.size(), 0);
+	unsigned int time = VERTEX_CACHE_SIZE;
+
+	// A triangle whose three vertices all miss is where Tipsify jumped somewhere new
+	std::vector<size_t> hardBoundaries;
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		if (simulateTriangle(&indices[t * 3], cachedAt, time) == 3) hardBoundaries.push_back(t);
+	}
+	if (hardBoundaries.empty() || hardBoundaries[0] != 0) hardBoundaries.insert(hardBoundaries.begin(), 0);
+	hardBoundaries.push_back(triangleCount);
+
+	// Each cluster starts with a cold cache, since it may be drawn after any other
+	std::vector<size_t> clusterStarts;
+	for (size_t h = 0; h + 1 < hardBoundaries.size(); h++)
+	{
+		size_t start = hardBoundaries[h], end = hardBoundaries[h + 1];
+
+		time += VERTEX_CACHE_SIZE;
+		size_t clusterMisses = 0;
+		for (size_t t = start; t < end; t++) clusterMisses += simulateTriangle(&indices[t * 3], cachedAt, time);
+		float limit = threshold * (float)clusterMisses / (float)(end - start);
+
+		time += VERTEX_CACHE_SIZE;
+		clusterStarts.push_back(start);
+
+		size_t misses = 0;
+		for (size_t t = start; t < end; t++)
+		{
+			misses += simulateTriangle(&indices[t * 3], cachedAt, time);
+
+			if (t + 1 < end && (float)misses <= limit * (float)(t + 1 - clusterStarts.back()))
+			{
+				clusterStarts.push_back(t + 1);
+				time += VERTEX_CACHE_SIZE;
+				misses = 0;
+			}
+		}
+	}
+	clusterStarts.push_back(triangleCount);
+
+	size_t clusterCount = clusterStarts.size() - 1;
+	std::vector<glm::vec3> clusterCentroids(clusterCount, glm::vec3(0.0f));
+	std::vector<glm::vec3> clusterNormals(clusterCount, glm::vec3(0.0f));
+	std::vector<float> clusterAreas(clusterCount, 0.0f);
+
+	glm::vec3 meshCentroid(0.0f);
+	float meshArea = 0.0f;
+
+	for (size_t c = 0; c < clusterCount; c++)
+	{
+		for (size_t t = clusterStarts[c]; t < clusterStarts[c + 1]; t++)
+		{
+			const glm::vec3& p0 = vertices[indices[t * 3 + 0]].position;
+			const glm::vec3& p1 = vertices[indices[t * 3 + 1]].position;
+			const glm::vec3& p2 = vertices[indices[t * 3 + 2]].position;
+
+			glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);	// length is twice the area
+			float area = glm::length(normal);
+			glm::vec3 centroid = (p0 + p1 + p2) / 3.0f;
+
+			clusterCentroids[c] += centroid * area;
+			clusterNormals[c] += normal;
+			clusterAreas[c] += area;
+		}
+
+		meshCentroid += clusterCentroids[c];
+		meshArea += clusterAreas[c];
+	}
+
+	if (meshArea > 0.0f) meshCentroid /= meshArea;
+
+	std::vector<float> occlusion(clusterCount, 0.0f);
+	for (size_t c = 0; c < clusterCount; c++)
+	{
+		float normalLength = glm::length(clusterNormals[c]);
+		if (clusterAreas[c] <= 0.0f || normalLength <= 0.0f) continue;
+
+		glm::vec3 centroid = clusterCentroids[c] / clusterAreas[c];
+		occlusion[c] = glm::dot(centroid - meshCentroid, clusterNormals[c] / normalLength);
+	}
+
+	std::vector<size_t> order(clusterCount);
+	for (size_t c = 0; c < clusterCount; c++) order[c] = c;
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return occlusion[a] > occlusion[b]; });
+
+	std::vector<unsigned int> result;
+	result.reserve(triangleCount * 3);
+	for (size_t c : order)
+	{
+		result.insert(result.end(), indices.begin() + clusterStarts[c] * 3, indices.begin() + clusterStarts[c + 1] * 3);
+	}
+
+	indices.swap(result);
+}
+
+// Renumbers vertices in the order the index buffer first uses them, dropping any that are unused
+void MeshOptimizerUtils::optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
+{
+	std::vector<unsigned int> remap(vertices.size(), UINT_MAX);
+	std::vector<Vertex> result;
+	result.reserve(vertices.size());
+
+	for (unsigned int& index : indices)
+	{
+		if (remap[index] == UINT_MAX)
+		{
+			remap[index] = (unsigned int)result.size();
+			result.push_back(vertices[index]);
+		}
+
+		index = remap[index];
+	}
+
+	vertices.swap(result);
+}
+
+void MeshOptimizerUtils::optimize(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
+{
+	optimizeVertexCache(indices, vertices.size());
+
+	// Small or fragmented meshes can lose more than the threshold once clusters are reordered; keep the cache order then
+	std::vector<unsigned int> overdrawOrder = indices;
+	optimizeOverdraw(overdrawOrder, vertices, OVERDRAW_THRESHOLD);
+
+	float cacheAcmr = analyzeVertexCache(indices, vertices.size()).acmr;
+	if (analyzeVertexCache(overdrawOrder, vertices.size()).acmr <= OVERDRAW_THRESHOLD * cacheAcmr)
+	{
+		indices.swap(overdrawOrder);
+	}
+
+	optimizeVertexFetch(vertices, indices);
+}
+
+void MeshOptimizerUtils::generatePositionRemap(const std::vector<Vertex>& vertices, std::vector<unsigned int>& remap)
+{
+	struct PositionHash
+	{
+		size_t operator()(const glm::vec3& position) const
+		{
+			return (size_t)FileUtils::hashBytes(&position, sizeof(glm::vec3));
+		}
+	};
+
+	std::unordered_map<glm::vec3, unsigned int, PositionHash> firstVertex;
+	firstVertex.reserve(vertices.size());
+
+	remap.resize(vertices.size());
+	for (unsigned int i = 0; i < (unsigned int)vertices.size(); i++)
+	{
+		remap[i] = firstVertex.emplace(vertices[i].position, i).first->second;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,28 @@
+#pragma once
+#include <vector>
+#include "mesh.h"
+
+// Post-transform vertex cache efficiency of an index buffer, measured with a simulated FIFO cache.
+struct VertexCacheStats
+{
+	float acmr;	// average cache miss ratio: vertex shader runs per triangle (0.5 is ideal for large grids, 3 is worst)
+	float atvr;	// average transformed vertex ratio: vertex shader runs per unique vertex (1 is ideal)
+};
+
+// Reorders indexed triangle meshes for the GPU without changing what is drawn:
+// triangles for vertex cache locality (Tipsify), then clusters of them for less overdraw,
+// then vertices so they are fetched in the order the index buffer first touches them.
+class MeshOptimizerUtils
+{
+public:
+	static void optimize(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+
+	static void optimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount);
+	static void optimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<Vertex>& vertices, float threshold);
+	static void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+
+	static VertexCacheStats analyzeVertexCache(const std::vector<unsigned int>& indices, size_t vertexCount);
+
+	// Points each vertex at the first vertex with the same position, so neighbours across UV seams and hard edges can be found
+	static void generatePositionRemap(const std::vector<Vertex>& vertices, std::vector<unsigned int>& remap);
+};
\ No newline at end of file
@@ -0,0 +1,550 @@
+#include "mesh_simplifier.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <glm/glm.hpp>
+#include "mesh_optimizer.h"
+
+static const unsigned int INVALID_VERTEX = ~0u;
+
+// Each level aims for this fraction of the previous level's triangles
+static const float LOD_REDUCTION = 0.5f;
+static const unsigned int MAX_LOD_COUNT = 5;
+static const size_t MIN_LOD_TRIANGLES = 32;
+
+// Coarsest level may deviate this far from the full mesh, relative to its bounding radius
+static const float LOD_MAX_ERROR = 0.1f;
+
+// Border and seam edges get a plane along them so their silhouette costs as much as the surface
+static const float BOUNDARY_WEIGHT = 2.0f;
+
+// Smooth normals may not turn more than this across a collapse (cos 60 degrees)
+static const float MIN_NORMAL_DOT = 0.5f;
+
+#pragma region Classification
+
+enum class VertexKind
+{
+	Manifold,	// interior with continuous attributes; can collapse anywhere
+	Border,		// on an open edge; only along the border
+	Seam,		// two attribute wedges meeting along a seam; only along the seam
+	Locked		// anything more complex, e.g. corners of seams and borders; never moves
+};
+
+static bool canCollapse(VertexKind from, VertexKind to)
+{
+	switch (from)
+	{
+	case VertexKind::Manifold: return true;
+	case VertexKind::Border: return to == VertexKind::Border;
+	case VertexKind::Seam: return to == VertexKind::Seam;
+	default: return false;
+	}
+}
+
+// Half edges leaving each vertex, as the next and previous corner of their triangle
+struct EdgeAdjacency
+{
+	std::vector<unsigned int> offsets;
+	std::vector<unsigned int> next;
+	std::vector<unsigned int> prev;
+};
+
+static void buildEdgeAdjacency(EdgeAdjacency& adjacency, const std::vector<unsigned int>& indices, size_t vertexCount)
+{
+	adjacency.offsets.assign(vertexCount + 1, 0);
+	for (unsigned int index : indices) adjacency.offsets[index + 1]++;
+	for (size_t v = 0; v < vertexCount; v++) adjacency.offsets[v + 1] += adjacency.offsets[v];
+
+	adjacency.next.resize(indices.size());
+	adjacency.prev.resize(indices.size());
+	std::vector<unsigned int> fill(adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			unsigned int vertex = indices[i + k];
+			unsigned int slot = fill[vertex]++;
+			adjacency.next[slot] = indices[i + (k + 1) % 3];
+			adjacency.prev[slot] = indices[i + (k + 2) % 3];
+		}
+	}
+}
+
+static bool hasEdge(const EdgeAdjacency& adjacency, unsigned int from, unsigned int to)
+{
+	for (unsigned int e = adjacency.offsets[from]; e < adjacency.offsets[from + 1]; e++)
+	{
+		if (adjacency.next[e] == to) return true;
+	}
+	return false;
+}
+
+// remap points each vertex at the first vertex with the same position; wedge links the vertices of a position in a ring
+static void buildPositionRemap(const std::vector<Vertex>& vertices, std::vector<unsigned int>& remap, std::vector<unsigned int>& wedge)
+{
+	MeshOptimizerUtils::generatePositionRemap(vertices, remap);
+
+	wedge.resize(vertices.size());
+	for (unsigned int i = 0; i < (unsigned int)vertices.size(); i++)
+	{
+		unsigned int first = remap[i];
+
+		if (first == i)
+		{
+			wedge[i] = i;
+		}
+		else
+		{
+			wedge[i] = wedge[first];
+			wedge[first] = i;
+		}
+	}
+}
+
+// Finds the kind of every vertex from the open half edges around it. loop gets the next vertex along the
+// border or seam a vertex is on.
+static void classifyVertices(std::vector<VertexKind>& kinds, std::vector<unsigned int>& loop, const EdgeAdjacency& adjacency,
+	const std::vector<unsigned int>& remap, const std::vector<unsigned int>& wedge)
+{
+	size_t vertexCount = remap.size();
+
+	// A vertex marks itself when it has more than one open edge in a direction
+	std::vector<unsigned int> openIncoming(vertexCount, INVALID_VERTEX);
+	std::vector<unsigned int> openOutgoing(vertexCount, INVALID_VERTEX);
+
+	for (unsigned int vertex = 0; vertex < (unsigned int)vertexCount; vertex++)
+	{
+		for (unsigned int e = adjacency.offsets[vertex]; e < adjacency.offsets[vertex + 1]; e++)
+		{
+			unsigned int target = adjacency.next[e];
+
+			if (target == vertex)
+			{
+				openIncoming[vertex] = openOutgoing[vertex] = vertex;
+			}
+			else if (!hasEdge(adjacency, target, vertex))
+			{
+				openIncoming[target] = openIncoming[target] == INVALID_VERTEX ? vertex : target;
+				openOutgoing[vertex] = openOutgoing[vertex] == INVALID_VERTEX ? target : vertex;
+			}
+		}
+	}
+
+	kinds.assign(vertexCount, VertexKind::Locked);
+
+	for (unsigned int i = 0; i < (unsigned int)vertexCount; i++)
+	{
+		if (remap[i] != i) continue;
+
+		if (wedge[i] == i)
+		{
+			unsigned int in = openIncoming[i], out = openOutgoing[i];
+
+			if (in == INVALID_VERTEX && out == INVALID_VERTEX) kinds[i] = VertexKind::Manifold;
+			else if (in != INVALID_VERTEX && out != INVALID_VERTEX && in != i && out != i) kinds[i] = VertexKind::Border;
+		}
+		else if (wedge[wedge[i]] == i)
+		{
+			// Each wedge has one open edge each way, and those of one wedge continue the other's along the seam
+			unsigned int w = wedge[i];
+			unsigned int inV = openIncoming[i], outV = openOutgoing[i];
+			unsigned int inW = openIncoming[w], outW = openOutgoing[w];
+
+			if (inV != INVALID_VERTEX && inV != i && outV != INVALID_VERTEX && outV != i &&
+				inW != INVALID_VERTEX && inW != w && outW != INVALID_VERTEX && outW != w &&
+				remap[inV] == remap[outW] && remap[outV] == remap[inW] && remap[inV] != remap[outV])
+			{
+				kinds[i] = VertexKind::Seam;
+			}
+		}
+	}
+
+	loop.assign(vertexCount, INVALID_VERTEX);
+	for (unsigned int i = 0; i < (unsigned int)vertexCount; i++)
+	{
+		kinds[i] = kinds[remap[i]];
+
+		if (openOutgoing[i] != INVALID_VERTEX && openOutgoing[i] != i) loop[i] = openOutgoing[i];
+	}
+}
+
+#pragma endregion
+
+#pragma region Quadrics
+
+// Sum of weighted squared distances to a set of planes: p'Ap + 2b.p + c
+struct Quadric
+{
+	float a00, a11, a22;
+	float a10, a20, a21;
+	float b0, b1, b2;
+	float c;
+	float weight;
+};
+
+static Quadric makePlaneQuadric(glm::vec3 normal, float distance, float weight)
+{
+	Quadric q;
+	q.a00 = weight * normal.x * normal.x;
+	q.a11 = weight * normal.y * normal.y;
+	q.a22 = weight * normal.z * normal.z;
+	q.a10 = weight * normal.y * normal.x;
+	q.a20 = weight * normal.z * normal.x;
+	q.a21 = weight * normal.z * normal.y;
+	q.b0 = weight * distance * normal.x;
+	q.b1 = weight * distance * normal.y;
+	q.b2 = weight * distance * normal.z;
+	q.c = weight * distance * distance;
+	q.weight = weight;
+	return q;
+}
+
+static void addQuadric(Quadric& q, const Quadric& r)
+{
+	q.a00 += r.a00; q.a11 += r.a11; q.a22 += r.a22;
+	q.a10 += r.a10; q.a20 += r.a20; q.a21 += r.a21;
+	q.b0 += r.b0; q.b1 += r.b1; q.b2 += r.b2;
+	q.c += r.c;
+	q.weight += r.weight;
+}
+
+// Weighted mean squared distance from p to the planes
+static float evaluateQuadric(const Quadric& q, glm::vec3 p)
+{
+	float rx = q.a00 * p.x + q.a10 * p.y + q.a20 * p.z;
+	float ry = q.a10 * p.x + q.a11 * p.y + q.a21 * p.z;
+	float rz = q.a20 * p.x + q.a21 * p.y + q.a22 * p.z;
+
+	float r = rx * p.x + ry * p.y + rz * p.z + 2.0f * (q.b0 * p.x + q.b1 * p.y + q.b2 * p.z) + q.c;
+	return q.weight > 0.0f ? std::fabs(r) / q.weight : 0.0f;
+}
+
+static void fillQuadrics(std::vector<Quadric>& quadrics, const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices,
+	const std::vector<unsigned int>& remap, const std::vector<VertexKind>& kinds, const std::vector<unsigned int>& loop)
+{
+	quadrics.assign(positions.size(), makePlaneQuadric(glm::vec3(0.0f), 0.0f, 0.0f));
+
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		unsigned int corners[3] = { indices[i], indices[i + 1], indices[i + 2] };
+		const glm::vec3& p0 = positions[corners[0]];
+
+		// Triangle plane weighted by area
+		glm::vec3 normal = glm::cross(positions[corners[1]] - p0, positions[corners[2]] - p0);
+		float area = glm::length(normal);
+		if (area > 0.0f) normal /= area;
+
+		Quadric face = makePlaneQuadric(normal, -glm::dot(normal, p0), area);
+		for (unsigned int corner : corners) addQuadric(quadrics[remap[corner]], face);
+
+		// Plane through each border or seam edge, perpendicular to the triangle
+		for (int k = 0; k < 3; k++)
+		{
+			unsigned int i0 = corners[k], i1 = corners[(k + 1) % 3], i2 = corners[(k + 2) % 3];
+			VertexKind k0 = kinds[i0], k1 = kinds[i1];
+
+			if (loop[i0] != i1) continue;
+			if ((k0 != VertexKind::Border && k0 != VertexKind::Seam) || (k1 != VertexKind::Border && k1 != VertexKind::Seam)) continue;
+
+			glm::vec3 edge = positions[i1] - positions[i0];
+			float length = glm::length(edge);
+			if (length <= 0.0f) continue;
+			edge /= length;
+
+			glm::vec3 toThird = positions[i2] - positions[i0];
+			glm::vec3 perpendicular = toThird - edge * glm::dot(toThird, edge);
+			float perpendicularLength = glm::length(perpendicular);
+			if (perpendicularLength <= 0.0f) continue;
+			perpendicular /= perpendicularLength;
+
+			// Seam edges are seen from both sides, so each side adds half
+			float weight = length * length * BOUNDARY_WEIGHT;
+			if (k0 == VertexKind::Seam && k1 == VertexKind::Seam) weight *= 0.5f;
+
+			Quadric boundary = makePlaneQuadric(perpendicular, -glm::dot(perpendicular, positions[i0]), weight);
+			addQuadric(quadrics[remap[i0]], boundary);
+			addQuadric(quadrics[remap[i1]], boundary);
+		}
+	}
+}
+
+#pragma endregion
+
+#pragma region Collapses
+
+struct Collapse
+{
+	unsigned int v0;	// removed
+	unsigned int v1;	// kept
+	bool bidirectional;
+	float error;
+};
+
+static void pickCollapses(std::vector<Collapse>& collapses, const std::vector<unsigned int>& indices, const std::vector<unsigned int>& remap,
+	const std::vector<VertexKind>& kinds, const std::vector<unsigned int>& loop)
+{
+	collapses.clear();
+
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			unsigned int i0 = indices[i + k], i1 = indices[i + (k + 1) % 3];
+			if (remap[i0] == remap[i1]) continue;
+
+			VertexKind k0 = kinds[i0], k1 = kinds[i1];
+			bool forward = canCollapse(k0, k1), backward = canCollapse(k1, k0);
+			if (!forward && !backward) continue;
+
+			// Interior edges appear once from each side; only border edges are single
+			bool border = k0 == VertexKind::Border && k1 == VertexKind::Border;
+			if (!border && remap[i1] > remap[i0]) continue;
+
+			// Both on a border or seam, but not next to each other along it
+			if (k0 == k1 && (k0 == VertexKind::Border || k0 == VertexKind::Seam) && loop[i0] != i1) continue;
+
+			Collapse collapse;
+			collapse.v0 = forward ? i0 : i1;
+			collapse.v1 = forward ? i1 : i0;
+			collapse.bidirectional = forward && backward;
+			collapse.error = 0.0f;
+			collapses.push_back(collapse);
+		}
+	}
+}
+
+static void rankCollapses(std::vector<Collapse>& collapses, const std::vector<glm::vec3>& positions, const std::vector<Quadric>& quadrics,
+	const std::vector<unsigned int>& remap)
+{
+	for (Collapse& collapse : collapses)
+	{
+		float forward = evaluateQuadric(quadrics[remap[collapse.v0]], positions[collapse.v1]);
+		float backward = collapse.bidirectional ? evaluateQuadric(quadrics[remap[collapse.v1]], positions[collapse.v0]) : FLT_MAX;
+
+		if (backward < forward)
+		{
+			std::swap(collapse.v0, collapse.v1);
+		}
+		collapse.error = std::min(forward, backward);
+	}
+}
+
+// Would moving v0 to v1 turn any triangle around v0 over?
+static bool hasTriangleFlips(const EdgeAdjacency& adjacency, const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& collapseRemap,
+	const std::vector<unsigned int>& remap, unsigned int v0, unsigned int v1)
+{
+	const glm::vec3& p0 = positions[v0];
+	const glm::vec3& p1 = positions[v1];
+
+	for (unsigned int e = adjacency.offsets[v0]; e < adjacency.offsets[v0 + 1]; e++)
+	{
+		unsigned int a = collapseRemap[adjacency.next[e]], b = collapseRemap[adjacency.prev[e]];
+
+		// Triangles on the collapsed edge disappear
+		if (remap[a] == remap[v1] || remap[b] == remap[v1]) continue;
+
+		glm::vec3 ab = positions[b] - positions[a];
+		glm::vec3 before = glm::cross(ab, p0 - positions[a]);
+		glm::vec3 after = glm::cross(ab, p1 - positions[a]);
+		if (glm::dot(before, after) <= 0.0f) return true;
+	}
+
+	return false;
+}
+
+static bool keepsNormal(const std::vector<Vertex>& vertices, unsigned int v0, unsigned int v1)
+{
+	const glm::vec3& n0 = vertices[v0].normal;
+	const glm::vec3& n1 = vertices[v1].normal;
+
+	float lengths = glm::length(n0) * glm::length(n1);
+	return lengths <= 0.0f || glm::dot(n0, n1) >= MIN_NORMAL_DOT * lengths;
+}
+
+// Applies the cheapest collapses whose vertices no earlier collapse in this pass touched. Returns how many were applied.
+static size_t performCollapses(std::vector<unsigned int>& collapseRemap, std::vector<Quadric>& quadrics, const std::vector<Collapse>& collapses,
+	const std::vector<unsigned int>& order, const std::vector<Vertex>& vertices, const std::vector<glm::vec3>& positions, const EdgeAdjacency& adjacency,
+	const std::vector<unsigned int>& remap, const std::vector<unsigned int>& wedge, const std::vector<VertexKind>& kinds,
+	size_t triangleGoal, float errorLimit, float& resultError)
+{
+	std::vector<bool> locked(positions.size(), false);
+	size_t applied = 0, triangles = 0;
+
+	// Half the collapses get locked out by earlier ones, so stop once the error clearly exceeds what the goal needs
+	size_t collapseGoal = triangleGoal / 2;
+	float errorGoal = collapseGoal < order.size() ? 1.5f * collapses[order[collapseGoal]].error : FLT_MAX;
+
+	for (unsigned int c : order)
+	{
+		const Collapse& collapse = collapses[c];
+		unsigned int v0 = collapse.v0, v1 = collapse.v1;
+		unsigned int r0 = remap[v0], r1 = remap[v1];
+
+		if (collapse.error > errorLimit || collapse.error > errorGoal || triangles >= triangleGoal) break;
+		if (locked[r0] || locked[r1]) continue;
+
+		bool seam = kinds[v0] == VertexKind::Seam;
+		unsigned int s0 = wedge[v0], s1 = wedge[v1];
+
+		if (hasTriangleFlips(adjacency, positions, collapseRemap, remap, v0, v1)) continue;
+		if (seam && hasTriangleFlips(adjacency, positions, collapseRemap, remap, s0, s1)) continue;
+		if (!keepsNormal(vertices, v0, v1) || (seam && !keepsNormal(vertices, s0, s1))) continue;
+
+		addQuadric(quadrics[r1], quadrics[r0]);
+
+		// The other side of a seam moves onto the other side of the target
+		collapseRemap[v0] = v1;
+		if (seam) collapseRemap[s0] = s1;
+
+		locked[r0] = locked[r1] = true;
+		triangles += kinds[v0] == VertexKind::Border ? 1 : 2;
+		resultError = std::max(resultError, collapse.error);
+		applied++;
+	}
+
+	return applied;
+}
+
+// Points loops past vertices that were collapsed away
+static void remapLoops(std::vector<unsigned int>& loop, const std::vector<unsigned int>& collapseRemap)
+{
+	for (unsigned int i = 0; i < (unsigned int)loop.size(); i++)
+	{
+		if (loop[i] == INVALID_VERTEX) continue;
+
+		unsigned int target = loop[i];
+		unsigned int moved = collapseRemap[target];
+
+		// The loop's next vertex collapsed onto this one, so skip over it
+		loop[i] = moved == i ? loop[target] : moved;
+	}
+}
+
+// Rewrites indices through collapseRemap, dropping triangles that became degenerate
+static void remapIndices(std::vector<unsigned int>& indices, const std::vector<unsigned int>& collapseRemap)
+{
+	size_t write = 0;
+
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		unsigned int a = collapseRemap[indices[i]], b = collapseRemap[indices[i + 1]], c = collapseRemap[indices[i + 2]];
+		if (a == b || a == c || b == c) continue;
+
+		indices[write++] = a;
+		indices[write++] = b;
+		indices[write++] = c;
+	}
+
+	indices.resize(write);
+}
+
+#pragma endregion
+
+// Passes pick every collapsible edge, rank them by quadric error and apply the cheapest that do not overlap,
+// until the target is reached or nothing more can collapse within targetError.
+float MeshSimplifierUtils::simplify(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, size_t targetIndexCount, float targetError, std::vector<unsigned int>& result)
+{
+	result = indices;
+	if (vertices.empty() || indices.size() < 3) return 0.0f;
+
+	// Work in a unit box so the quadrics stay well conditioned whatever the model's scale
+	glm::vec3 minPosition = vertices[0].position, maxPosition = vertices[0].position;
+	for (const Vertex& vertex : vertices)
+	{
+		minPosition = glm::min(minPosition, vertex.position);
+		maxPosition = glm::max(maxPosition, vertex.position);
+	}
+	glm::vec3 size = maxPosition - minPosition;
+	float extent = std::max(size.x, std::max(size.y, size.z));
+	if (extent <= 0.0f) return 0.0f;
+
+	std::vector<glm::vec3> positions(vertices.size());
+	for (size_t i = 0; i < vertices.size(); i++) positions[i] = (vertices[i].position - minPosition) / extent;
+
+	std::vector<unsigned int> remap, wedge;
+	buildPositionRemap(vertices, remap, wedge);
+
+	EdgeAdjacency adjacency;
+	buildEdgeAdjacency(adjacency, result, vertices.size());
+
+	std::vector<VertexKind> kinds;
+	std::vector<unsigned int> loop;
+	classifyVertices(kinds, loop, adjacency, remap, wedge);
+
+	std::vector<Quadric> quadrics;
+	fillQuadrics(quadrics, positions, result, remap, kinds, loop);
+
+	float errorLimit = (targetError / extent) * (targetError / extent);
+	float resultError = 0.0f;
+
+	std::vector<Collapse> collapses;
+	std::vector<unsigned int> order;
+	std::vector<unsigned int> collapseRemap(vertices.size());
+
+	while (result.size() > targetIndexCount)
+	{
+		buildEdgeAdjacency(adjacency, result, vertices.size());
+
+		pickCollapses(collapses, result, remap, kinds, loop);
+		if (collapses.empty()) break;
+
+		rankCollapses(collapses, positions, quadrics, remap);
+
+		order.resize(collapses.size());
+		for (unsigned int c = 0; c < (unsigned int)collapses.size(); c++) order[c] = c;
+		std::sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b)
+		{
+			return collapses[a].error < collapses[b].error || (collapses[a].error == collapses[b].error && a < b);
+		});
+
+		for (unsigned int v = 0; v < (unsigned int)vertices.size(); v++) collapseRemap[v] = v;
+
+		size_t triangleGoal = (result.size() - targetIndexCount) / 3;
+		size_t applied = performCollapses(collapseRemap, quadrics, collapses, order, vertices, positions, adjacency,
+			remap, wedge, kinds, std::max(triangleGoal, (size_t)1), errorLimit, resultError);
+		if (applied == 0) break;
+
+		remapLoops(loop, collapseRemap);
+		remapIndices(result, collapseRemap);
+	}
+
+	return std::sqrt(resultError) * extent;
+}
+
+void MeshSimplifierUtils::buildLodChain(const std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, std::vector<MeshLod>& lods)
+{
+	lods.clear();
+	lods.push_back({ 0, (unsigned int)indices.size(), 0.0f });
+	if (vertices.empty()) return;
+
+	glm::vec3 minPosition = vertices[0].position, maxPosition = vertices[0].position;
+	for (const Vertex& vertex : vertices)
+	{
+		minPosition = glm::min(minPosition, vertex.position);
+		maxPosition = glm::max(maxPosition, vertex.position);
+	}
+	float maxError = LOD_MAX_ERROR * 0.5f * glm::length(maxPosition - minPosition);
+
+	// Each level is simplified from the full mesh, so its error is measured against what LOD 0 shows
+	std::vector<unsigned int> full(indices.begin(), indices.end());
+	std::vector<unsigned int> level;
+
+	while (lods.size() < MAX_LOD_COUNT)
+	{
+		size_t previousCount = lods.back().indexCount;
+		if (previousCount / 3 <= MIN_LOD_TRIANGLES) break;
+
+		size_t target = (size_t)(previousCount / 3 * LOD_REDUCTION) * 3;
+		float error = simplify(vertices, full, target, maxError, level);
+
+		// Stop once simplification stalls on locked vertices or the error limit
+		if (level.empty() || level.size() > previousCount * 0.8f) break;
+
+		MeshOptimizerUtils::optimizeVertexCache(level, vertices.size());
+
+		lods.push_back({ (unsigned int)indices.size(), (unsigned int)level.size(), error });
+		indices.insert(indices.end(), level.begin(), level.end());
+	}
+}
\ No newline at end of file
@@ -0,0 +1,18 @@
+#pragma once
+#include <vector>
+#include "mesh.h"
+
+// Quadric error metric simplification (Garland & Heckbert 1997) by edge collapse onto existing vertices.
+// No vertex is moved or created, so every level of detail indexes the same vertex buffer as the full mesh.
+// Vertices where attributes split (UV seams, hard normal edges) only slide along their seam, together with
+// their other side, and open borders only along the border, so seams and silhouettes stay intact.
+class MeshSimplifierUtils
+{
+public:
+	// Collapses edges of indices until targetIndexCount is reached or the next collapse would move the surface
+	// further than targetError (model space units). Returns the largest distance introduced.
+	static float simplify(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, size_t targetIndexCount, float targetError, std::vector<unsigned int>& result);
+
+	// indices holds LOD 0 on input; coarser levels are appended after it, each ordered for the vertex cache.
+	static void buildLodChain(const std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, std::vector<MeshLod>& lods);
+};
\ No newline at end of file
@@ -1,10 +1,21 @@
 #include "mesh_utils.h"
+#include "mesh_binary.h"
+#include "mesh_optimizer.h"
+#include "mesh_simplifier.h"
+#include "meshlet.h"
+#include "obj_parser.h"
+#include "vertex_format.h"
+#include "../framework/bench_utils.h"
+#include "../framework/load_arena.h"
 #include <glad/glad.h>
 #define TINYOBJLOADER_IMPLEMENTATION
 #include <tinyobjloader/tiny_obj_loader.h>
 #include <iostream>
+#include <chrono>
 #include <glm/gtc/constants.hpp>
 
+ObjParser MeshUtils::objParser = ObjParser::Mapped;
+
 Mesh* MeshUtils::makeQuad(float size)
 {
 	if (size <= 0) size = 1.0f;
@@ -152,8 +163,14 @@ Mesh* MeshUtils::makePlane(glm::vec2 size, glm::ivec2 partitions, glm::ivec2 til
 	return new Mesh(vertexes);
 }
 
-Mesh* MeshUtils::loadObjFile(const std::string& filePath)
+// Expands every face corner of the OBJ into its own vertex
+bool MeshUtils::parseObjFile(const std::string& filePath, std::vector<Vertex>& vertices, ObjParser parser)
 {
+	if (parser == ObjParser::Mapped)
+	{
+		return ObjParserUtils::parseMapped(filePath, vertices);
+	}
+
 	tinyobj::ObjReaderConfig reader_config;
 	reader_config.mtl_search_path = "";
 	tinyobj::ObjReader reader;
@@ -163,7 +180,7 @@ Mesh* MeshUtils::loadObjFile(const std::string& filePath)
 			std::cerr << "TinyObjReader: " << reader.Error();
 		}
 
-		return 0;
+		return false;
 	}
 	if (!reader.Warning().empty()) {
 		std::cout << "TinyObjReader: " << reader.Warning();
@@ -173,7 +190,15 @@ Mesh* MeshUtils::loadObjFile(const std::string& filePath)
 	auto& shapes = reader.GetShapes();
 	auto& materials = reader.GetMaterials();
 
-	std::vector<Vertex> vertices;
+	// One vertex per face corner; reserve up front to avoid regrowth
+	size_t cornerCount = 0;
+	for (size_t s = 0; s < shapes.size(); s++)
+	{
+		cornerCount += shapes[s].mesh.indices.size();
+	}
+
+	vertices.clear();
+	vertices.reserve(cornerCount);
 
 	// Loop over shapes
 	for (size_t s = 0; s < shapes.size(); s++)
@@ -227,7 +252,96 @@ Mesh* MeshUtils::loadObjFile(const std::string& filePath)
 		}
 	}
 
-	Mesh* mesh = new Mesh(vertices);
+	return true;
+}
+
+Mesh* MeshUtils::loadObjFile(const std::string& filePath, VertexFormat format)
+{
+	Mesh* mesh = loadCachedObjFile(filePath, format);
+	if (mesh) return mesh;
+
+	ColdMeshLoad load = processObjFile(filePath);
+	return finishObjFile(filePath, format, load);
+}
+
+Mesh* MeshUtils::loadCachedObjFile(const std::string& filePath, VertexFormat format)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	// Warm path: processed mesh from the binary cache next to the OBJ
+	Mesh* mesh = MeshBinaryUtils::load(filePath, format);
+	if (mesh)
+	{
+		std::cout << "Loaded mesh (warm): " << filePath << " (" << mesh->vertexCount << " vertices, " << VertexFormatUtils::getName(mesh->format) << ", " << BenchUtils::getElapsedMs(start) << " ms)" << std::endl;
+	}
+	return mesh;
+}
+
+ColdMeshLoad MeshUtils::processObjFile(const std::string& filePath)
+{
+	auto start = std::chrono::steady_clock::now();
+	ColdMeshLoad load = {};
+
+	// Cold path: parse, generate tangents and weld, then reorder for the GPU.
+	// Scratch memory of all of it comes from this thread's load arena and is given back before returning.
+	LoadArenaScope arenaScope(LoadArena::forThread());
+	std::vector<Vertex> vertices;
+	if (!parseObjFile(filePath, vertices, objParser))
+	{
+		return load;
+	}
+
+	load.cornerCount = vertices.size();
+
+	// Generate tangents and weld identical corners
+	Mesh* mesh = new Mesh();
+	mesh->vertices.swap(vertices);
+	mesh->prepare();
+
+	load.before = MeshOptimizerUtils::analyzeVertexCache(mesh->indices, mesh->vertices.size());
+	MeshOptimizerUtils::optimize(mesh->vertices, mesh->indices);
+
+	// Split LOD 0 into meshlets for culling, in the triangle order just optimised
+	MeshletUtils::buildMeshlets(mesh->vertices, mesh->indices, mesh->indices.size(), mesh->meshlets);
+	load.after = MeshOptimizerUtils::analyzeVertexCache(mesh->indices, mesh->vertices.size());
+
+	// Coarser levels go after the full mesh in the same index buffer
+	MeshSimplifierUtils::buildLodChain(mesh->vertices, mesh->indices, mesh->lods);
+
+	load.mesh = mesh;
+	load.processMs = BenchUtils::getElapsedMs(start);
+	return load;
+}
+
+Mesh* MeshUtils::finishObjFile(const std::string& filePath, VertexFormat format, const ColdMeshLoad& load)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	Mesh* mesh = load.mesh;
+	if (!mesh) return 0;
+
+	mesh->format = format;
+	mesh->setup();
+	double coldMs = load.processMs + BenchUtils::getElapsedMs(start);
+
+	MeshBinaryUtils::save(filePath, mesh);
+
+	std::cout << "Loaded mesh (cold): " << filePath << " (" << load.cornerCount << " corners -> " << mesh->vertices.size() << " vertices, " << coldMs << " ms)" << std::endl;
+	std::cout << "Optimised mesh: " << filePath << " (ACMR " << load.before.acmr << " -> " << load.after.acmr << ", ATVR " << load.before.atvr << " -> " << load.after.atvr << ")" << std::endl;
+
+	std::cout << "Mesh LODs: " << filePath << " (";
+	for (unsigned int i = 0; i < mesh->getLodCount(); i++)
+	{
+		const MeshLod& lod = mesh->getLod(i);
+		std::cout << (i > 0 ? ", " : "") << lod.indexCount / 3 << " triangles";
+		if (i > 0) std::cout << " at error " << lod.error;
+	}
+	std::cout << "), " << mesh->meshlets.size() << " meshlets" << std::endl;
+
+	// Round trip through the chosen format to show what quantisation costs
+	VertexRoundTripError error = VertexFormatUtils::measureError(mesh->format, mesh->vertices.data(), mesh->vertices.size());
+	std::cout << "Vertex format: " << filePath << " (" << VertexFormatUtils::getName(mesh->format) << ", " << sizeof(Vertex) << " -> " << VertexFormatUtils::getStride(mesh->format) << " bytes per vertex"
+		<< ", max error: position " << error.position << ", normal " << error.normalDegrees << " deg, tangent " << error.tangentDegrees << " deg, uv " << error.uv << ", colour " << error.colour << ")" << std::endl;
 	return mesh;
 }
 
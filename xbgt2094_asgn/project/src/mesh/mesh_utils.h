@@ -1,16 +1,43 @@
 #pragma once
 #include <string>
+#include <vector>
 #include <glm/glm.hpp>
 #include "mesh.h"
+#include "mesh_optimizer.h"
+
+enum class ObjParser
+{
+	TinyObj,	// tinyobjloader, single threaded through iostreams
+	Mapped		// ObjParserUtils::parseMapped, memory-mapped and multi-threaded
+};
+
+// What the CPU half of a cold OBJ load made, for MeshUtils::finishObjFile to upload
+struct ColdMeshLoad
+{
+	Mesh* mesh;		// not uploaded yet; null if the file could not be parsed
+	size_t cornerCount;
+	VertexCacheStats before, after;	// of the welded triangles, and once reordered
+	double processMs;
+};
 
 class MeshUtils
 {
 public:
+	static ObjParser objParser;	// backend used by loadObjFile
+
 	static Mesh* makeQuad(float size);
 	static Mesh* makeQuad(float width, float height);
 	static Mesh* makeEquiTriangle(float edgeLength);
 	static Mesh* makeDisk(float radius, int slices);
 	static Mesh* makePlane(glm::vec2 size, glm::ivec2 partitions, glm::ivec2 tiling);
-	static Mesh* loadObjFile(const std::string& filePath);
+	static Mesh* loadObjFile(const std::string& filePath, VertexFormat format = VertexFormat::Packed);
+	// The halves of loadObjFile. The binary cache is tried first, on the thread owning the GL context; null when
+	// there is no valid one. processObjFile is the cold path's parsing, tangents, welding, reordering, meshlets
+	// and LODs, makes no GL calls and can run on any thread. finishObjFile uploads its mesh in format on the
+	// context's thread, writes the binary cache and logs the load.
+	static Mesh* loadCachedObjFile(const std::string& filePath, VertexFormat format);
+	static ColdMeshLoad processObjFile(const std::string& filePath);
+	static Mesh* finishObjFile(const std::string& filePath, VertexFormat format, const ColdMeshLoad& load);
+	static bool parseObjFile(const std::string& filePath, std::vector<Vertex>& vertices, ObjParser parser);
 	static Mesh* makeSkybox();
 };
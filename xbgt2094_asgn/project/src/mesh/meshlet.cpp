@@ -0,0 +1,336 @@
+#include "meshlet.h"
+#include "mesh_optimizer.h"
+#include "obj_parser.h"
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include "../framework/bench_utils.h"
+
+// A meshlet of at least this many triangles ends before one facing further than MIN_SPLIT_DOT from its average
+// normal, about 45 degrees
+static const unsigned int MIN_CONE_TRIANGLES = 16;
+static const float MIN_SPLIT_DOT = 0.7f;
+
+// Cones wider than this (normals more than ~84 degrees off the axis) can never be fully backfacing
+static const float MIN_CONE_DOT = 0.1f;
+
+static glm::vec3 getTriangleNormal(const std::vector<Vertex>& vertices, const unsigned int* triangle)
+{
+	const glm::vec3& p0 = vertices[triangle[0]].position;
+	glm::vec3 normal = glm::cross(vertices[triangle[1]].position - p0, vertices[triangle[2]].position - p0);
+	float length = glm::length(normal);
+	return length > 0.0f ? normal / length : glm::vec3(0.0f);
+}
+
+// Bounding sphere around the box of the meshlet's vertices, and the cone around its triangle normals
+static void computeBounds(const std::vector<Vertex>& vertices, const unsigned int* indices, Meshlet& meshlet)
+{
+	size_t indexCount = (size_t)meshlet.triangleCount * 3;
+
+	glm::vec3 minPosition = vertices[indices[0]].position, maxPosition = minPosition;
+	for (size_t i = 1; i < indexCount; i++)
+	{
+		minPosition = glm::min(minPosition, vertices[indices[i]].position);
+		maxPosition = glm::max(maxPosition, vertices[indices[i]].position);
+	}
+
+	meshlet.center = (minPosition + maxPosition) * 0.5f;
+	meshlet.radius = 0.0f;
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		meshlet.radius = std::max(meshlet.radius, glm::length(vertices[indices[i]].position - meshlet.center));
+	}
+
+	glm::vec3 normalSum(0.0f);
+	for (size_t i = 0; i < indexCount; i += 3) normalSum += getTriangleNormal(vertices, &indices[i]);
+
+	float length = glm::length(normalSum);
+	meshlet.coneAxis = length > 0.0f ? normalSum / length : glm::vec3(0.0f, 0.0f, 1.0f);
+	meshlet.coneCutoff = 1.0f;
+	if (length <= 0.0f) return;
+
+	float minDot = 1.0f;
+	for (size_t i = 0; i < indexCount; i += 3)
+	{
+		glm::vec3 normal = getTriangleNormal(vertices, &indices[i]);
+		if (normal != glm::vec3(0.0f)) minDot = std::min(minDot, glm::dot(normal, meshlet.coneAxis));
+	}
+
+	// Every triangle faces away once the view direction is within 90 degrees minus the cone's half angle of the axis
+	if (minDot > MIN_CONE_DOT)
+	{
+		meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+	}
+}
+
+// Cuts LOD 0 into meshlets in the order the optimizer left its triangles, so the vertex cache and overdraw order
+// are drawn exactly as they were. A meshlet ends when the next triangle would take it past MAX_VERTICES or
+// MAX_TRIANGLES, or, once it holds MIN_CONE_TRIANGLES, would bend its normal cone past MIN_SPLIT_DOT, which
+// keeps the cones of curved surfaces narrow enough to be culled.
+void MeshletUtils::buildMeshlets(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, size_t indexCount, std::vector<Meshlet>& meshlets)
+{
+	meshlets.clear();
+
+	size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0) return;
+
+	std::vector<unsigned int> usedBy(vertices.size(), UINT_MAX);	// meshlet that already holds the vertex
+	unsigned int current = 0;
+	glm::vec3 normalSum(0.0f);
+
+	Meshlet meshlet = {};
+
+	auto finishMeshlet = [&](size_t end)
+	{
+		computeBounds(vertices, &indices[meshlet.indexOffset], meshlet);
+		meshlets.push_back(meshlet);
+
+		meshlet = {};
+		meshlet.indexOffset = (unsigned int)end;
+		normalSum = glm::vec3(0.0f);
+		current++;
+	};
+
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		const unsigned int* triangle = &indices[t * 3];
+		glm::vec3 normal = getTriangleNormal(vertices, triangle);
+
+		if (meshlet.triangleCount > 0)
+		{
+			unsigned int extra = 0;
+			for (int k = 0; k < 3; k++)
+			{
+				bool repeated = (k > 0 && triangle[k] == triangle[0]) || (k > 1 && triangle[k] == triangle[1]);
+				if (usedBy[triangle[k]] != current && !repeated) extra++;
+			}
+
+			float length = glm::length(normalSum);
+			bool full = meshlet.vertexCount + extra > MAX_VERTICES || meshlet.triangleCount == MAX_TRIANGLES;
+			bool bends = meshlet.triangleCount >= MIN_CONE_TRIANGLES && length > 0.0f && glm::dot(normal, normalSum / length) < MIN_SPLIT_DOT;
+
+			if (full || bends) finishMeshlet(t * 3);
+		}
+
+		for (int k = 0; k < 3; k++)
+		{
+			if (usedBy[triangle[k]] == current) continue;
+
+			usedBy[triangle[k]] = current;
+			meshlet.vertexCount++;
+		}
+
+		meshlet.triangleCount++;
+		normalSum += normal;
+	}
+
+	finishMeshlet(triangleCount * 3);
+}
+
+void MeshletUtils::cull(const Mesh* mesh, const glm::mat4& model, const glm::mat4& viewProjection, glm::vec3 cameraPosition, bool backfaceCull,
+	MeshletDrawList& drawList, MeshletCullStats& stats)
+{
+	drawList.counts.clear();
+	drawList.offsets.clear();
+
+	// Frustum planes in model space (Gribb & Hartmann), normalised so sphere radii can be compared directly
+	glm::mat4 mvp = viewProjection * model;
+	glm::vec4 rows[4];
+	for (int r = 0; r < 4; r++) rows[r] = glm::vec4(mvp[0][r], mvp[1][r], mvp[2][r], mvp[3][r]);
+
+	glm::vec4 planes[6] = { rows[3] + rows[0], rows[3] - rows[0], rows[3] + rows[1], rows[3] - rows[1], rows[3] + rows[2], rows[3] - rows[2] };
+	for (glm::vec4& plane : planes)
+	{
+		float length = glm::length(glm::vec3(plane));
+		if (length > 0.0f) plane /= length;
+	}
+
+	// Facing is preserved by affine transforms, so the cone test works in model space too
+	glm::vec3 eye = glm::vec3(glm::inverse(model) * glm::vec4(cameraPosition, 1.0f));
+
+	unsigned int runEnd = UINT_MAX;
+
+	for (const Meshlet& meshlet : mesh->getMeshlets())
+	{
+		stats.meshlets++;
+		stats.triangles += meshlet.triangleCount;
+
+		bool inside = true;
+		for (const glm::vec4& plane : planes)
+		{
+			if (glm::dot(glm::vec3(plane), meshlet.center) + plane.w < -meshlet.radius)
+			{
+				inside = false;
+				break;
+			}
+		}
+
+		if (!inside)
+		{
+			stats.frustumCulled++;
+			continue;
+		}
+
+		if (backfaceCull && meshlet.coneCutoff < 1.0f)
+		{
+			glm::vec3 toCenter = meshlet.center - eye;
+			if (glm::dot(toCenter, meshlet.coneAxis) >= meshlet.coneCutoff * glm::length(toCenter) + meshlet.radius)
+			{
+				stats.coneCulled++;
+				continue;
+			}
+		}
+
+		stats.trianglesDrawn += meshlet.triangleCount;
+
+		// Extend the previous run when this meshlet follows it in the index buffer
+		unsigned int count = meshlet.triangleCount * 3;
+
+		if (meshlet.indexOffset == runEnd)
+		{
+			drawList.counts.back() += (int)count;
+		}
+		else
+		{
+			drawList.counts.push_back((int)count);
+			drawList.offsets.push_back((const void*)((size_t)meshlet.indexOffset * sizeof(unsigned int)));
+		}
+
+		runEnd = meshlet.indexOffset + count;
+	}
+}
+
+#pragma region Benchmark
+
+// Triangle list of a UV sphere, dense enough for meshlets to be nearly flat
+static void makeSyntheticSphere(std::vector<Vertex>& vertices, int rings, int segments)
+{
+	auto point = [&](int ring, int segment)
+	{
+		float theta = glm::pi<float>() * ring / rings;
+		float phi = 2.0f * glm::pi<float>() * segment / segments;
+		glm::vec3 normal(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+		return Vertex(normal, normal, glm::vec2((float)segment / segments, (float)ring / rings));
+	};
+
+	vertices.clear();
+	for (int ring = 0; ring < rings; ring++)
+	{
+		for (int segment = 0; segment < segments; segment++)
+		{
+			Vertex a = point(ring, segment), b = point(ring, segment + 1);
+			Vertex c = point(ring + 1, segment), d = point(ring + 1, segment + 1);
+
+			// Counter-clockwise seen from outside
+			if (ring > 0) vertices.insert(vertices.end(), { a, b, c });
+			if (ring < rings - 1) vertices.insert(vertices.end(), { b, d, c });
+		}
+	}
+}
+
+// Culls mesh from rings of views around it: far enough to see all of it, and close enough to see part of it
+static void benchmarkMesh(const std::string& name, Mesh& mesh, double buildMs, float optimizedAcmr, bool sameOrder)
+{
+	const int VIEWS_PER_RING = 16;
+	const float RING_ELEVATIONS[3] = { -30.0f, 0.0f, 30.0f };
+	const float RING_DISTANCES[2] = { 3.0f, 1.2f };
+	glm::mat4 projection = glm::perspective(glm::radians(60.0f), 1024.0f / 768.0f, 0.1f, 1000.0f);
+
+	glm::vec3 center = mesh.getBoundsCenter();
+	float radius = mesh.getBoundsRadius();
+
+	// Whole-object culling draws every triangle whenever the mesh is in view, which it always is here
+	size_t views = 0, objectTriangles = 0, meshletTriangles = 0, meshletCount = 0, frustumCulled = 0, coneCulled = 0;
+	double cullMs = 0.0;
+	MeshletDrawList drawList;
+
+	for (float distance : RING_DISTANCES)
+	{
+		for (float elevation : RING_ELEVATIONS)
+		{
+			for (int v = 0; v < VIEWS_PER_RING; v++)
+			{
+				float azimuth = glm::radians(360.0f * v / VIEWS_PER_RING);
+				float pitch = glm::radians(elevation);
+				glm::vec3 direction(std::cos(pitch) * std::sin(azimuth), std::sin(pitch), std::cos(pitch) * std::cos(azimuth));
+				glm::vec3 eye = center + direction * radius * distance;
+				glm::mat4 viewProjection = projection * glm::lookAt(eye, center, glm::vec3(0.0f, 1.0f, 0.0f));
+
+				MeshletCullStats stats = {};
+				auto cullStart = std::chrono::steady_clock::now();
+				MeshletUtils::cull(&mesh, glm::mat4(1.0f), viewProjection, eye, true, drawList, stats);
+				cullMs += BenchUtils::getElapsedMs(cullStart);
+
+				views++;
+				objectTriangles += stats.triangles;
+				meshletTriangles += stats.trianglesDrawn;
+				meshletCount += stats.meshlets;
+				frustumCulled += stats.frustumCulled;
+				coneCulled += stats.coneCulled;
+			}
+		}
+	}
+
+	float meshletAcmr = MeshOptimizerUtils::analyzeVertexCache(mesh.indices, mesh.vertices.size()).acmr;
+
+	printf("%-40s %10zu %9zu %9.2f %14.1f%% %14.1f%% %12.1f%% %12.1f%% %9.2f %9.3f %9.3f %s\n", name.c_str(), mesh.indices.size() / 3, mesh.getMeshlets().size(), buildMs,
+		100.0, 100.0 * meshletTriangles / objectTriangles, 100.0 * frustumCulled / meshletCount, 100.0 * coneCulled / meshletCount, cullMs * 1000.0 / views,
+		optimizedAcmr, meshletAcmr, sameOrder ? "same" : "changed");
+}
+
+void MeshletUtils::runBenchmark(const std::string& assetDirectory)
+{
+	std::vector<std::string> filePaths = BenchUtils::findFiles(assetDirectory, { ".obj" });
+
+	// Empty path stands for the generated sphere
+	filePaths.push_back("");
+
+	BenchUtils::printTitle("Meshlet culling benchmark, %u vertices and %u triangles per meshlet at most", MAX_VERTICES, MAX_TRIANGLES);
+	printf("%-40s %10s %9s %9s %15s %15s %13s %13s %9s %9s %9s %s\n", "File", "Triangles", "Meshlets", "Build ms", "Drawn (object)", "Drawn (meshlet)",
+		"Frustum cull", "Cone cull", "Cull us", "ACMR opt", "ACMR mlt", "Triangle order");
+
+	for (const std::string& path : filePaths)
+	{
+		Mesh mesh;
+		if (path.empty())
+		{
+			makeSyntheticSphere(mesh.vertices, 256, 512);
+		}
+		else if (!ObjParserUtils::parseMapped(path, mesh.vertices))
+		{
+			continue;
+		}
+
+		// Same processing as loading the mesh, without uploading it
+		mesh.prepare();
+		MeshOptimizerUtils::optimize(mesh.vertices, mesh.indices);
+
+		// The vertex cache and overdraw order the meshlets have to keep
+		std::vector<unsigned int> optimized = mesh.indices;
+		float optimizedAcmr = MeshOptimizerUtils::analyzeVertexCache(optimized, mesh.vertices.size()).acmr;
+
+		auto start = std::chrono::steady_clock::now();
+		buildMeshlets(mesh.vertices, mesh.indices, mesh.indices.size(), mesh.meshlets);
+		double buildMs = BenchUtils::getElapsedMs(start);
+
+		if (mesh.meshlets.empty()) continue;
+
+		// Bounds are normally computed on upload
+		glm::vec3 minPosition = mesh.vertices[0].position, maxPosition = minPosition;
+		for (const Vertex& vertex : mesh.vertices)
+		{
+			minPosition = glm::min(minPosition, vertex.position);
+			maxPosition = glm::max(maxPosition, vertex.position);
+		}
+		mesh.boundsCenter = (minPosition + maxPosition) * 0.5f;
+		mesh.boundsRadius = glm::length(maxPosition - minPosition) * 0.5f;
+
+		benchmarkMesh(path.empty() ? "(synthetic sphere)" : path, mesh, buildMs, optimizedAcmr, mesh.indices == optimized);
+	}
+}
+
+#pragma endregion
\ No newline at end of file
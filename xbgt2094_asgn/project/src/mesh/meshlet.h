@@ -0,0 +1,42 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "mesh.h"
+
+// Visible parts of a mesh as runs of its index buffer, for glMultiDrawElements
+struct MeshletDrawList
+{
+	std::vector<int> counts;				// indices per run
+	std::vector<const void*> offsets;		// byte offset of each run in the index buffer
+};
+
+struct MeshletCullStats
+{
+	unsigned int meshlets;
+	unsigned int frustumCulled;
+	unsigned int coneCulled;
+	unsigned int triangles;
+	unsigned int trianglesDrawn;
+};
+
+// Splits LOD 0 of a mesh into small clusters of neighbouring triangles, each with a bounding sphere and a
+// cone around its normals, so parts of the mesh outside the view or facing away can be skipped on the CPU.
+class MeshletUtils
+{
+public:
+	static const unsigned int MAX_VERTICES = 64;
+	static const unsigned int MAX_TRIANGLES = 124;
+
+	// Splits the first indexCount entries of indices into meshlets of consecutive triangles, leaving their order as it is
+	static void buildMeshlets(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, size_t indexCount, std::vector<Meshlet>& meshlets);
+
+	// Fills drawList with the meshlets that are inside the frustum of viewProjection and, with backfaceCull,
+	// not facing away from cameraPosition. Adjacent visible meshlets are merged into one run.
+	static void cull(const Mesh* mesh, const glm::mat4& model, const glm::mat4& viewProjection, glm::vec3 cameraPosition, bool backfaceCull,
+		MeshletDrawList& drawList, MeshletCullStats& stats);
+
+	// Builds meshlets for every OBJ under assetDirectory, plus a dense generated sphere, and culls them from rings of views around each mesh,
+	// comparing the triangles drawn against culling whole objects. Needs no window or GL context.
+	static void runBenchmark(const std::string& assetDirectory);
+};
\ No newline at end of file
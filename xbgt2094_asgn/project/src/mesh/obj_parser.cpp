@@ -0,0 +1,754 @@
+#include "obj_parser.h"
+#include "mesh_utils.h"
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <limits>
+#include <thread>
+#include "../framework/bench_utils.h"
+#include "../framework/file_utils.h"
+#include "../framework/load_arena.h"
+
+// Files smaller than this per thread are not worth splitting further.
+static const size_t MIN_CHUNK_BYTES = 256 * 1024;
+
+// Attributes and faces of one line-aligned slice of the file.
+struct ObjChunk
+{
+	const char* begin;
+	const char* end;
+
+	std::vector<float> positions;	// xyz
+	std::vector<float> colours;		// rgb per position; white when the line has none
+	std::vector<float> uvs;			// uv
+	std::vector<float> normals;		// xyz
+
+	std::vector<int> corners;				// (position, uv, normal) index per face corner, -1 when absent
+	std::vector<unsigned int> faceSizes;	// corners per face, as written
+	std::vector<size_t> relativeCorners;	// corners entries holding negative indices, resolved against this chunk only
+	bool onlyTriangles;
+
+	std::vector<unsigned int> triangles;	// corner numbers after triangulation; unused when onlyTriangles
+
+	size_t lineCount;
+	size_t errorLine;	// line within the chunk that failed to parse, 0 if none
+	bool badIndex;
+
+	size_t positionOffset, uvOffset, normalOffset;
+	size_t triangleOffset, triangleCount;
+};
+
+// Runs fn(i) for every chunk, one thread per chunk with chunk 0 on the calling thread
+template <typename Fn>
+static void forEachChunk(std::vector<ObjChunk>& chunks, Fn fn)
+{
+	std::vector<std::thread> workers;
+	for (size_t i = 1; i < chunks.size(); i++)
+	{
+		workers.emplace_back([&fn, &chunks, i]() { fn(chunks[i]); });
+	}
+
+	fn(chunks[0]);
+
+	for (std::thread& worker : workers)
+	{
+		worker.join();
+	}
+}
+
+#pragma region Line Parsing
+
+// The mapped file is not NUL terminated, so every helper stops at end as well as at the rules tinyobj uses.
+
+static inline bool isSpace(char c) { return c == ' ' || c == '\t'; }
+static inline bool isLineEnd(char c) { return c == '\r' || c == '\n'; }
+static inline bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+static inline const char* skipSpaces(const char* p, const char* end)
+{
+	while (p < end && isSpace(*p)) p++;
+	return p;
+}
+
+// tinyobj parseReal: the token runs to the next blank, and a failed parse leaves value untouched.
+// Parsed as a double and narrowed, like tinyobj, so both paths agree on every bit.
+static inline bool parseFloat(const char*& p, const char* end, float& value)
+{
+	const char* first = skipSpaces(p, end);
+	const char* last = first;
+	while (last < end && !isSpace(*last) && !isLineEnd(*last)) last++;
+	p = last;
+
+	// tinyobj only takes digits after an optional sign (no inf/nan), and from_chars rejects '+'
+	const char* digits = (first < last && (*first == '+' || *first == '-')) ? first + 1 : first;
+	if (digits == last || !(isDigit(*digits) || *digits == '.')) return false;
+	if (*first == '+') first++;
+
+	double parsed;
+	if (std::from_chars(first, last, parsed).ec != std::errc()) return false;
+
+	value = (float)parsed;
+	return true;
+}
+
+// atoi, bounded by end
+static inline int parseInt(const char* p, const char* end)
+{
+	while (p < end && (isSpace(*p) || *p == '\v' || *p == '\f')) p++;
+
+	bool negative = false;
+	if (p < end && (*p == '+' || *p == '-'))
+	{
+		negative = *p == '-';
+		p++;
+	}
+
+	int value = 0;
+	while (p < end && isDigit(*p))
+	{
+		value = value * 10 + (*p - '0');
+		p++;
+	}
+
+	return negative ? -value : value;
+}
+
+static inline const char* skipIndex(const char* p, const char* end)
+{
+	while (p < end && *p != '/' && !isSpace(*p) && !isLineEnd(*p)) p++;
+	return p;
+}
+
+// tinyobj fixIndex: 1-based, negative counts back from the attributes read so far, 0 is invalid.
+// A chunk only knows its own attributes, so negative indices are flagged and offset after the merge.
+static inline bool fixIndex(int index, size_t count, int& result, bool& relative)
+{
+	if (index == 0) return false;
+
+	if (index > 0)
+	{
+		result = index - 1;
+	}
+	else
+	{
+		result = (int)count + index;
+		relative = true;
+	}
+
+	return true;
+}
+
+// One face corner: i, i/j, i//k or i/j/k (tinyobj parseTriple)
+static bool parseCorner(const char*& p, const char* end, ObjChunk& chunk)
+{
+	int corner[3] = { -1, -1, -1 };
+	bool relative[3] = { false, false, false };
+
+	if (!fixIndex(parseInt(p, end), chunk.positions.size() / 3, corner[0], relative[0])) return false;
+	p = skipIndex(p, end);
+
+	if (p < end && *p == '/')
+	{
+		p++;
+
+		if (p < end && *p == '/')
+		{
+			p++;
+			if (!fixIndex(parseInt(p, end), chunk.normals.size() / 3, corner[2], relative[2])) return false;
+			p = skipIndex(p, end);
+		}
+		else
+		{
+			if (!fixIndex(parseInt(p, end), chunk.uvs.size() / 2, corner[1], relative[1])) return false;
+			p = skipIndex(p, end);
+
+			if (p < end && *p == '/')
+			{
+				p++;
+				if (!fixIndex(parseInt(p, end), chunk.normals.size() / 3, corner[2], relative[2])) return false;
+				p = skipIndex(p, end);
+			}
+		}
+	}
+
+	for (int i = 0; i < 3; i++)
+	{
+		if (relative[i]) chunk.relativeCorners.push_back(chunk.corners.size());
+		chunk.corners.push_back(corner[i]);
+	}
+
+	return true;
+}
+
+static void parseChunk(ObjChunk& chunk)
+{
+	const char* p = chunk.begin;
+	const char* end = chunk.end;
+
+	chunk.lineCount = 0;
+	chunk.errorLine = 0;
+	chunk.onlyTriangles = true;
+
+	while (p < end)
+	{
+		chunk.lineCount++;
+
+		const char* lineEnd = p;
+		while (lineEnd < end && !isLineEnd(*lineEnd)) lineEnd++;
+
+		const char* token = skipSpaces(p, lineEnd);
+		size_t length = lineEnd - token;
+
+		// Lines end at \n, \r or \r\n, like tinyobj's safeGetline
+		p = lineEnd;
+		if (p < end)
+		{
+			p += (*p == '\r' && p + 1 < end && p[1] == '\n') ? 2 : 1;
+		}
+
+		if (length < 2 || token[0] == '#') continue;
+
+		if (token[0] == 'v' && isSpace(token[1]))
+		{
+			token += 2;
+
+			float x = 0.0f, y = 0.0f, z = 0.0f;
+			parseFloat(token, lineEnd, x);
+			parseFloat(token, lineEnd, y);
+			parseFloat(token, lineEnd, z);
+
+			float r, g, b;
+			bool hasColour = parseFloat(token, lineEnd, r) && parseFloat(token, lineEnd, g) && parseFloat(token, lineEnd, b);
+			if (!hasColour) r = g = b = 1.0f;
+
+			chunk.positions.insert(chunk.positions.end(), { x, y, z });
+			chunk.colours.insert(chunk.colours.end(), { r, g, b });
+			continue;
+		}
+
+		if (length < 3) continue;
+
+		if (token[0] == 'v' && token[1] == 'n' && isSpace(token[2]))
+		{
+			token += 3;
+
+			float x = 0.0f, y = 0.0f, z = 0.0f;
+			parseFloat(token, lineEnd, x);
+			parseFloat(token, lineEnd, y);
+			parseFloat(token, lineEnd, z);
+
+			chunk.normals.insert(chunk.normals.end(), { x, y, z });
+			continue;
+		}
+
+		if (token[0] == 'v' && token[1] == 't' && isSpace(token[2]))
+		{
+			token += 3;
+
+			float u = 0.0f, v = 0.0f;
+			parseFloat(token, lineEnd, u);
+			parseFloat(token, lineEnd, v);
+
+			chunk.uvs.insert(chunk.uvs.end(), { u, v });
+			continue;
+		}
+
+		if (token[0] == 'f' && isSpace(token[1]))
+		{
+			token = skipSpaces(token + 2, lineEnd);
+
+			unsigned int cornerCount = 0;
+			while (token < lineEnd)
+			{
+				if (!parseCorner(token, lineEnd, chunk))
+				{
+					chunk.errorLine = chunk.lineCount;
+					return;
+				}
+
+				cornerCount++;
+				token = skipSpaces(token, lineEnd);
+			}
+
+			chunk.faceSizes.push_back(cornerCount);
+			if (cornerCount != 3) chunk.onlyTriangles = false;
+		}
+	}
+}
+
+#pragma endregion
+
+#pragma region Triangulation
+
+// tinyobj pnpoly
+static int pointInPolygon(int nvert, const float* vertx, const float* verty, float testx, float testy)
+{
+	int i, j, c = 0;
+	for (i = 0, j = nvert - 1; i < nvert; j = i++)
+	{
+		if (((verty[i] > testy) != (verty[j] > testy)) &&
+			(testx < (vertx[j] - vertx[i]) * (testy - verty[i]) / (verty[j] - verty[i]) + vertx[i]))
+			c = !c;
+	}
+	return c;
+}
+
+// Ear clipping ported from tinyobj's exportGroupsToShape, expression for expression, so polygons
+// split into exactly the same triangles. Appends corner numbers of the polygon starting at firstCorner.
+static void triangulatePolygon(const ObjChunk& chunk, unsigned int firstCorner, unsigned int cornerCount,
+	const ArenaVector<float>& v, std::vector<unsigned int>& triangles)
+{
+	const size_t npolys = cornerCount;
+	auto positionOf = [&](unsigned int corner) { return (size_t)chunk.corners[3 * corner]; };
+
+	// find the two axes to work in
+	size_t axes[2] = { 1, 2 };
+	for (size_t k = 0; k < npolys; ++k)
+	{
+		size_t vi0 = positionOf(firstCorner + (unsigned int)((k + 0) % npolys));
+		size_t vi1 = positionOf(firstCorner + (unsigned int)((k + 1) % npolys));
+		size_t vi2 = positionOf(firstCorner + (unsigned int)((k + 2) % npolys));
+
+		float v0x = v[vi0 * 3 + 0];
+		float v0y = v[vi0 * 3 + 1];
+		float v0z = v[vi0 * 3 + 2];
+		float v1x = v[vi1 * 3 + 0];
+		float v1y = v[vi1 * 3 + 1];
+		float v1z = v[vi1 * 3 + 2];
+		float v2x = v[vi2 * 3 + 0];
+		float v2y = v[vi2 * 3 + 1];
+		float v2z = v[vi2 * 3 + 2];
+		float e0x = v1x - v0x;
+		float e0y = v1y - v0y;
+		float e0z = v1z - v0z;
+		float e1x = v2x - v1x;
+		float e1y = v2y - v1y;
+		float e1z = v2z - v1z;
+		float cx = std::fabs(e0y * e1z - e0z * e1y);
+		float cy = std::fabs(e0z * e1x - e0x * e1z);
+		float cz = std::fabs(e0x * e1y - e0y * e1x);
+		const float epsilon = std::numeric_limits<float>::epsilon();
+		if (cx > epsilon || cy > epsilon || cz > epsilon)
+		{
+			// found a corner
+			if (!(cx > cy && cx > cz))
+			{
+				axes[0] = 0;
+				if (cz > cx && cz > cy) axes[1] = 1;
+			}
+			break;
+		}
+	}
+
+	float area = 0;
+	for (size_t k = 0; k < npolys; ++k)
+	{
+		size_t vi0 = positionOf(firstCorner + (unsigned int)((k + 0) % npolys));
+		size_t vi1 = positionOf(firstCorner + (unsigned int)((k + 1) % npolys));
+		float v0x = v[vi0 * 3 + axes[0]];
+		float v0y = v[vi0 * 3 + axes[1]];
+		float v1x = v[vi1 * 3 + axes[0]];
+		float v1y = v[vi1 * 3 + axes[1]];
+		area += (v0x * v1y - v0y * v1x) * 0.5f;
+	}
+
+	ArenaVector<unsigned int> remaining(npolys);
+	for (size_t k = 0; k < npolys; k++) remaining[k] = firstCorner + (unsigned int)k;
+
+	size_t guessVert = 0;
+	unsigned int ind[3];
+	float vx[3];
+	float vy[3];
+
+	// How many iterations can we do without decreasing the remaining vertices
+	size_t remainingIterations = npolys;
+	size_t previousRemainingVertices = npolys;
+
+	while (remaining.size() > 3 && remainingIterations > 0)
+	{
+		size_t count = remaining.size();
+		if (guessVert >= count) guessVert -= count;
+
+		if (previousRemainingVertices != count)
+		{
+			previousRemainingVertices = count;
+			remainingIterations = count;
+		}
+		else
+		{
+			remainingIterations--;
+		}
+
+		for (size_t k = 0; k < 3; k++)
+		{
+			ind[k] = remaining[(guessVert + k) % count];
+			size_t vi = positionOf(ind[k]);
+			vx[k] = v[vi * 3 + axes[0]];
+			vy[k] = v[vi * 3 + axes[1]];
+		}
+
+		float e0x = vx[1] - vx[0];
+		float e0y = vy[1] - vy[0];
+		float e1x = vx[2] - vx[1];
+		float e1y = vy[2] - vy[1];
+		float cross = e0x * e1y - e0y * e1x;
+
+		// if an internal angle
+		if (cross * area < 0.0f)
+		{
+			guessVert += 1;
+			continue;
+		}
+
+		// check all other verts in case they are inside this triangle
+		bool overlap = false;
+		for (size_t otherVert = 3; otherVert < count; ++otherVert)
+		{
+			size_t ovi = positionOf(remaining[(guessVert + otherVert) % count]);
+			float tx = v[ovi * 3 + axes[0]];
+			float ty = v[ovi * 3 + axes[1]];
+			if (pointInPolygon(3, vx, vy, tx, ty))
+			{
+				overlap = true;
+				break;
+			}
+		}
+
+		if (overlap)
+		{
+			guessVert += 1;
+			continue;
+		}
+
+		// this triangle is an ear
+		triangles.insert(triangles.end(), { ind[0], ind[1], ind[2] });
+		remaining.erase(remaining.begin() + (guessVert + 1) % count);
+	}
+
+	if (remaining.size() == 3)
+	{
+		triangles.insert(triangles.end(), { remaining[0], remaining[1], remaining[2] });
+	}
+}
+
+#pragma endregion
+
+bool ObjParserUtils::parseMapped(const std::string& filePath, std::vector<Vertex>& vertices, unsigned int threadCount)
+{
+	FileUtils::MappedFile file;
+	if (!file.open(filePath))
+	{
+		std::cerr << "ObjParser: could not open " << filePath << std::endl;
+		return false;
+	}
+
+	const char* data = reinterpret_cast<const char*>(file.data());
+	const char* dataEnd = data + file.size();
+
+	if (threadCount == 0) threadCount = std::max(1u, std::thread::hardware_concurrency());
+	size_t chunkCount = std::min<size_t>(threadCount, std::max<size_t>(1, file.size() / MIN_CHUNK_BYTES));
+
+	// Split into roughly equal chunks, each ending just after a newline so no line straddles two chunks
+	std::vector<ObjChunk> chunks(chunkCount);
+	const char* chunkBegin = data;
+	for (size_t i = 0; i < chunkCount; i++)
+	{
+		const char* chunkEnd = dataEnd;
+		if (i + 1 < chunkCount)
+		{
+			const char* target = std::max(chunkBegin, data + file.size() / chunkCount * (i + 1));
+			const char* newline = static_cast<const char*>(memchr(target, '\n', dataEnd - target));
+			if (newline) chunkEnd = newline + 1;
+		}
+
+		chunks[i].begin = chunkBegin;
+		chunks[i].end = chunkEnd;
+		chunkBegin = chunkEnd;
+	}
+
+	forEachChunk(chunks, parseChunk);
+
+	// Attribute offsets of each chunk in the merged arrays
+	size_t lineOffset = 0, positionCount = 0, uvCount = 0, normalCount = 0;
+	for (ObjChunk& chunk : chunks)
+	{
+		if (chunk.errorLine != 0)
+		{
+			std::cerr << "ObjParser: failed to parse face on line " << (lineOffset + chunk.errorLine) << " of " << filePath << std::endl;
+			return false;
+		}
+		lineOffset += chunk.lineCount;
+
+		chunk.positionOffset = positionCount;
+		chunk.uvOffset = uvCount;
+		chunk.normalOffset = normalCount;
+		positionCount += chunk.positions.size() / 3;
+		uvCount += chunk.uvs.size() / 2;
+		normalCount += chunk.normals.size() / 3;
+	}
+
+	// The merged attributes only live until the vertices are expanded
+	LoadArenaScope arenaScope(LoadArena::forThread());
+	ArenaVector<float> positions(positionCount * 3), colours(positionCount * 3), uvs(uvCount * 2), normals(normalCount * 3);
+
+	// Merge attributes and turn every corner index into an index into the merged arrays
+	forEachChunk(chunks, [&](ObjChunk& chunk)
+	{
+		std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + chunk.positionOffset * 3);
+		std::copy(chunk.colours.begin(), chunk.colours.end(), colours.begin() + chunk.positionOffset * 3);
+		std::copy(chunk.uvs.begin(), chunk.uvs.end(), uvs.begin() + chunk.uvOffset * 2);
+		std::copy(chunk.normals.begin(), chunk.normals.end(), normals.begin() + chunk.normalOffset * 3);
+		std::vector<float>().swap(chunk.positions);
+		std::vector<float>().swap(chunk.colours);
+		std::vector<float>().swap(chunk.uvs);
+		std::vector<float>().swap(chunk.normals);
+
+		const size_t offsets[3] = { chunk.positionOffset, chunk.uvOffset, chunk.normalOffset };
+		for (size_t slot : chunk.relativeCorners)
+		{
+			chunk.corners[slot] += (int)offsets[slot % 3];
+		}
+
+		chunk.badIndex = false;
+		for (size_t i = 0; i < chunk.corners.size(); i += 3)
+		{
+			const int* corner = &chunk.corners[i];
+			if (corner[0] < 0 || (size_t)corner[0] >= positionCount ||
+				corner[1] < -1 || (corner[1] >= 0 && (size_t)corner[1] >= uvCount) ||
+				corner[2] < -1 || (corner[2] >= 0 && (size_t)corner[2] >= normalCount))
+			{
+				chunk.badIndex = true;
+				break;
+			}
+		}
+	});
+
+	for (const ObjChunk& chunk : chunks)
+	{
+		if (chunk.badIndex)
+		{
+			std::cerr << "ObjParser: face index out of range in " << filePath << std::endl;
+			return false;
+		}
+	}
+
+	// Triangulate polygons; needs every chunk's positions merged first
+	forEachChunk(chunks, [&](ObjChunk& chunk)
+	{
+		if (chunk.onlyTriangles)
+		{
+			chunk.triangleCount = chunk.faceSizes.size();
+			return;
+		}
+
+		// Each polygon's working list is taken back as soon as it is clipped
+		LoadArenaScope arenaScope(LoadArena::forThread());
+		unsigned int firstCorner = 0;
+		for (unsigned int faceSize : chunk.faceSizes)
+		{
+			if (faceSize == 3)
+			{
+				chunk.triangles.insert(chunk.triangles.end(), { firstCorner, firstCorner + 1, firstCorner + 2 });
+			}
+			else if (faceSize > 3)
+			{
+				triangulatePolygon(chunk, firstCorner, faceSize, positions, chunk.triangles);
+			}
+
+			// Faces with fewer than 3 corners are dropped, as tinyobj does
+			firstCorner += faceSize;
+		}
+
+		chunk.triangleCount = chunk.triangles.size() / 3;
+	});
+
+	size_t triangleCount = 0;
+	for (ObjChunk& chunk : chunks)
+	{
+		chunk.triangleOffset = triangleCount;
+		triangleCount += chunk.triangleCount;
+	}
+
+	vertices.clear();
+	vertices.resize(triangleCount * 3);
+
+	// Expand corners into vertices, each chunk writing its own range
+	forEachChunk(chunks, [&](ObjChunk& chunk)
+	{
+		Vertex* out = vertices.data() + chunk.triangleOffset * 3;
+		size_t cornerCount = chunk.triangleCount * 3;
+
+		for (size_t i = 0; i < cornerCount; i++)
+		{
+			const int* corner = &chunk.corners[3 * (chunk.onlyTriangles ? i : chunk.triangles[i])];
+			Vertex& vertex = out[i];
+
+			size_t p = 3 * (size_t)corner[0];
+			vertex.position = { positions[p + 0], positions[p + 1], positions[p + 2] };
+
+			if (corner[2] >= 0)
+			{
+				size_t n = 3 * (size_t)corner[2];
+				vertex.normal = { normals[n + 0], normals[n + 1], normals[n + 2] };
+			}
+
+			if (corner[1] >= 0)
+			{
+				size_t t = 2 * (size_t)corner[1];
+				vertex.uv = { uvs[t + 0], uvs[t + 1] };
+			}
+
+			vertex.colour = { colours[p + 0], colours[p + 1], colours[p + 2] };
+		}
+	});
+
+	return true;
+}
+
+#pragma region Benchmark
+
+// Grid of quads with positions, uvs and one shared normal. Alternate rows are written as quads and
+// as triangle pairs so the benchmark covers both the polygon and the plain triangle paths.
+static bool writeSyntheticObj(const std::string& filePath, size_t triangleCount)
+{
+	FILE* file = fopen(filePath.c_str(), "wb");
+	if (!file) return false;
+
+	size_t cells = (triangleCount + 1) / 2;
+	size_t columns = (size_t)std::ceil(std::sqrt((double)cells));
+	size_t rows = (cells + columns - 1) / columns;
+
+	std::vector<char> buffer(1 << 20);
+	size_t used = 0;
+	auto flushIfFull = [&]()
+	{
+		if (buffer.size() - used < 256)
+		{
+			fwrite(buffer.data(), 1, used, file);
+			used = 0;
+		}
+	};
+
+	used += snprintf(&buffer[used], buffer.size() - used, "# synthetic benchmark grid, %zu triangles\n", triangleCount);
+
+	for (size_t y = 0; y <= rows; y++)
+	{
+		for (size_t x = 0; x <= columns; x++)
+		{
+			float u = (float)x / columns, v = (float)y / rows;
+			used += snprintf(&buffer[used], buffer.size() - used, "v %.6f %.6f 0.000000\nvt %.6f %.6f\n", u * 100.0f - 50.0f, v * 100.0f - 50.0f, u, v);
+			flushIfFull();
+		}
+	}
+
+	used += snprintf(&buffer[used], buffer.size() - used, "vn 0.000000 0.000000 1.000000\n");
+
+	size_t written = 0;
+	for (size_t y = 0; y < rows && written < triangleCount; y++)
+	{
+		for (size_t x = 0; x < columns && written < triangleCount; x++)
+		{
+			size_t a = y * (columns + 1) + x + 1;
+			size_t b = a + 1;
+			size_t c = a + columns + 2;
+			size_t d = a + columns + 1;
+
+			if (y % 2 == 0 && triangleCount - written >= 2)
+			{
+				used += snprintf(&buffer[used], buffer.size() - used, "f %zu/%zu/1 %zu/%zu/1 %zu/%zu/1 %zu/%zu/1\n", a, a, b, b, c, c, d, d);
+				written += 2;
+			}
+			else
+			{
+				used += snprintf(&buffer[used], buffer.size() - used, "f %zu/%zu/1 %zu/%zu/1 %zu/%zu/1\n", a, a, b, b, c, c);
+				written++;
+				if (written < triangleCount)
+				{
+					used += snprintf(&buffer[used], buffer.size() - used, "f %zu/%zu/1 %zu/%zu/1 %zu/%zu/1\n", a, a, c, c, d, d);
+					written++;
+				}
+			}
+			flushIfFull();
+		}
+	}
+
+	fwrite(buffer.data(), 1, used, file);
+	return fclose(file) == 0;
+}
+
+// Parses the file the given way, keeping only the fastest of runs and a hash of the output
+template <typename Fn>
+static bool timeParse(int runs, Fn parse, double& bestMs, size_t& vertexCount, uint64_t& hash)
+{
+	bestMs = std::numeric_limits<double>::max();
+
+	for (int run = 0; run < runs; run++)
+	{
+		std::vector<Vertex> vertices;
+
+		auto start = std::chrono::steady_clock::now();
+		if (!parse(vertices)) return false;
+		bestMs = std::min(bestMs, BenchUtils::getElapsedMs(start));
+
+		vertexCount = vertices.size();
+		hash = FileUtils::hashBytes(vertices.data(), vertices.size() * sizeof(Vertex));
+	}
+
+	return true;
+}
+
+void ObjParserUtils::runBenchmark(const std::string& assetDirectory, size_t syntheticTriangles)
+{
+	std::vector<std::string> filePaths = BenchUtils::findFiles(assetDirectory, { ".obj" });
+
+	std::string syntheticPath;
+	if (syntheticTriangles > 0)
+	{
+		syntheticPath = (std::filesystem::temp_directory_path() / "obj_parser_benchmark.obj").string();
+		printf("Writing synthetic OBJ with %zu triangles to %s\n", syntheticTriangles, syntheticPath.c_str());
+
+		if (writeSyntheticObj(syntheticPath, syntheticTriangles))
+			filePaths.push_back(syntheticPath);
+		else
+			printf("Could not write %s\n", syntheticPath.c_str());
+	}
+
+	BenchUtils::printTitle("OBJ parser benchmark%s", BenchUtils::getThreadsNote().c_str());
+	printf("%-56s %10s %12s %12s %8s  %s\n", "File", "Vertices", "tinyobj ms", "mapped ms", "Speedup", "Output");
+
+	for (const std::string& path : filePaths)
+	{
+		std::error_code sizeError;
+		bool large = std::filesystem::file_size(path, sizeError) > 64 * 1024 * 1024;
+		int runs = large ? 1 : 5;
+
+		double tinyMs = 0.0, mappedMs = 0.0;
+		size_t tinyCount = 0, mappedCount = 0;
+		uint64_t tinyHash = 0, mappedHash = 0;
+
+		bool tinyOk = timeParse(runs, [&](std::vector<Vertex>& v) { return MeshUtils::parseObjFile(path, v, ObjParser::TinyObj); }, tinyMs, tinyCount, tinyHash);
+		bool mappedOk = timeParse(runs, [&](std::vector<Vertex>& v) { return parseMapped(path, v); }, mappedMs, mappedCount, mappedHash);
+
+		if (!tinyOk || !mappedOk)
+		{
+			printf("%-56s %10s %12s %12s %8s  %s\n", path.c_str(), "-", tinyOk ? "ok" : "failed", mappedOk ? "ok" : "failed", "-", "-");
+			continue;
+		}
+
+		bool identical = tinyCount == mappedCount && tinyHash == mappedHash;
+		printf("%-56s %10zu %12.2f %12.2f %7.2fx  %s\n", path.c_str(), mappedCount, tinyMs, mappedMs, tinyMs / mappedMs, identical ? "identical" : "MISMATCH");
+	}
+
+	if (!syntheticPath.empty())
+	{
+		std::error_code error;
+		std::filesystem::remove(syntheticPath, error);
+	}
+}
+
+#pragma endregion
\ No newline at end of file
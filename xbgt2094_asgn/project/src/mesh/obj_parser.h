@@ -0,0 +1,20 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "mesh.h"
+
+// OBJ parser that memory-maps the file, splits it into line-aligned chunks and parses the chunks
+// on worker threads, then merges the per-chunk attribute and face arrays.
+// The result matches the tinyobjloader path corner for corner: positions, normals, uvs and vertex
+// colours, with polygons triangulated by the same ear clipping. Materials, groups, lines and points
+// are not needed by the renderer and are skipped.
+class ObjParserUtils
+{
+public:
+	// Expands every triangle corner into its own vertex. threadCount 0 uses every hardware thread.
+	static bool parseMapped(const std::string& filePath, std::vector<Vertex>& vertices, unsigned int threadCount = 0);
+
+	// Times tinyobjloader against parseMapped on every OBJ under assetDirectory, plus a generated OBJ with
+	// syntheticTriangles triangles when that is non-zero, and checks that both produce bit-identical vertices.
+	static void runBenchmark(const std::string& assetDirectory, size_t syntheticTriangles);
+};
\ No newline at end of file
@@ -0,0 +1,378 @@
+#include "tangent_space.h"
+#include "mikktspace.h"
+#include "obj_parser.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <unordered_map>
+#include "../framework/bench_utils.h"
+#include "../framework/file_utils.h"
+#include "../framework/job_utils.h"
+
+// Triangle lists smaller than this are generated on the calling thread
+static const size_t MIN_PARALLEL_TRIANGLES = 32768;
+
+// Smallest part worth handing to another thread
+static const size_t MIN_JOB_TRIANGLES = 8192;
+
+// JobUtils::run for generators, which return false when MikkTSpace fails; so does this if any did
+template <typename Fn>
+static bool runJobs(size_t count, unsigned int threadCount, Fn fn)
+{
+	std::atomic<bool> ok(true);
+	JobUtils::run(count, threadCount, [&](size_t i)
+	{
+		if (!fn(i)) ok = false;
+	});
+	return ok;
+}
+
+#pragma region MikkTSpace Callbacks
+
+// The job is the context's user data, so nothing is shared between generators
+static const TangentSpaceJob* getJob(const SMikkTSpaceContext* context)
+{
+	return static_cast<const TangentSpaceJob*>(context->m_pUserData);
+}
+
+// Corner in the full triangle list
+static size_t getCorner(const TangentSpaceJob* job, int iFace, int iVert)
+{
+	size_t face = job->faces ? job->faces[iFace] : (size_t)iFace;
+	return face * 3 + iVert;
+}
+
+static int get_num_faces_fn(const SMikkTSpaceContext* context)
+{
+	return (int)getJob(context)->faceCount;
+}
+
+static int get_num_vertices_of_face_fn(const SMikkTSpaceContext*, int)
+{
+	return 3;
+}
+
+static void get_position_fn(const SMikkTSpaceContext* context, float outpos[], int iFace, int iVert)
+{
+	const TangentSpaceJob* job = getJob(context);
+	const glm::vec3& position = job->positions[getCorner(job, iFace, iVert)];
+
+	outpos[0] = position.x;
+	outpos[1] = position.y;
+	outpos[2] = position.z;
+}
+
+static void get_normal_fn(const SMikkTSpaceContext* context, float outnormal[], int iFace, int iVert)
+{
+	const TangentSpaceJob* job = getJob(context);
+	const glm::vec3& normal = job->normals[getCorner(job, iFace, iVert)];
+
+	outnormal[0] = normal.x;
+	outnormal[1] = normal.y;
+	outnormal[2] = normal.z;
+}
+
+static void get_uv_fn(const SMikkTSpaceContext* context, float outuv[], int iFace, int iVert)
+{
+	const TangentSpaceJob* job = getJob(context);
+	const glm::vec2& uv = job->uvs[getCorner(job, iFace, iVert)];
+
+	outuv[0] = uv.x;
+	outuv[1] = uv.y;
+}
+
+static void set_tspace_basic_fn(const SMikkTSpaceContext* context, const float tangentu[], float fSign, int iFace, int iVert)
+{
+	const TangentSpaceJob* job = getJob(context);
+	glm::vec4& tangent = job->tangents[getCorner(job, iFace, iVert)];
+
+	tangent.x = tangentu[0];
+	tangent.y = tangentu[1];
+	tangent.z = tangentu[2];
+	tangent.w = fSign;
+}
+
+#pragma endregion
+
+#pragma region Splitting
+
+// MikkTSpace merges corners whose position, normal and uv compare equal, and only triangles sharing a merged
+// corner affect each other's tangents. Adding 0 turns -0 into +0 so the bytes match whenever the floats do.
+struct CornerKey
+{
+	float values[8];
+};
+
+struct CornerKeyHash
+{
+	size_t operator()(const CornerKey& key) const
+	{
+		return (size_t)FileUtils::hashBytes(key.values, sizeof(key.values));
+	}
+};
+
+struct CornerKeyEqual
+{
+	bool operator()(const CornerKey& a, const CornerKey& b) const
+	{
+		return std::memcmp(a.values, b.values, sizeof(a.values)) == 0;
+	}
+};
+
+static unsigned int findRoot(std::vector<unsigned int>& parent, unsigned int i)
+{
+	while (parent[i] != i)
+	{
+		parent[i] = parent[parent[i]];
+		i = parent[i];
+	}
+	return i;
+}
+
+// Groups the triangles of job into at most jobLimit lists of roughly equal size, never separating triangles
+// that share a MikkTSpace vertex. Each list keeps the triangles in their original order.
+static void splitIndependentParts(const TangentSpaceJob& job, size_t jobLimit, std::vector<std::vector<unsigned int>>& parts)
+{
+	unsigned int faceCount = (unsigned int)job.faceCount;
+
+	std::vector<unsigned int> parent(faceCount);
+	for (unsigned int i = 0; i < faceCount; i++) parent[i] = i;
+
+	std::unordered_map<CornerKey, unsigned int, CornerKeyHash, CornerKeyEqual> firstFace;
+	firstFace.reserve(job.faceCount * 3);
+
+	for (unsigned int face = 0; face < faceCount; face++)
+	{
+		for (int corner = 0; corner < 3; corner++)
+		{
+			size_t index = (size_t)face * 3 + corner;
+			const glm::vec3& position = job.positions[index];
+			const glm::vec3& normal = job.normals[index];
+			const glm::vec2& uv = job.uvs[index];
+
+			CornerKey key = { { position.x + 0.0f, position.y + 0.0f, position.z + 0.0f,
+				normal.x + 0.0f, normal.y + 0.0f, normal.z + 0.0f, uv.x + 0.0f, uv.y + 0.0f } };
+
+			unsigned int other = firstFace.emplace(key, face).first->second;
+			unsigned int a = findRoot(parent, face), b = findRoot(parent, other);
+
+			// Keep the earliest face as the root so parts are numbered in order of appearance
+			if (a != b) parent[std::max(a, b)] = std::min(a, b);
+		}
+	}
+
+	// Triangles per connected group, counted at its root
+	std::vector<unsigned int> groupSize(faceCount, 0);
+	for (unsigned int face = 0; face < faceCount; face++)
+	{
+		groupSize[findRoot(parent, face)]++;
+	}
+
+	// Fill each part up to its share before starting the next one
+	size_t target = (job.faceCount + jobLimit - 1) / jobLimit;
+	std::vector<unsigned int> groupPart(faceCount, 0);
+	size_t part = 0, partSize = 0;
+
+	for (unsigned int face = 0; face < faceCount; face++)
+	{
+		if (parent[face] != face) continue;
+
+		if (partSize >= target && part + 1 < jobLimit)
+		{
+			part++;
+			partSize = 0;
+		}
+		groupPart[face] = (unsigned int)part;
+		partSize += groupSize[face];
+	}
+
+	parts.assign(part + 1, std::vector<unsigned int>());
+	for (unsigned int face = 0; face < faceCount; face++)
+	{
+		parts[groupPart[parent[face]]].push_back(face);
+	}
+}
+
+#pragma endregion
+
+TangentSpaceJob TangentSpaceUtils::makeJob(std::vector<Vertex>& vertices)
+{
+	TangentSpaceJob job = {};
+	if (vertices.empty()) return job;
+
+	Vertex* first = vertices.data();
+	job.positions = { &first->position, sizeof(Vertex) };
+	job.normals = { &first->normal, sizeof(Vertex) };
+	job.uvs = { &first->uv, sizeof(Vertex) };
+	job.tangents = { &first->tangent, sizeof(Vertex) };
+	job.faces = nullptr;
+	job.faceCount = vertices.size() / 3;
+	return job;
+}
+
+bool TangentSpaceUtils::generate(const TangentSpaceJob& job)
+{
+	if (job.faceCount == 0) return true;
+
+	SMikkTSpaceInterface iface = {};
+	iface.m_getNumFaces = get_num_faces_fn;
+	iface.m_getNumVerticesOfFace = get_num_vertices_of_face_fn;
+	iface.m_getNormal = get_normal_fn;
+	iface.m_getPosition = get_position_fn;
+	iface.m_getTexCoord = get_uv_fn;
+
+	iface.m_setTSpaceBasic = set_tspace_basic_fn;
+
+	SMikkTSpaceContext context = {};
+	context.m_pInterface = &iface;
+	context.m_pUserData = const_cast<TangentSpaceJob*>(&job);
+
+	return genTangSpaceDefault(&context) != 0;
+}
+
+bool TangentSpaceUtils::generate(std::vector<Vertex>& vertices, unsigned int threadCount)
+{
+	TangentSpaceJob whole = makeJob(vertices);
+
+	if (threadCount == 0) threadCount = std::max(1u, std::thread::hardware_concurrency());
+	size_t jobLimit = std::min<size_t>(threadCount, whole.faceCount / MIN_JOB_TRIANGLES);
+
+	if (whole.faceCount < MIN_PARALLEL_TRIANGLES || jobLimit < 2)
+	{
+		return generate(whole);
+	}
+
+	// A connected mesh is a single part and gains nothing from splitting
+	std::vector<std::vector<unsigned int>> parts;
+	splitIndependentParts(whole, jobLimit, parts);
+
+	if (parts.size() < 2)
+	{
+		return generate(whole);
+	}
+
+	std::vector<TangentSpaceJob> jobs(parts.size(), whole);
+	for (size_t i = 0; i < parts.size(); i++)
+	{
+		jobs[i].faces = parts[i].data();
+		jobs[i].faceCount = parts[i].size();
+	}
+
+	return runJobs(jobs.size(), threadCount, [&](size_t i) { return generate(jobs[i]); });
+}
+
+bool TangentSpaceUtils::generateBatch(const std::vector<std::vector<Vertex>*>& meshes, unsigned int threadCount)
+{
+	if (threadCount == 0) threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+	// Starting with the largest keeps one big mesh from finishing last on its own
+	std::vector<size_t> order(meshes.size());
+	for (size_t i = 0; i < order.size(); i++) order[i] = i;
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return meshes[a]->size() > meshes[b]->size(); });
+
+	return runJobs(order.size(), threadCount, [&](size_t i) { return generate(makeJob(*meshes[order[i]])); });
+}
+
+#pragma region Benchmark
+
+static bool isIdentical(const std::vector<Vertex>& a, const std::vector<Vertex>& b)
+{
+	return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size() * sizeof(Vertex)) == 0;
+}
+
+// Copies of every mesh side by side, each shifted by its own offset, until there are at least minTriangles
+static void tileMeshes(const std::vector<std::vector<Vertex>>& meshes, size_t minTriangles, std::vector<Vertex>& tiled)
+{
+	tiled.clear();
+	for (int tile = 0; tiled.size() / 3 < minTriangles; tile++)
+	{
+		glm::vec3 offset((float)(tile % 32) * 16.0f, 0.0f, (float)(tile / 32) * 16.0f);
+		for (const std::vector<Vertex>& mesh : meshes)
+		{
+			for (Vertex vertex : mesh)
+			{
+				vertex.position += offset;
+				tiled.push_back(vertex);
+			}
+		}
+	}
+}
+
+void TangentSpaceUtils::runBenchmark(const std::string& assetDirectory)
+{
+	std::vector<std::string> filePaths = BenchUtils::findFiles(assetDirectory, { ".obj" });
+
+	std::vector<std::string> names;
+	std::vector<std::vector<Vertex>> meshes;
+	for (const std::string& path : filePaths)
+	{
+		std::vector<Vertex> vertices;
+		if (ObjParserUtils::parseMapped(path, vertices) && !vertices.empty())
+		{
+			names.push_back(path);
+			meshes.push_back(std::move(vertices));
+		}
+	}
+
+	if (!meshes.empty())
+	{
+		std::vector<Vertex> tiled;
+		tileMeshes(meshes, 1000000, tiled);
+		names.push_back("(assets tiled)");
+		meshes.push_back(std::move(tiled));
+	}
+
+	BenchUtils::printTitle("Tangent space benchmark%s", BenchUtils::getThreadsNote().c_str());
+	printf("%-40s %10s %12s %12s %8s  %s\n", "File", "Triangles", "single ms", "split ms", "Speedup", "Output");
+
+	std::vector<std::vector<Vertex>> reference(meshes.size());
+	double singleTotalMs = 0.0;
+
+	for (size_t i = 0; i < meshes.size(); i++)
+	{
+		// One pass over the whole list on this thread, as the loader always did
+		reference[i] = meshes[i];
+		auto start = std::chrono::steady_clock::now();
+		generate(makeJob(reference[i]));
+		double singleMs = BenchUtils::getElapsedMs(start);
+
+		std::vector<Vertex> split = meshes[i];
+		start = std::chrono::steady_clock::now();
+		generate(split);
+		double splitMs = BenchUtils::getElapsedMs(start);
+
+		if (i + 1 < meshes.size()) singleTotalMs += singleMs;
+
+		printf("%-40s %10zu %12.2f %12.2f %7.2fx  %s\n", names[i].c_str(), split.size() / 3, singleMs, splitMs, singleMs / splitMs,
+			isIdentical(reference[i], split) ? "identical" : "MISMATCH");
+	}
+
+	// Every asset as its own job, the way a scene's meshes would be prepared together
+	size_t assetCount = meshes.size() > 0 ? meshes.size() - 1 : 0;
+	std::vector<std::vector<Vertex>> batch(meshes.begin(), meshes.begin() + assetCount);
+	std::vector<std::vector<Vertex>*> batchPointers;
+	size_t batchTriangles = 0;
+	for (std::vector<Vertex>& vertices : batch)
+	{
+		batchPointers.push_back(&vertices);
+		batchTriangles += vertices.size() / 3;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	generateBatch(batchPointers);
+	double batchMs = BenchUtils::getElapsedMs(start);
+
+	bool identical = true;
+	for (size_t i = 0; i < batch.size(); i++)
+	{
+		identical = identical && isIdentical(reference[i], batch[i]);
+	}
+
+	printf("%-40s %10zu %12.2f %12.2f %7.2fx  %s\n", "(assets batched)", batchTriangles, singleTotalMs, batchMs, singleTotalMs / batchMs,
+		identical ? "identical" : "MISMATCH");
+}
+
+#pragma endregion
\ No newline at end of file
@@ -0,0 +1,56 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "mesh.h"
+
+// One attribute read in place: a member of an array of Vertex, or a tightly packed array (stride == sizeof(T))
+template <typename T>
+struct AttributeView
+{
+	T* first;
+	size_t stride;	// bytes from one element to the next
+
+	T& operator[](size_t i) const
+	{
+		return *reinterpret_cast<T*>(reinterpret_cast<uintptr_t>(first) + i * stride);
+	}
+};
+
+// Triangle list to generate tangents for, with one entry per face corner.
+// faces picks a subset of the triangles by number, so parts of one list can be separate jobs without copying them.
+struct TangentSpaceJob
+{
+	AttributeView<const glm::vec3> positions;
+	AttributeView<const glm::vec3> normals;
+	AttributeView<const glm::vec2> uvs;
+	AttributeView<glm::vec4> tangents;	// xyz tangent, w bitangent sign
+
+	const unsigned int* faces;	// triangle numbers in ascending order; null for every triangle
+	size_t faceCount;
+};
+
+// MikkTSpace tangent generation without shared state, so any number of jobs can run at once.
+// Every path writes the same bits as running MikkTSpace once over the whole triangle list.
+class TangentSpaceUtils
+{
+public:
+	// Views over every triangle of vertices
+	static TangentSpaceJob makeJob(std::vector<Vertex>& vertices);
+
+	// Runs MikkTSpace on the calling thread
+	static bool generate(const TangentSpaceJob& job);
+
+	// Large triangle lists are split into parts that share no MikkTSpace vertex, on up to threadCount threads.
+	// threadCount 0 uses every hardware thread.
+	static bool generate(std::vector<Vertex>& vertices, unsigned int threadCount = 0);
+
+	// One triangle list per job, largest first
+	static bool generateBatch(const std::vector<std::vector<Vertex>*>& meshes, unsigned int threadCount = 0);
+
+	// Times a single MikkTSpace pass against the split and batched paths on every OBJ under assetDirectory,
+	// plus a large mesh tiled from all of them, and checks that the tangents are bit-identical.
+	static void runBenchmark(const std::string& assetDirectory);
+};
\ No newline at end of file
@@ -0,0 +1,374 @@
+#include "vertex_format.h"
+#include "obj_parser.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <glm/gtc/packing.hpp>
+#include "../framework/bench_utils.h"
+
+static const float SNORM16_MAX = 32767.0f;
+
+// What the benchmark accepts. Half floats keep 11 bits over [-1, 1] of the bounds, so a corner is off by at most
+// sqrt(3) / 4096, about 1/2365, of the half extent; octahedral 16-bit normals and tangents by about 0.007 degrees;
+// 16-bit uvs by 1/131070 of their range and 8-bit colours by 1/510. Each limit leaves at least twice that.
+static const float MAX_POSITION_ERROR = 1.0f / 1024.0f;		// of the largest half extent of the bounds
+static const float MAX_DIRECTION_ERROR = 0.02f;				// degrees, normals and tangents
+static const float MAX_UV_ERROR = 1.0f / 32768.0f;			// of the largest uv range
+static const float MAX_COLOUR_ERROR = 1.0f / 255.0f;
+
+#pragma region Octahedral Encoding
+
+static glm::vec2 signNotZero(glm::vec2 v)
+{
+	return glm::vec2(v.x >= 0.0f ? 1.0f : -1.0f, v.y >= 0.0f ? 1.0f : -1.0f);
+}
+
+// Same steps as OctDecode in the vertex shaders
+static glm::vec3 octDecode(const int16_t encoded[2])
+{
+	glm::vec2 e = glm::vec2(encoded[0], encoded[1]) * (1.0f / SNORM16_MAX);
+	glm::vec3 v(e.x, e.y, 1.0f - std::fabs(e.x) - std::fabs(e.y));
+	if (v.z < 0.0f)
+	{
+		glm::vec2 wrapped = (1.0f - glm::abs(glm::vec2(v.y, v.x))) * signNotZero(glm::vec2(v.x, v.y));
+		v.x = wrapped.x;
+		v.y = wrapped.y;
+	}
+	return glm::normalize(v);
+}
+
+// Projects onto the octahedron, then keeps whichever of the four surrounding
+// quantised points decodes closest to the input rather than just rounding.
+static void octEncode(glm::vec3 n, int16_t encoded[2])
+{
+	float length = std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z);
+	if (length <= 0.0f)
+	{
+		encoded[0] = encoded[1] = 0;
+		return;
+	}
+
+	glm::vec2 e = glm::vec2(n.x, n.y) / length;
+	if (n.z < 0.0f)
+	{
+		e = (1.0f - glm::abs(glm::vec2(e.y, e.x))) * signNotZero(e);
+	}
+
+	glm::vec3 target = glm::normalize(n);
+	glm::vec2 scaled = glm::clamp(e, -1.0f, 1.0f) * SNORM16_MAX;
+	float bestDot = -2.0f;
+
+	for (int i = 0; i < 4; i++)
+	{
+		int16_t candidate[2] = {
+			(int16_t)((i & 1) ? std::ceil(scaled.x) : std::floor(scaled.x)),
+			(int16_t)((i & 2) ? std::ceil(scaled.y) : std::floor(scaled.y))
+		};
+
+		float d = glm::dot(octDecode(candidate), target);
+		if (d > bestDot)
+		{
+			bestDot = d;
+			encoded[0] = candidate[0];
+			encoded[1] = candidate[1];
+		}
+	}
+}
+
+#pragma endregion
+
+static uint16_t packUnorm16(float v)
+{
+	return (uint16_t)std::lround(glm::clamp(v, 0.0f, 1.0f) * 65535.0f);
+}
+
+// Fields shared by both packed layouts
+template <typename PackedType>
+static void packVertex(const Vertex& vertex, const VertexDecode& decode, PackedType& packed)
+{
+	glm::vec3 position = (vertex.position - decode.positionBias) / decode.positionScale;
+	for (int k = 0; k < 3; k++)
+	{
+		packed.position[k].bits = glm::packHalf1x16(position[k]);
+	}
+	packed.position[3].bits = glm::packHalf1x16(vertex.tangent.w < 0.0f ? -1.0f : 1.0f);
+
+	octEncode(vertex.normal, packed.normal);
+	octEncode(glm::vec3(vertex.tangent), packed.tangent);
+
+	glm::vec2 uv = (vertex.uv - glm::vec2(decode.uvScaleBias.z, decode.uvScaleBias.w)) / glm::vec2(decode.uvScaleBias.x, decode.uvScaleBias.y);
+	packed.uv[0] = packUnorm16(uv.x);
+	packed.uv[1] = packUnorm16(uv.y);
+}
+
+template <typename PackedType>
+static Vertex unpackVertex(const PackedType& packed, const VertexDecode& decode)
+{
+	Vertex vertex;
+
+	glm::vec3 position(glm::unpackHalf1x16(packed.position[0].bits), glm::unpackHalf1x16(packed.position[1].bits), glm::unpackHalf1x16(packed.position[2].bits));
+	vertex.position = position * decode.positionScale + decode.positionBias;
+
+	vertex.normal = octDecode(packed.normal);
+	vertex.tangent = glm::vec4(octDecode(packed.tangent), glm::unpackHalf1x16(packed.position[3].bits));
+
+	glm::vec2 uv(packed.uv[0] / 65535.0f, packed.uv[1] / 65535.0f);
+	vertex.uv = uv * glm::vec2(decode.uvScaleBias.x, decode.uvScaleBias.y) + glm::vec2(decode.uvScaleBias.z, decode.uvScaleBias.w);
+
+	return vertex;
+}
+
+template <typename PackedType>
+static void packAll(const Vertex* vertices, size_t count, const VertexDecode& decode, std::vector<unsigned char>& out)
+{
+	out.resize(count * sizeof(PackedType));
+	PackedType* packed = reinterpret_cast<PackedType*>(out.data());
+
+	for (size_t i = 0; i < count; i++)
+	{
+		packVertex(vertices[i], decode, packed[i]);
+	}
+}
+
+const char* VertexFormatUtils::getName(VertexFormat format)
+{
+	switch (format)
+	{
+	case VertexFormat::Packed: return "Packed";
+	case VertexFormat::PackedColour: return "PackedColour";
+	default: return "Full";
+	}
+}
+
+size_t VertexFormatUtils::getStride(VertexFormat format)
+{
+	switch (format)
+	{
+	case VertexFormat::Packed: return sizeof(PackedVertex);
+	case VertexFormat::PackedColour: return sizeof(PackedColourVertex);
+	default: return sizeof(Vertex);
+	}
+}
+
+bool VertexFormatUtils::hasColour(VertexFormat format)
+{
+	return format != VertexFormat::Packed;
+}
+
+VertexDecode VertexFormatUtils::getIdentityDecode()
+{
+	return { glm::vec3(1.0f), glm::vec3(0.0f), glm::vec4(1.0f, 1.0f, 0.0f, 0.0f) };
+}
+
+VertexFormat VertexFormatUtils::resolve(VertexFormat format, const Vertex* vertices, size_t count)
+{
+	if (format != VertexFormat::Packed) return format;
+
+	for (size_t i = 0; i < count; i++)
+	{
+		if (vertices[i].colour != glm::vec3(1.0f)) return VertexFormat::PackedColour;
+	}
+
+	return format;
+}
+
+VertexDecode VertexFormatUtils::pack(VertexFormat format, const Vertex* vertices, size_t count, std::vector<unsigned char>& out)
+{
+	if (format == VertexFormat::Full)
+	{
+		out.resize(count * sizeof(Vertex));
+		if (count > 0) std::memcpy(out.data(), vertices, count * sizeof(Vertex));
+		return getIdentityDecode();
+	}
+
+	if (count == 0)
+	{
+		out.clear();
+		return getIdentityDecode();
+	}
+
+	// Map the bounds onto [-1, 1] for positions and [0, 1] for uvs
+	glm::vec3 minPosition = vertices[0].position, maxPosition = vertices[0].position;
+	glm::vec2 minUv = vertices[0].uv, maxUv = vertices[0].uv;
+	for (size_t i = 1; i < count; i++)
+	{
+		minPosition = glm::min(minPosition, vertices[i].position);
+		maxPosition = glm::max(maxPosition, vertices[i].position);
+		minUv = glm::min(minUv, vertices[i].uv);
+		maxUv = glm::max(maxUv, vertices[i].uv);
+	}
+
+	VertexDecode decode;
+	decode.positionBias = (minPosition + maxPosition) * 0.5f;
+	decode.positionScale = (maxPosition - minPosition) * 0.5f;
+	glm::vec2 uvScale = maxUv - minUv;
+	for (int k = 0; k < 3; k++)
+	{
+		if (decode.positionScale[k] <= 0.0f) decode.positionScale[k] = 1.0f;
+	}
+	for (int k = 0; k < 2; k++)
+	{
+		if (uvScale[k] <= 0.0f) uvScale[k] = 1.0f;
+	}
+	decode.uvScaleBias = glm::vec4(uvScale, minUv);
+
+	if (format == VertexFormat::Packed)
+	{
+		packAll<PackedVertex>(vertices, count, decode, out);
+	}
+	else
+	{
+		packAll<PackedColourVertex>(vertices, count, decode, out);
+
+		PackedColourVertex* packed = reinterpret_cast<PackedColourVertex*>(out.data());
+		for (size_t i = 0; i < count; i++)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				packed[i].colour[k] = (uint8_t)std::lround(glm::clamp(vertices[i].colour[k], 0.0f, 1.0f) * 255.0f);
+			}
+			packed[i].colour[3] = 255;
+		}
+	}
+
+	return decode;
+}
+
+Vertex VertexFormatUtils::unpack(VertexFormat format, const unsigned char* vertex, const VertexDecode& decode)
+{
+	switch (format)
+	{
+	case VertexFormat::Packed:
+		return unpackVertex(*reinterpret_cast<const PackedVertex*>(vertex), decode);
+
+	case VertexFormat::PackedColour:
+	{
+		const PackedColourVertex& packed = *reinterpret_cast<const PackedColourVertex*>(vertex);
+		Vertex result = unpackVertex(packed, decode);
+		result.colour = glm::vec3(packed.colour[0], packed.colour[1], packed.colour[2]) / 255.0f;
+		return result;
+	}
+
+	default:
+		return *reinterpret_cast<const Vertex*>(vertex);
+	}
+}
+
+void VertexFormatUtils::setupAttributes(VertexFormat format)
+{
+	switch (format)
+	{
+	case VertexFormat::Packed: PackedVertexLayout::setup(); break;
+	case VertexFormat::PackedColour: PackedColourVertexLayout::setup(); break;
+	default: FullVertexLayout::setup(); break;
+	}
+}
+
+// atan2 rather than acos of the dot product, which cannot tell angles below about 0.03 degrees from 0 in floats
+static float angleDegrees(glm::vec3 a, glm::vec3 b)
+{
+	return glm::degrees(std::atan2(glm::length(glm::cross(a, b)), glm::dot(a, b)));
+}
+
+VertexRoundTripError VertexFormatUtils::measureError(VertexFormat format, const Vertex* vertices, size_t count)
+{
+	VertexRoundTripError error = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+
+	std::vector<unsigned char> packed;
+	VertexDecode decode = pack(format, vertices, count, packed);
+	size_t stride = getStride(format);
+
+	for (size_t i = 0; i < count; i++)
+	{
+		const Vertex& original = vertices[i];
+		Vertex decoded = unpack(format, packed.data() + i * stride, decode);
+
+		error.position = std::max(error.position, glm::length(decoded.position - original.position));
+		error.uv = std::max(error.uv, glm::max(std::fabs(decoded.uv.x - original.uv.x), std::fabs(decoded.uv.y - original.uv.y)));
+
+		// Zero vectors (no normals or uvs in the source) have no direction to keep
+		if (glm::length(original.normal) > 0.0f)
+		{
+			error.normalDegrees = std::max(error.normalDegrees, angleDegrees(decoded.normal, original.normal));
+		}
+
+		glm::vec3 tangent(original.tangent);
+		if (glm::length(tangent) > 0.0f)
+		{
+			bool flipped = (decoded.tangent.w < 0.0f) != (original.tangent.w < 0.0f);
+			error.tangentDegrees = std::max(error.tangentDegrees, flipped ? 180.0f : angleDegrees(glm::vec3(decoded.tangent), tangent));
+		}
+
+		if (hasColour(format))
+		{
+			glm::vec3 difference = glm::abs(decoded.colour - original.colour);
+			error.colour = std::max(error.colour, std::max(difference.x, std::max(difference.y, difference.z)));
+		}
+	}
+
+	return error;
+}
+
+bool VertexFormatUtils::runBenchmark(const std::string& assetDirectory)
+{
+	std::vector<std::string> filePaths = BenchUtils::findFiles(assetDirectory, { ".obj" });
+
+	BenchUtils::printTitle("Vertex format round trip, limits: position %.6f of the half extent, normal and tangent %.2f deg, uv %.6f of the range, colour %.4f",
+		MAX_POSITION_ERROR, MAX_DIRECTION_ERROR, MAX_UV_ERROR, MAX_COLOUR_ERROR);
+	printf("%-40s %-12s %9s %10s %12s %10s %11s %10s %10s %9s  %s\n", "File", "Format", "Vertices", "Bytes", "Position", "Normal deg",
+		"Tangent deg", "UV", "Colour", "Pack ms", "Result");
+
+	const VertexFormat formats[3] = { VertexFormat::Full, VertexFormat::Packed, VertexFormat::PackedColour };
+	unsigned int failures = 0, checked = 0;
+
+	for (const std::string& path : filePaths)
+	{
+		// Same tangents and welding as loading the mesh
+		Mesh mesh;
+		if (!ObjParserUtils::parseMapped(path, mesh.vertices) || mesh.vertices.empty()) continue;
+		mesh.prepare();
+
+		const std::vector<Vertex>& vertices = mesh.vertices;
+		glm::vec3 minPosition = vertices[0].position, maxPosition = minPosition;
+		glm::vec2 minUv = vertices[0].uv, maxUv = minUv;
+		for (const Vertex& vertex : vertices)
+		{
+			minPosition = glm::min(minPosition, vertex.position);
+			maxPosition = glm::max(maxPosition, vertex.position);
+			minUv = glm::min(minUv, vertex.uv);
+			maxUv = glm::max(maxUv, vertex.uv);
+		}
+		glm::vec3 halfExtent = (maxPosition - minPosition) * 0.5f;
+		glm::vec2 uvRange = maxUv - minUv;
+		float positionLimit = MAX_POSITION_ERROR * std::max(halfExtent.x, std::max(halfExtent.y, halfExtent.z));
+		float uvLimit = MAX_UV_ERROR * std::max(uvRange.x, uvRange.y);
+
+		for (VertexFormat format : formats)
+		{
+			auto start = std::chrono::steady_clock::now();
+			VertexRoundTripError roundTrip = measureError(format, vertices.data(), vertices.size());
+			double packMs = BenchUtils::getElapsedMs(start);
+
+			// Full must come back exactly
+			bool exact = format == VertexFormat::Full;
+			std::string exceeded;
+			if (roundTrip.position > (exact ? 0.0f : positionLimit)) exceeded += " position";
+			if (roundTrip.normalDegrees > (exact ? 0.0f : MAX_DIRECTION_ERROR)) exceeded += " normal";
+			if (roundTrip.tangentDegrees > (exact ? 0.0f : MAX_DIRECTION_ERROR)) exceeded += " tangent";
+			if (roundTrip.uv > (exact ? 0.0f : uvLimit)) exceeded += " uv";
+			if (roundTrip.colour > (exact ? 0.0f : MAX_COLOUR_ERROR)) exceeded += " colour";
+
+			checked++;
+			if (!exceeded.empty()) failures++;
+
+			printf("%-40s %-12s %9zu %10zu %12.6f %10.4f %11.4f %10.7f %10.5f %9.3f  %s%s\n", path.c_str(), getName(format), vertices.size(),
+				vertices.size() * getStride(format), roundTrip.position, roundTrip.normalDegrees, roundTrip.tangentDegrees, roundTrip.uv,
+				roundTrip.colour, packMs, exceeded.empty() ? "ok" : "FAIL:", exceeded.c_str());
+		}
+	}
+
+	printf("%u of %u round trips over the limits\n", failures, checked);
+	return failures == 0;
+}
\ No newline at end of file
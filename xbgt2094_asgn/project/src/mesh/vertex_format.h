@@ -0,0 +1,86 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "mesh.h"
+#include "vertex_layout.h"
+
+// Quantised vertices. Positions are half floats in [-1, 1] of the mesh bounds, normals and tangents
+// are octahedral in 16-bit integers and uvs are 16-bit unorm over the mesh's uv range; VertexDecode
+// and the vertex shaders turn them back. Normals and tangents go up as plain integers and are
+// divided by 32767 in the shader, since GL 3.3 and later versions map snorm values differently.
+struct PackedVertex
+{
+	Half position[4];		// w holds the tangent handedness
+	int16_t normal[2];
+	int16_t tangent[2];
+	uint16_t uv[2];
+};
+
+struct PackedColourVertex
+{
+	Half position[4];
+	int16_t normal[2];
+	int16_t tangent[2];
+	uint16_t uv[2];
+	uint8_t colour[4];
+};
+
+static_assert(sizeof(PackedVertex) == 20, "PackedVertex must be tightly packed");
+static_assert(sizeof(PackedColourVertex) == 24, "PackedColourVertex must be tightly packed");
+
+typedef VertexLayout<Vertex,
+	VERTEX_ATTRIBUTE(0, Vertex, position, false),
+	VERTEX_ATTRIBUTE(1, Vertex, normal, false),
+	VERTEX_ATTRIBUTE(2, Vertex, uv, false),
+	VERTEX_ATTRIBUTE(3, Vertex, colour, false),
+	VERTEX_ATTRIBUTE(4, Vertex, tangent, false)> FullVertexLayout;
+
+typedef VertexLayout<PackedVertex,
+	VERTEX_ATTRIBUTE(0, PackedVertex, position, false),
+	VERTEX_ATTRIBUTE(1, PackedVertex, normal, false),
+	VERTEX_ATTRIBUTE(2, PackedVertex, uv, true),
+	VERTEX_ATTRIBUTE(4, PackedVertex, tangent, false)> PackedVertexLayout;
+
+typedef VertexLayout<PackedColourVertex,
+	VERTEX_ATTRIBUTE(0, PackedColourVertex, position, false),
+	VERTEX_ATTRIBUTE(1, PackedColourVertex, normal, false),
+	VERTEX_ATTRIBUTE(2, PackedColourVertex, uv, true),
+	VERTEX_ATTRIBUTE(3, PackedColourVertex, colour, true),
+	VERTEX_ATTRIBUTE(4, PackedColourVertex, tangent, false)> PackedColourVertexLayout;
+
+// Largest difference between vertices and what the GPU reads back after packing them
+struct VertexRoundTripError
+{
+	float position;			// model space units
+	float normalDegrees;
+	float tangentDegrees;	// 180 if a handedness flipped
+	float uv;
+	float colour;
+};
+
+class VertexFormatUtils
+{
+public:
+	static const char* getName(VertexFormat format);
+	static size_t getStride(VertexFormat format);
+	static bool hasColour(VertexFormat format);
+	static VertexDecode getIdentityDecode();
+
+	// Packed becomes PackedColour if any vertex colour is not white
+	static VertexFormat resolve(VertexFormat format, const Vertex* vertices, size_t count);
+
+	// Writes count vertices in format to out and returns how to decode them
+	static VertexDecode pack(VertexFormat format, const Vertex* vertices, size_t count, std::vector<unsigned char>& out);
+
+	// CPU mirror of the vertex shader decode
+	static Vertex unpack(VertexFormat format, const unsigned char* vertex, const VertexDecode& decode);
+
+	// Attribute pointers for the bound VAO and VBO
+	static void setupAttributes(VertexFormat format);
+
+	static VertexRoundTripError measureError(VertexFormat format, const Vertex* vertices, size_t count);
+
+	// Packs and unpacks every OBJ under assetDirectory, prepared as on load, in each format and prints the largest
+	// errors against the tolerances below. False when any is exceeded. Needs no window or GL context.
+	static bool runBenchmark(const std::string& assetDirectory);
+};
\ No newline at end of file
@@ -0,0 +1,69 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// Compile-time description of a vertex struct's attributes. Component type, count and offset come
+// from the struct members themselves, so a layout cannot drift from the struct it describes:
+//
+//	typedef VertexLayout<Vertex,
+//		VERTEX_ATTRIBUTE(0, Vertex, position, false),
+//		VERTEX_ATTRIBUTE(1, Vertex, normal, false)> Layout;
+//	Layout::setup();	// glVertexAttribPointer + glEnableVertexAttribArray for each attribute
+
+// 16-bit float bits, as produced by glm::packHalf1x16
+struct Half
+{
+	uint16_t bits;
+};
+
+template <typename T> struct VertexComponentType;
+template <> struct VertexComponentType<float> { static const GLenum value = GL_FLOAT; };
+template <> struct VertexComponentType<Half> { static const GLenum value = GL_HALF_FLOAT; };
+template <> struct VertexComponentType<int16_t> { static const GLenum value = GL_SHORT; };
+template <> struct VertexComponentType<uint16_t> { static const GLenum value = GL_UNSIGNED_SHORT; };
+template <> struct VertexComponentType<uint8_t> { static const GLenum value = GL_UNSIGNED_BYTE; };
+
+// Component type and count of a member: glm vectors or plain arrays
+template <typename T> struct VertexMemberTraits;
+
+template <glm::length_t L, typename T, glm::qualifier Q>
+struct VertexMemberTraits<glm::vec<L, T, Q>>
+{
+	typedef T Component;
+	static const GLint count = L;
+};
+
+template <typename T, size_t N>
+struct VertexMemberTraits<T[N]>
+{
+	typedef T Component;
+	static const GLint count = (GLint)N;
+};
+
+template <GLuint Location, typename Member, bool Normalized, size_t Offset>
+struct VertexAttribute
+{
+	typedef VertexMemberTraits<Member> Traits;
+	static_assert(Traits::count >= 1 && Traits::count <= 4, "Vertex attributes have 1 to 4 components");
+
+	static void setup(GLsizei stride)
+	{
+		glVertexAttribPointer(Location, Traits::count, VertexComponentType<typename Traits::Component>::value,
+			Normalized ? GL_TRUE : GL_FALSE, stride, (void*)Offset);
+		glEnableVertexAttribArray(Location);
+	}
+};
+
+#define VERTEX_ATTRIBUTE(location, VertexType, member, normalized) \
+	VertexAttribute<location, decltype(VertexType::member), normalized, offsetof(VertexType, member)>
+
+template <typename VertexType, typename... Attributes>
+struct VertexLayout
+{
+	static void setup()
+	{
+		(Attributes::setup((GLsizei)sizeof(VertexType)), ...);
+	}
+};
\ No newline at end of file
@@ -1,15 +1,29 @@
 #include "renderable_entity.h"
 #include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include "camera/camera_base.h"
+
+// Full specular, no occlusion and no emission
+static Texture2D* defaultMaterialTexture2D()
+{
+	static unsigned char data[4] = { 0xff, 0xff, 0x00, 0xff };
+	static Texture2D* blank = Texture2D::createColourTexture(1, 1,
+		TextureConfig(TextureWrapMode::REPEAT, TextureWrapMode::REPEAT, TextureFilterMode::NEAREST, false),
+		GL_RGBA, data);
+
+	return blank;
+}
 
 RenderableEntity::RenderableEntity() : mesh(0), shader(0)
 {
 	active = true;
 
 	diffuseTex = TextureUtils::checkerTexture2D();
-	specularTex = TextureUtils::whiteTexture2D();
 	normalTex = TextureUtils::whiteTexture2D();
-	emissiveTex = TextureUtils::blackTexture2D();	// Set blank texture for safety
-	aoTex = TextureUtils::whiteTexture2D();
+	materialTex = defaultMaterialTexture2D();	// Set blank texture for safety
+	materialArrays = nullptr;
+	materialLayer = 0;
+	virtualDiffuse = nullptr;
 
 	shininess = 128;
 	alphaClip = 0.1;
@@ -17,6 +31,8 @@ RenderableEntity::RenderableEntity() : mesh(0), shader(0)
 	breathingSpeed = 0;
 	tint = glm::vec3(1);
 	opacity = 1;
+	lod = 0;
+	objectSlot = 0;
 }
 
 glm::mat4 RenderableEntity::getModelMatrix() const
@@ -36,4 +52,53 @@ glm::mat4 RenderableEntity::getModelMatrix() const
 glm::vec3 RenderableEntity::getPosition() const
 {
 	return glm::vec3(getModelMatrix()[3]);
+}
+
+float RenderableEntity::getMaxScale() const
+{
+	glm::mat4 model = getModelMatrix();
+	return std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+}
+
+float RenderableEntity::getPixelsPerUnit(const CameraBase* camera, const glm::vec3& eye, float viewportHeight) const
+{
+	// Pixels per world unit: proj[1][1] maps view space y to NDC, which spans half the viewport per unit.
+	// Perspective divides by depth, taken at the nearest point of the bounding sphere.
+	glm::mat4 projection = camera->getProjectionMatrix();
+	float pixelsPerUnit = projection[1][1] * viewportHeight * 0.5f;
+
+	if (mesh && projection[2][3] != 0.0f)
+	{
+		glm::vec3 center = glm::vec3(getModelMatrix() * glm::vec4(mesh->getBoundsCenter(), 1.0f));
+		float distance = glm::length(center - eye) - mesh->getBoundsRadius() * getMaxScale();
+		pixelsPerUnit /= std::max(distance, camera->getNearClip());
+	}
+	return pixelsPerUnit;
+}
+
+float RenderableEntity::getScreenSize(const CameraBase* camera, const glm::vec3& eye, float viewportHeight) const
+{
+	if (mesh == 0) return 0.0f;
+	return 2.0f * mesh->getBoundsRadius() * getMaxScale() * getPixelsPerUnit(camera, eye, viewportHeight);
+}
+
+unsigned int RenderableEntity::selectLod(const CameraBase* camera, float viewportHeight, float maxPixelError)
+{
+	lod = 0;
+	if (mesh == 0 || mesh->getLodCount() <= 1) return lod;
+
+	float maxScale = getMaxScale();
+	float pixelsPerUnit = getPixelsPerUnit(camera, camera->getPosition(), viewportHeight);
+
+	// Levels get coarser and their error only grows
+	for (unsigned int i = mesh->getLodCount() - 1; i > 0; i--)
+	{
+		if (mesh->getLod(i).error * maxScale * pixelsPerUnit <= maxPixelError)
+		{
+			lod = i;
+			break;
+		}
+	}
+
+	return lod;
 }
\ No newline at end of file
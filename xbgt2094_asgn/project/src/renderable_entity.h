@@ -3,6 +3,8 @@
 #include "framework/framework.h"
 #include <string>
 
+class CameraBase;
+
 struct RenderableEntity
 {
 public:
@@ -21,10 +23,13 @@ public:
 	// Materials
 	// ----------------------------
 	Texture2D* diffuseTex;
-	Texture2D* specularTex;
 	Texture2D* normalTex;
-	Texture2D* emissiveTex;
-	Texture2D* aoTex;
+	Texture2D* materialTex;	// specular in R, AO in G, emissive in B
+	// Or, instead of the three above, a layer of arrays shared with other entities
+	const MaterialArrays* materialArrays;
+	unsigned int materialLayer;
+	// Sampled for diffuse instead of diffuseTex while virtual texturing is on
+	VirtualTexture* virtualDiffuse;
 	// ----------------------------
 
 	float shininess;
@@ -34,9 +39,22 @@ public:
 	glm::vec3 tint;
 	float opacity;
 
+	unsigned int lod;	// level of the mesh's LOD chain to draw, from selectLod
+	unsigned int objectSlot;	// range of the scene's object uniform buffer holding its ObjectBlock this frame
+
 	RenderableEntity();
 	glm::mat4 getModelMatrix() const;
 	glm::vec3 getPosition() const;
+
+	// Picks the coarsest LOD whose error covers at most maxPixelError pixels of a viewportHeight tall view
+	unsigned int selectLod(const CameraBase* camera, float viewportHeight, float maxPixelError);
+
+	// Pixels across the bounding sphere when seen from eye through camera's projection; eye need not be
+	// where the camera is, for asking how big the entity will be
+	float getScreenSize(const CameraBase* camera, const glm::vec3& eye, float viewportHeight) const;
+
+	float getMaxScale() const;
+	float getPixelsPerUnit(const CameraBase* camera, const glm::vec3& eye, float viewportHeight) const;
 	
 	RenderableEntity* parent = nullptr;
 };
@@ -60,21 +60,71 @@ static TextureConfig cfgClamp(TextureWrapMode::CLAMP, TextureWrapMode::CLAMP, Te
 static TextureConfig cfgRepeatPixel(TextureWrapMode::REPEAT, TextureWrapMode::REPEAT, TextureFilterMode::NEAREST, true);
 static TextureConfig cfgClampPixel(TextureWrapMode::CLAMP, TextureWrapMode::CLAMP, TextureFilterMode::NEAREST, true);
 
+// Spawn functions queue their meshes and maps here; load() processes them all at once on worker threads
+static MeshBatch meshBatch;
+static TextureBatch textureBatch;
+
+// Each map is cooked to the block format that keeps what lit.frag reads from it: colour for diffuse and
+// the packed material map, and xy for normals
+static TextureConfig WithCompression(TextureConfig cfg, TextureCompression compression)
+{
+	cfg.compression = compression;
+	return cfg;
+}
+
+// Alpha tested maps keep the fraction of texels that pass the entity's alphaClip at every mip level, so
+// leaves do not thin out with distance
+static TextureConfig WithAlphaCoverage(TextureConfig cfg, float alphaClip)
+{
+	cfg.alphaCoverage = alphaClip;
+	return cfg;
+}
+
+// lit.frag reads specular, AO and emissive from the R, G and B of one packed map, so they cost a single sample
+static void AddMaterialMap(RenderableEntity* entity, const TextureChannel& specular, const TextureChannel& ao, const TextureChannel& emissive, TextureConfig cfg)
+{
+	textureBatch.addPacked(&entity->materialTex, specular, ao, emissive, WithCompression(cfg, TextureCompression::COLOUR));
+}
+
+// The figurines' maps are all the same size, so each figurine gets a layer of three shared arrays. That saves
+// their texture binds only: each still has its own mesh, draw call and object range, and sets its layer as a uniform
+static MaterialArrayPacker figurinePacker;
+static MaterialArrays figurineArrays;
+
+static void AddFigurineMaterial(RenderableEntity* entity, const std::string& diffuse, const std::string& normal,
+	const TextureChannel& specular, const TextureChannel& ao, const TextureChannel& emissive)
+{
+	entity->materialArrays = &figurineArrays;
+	entity->materialLayer = figurinePacker.add(diffuse, normal, specular, ao, emissive);
+}
+
 
 //FBO--------------------------------------------------------------------------------
 
 static ColourDepthFBO* fbo;
-static Shader* shader_screen;
+static ShaderVariants* screenVariants;
+static Shader* shader_screen;	// the variant for this frame's post process toggles
 
-static void FBOShader()	
+static void ScreenSamplers(Shader* shader)
 {
-	ShaderUtils::loadShader(&shader_screen, "shader_screen", "../assets/shaders/screen.vert", "../assets/shaders/screen.frag");
-
-	SimpleRenderer::bindShader(shader_screen);
+	SimpleRenderer::bindShader(shader);
 	SimpleRenderer::setShaderProp_Integer("mainTex", 0);
 	SimpleRenderer::setShaderProp_Integer("scanline", 1);
 }
 
+static void FBOShader()	
+{
+	if (screenVariants)
+	{
+		screenVariants->reload();
+		return;
+	}
+
+	screenVariants = new ShaderVariants("shader_screen", "../assets/shaders/screen.vert", "../assets/shaders/screen.frag",
+		{ { "SPHERIZE", 1 }, { "GRAYSCALE", 1 }, { "SCANLINES", 1 }, { "VIGNETTE", 1 } }, ScreenSamplers);
+	shader_screen = screenVariants->get(0);
+}
+
 Texture2D* scanlineTex = nullptr;
 
 static void LoadFBO()
@@ -128,19 +178,13 @@ static void RenderFBO()
 	// set shader properties
 	SimpleRenderer::setShaderProp_Float("time", App::getTime());
 
-	SimpleRenderer::setShaderProp_Bool("EnablePostProcess", EnablePostProcess);
-
-	SimpleRenderer::setShaderProp_Bool("EnableSpherize", EnableSpherize);
+	// (which effects run is compiled into the variant)
 	SimpleRenderer::setShaderProp_Float("SpherizeStrength", SpherizeStrength);
 	SimpleRenderer::setShaderProp_Float("ZoomScale", ZoomScale);
 
-	SimpleRenderer::setShaderProp_Bool("EnableGrayscale", EnableGrayscale);
-
-	SimpleRenderer::setShaderProp_Bool("EnableScanlines", EnableScanlines);
 	SimpleRenderer::setShaderProp_Integer("ScanlineTiling", ScanlineTiling);
 	SimpleRenderer::setShaderProp_Float("ScanlineScroll", ScanlineScroll);
 
-	SimpleRenderer::setShaderProp_Bool("EnableVignette", EnableVignette);
 	SimpleRenderer::setShaderProp_Float("VignetteStrength", VignetteStrength);
 	SimpleRenderer::setShaderProp_Vec3("VignetteColor", VignetteColor);
 
@@ -219,19 +263,36 @@ static std::vector<DirectionalLight*> lights_directional;
 static std::vector<PointLight*> lights_point;
 static std::vector<SpotLight*> lights_spot;
 
-static Shader* shader_lit;
+static ShaderVariants* litVariants;
+static Shader* shader_lit;	// the variant for this frame's shadow toggle and light counts
 
-static void StandardLitShader()
+static void LitSamplers(Shader* shader)
 {
-	ShaderUtils::loadShader(&shader_lit, "shader_lit", "../assets/shaders/standard.vert", "../assets/shaders/lit.frag");
-
-	SimpleRenderer::bindShader(shader_lit);
+	SimpleRenderer::bindShader(shader);
 	SimpleRenderer::setShaderProp_Integer("DiffuseTexture", 0);
-	SimpleRenderer::setShaderProp_Integer("SpecularTexture", 1);
+	SimpleRenderer::setShaderProp_Integer("MaterialTexture", 1);
 	SimpleRenderer::setShaderProp_Integer("NormalTexture", 2);
-	SimpleRenderer::setShaderProp_Integer("EmissiveTexture", 3);
-	SimpleRenderer::setShaderProp_Integer("AOTexture", 4);
 	SimpleRenderer::setShaderProp_Integer("shadowMap", 5);
+	SimpleRenderer::setShaderProp_Integer("DiffuseArray", 6);
+	SimpleRenderer::setShaderProp_Integer("MaterialArray", 7);
+	SimpleRenderer::setShaderProp_Integer("NormalArray", 8);
+	SimpleRenderer::setShaderProp_Integer("PageTable", 9);
+	SimpleRenderer::setShaderProp_Integer("PageCache", 10);
+}
+
+static void StandardLitShader()
+{
+	if (litVariants)
+	{
+		litVariants->reload();
+		return;
+	}
+
+	litVariants = new ShaderVariants("shader_lit", "../assets/shaders/standard.vert", "../assets/shaders/lit.frag",
+		{ { "SHADOW", 1 }, { "DIRECTIONAL_LIGHTS", 5 }, { "POINT_LIGHTS", 5 }, { "SPOT_LIGHTS", 5 } }, LitSamplers);
+
+	// Entities spawn with this one and move to the variant matching the scene every frame
+	shader_lit = litVariants->get(0);
 }
 
 static Shader* shader_fire;
@@ -251,11 +312,19 @@ static void ShadowShader()
 	ShaderUtils::loadShader(&shader_shadow, "shader_shadow", "../assets/shaders/shadow.vert", "../assets/shaders/shadow.frag");
 }
 
+static Shader* shader_vt_feedback;
+
+static void VirtualTextureFeedbackShader()
+{
+	ShaderUtils::loadShader(&shader_vt_feedback, "shader_vt_feedback", "../assets/shaders/standard.vert", "../assets/shaders/vt_feedback.frag");
+}
+
 void Scene_ASGN::loadShaders()
 {	
 	StandardLitShader();
 	FireShader();
 	ShadowShader();
+	VirtualTextureFeedbackShader();
 	FBOShader();
 }
 
@@ -267,102 +336,135 @@ static bool EnableShadow = false;
 static float ShadowStrength = 1;
 static float ShadowBias = 0.0005;
 
-static void RenderDirectionalLights()
+// Bound once at their fixed points; every program that declares the blocks reads them
+static UniformBuffer* frameUniforms;
+static UniformBuffer* lightUniforms;
+
+// Every entity's ObjectBlock for the frame in one buffer, a range each, bound per draw
+static UniformBuffer* objectUniforms;
+static size_t objectStride;						// ObjectBlock rounded up to the offset alignment
+static std::vector<unsigned char> objectBlocks;	// staged for the upload
+
+static void CreateUniformBuffers()
 {
-	SimpleRenderer::bindShader(shader_lit);
+	frameUniforms = new UniformBuffer(UniformBlockBinding::FRAME, sizeof(FrameBlock));
+	lightUniforms = new UniformBuffer(UniformBlockBinding::LIGHTS, sizeof(LightsBlock));
+}
 
-	int num_lights = lights_directional.size();
+static ObjectBlock& GetObjectBlock(const RenderableEntity& entity)
+{
+	return *reinterpret_cast<ObjectBlock*>(objectBlocks.data() + entity.objectSlot * objectStride);
+}
 
-	SimpleRenderer::setShaderProp_Integer("NUM_DIRECTIONAL_LIGHTS", num_lights);
+// Built every frame and uploaded only when it differs from the last upload
+static LightsBlock lightsBlock;
 
-	for (int i = 0; i < num_lights; i++)
+// The shadow is cast by the first active directional light
+static glm::mat4 GetShadowLightSpaceMatrix()
+{
+	for (auto light : lights_directional)
 	{
-		auto light = lights_directional[i];
-
-		// check light active
-		glm::vec3 lightCol = light->getActive() ? light->getColorIntensified() : glm::vec3(0, 0, 0);
+		if (light->getActive()) return GetLightSpaceMatrix(light->getDirection());
+	}
+	return glm::mat4(1);
+}
 
-		// set light properties
-		SimpleRenderer::setShaderProp_Vec3("DirectionalLights[" + std::to_string(i) + "].col", lightCol);
-		SimpleRenderer::setShaderProp_Vec3("DirectionalLights[" + std::to_string(i) + "].dir", light->getDirection());
+static void RenderDirectionalLights()
+{
+	int count = 0;
 
-		// set shadow properties
-		SimpleRenderer::setShaderProp_Bool("EnableShadow", EnableShadow);
-		SimpleRenderer::setShaderProp_Float("ShadowStrength", ShadowStrength);
-		SimpleRenderer::setShaderProp_Float("ShadowBias", ShadowBias);
+	for (auto light : lights_directional)
+	{
+		if (!light->getActive() || count == MAX_LIGHTS) continue;
 
-		// set shadowMap
-		glActiveTexture(GL_TEXTURE5);
-		glBindTexture(GL_TEXTURE_2D, shadowMap);
-		SimpleRenderer::setShaderProp_Integer("shadowMap", 5);
+		DirectionalLightBlock& data = lightsBlock.directionalLights[count++];
+		data.col = light->getColorIntensified();
+		data.dir = light->getDirection();
+	}
 
-		// Calculate and set the light space matrix
-		glm::vec3 lightDir = lights_directional[i]->getDirection();
-		glm::mat4 lightSpaceMatrix = GetLightSpaceMatrix(lightDir);
-		SimpleRenderer::setShaderProp_Mat4("lightProjection", lightSpaceMatrix);
-	}	
+	lightsBlock.directionalCount = count;
 }
 
 static void RenderPointLights()
 {
-	SimpleRenderer::bindShader(shader_lit);
-
-	int num_lights = lights_point.size();
+	int count = 0;
 
-	SimpleRenderer::setShaderProp_Integer("NUM_POINT_LIGHTS", num_lights);
-
-	for (int i = 0; i < num_lights; i++)
+	for (auto light : lights_point)
 	{
-		auto light = lights_point[i];
-
-		// check light active
-		glm::vec3 lightCol = light->getActive() ? light->getColorIntensified() : glm::vec3(0, 0, 0);
+		if (!light->getActive() || count == MAX_LIGHTS) continue;
 
-		// set light properties
-		SimpleRenderer::setShaderProp_Vec3("PointLights[" + std::to_string(i) + "].col", lightCol);
-		SimpleRenderer::setShaderProp_Float("PointLights[" + std::to_string(i) + "].range", light->getInverseSquaredRange());
-		SimpleRenderer::setShaderProp_Vec3("PointLights[" + std::to_string(i) + "].pos", light->getPosition());
+		PointLightBlock& data = lightsBlock.pointLights[count++];
+		data.col = light->getColorIntensified();
+		data.range = light->getInverseSquaredRange();
+		data.pos = light->getPosition();
 
 		// Calculate and set the light space matrix
 		//glm::mat4 lightSpaceMatrix = GetLightSpaceMatrixPoint(light->getPosition());
-		//SimpleRenderer::setShaderProp_Mat4("PointLights[" + std::to_string(i) + "].lightSpaceMatrix", lightSpaceMatrix);
 
 		// Set the shadow map texture
 		//int texID = light->getShadowMapTextureID();
 		//SimpleRenderer::setTexture_X(light->getDepthFBO(), texID);
 	}
+
+	lightsBlock.pointCount = count;
 }
 
 static void RenderSpotLights()
 {
-	SimpleRenderer::bindShader(shader_lit);
-
-	int num_lights = lights_spot.size();
+	int count = 0;
 
-	SimpleRenderer::setShaderProp_Integer("NUM_SPOT_LIGHTS", num_lights);
-
-	for (int i = 0; i < num_lights; i++)
+	for (auto light : lights_spot)
 	{
-		auto light = lights_spot[i];
-
-		// check light active
-		glm::vec3 lightCol = light->getActive() ? light->getColorIntensified() : glm::vec3(0, 0, 0);
+		if (!light->getActive() || count == MAX_LIGHTS) continue;
 
-		// set light properties
-		SimpleRenderer::setShaderProp_Vec3("SpotLights[" + std::to_string(i) + "].col", lightCol);
-		SimpleRenderer::setShaderProp_Vec3("SpotLights[" + std::to_string(i) + "].dir", light->getDirection());
-		SimpleRenderer::setShaderProp_Vec3("SpotLights[" + std::to_string(i) + "].pos", light->getPosition());
-		SimpleRenderer::setShaderProp_Float("SpotLights[" + std::to_string(i) + "].range", light->getInverseSquaredRange());
-		SimpleRenderer::setShaderProp_Vec2("SpotLights[" + std::to_string(i) + "].angles", light->getCalculatedAngles());
+		SpotLightBlock& data = lightsBlock.spotLights[count++];
+		data.col = light->getColorIntensified();
+		data.range = light->getInverseSquaredRange();
+		data.dir = light->getDirection();
+		data.pos = light->getPosition();
+		data.angles = light->getCalculatedAngles();
 
 		// Calculate and set the light space matrix
 		//glm::mat4 lightSpaceMatrix = GetLightSpaceMatrixSpot(light);
-		//SimpleRenderer::setShaderProp_Mat4("SpotLights[" + std::to_string(i) + "].lightSpaceMatrix", lightSpaceMatrix);
 
 		// Set the shadow map texture
 		//int texID = light->getShadowMapTextureID();
 		//SimpleRenderer::setTexture_X(light->getDepthFBO(), texID);
 	}
+
+	lightsBlock.spotCount = count;
+}
+
+static void RenderLights()
+{
+	RenderDirectionalLights();
+	RenderPointLights();
+	RenderSpotLights();
+
+	// set shadow properties
+	lightsBlock.enableShadow = EnableShadow ? 1 : 0;
+	lightsBlock.shadowStrength = ShadowStrength;
+	lightsBlock.shadowBias = ShadowBias;
+
+	lightUniforms->update(lightsBlock);
+	lightUniforms->bind();
+
+	// set shadowMap
+	glActiveTexture(GL_TEXTURE5);
+	glBindTexture(GL_TEXTURE_2D, shadowMap);
+}
+
+static void UpdateFrameUniforms(CameraBase* camera)
+{
+	FrameBlock frame;
+	frame.projection = camera->getProjectionMatrix();
+	frame.view = camera->getViewMatrix();
+	frame.lightProjection = GetShadowLightSpaceMatrix();
+	frame.cameraPosition = camera->getPosition();
+	frame.time = App::getTime();
+
+	frameUniforms->update(frame);
+	frameUniforms->bind();
 }
 
 
@@ -375,6 +477,65 @@ static bool enableNormal = true;
 static bool enableEmissive = true;
 static bool enableAO = true;
 
+static bool EnableLod = true;
+static float LodPixelError = 1;
+
+static bool EnableMeshletCulling = true;
+static MeshletDrawList meshletDrawList;
+static MeshletCullStats meshletStats;
+
+static bool EnableTextureStreaming = true;
+static int TextureStreamingBudgetKB = 4096;
+static int TextureResidencyBudgetMB = 256;	// lower it to try the scene as a low memory target would run it
+
+static bool EnableVirtualTexture = false;
+static int VirtualPagesPerFrame = 8;
+
+// Only the uniforms the bound shader, lit or feedback, reads are set
+static void SetVirtualTextureProps(VirtualTexture* virtualTexture, bool lit)
+{
+	SimpleRenderer::setShaderProp_Bool("UseVirtualTexture", virtualTexture != nullptr);
+	if (!virtualTexture) return;
+
+	SimpleRenderer::setShaderProp_Vec2("VirtualSize", (float)virtualTexture->getWidth(), (float)virtualTexture->getHeight());
+	SimpleRenderer::setShaderProp_Float("VirtualPageSize", (float)virtualTexture->getPageSize());
+	SimpleRenderer::setShaderProp_Integer("VirtualLevels", (int)virtualTexture->getLevelCount());
+	if (!lit) return;
+
+	SimpleRenderer::setShaderProp_Float("VirtualBorder", (float)virtualTexture->getBorder());
+	SimpleRenderer::setShaderProp_Float("VirtualTileSize", (float)virtualTexture->getTileSize());
+	SimpleRenderer::setShaderProp_Vec2("VirtualCacheSize", (float)virtualTexture->getCacheWidth(), (float)virtualTexture->getCacheHeight());
+	SimpleRenderer::setVirtualTexture_X(9, 10, virtualTexture);
+}
+
+// Asks for the mips the entity's textures need at its size on screen, now or where the camera is heading,
+// whichever is bigger, so levels are in before the camera gets close
+static void RequestTextureLevels(RenderableEntity& entity, CameraBase* camera)
+{
+	float viewportHeight = (float)App::getViewportSize().y;
+	float screenSize = std::max(entity.getScreenSize(camera, camera->getPosition(), viewportHeight),
+		entity.getScreenSize(camera, TextureStreaming::getPrefetchPosition(), viewportHeight));
+
+	TextureStreaming::request(entity.diffuseTex, screenSize);
+	TextureStreaming::request(entity.materialTex, screenSize);
+	TextureStreaming::request(entity.normalTex, screenSize);
+}
+
+// DDS and KTX2 maps whose blocks could not be flipped for GL keep their rows top first, and the shaders
+// mirror v for them
+static float IsTopDown(Texture2D* tex)
+{
+	return tex && tex->isTopDown() ? 1.0f : 0.0f;
+}
+
+// Arrays on units 6 to 8, kept across entities; cleared every frame
+static const MaterialArrays* boundMaterialArrays = nullptr;
+static unsigned int materialArrayDraws = 0, materialArrayBinds = 0;	// this frame
+
+// Heap allocations made setting the lights' and objects' uniforms this frame, which should stay at 0;
+// counted only in builds with XBGT2094_COUNT_ALLOCATIONS
+static size_t uniformAllocations = 0;
+
 static void RenderObject(RenderableEntity& entity, CameraBase* camera)
 {
 	if (entity.doubleSided) glDisable(GL_CULL_FACE);
@@ -382,33 +543,60 @@ static void RenderObject(RenderableEntity& entity, CameraBase* camera)
 	// 1. Bind the shader for this entity
 	SimpleRenderer::bindShader(entity.shader);
 
-	// 2. Set shader properties
-	SimpleRenderer::setShaderProp_Mat4("projection", camera->getProjectionMatrix());
-	SimpleRenderer::setShaderProp_Mat4("view", camera->getViewMatrix());
-	SimpleRenderer::setShaderProp_Mat4("model", entity.getModelMatrix());
-	SimpleRenderer::setShaderProp_Float("time", App::getTime());
-	SimpleRenderer::setShaderProp_Float("Shininess", entity.shininess);
-	SimpleRenderer::setShaderProp_Float("AlphaClip", entity.alphaClip);
-	SimpleRenderer::setShaderProp_Float("BreathingSpeed", entity.breathingSpeed);
-	SimpleRenderer::setShaderProp_Vec3("Tint", entity.tint);
-	SimpleRenderer::setShaderProp_Float("Opacity", entity.opacity);
+	// 2. Set shader properties: its ObjectBlock, made at the start of the frame
+	// (camera, time and lights come from the Frame and Lights blocks)
+	objectUniforms->bindRange(entity.objectSlot * objectStride, sizeof(ObjectBlock));
 
 	// 3. Set material properties of this entity
 
-	Texture2D* diffuseTex = enableDiffuse ? entity.diffuseTex : TextureUtils::whiteTexture2D();
-	Texture2D* specularTex = enableSpecular ? entity.specularTex : TextureUtils::whiteTexture2D();
-	Texture2D* normalTex = enableNormal ? entity.normalTex : TextureUtils::whiteTexture2D();
-	Texture2D* emissiveTex = enableEmissive ? entity.emissiveTex : TextureUtils::blackTexture2D();
-	Texture2D* aoTex = enableAO ? entity.aoTex : TextureUtils::whiteTexture2D();
+	SimpleRenderer::setShaderProp_Bool("UseMaterialArrays", entity.materialArrays != nullptr);
+	if (entity.materialArrays)
+	{
+		// Entities on the same arrays only differ by layer
+		if (entity.materialArrays != boundMaterialArrays)
+		{
+			SimpleRenderer::setTextureArray_X(6, entity.materialArrays->diffuse);
+			SimpleRenderer::setTextureArray_X(7, entity.materialArrays->material);
+			SimpleRenderer::setTextureArray_X(8, entity.materialArrays->normal);
+			boundMaterialArrays = entity.materialArrays;
+			materialArrayBinds++;
+		}
+		materialArrayDraws++;
+		SimpleRenderer::setShaderProp_Integer("MaterialLayer", entity.materialLayer);
+		SimpleRenderer::setShaderProp_Vec2("ArrayMask", enableDiffuse ? 1.0f : 0.0f, enableNormal ? 1.0f : 0.0f);
+	}
+	else
+	{
+		SetVirtualTextureProps(EnableVirtualTexture && enableDiffuse ? entity.virtualDiffuse : nullptr, true);
+
+		Texture2D* diffuseTex = enableDiffuse ? entity.diffuseTex : TextureUtils::whiteTexture2D();
+		Texture2D* normalTex = enableNormal ? entity.normalTex : TextureUtils::whiteTexture2D();
+
+		SimpleRenderer::setTexture_0(diffuseTex);
+		SimpleRenderer::setTexture_1(entity.materialTex);
+		SimpleRenderer::setTexture_2(normalTex);
+		SimpleRenderer::setShaderProp_Vec3("TopDownMaps", glm::vec3(IsTopDown(diffuseTex), IsTopDown(entity.materialTex), IsTopDown(normalTex)));
+		RequestTextureLevels(entity, camera);
+	}
 
-	SimpleRenderer::setTexture_0(diffuseTex);
-	SimpleRenderer::setTexture_1(specularTex);
-	SimpleRenderer::setTexture_2(normalTex);
-	SimpleRenderer::setTexture_3(emissiveTex);
-	SimpleRenderer::setTexture_4(aoTex);
+	// Channels of the packed map that are switched off read as full specular, no occlusion and no emission
+	SimpleRenderer::setShaderProp_Vec3("MaterialMask", glm::vec3(enableSpecular ? 1.0f : 0.0f, enableAO ? 1.0f : 0.0f, enableEmissive ? 1.0f : 0.0f));
 
-	// 4. draw the mesh of this entity
-	SimpleRenderer::drawMesh(entity.mesh);
+	// 4. draw the mesh of this entity, as coarse as its size on screen allows
+	if (EnableLod) entity.selectLod(camera, (float)App::getViewportSize().y, LodPixelError);
+	else entity.lod = 0;
+
+	// At full detail only the meshlets in view and facing the camera are drawn
+	if (EnableMeshletCulling && entity.lod == 0 && entity.mesh && !entity.mesh->getMeshlets().empty())
+	{
+		MeshletUtils::cull(entity.mesh, GetObjectBlock(entity).model, camera->getProjectionMatrix() * camera->getViewMatrix(), camera->getPosition(),
+			!entity.doubleSided, meshletDrawList, meshletStats);
+		SimpleRenderer::drawMesh(entity.mesh, meshletDrawList);
+	}
+	else
+	{
+		SimpleRenderer::drawMesh(entity.mesh, entity.lod);
+	}
 
 	glEnable(GL_CULL_FACE);
 }
@@ -472,6 +660,151 @@ static std::vector<RenderableEntity*> pivots;
 
 
 
+//OBJECT UNIFORMS--------------------------------------------------------------------------------
+
+// A range for every entity that can be drawn, made once the hierarchy is loaded
+static void CreateObjectUniforms()
+{
+	size_t alignment = UniformBuffer::getOffsetAlignment();
+	objectStride = (sizeof(ObjectBlock) + alignment - 1) / alignment * alignment;
+
+	size_t capacity = std::max<size_t>(1, entities_lit.size() + entities_alphablend.size());
+	objectBlocks.assign(capacity * objectStride, 0);
+	objectUniforms = new UniformBuffer(UniformBlockBinding::OBJECT, objectBlocks.size());
+}
+
+static void SetObjectBlock(RenderableEntity& entity, unsigned int slot, const glm::mat4& viewProjection)
+{
+	entity.objectSlot = slot;
+
+	ObjectBlock& block = GetObjectBlock(entity);
+	block.model = entity.getModelMatrix();
+
+	// the transpose of the inverse of the upper 3x3 of model keeps normals perpendicular under non-uniform scale
+	glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(block.model)));
+	for (int i = 0; i < 3; i++) block.normalMatrix[i] = glm::vec4(normalMatrix[i], 0.0f);
+
+	block.modelViewProjection = viewProjection * block.model;
+	block.tint = entity.tint;
+	block.shininess = entity.shininess;
+	block.opacity = entity.opacity;
+	block.alphaClip = entity.alphaClip;
+	block.breathingSpeed = entity.breathingSpeed;
+}
+
+// Computes every active entity's ObjectBlock once and uploads them all together, when anything changed
+static void UpdateObjectUniforms(CameraBase* camera)
+{
+	glm::mat4 viewProjection = camera->getProjectionMatrix() * camera->getViewMatrix();
+	unsigned int slot = 0;
+
+	for (auto it : entities_lit)
+	{
+		if (it->active) SetObjectBlock(*it, slot++, viewProjection);
+	}
+	for (auto it : entities_alphablend)
+	{
+		if (it->active) SetObjectBlock(*it, slot++, viewProjection);
+	}
+
+	objectUniforms->update(objectBlocks.data(), objectBlocks.size());
+}
+
+
+
+//SHADER VARIANTS--------------------------------------------------------------------------------
+
+// Picks the lit and screen variants built for this frame's toggles and light counts, compiling any not used
+// before, and moves the entities drawn with the lit shader onto the new one
+static void SelectShaderVariants()
+{
+	Shader* lit = litVariants->get(litVariants->makeKey({ EnableShadow, (unsigned int)lightsBlock.directionalCount,
+		(unsigned int)lightsBlock.pointCount, (unsigned int)lightsBlock.spotCount }));
+
+	if (lit != shader_lit)
+	{
+		for (auto entities : { &entities_lit, &entities_alphablend })
+		{
+			for (auto it : *entities)
+			{
+				if (it->shader == shader_lit) it->shader = lit;
+			}
+		}
+		shader_lit = lit;
+	}
+
+	shader_screen = screenVariants->get(screenVariants->makeKey({ EnablePostProcess && EnableSpherize,
+		EnablePostProcess && EnableGrayscale, EnablePostProcess && EnableScanlines, EnablePostProcess && EnableVignette }));
+}
+
+
+
+//VIRTUAL TEXTURE--------------------------------------------------------------------------------
+// Feedback carries no texture id, so one virtual texture is fed at a time: the base's diffuse map, standing in
+// for the large unique textures (terrain, scans) this is meant for
+
+static VirtualTexture* baseVirtualTexture = nullptr;
+
+static const int FEEDBACK_DIVISOR = 8;	// of the screen's width and height
+static ColourDepthFBO* feedbackFbo;
+
+static glm::uvec2 GetFeedbackSize(int width, int height)
+{
+	return glm::uvec2(std::max(1, width / FEEDBACK_DIVISOR), std::max(1, height / FEEDBACK_DIVISOR));
+}
+
+static void LoadVirtualTextures()
+{
+	baseVirtualTexture = VirtualTexture::load("../assets/textures/base/base.jpg", TextureCompression::COLOUR, MipChainUtils::getSettings(cfgRepeat));
+	entities_lit[0]->virtualDiffuse = baseVirtualTexture; // base
+
+	ColourDepthFrameBufferConfig fbocfg;
+
+	glm::uvec2 viewportSize = App::getViewportSize();
+	fbocfg.size = GetFeedbackSize(viewportSize.x, viewportSize.y);
+	fbocfg.depthFormat = DepthFormat::FLOAT24;
+	fbocfg.colourAttachments.push_back(ColourAttachmentData(ColourFormat::RGBA, TextureFilterMode::NEAREST));
+
+	feedbackFbo = FBOUtils::createColourDepthFBO(fbocfg);
+}
+
+// Draws the lit entities small with the page and level each pixel wants, and queues the result to be read
+// back. Everything draws so that nearer entities hide the pages behind them.
+static void RenderVirtualTextureFeedback()
+{
+	if (!EnableVirtualTexture || !baseVirtualTexture) return;
+
+	SimpleRenderer::bindFBO(feedbackFbo);
+
+	// Alpha 0 means no request, so the clear must not use the scene's background colour
+	GLfloat clearColour[4];
+	glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColour);
+	glClearColor(0, 0, 0, 0);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	glClearColor(clearColour[0], clearColour[1], clearColour[2], clearColour[3]);
+
+	SimpleRenderer::bindShader(shader_vt_feedback);
+	SimpleRenderer::setShaderProp_Float("FeedbackBias", std::log2((float)FEEDBACK_DIVISOR));
+
+	for (auto it : entities_lit)
+	{
+		auto& entity = *it;
+
+		if (!entity.active) continue;
+		if (entity.doubleSided) glDisable(GL_CULL_FACE);
+
+		objectUniforms->bindRange(entity.objectSlot * objectStride, sizeof(ObjectBlock));
+		SetVirtualTextureProps(entity.virtualDiffuse, false);
+		SimpleRenderer::drawMesh(entity.mesh, entity.lod);
+
+		glEnable(GL_CULL_FACE);
+	}
+
+	baseVirtualTexture->readFeedback(feedbackFbo->getSize().x, feedbackFbo->getSize().y);
+}
+
+
+
 //PARENT LIGHTS--------------------------------------------------------------------------------
 
 static void ParentLight(RenderableEntity* parent, PointLight* light)
@@ -520,16 +853,14 @@ static void SpawnBase()
 	RenderableEntity* entity = new RenderableEntity();
 
 	entity->name = "Base";
-	entity->mesh = MeshUtils::loadObjFile("../assets/models/base/base.obj");
+	meshBatch.add(&entity->mesh, "../assets/models/base/base.obj");
 	entity->shader = shader_lit;
 
 	TextureConfig cfg = cfgRepeat;
 
-	entity->diffuseTex = TextureUtils::loadTexture2D("../assets/textures/base/base.jpg", cfg);
-	entity->specularTex = TextureUtils::loadTexture2D("../assets/textures/base/base_s.jpg", cfg);
-	entity->normalTex = TextureUtils::loadTexture2D("../assets/textures/base/base_n.jpg", cfg);
-	//entity->emissiveTex = 
-	entity->aoTex = TextureUtils::loadTexture2D("../assets/textures/base/base_ao.jpg", cfg);
+	textureBatch.add(&entity->diffuseTex, "../assets/textures/base/base.jpg", WithCompression(cfg, TextureCompression::COLOUR));
+	textureBatch.add(&entity->normalTex, "../assets/textures/base/base_n.jpg", WithCompression(cfg, TextureCompression::NORMAL));
+	AddMaterialMap(entity, "../assets/textures/base/base_s.jpg", "../assets/textures/base/base_ao.jpg", TextureChannel::constant(0), cfg);
 
 	//entity->shininess = 0;
 	//entity->alphaClip = 0.1;
@@ -551,16 +882,14 @@ static void SpawnVine1()
 	RenderableEntity* entity = new RenderableEntity();
 
 	entity->name = "Vine1";
-	entity->mesh = MeshUtils::loadObjFile("../assets/models/base/vine1.obj");
+	meshBatch.add(&entity->mesh, "../assets/models/base/vine1.obj");
 	entity->shader = shader_lit;
 
 	TextureConfig cfg = cfgClamp;
 
-	entity->diffuseTex = TextureUtils::loadTexture2D("../assets/textures/base/vine1.png", cfg);
-	entity->specularTex = TextureUtils::loadTexture2D("../assets/textures/base/vine1_s.jpg", cfg);
-	entity->normalTex = TextureUtils::loadTexture2D("../assets/textures/base/vine1_n.jpg", cfg);
-	//entity->emissiveTex = 
-	entity->aoTex = TextureUtils::loadTexture2D("../assets/textures/base/vine1_ao.jpg", cfg);
+	textureBatch.add(&entity->diffuseTex, "../assets/textures/base/vine1.png", WithAlphaCoverage(WithCompression(cfg, TextureCompression::COLOUR), 0.9f));
+	textureBatch.add(&entity->normalTex, "../assets/textures/base/vine1_n.jpg", WithCompression(cfg, TextureCompression::NORMAL));
+	AddMaterialMap(entity, "../assets/textures/base/vine1_s.jpg", "../assets/textures/base/vine1_ao.jpg", TextureChannel::constant(0), cfg);
 
 	//entity->shininess = 0;
 	entity->alphaClip = 0.9;
@@ -580,16 +909,14 @@ static void SpawnVine2()
 	RenderableEntity* entity = new RenderableEntity();
 
 	entity->name = "Vine2";
-	entity->mesh = MeshUtils::loadObjFile("../assets/models/base/vine2.obj");
+	meshBatch.add(&entity->mesh, "../assets/models/base/vine2.obj");
 	entity->shader = shader_lit;
 
 	TextureConfig cfg = cfgClamp;
 
-	entity->diffuseTex = TextureUtils::loadTexture2D("../assets/textures/base/vine2.png", cfg);
-	entity->specularTex = TextureUtils::loadTexture2D("../assets/textures/base/vine2_s.jpg", cfg);
-	entity->normalTex = TextureUtils::loadTexture2D("../assets/textures/base/vine2_n.jpg", cfg);
-	//entity->emissiveTex = 
-	entity->aoTex = TextureUtils::loadTexture2D("../assets/textures/base/vine2_ao.jpg", cfg);
+	textureBatch.add(&entity->diffuseTex, "../assets/textures/base/vine2.png", WithAlphaCoverage(WithCompression(cfg, TextureCompression::COLOUR), 0.8f));
+	textureBatch.add(&entity->normalTex, "../assets/textures/base/vine2_n.jpg", WithCompression(cfg, TextureCompression::NORMAL));
+	AddMaterialMap(entity, "../assets/textures/base/vine2_s.jpg", "../assets/textures/base/vine2_ao.jpg", TextureChannel::constant(0), cfg);
 
 	//entity->shininess = 0;
 	entity->alphaClip = 0.8;
@@ -609,16 +936,14 @@ static void SpawnTiny()
 	RenderableEntity* entity = new RenderableEntity();
 
 	entity->name = "Tiny";
-	entity->mesh = MeshUtils::loadObjFile("../assets/models/tiny/tiny.obj");
+	meshBatch.add(&entity->mesh, "../assets/models/tiny/tiny.obj");
 	entity->shader = shader_lit;
 
 	TextureConfig cfg = cfgRepeat;
 
-	entity->diffuseTex = TextureUtils::loadTexture2D("../assets/textures/tiny/tiny.jpg", cfg);
-	entity->specularTex = TextureUtils::loadTexture2D("../assets/textures/tiny/tiny_s.jpg", cfg);
-	entity->normalTex = TextureUtils::loadTexture2D("../assets/textures/tiny/tiny_n.jpg", cfg);
-	entity->emissiveTex = TextureUtils::loadTexture2D("../assets/textures/tiny/tiny_e.jpg", cfg);
-	entity->aoTex = TextureUtils::loadTexture2D("../assets/textures/tiny/tiny_ao.jpg", cfg);
+	textureBatch.add(&entity->diffuseTex, "../assets/textures/tiny/tiny.jpg", WithCompression(cfg, TextureCompression::COLOUR));
+	textureBatch.add(&entity->normalTex, "../assets/textures/tiny/tiny_n.jpg", WithCompression(cfg, TextureCompression::NORMAL));
+	AddMaterialMap(entity, "../assets/textures/tiny/tiny_s.jpg", "../assets/textures/tiny/tiny_ao.jpg", "../assets/textures/tiny/tiny_e.jpg", cfg);
 
 	//entity->shininess = 0;
 	//entity->alphaClip = 0.1;
@@ -642,16 +967,10 @@ static void SpawnBear()
 	RenderableEntity* entity = new RenderableEntity();
 
 	entity->name = "Bear";
-	entity->mesh = MeshUtils::loadObjFile("../assets/models/figurines/bear.obj");
+	meshBatch.add(&entity->mesh, "../assets/models/figurines/bear.obj");
 	entity->shader = shader_lit;
 
-	TextureConfig cfg = cfgRepeat;
-
-	entity->diffuseTex = TextureUtils::loadTexture2D("../assets/textures/figurines/bear/bear.jpg", cfg);
-	entity->specularTex = TextureUtils::loadTexture2D("../assets/textures/figurines/bear/bear_s.jpg", cfg);
-	entity->normalTex = TextureUtils::loadTexture2D("../assets/textures/figurines/bear/bear_n.jpg", cfg);
-	entity->emissiveTex = TextureUtils::loadTexture2D("../assets/textures/figurines/bear/bear_e.jpg", cfg);
-	entity->aoTex = TextureUtils::loadTexture2D("../assets/textures/figurines/bear/bear_ao.jpg", cfg);
+	AddFigurineMaterial(entity, "../assets/textures/figurines/bear/bear.jpg", "../assets/textures/figurines/bear/bear_n.jpg", "../assets/textures/figurines/bear/bear_s.jpg", "../assets/textures/figurines/bear/bear_ao.jpg", "../assets/textures/figurines/bear/bear_e.jpg");
 
 	//entity->shininess = 0;
 	//entity->alphaClip = 0.1;
@@ -675,16 +994,10 @@ static void SpawnCat()
 	RenderableEntity* entity = new RenderableEntity();
 
 	entity->name = "Cat";
-	entity->mesh = MeshUtils::loadObjFile("../assets/models/figurines/cat.obj");
+	meshBatch.add(&entity->mesh, "../assets/models/figurines/cat.obj");
 	entity->shader = shader_lit;
 
-	TextureConfig cfg = cfgRepeat;
-
-	entity->diffuseTex = TextureUtils::loadTexture2D("../assets/textures/figurines/cat/cat.jpg", cfg);
-	entity->specularTex = TextureUtils::loadTexture2D("../assets/textures/figurines/cat/cat_s.jpg", cfg);
-	entity->normalTex = TextureUtils::loadTexture2D("../assets/textures/figurines/cat/cat_n.jpg", cfg);
-	entity->emissiveTex = TextureUtils::loadTexture2D("../assets/textures/figurines/cat/cat_e.jpg", cfg);
-	entity->aoTex = TextureUtils::loadTexture2D("../assets/textures/figurines/cat/cat_ao.jpg", cfg);
+	AddFigurineMaterial(entity, "../assets/textures/figurines/cat/cat.jpg", "../assets/textures/figurines/cat/cat_n.jpg", "../assets/textures/figurines/cat/cat_s.jpg", "../assets/textures/figurines/cat/cat_ao.jpg", "../assets/textures/figurines/cat/cat_e.jpg");
 
 	//entity->shininess = 0;
 	//entity->alphaClip = 0.1;
@@ -708,16 +1021,10 @@ static void SpawnOwl()
 	RenderableEntity* entity = new RenderableEntity();
 
 	entity->name = "Owl";
-	entity->mesh = MeshUtils::loadObjFile("../assets/models/figurines/owl.obj");
+	meshBatch.add(&entity->mesh, "../assets/models/figurines/owl.obj");
 	entity->shader = shader_lit;
 
-	TextureConfig cfg = cfgRepeat;
-
-	entity->diffuseTex = TextureUtils::loadTexture2D("../assets/textures/figurines/owl/owl.jpg", cfg);
-	entity->specularTex = TextureUtils::loadTexture2D("../assets/textures/figurines/owl/owl_s.jpg", cfg);
-	entity->normalTex = TextureUtils::loadTexture2D("../assets/textures/figurines/owl/owl_n.jpg", cfg);
-	entity->emissiveTex = TextureUtils::loadTexture2D("../assets/textures/figurines/owl/owl_e.jpg", cfg);
-	entity->aoTex = TextureUtils::loadTexture2D("../assets/textures/figurines/owl/owl_ao.jpg", cfg);
+	AddFigurineMaterial(entity, "../assets/textures/figurines/owl/owl.jpg", "../assets/textures/figurines/owl/owl_n.jpg", "../assets/textures/figurines/owl/owl_s.jpg", "../assets/textures/figurines/owl/owl_ao.jpg", "../assets/textures/figurines/owl/owl_e.jpg");
 
 	//entity->shininess = 0;
 	//entity->alphaClip = 0.1;
@@ -741,16 +1048,10 @@ static void SpawnTurtle()
 	RenderableEntity* entity = new RenderableEntity();
 
 	entity->name = "Turtle";
-	entity->mesh = MeshUtils::loadObjFile("../assets/models/figurines/turtle.obj");
+	meshBatch.add(&entity->mesh, "../assets/models/figurines/turtle.obj");
 	entity->shader = shader_lit;
 
-	TextureConfig cfg = cfgRepeat;
-
-	entity->diffuseTex = TextureUtils::loadTexture2D("../assets/textures/figurines/turtle/turtle.jpg", cfg);
-	entity->specularTex = TextureUtils::loadTexture2D("../assets/textures/figurines/turtle/turtle_s.jpg", cfg);
-	entity->normalTex = TextureUtils::loadTexture2D("../assets/textures/figurines/turtle/turtle_n.jpg", cfg);
-	entity->emissiveTex = TextureUtils::loadTexture2D("../assets/textures/figurines/turtle/turtle_e.jpg", cfg);
-	entity->aoTex = TextureUtils::loadTexture2D("../assets/textures/figurines/turtle/turtle_ao.jpg", cfg);
+	AddFigurineMaterial(entity, "../assets/textures/figurines/turtle/turtle.jpg", "../assets/textures/figurines/turtle/turtle_n.jpg", "../assets/textures/figurines/turtle/turtle_s.jpg", "../assets/textures/figurines/turtle/turtle_ao.jpg", "../assets/textures/figurines/turtle/turtle_e.jpg");
 
 	//entity->shininess = 0;
 	//entity->alphaClip = 0.1;
@@ -789,16 +1090,14 @@ static void SpawnGem(std::string name, std::string obj, glm::vec3 pos)
 	RenderableEntity* entity = new RenderableEntity();
 
 	entity->name = name;
-	entity->mesh = MeshUtils::loadObjFile("../assets/models/gems/" + obj);
+	meshBatch.add(&entity->mesh, "../assets/models/gems/" + obj);
 	entity->shader = shader_lit;
 
 	TextureConfig cfg = cfgRepeat;
 
-	entity->diffuseTex = TextureUtils::loadTexture2D("../assets/textures/gems/white.png", cfg);
-	entity->specularTex = TextureUtils::loadTexture2D("../assets/textures/gems/gem_s.jpg", cfg);
-	entity->normalTex = TextureUtils::loadTexture2D("../assets/textures/gems/gem_n.jpg", cfg);
-	entity->emissiveTex = TextureUtils::whiteTexture2D();
-	entity->aoTex = TextureUtils::loadTexture2D("../assets/textures/gems/gem_ao.jpg", cfg);
+	textureBatch.add(&entity->diffuseTex, "../assets/textures/gems/white.png", WithCompression(cfg, TextureCompression::COLOUR));
+	textureBatch.add(&entity->normalTex, "../assets/textures/gems/gem_n.jpg", WithCompression(cfg, TextureCompression::NORMAL));
+	AddMaterialMap(entity, "../assets/textures/gems/gem_s.jpg", "../assets/textures/gems/gem_ao.jpg", TextureChannel::constant(255), cfg);
 
 	//entity->shininess = 0;
 	//entity->alphaClip = 0.1;
@@ -836,16 +1135,14 @@ static void SpawnTorch(std::string name, glm::vec3 pos, glm::vec3 rot)
 	RenderableEntity* entity = new RenderableEntity();
 
 	entity->name = name;
-	entity->mesh = MeshUtils::loadObjFile("../assets/models/torch/torch.obj");
+	meshBatch.add(&entity->mesh, "../assets/models/torch/torch.obj");
 	entity->shader = shader_lit;
 
 	TextureConfig cfg = cfgRepeat;
 
-	entity->diffuseTex = TextureUtils::loadTexture2D("../assets/textures/torch/torch.jpg", cfg);
-	entity->specularTex = TextureUtils::loadTexture2D("../assets/textures/torch/torch_s.jpg", cfg);
-	entity->normalTex = TextureUtils::loadTexture2D("../assets/textures/torch/torch_n.jpg", cfg);
-	//entity->emissiveTex =
-	entity->aoTex = TextureUtils::loadTexture2D("../assets/textures/torch/torch_ao.jpg", cfg);
+	textureBatch.add(&entity->diffuseTex, "../assets/textures/torch/torch.jpg", WithCompression(cfg, TextureCompression::COLOUR));
+	textureBatch.add(&entity->normalTex, "../assets/textures/torch/torch_n.jpg", WithCompression(cfg, TextureCompression::NORMAL));
+	AddMaterialMap(entity, "../assets/textures/torch/torch_s.jpg", "../assets/textures/torch/torch_ao.jpg", TextureChannel::constant(0), cfg);
 
 	//entity->shininess = 0;
 	//entity->alphaClip = 0.1;
@@ -867,12 +1164,12 @@ static void SpawnFire(std::string name, RenderableEntity* parent)
 	RenderableEntity* entity = new RenderableEntity();
 
 	entity->name = name;
-	entity->mesh = MeshUtils::loadObjFile("../assets/models/torch/fire.obj");
+	meshBatch.add(&entity->mesh, "../assets/models/torch/fire.obj");
 	entity->shader = shader_fire;
 
 	TextureConfig cfg = cfgClamp;
 
-	entity->diffuseTex = TextureUtils::loadTexture2D("../assets/textures/torch/fire.png", cfg);
+	textureBatch.add(&entity->diffuseTex, "../assets/textures/torch/fire.png", WithCompression(cfg, TextureCompression::COLOUR));
 
 	//entity->alphaClip = 0.1;
 	entity->doubleSided = true;
@@ -952,9 +1249,8 @@ static void load_instructions()
 	// et1->mesh = ...;
 	// et1->shader = ...;
 	// et1->diffuseTex = TextureUtils::loadTexture2D("...", ...);
-	// et1->specularTex = TextureUtils::loadTexture2D("...", ...);
 	// et1->normalTex = TextureUtils::loadTexture2D("...", ...);
-	// et1->emissiveTex = TextureUtils::loadTexture2D("...", ...);
+	// et1->materialTex = TextureUtils::loadPackedTexture2D("..._s", "..._ao", "..._e", ...);
 	// et1->shininess = ...;
 	// 
 	// entities_opaque.push_back(et1);
@@ -1039,13 +1335,44 @@ static void LoadHierarchy()
 	// lights_spot[0]
 }
 
+static void PackFigurineMaterials()
+{
+	if (figurinePacker.size() == 0) return;
+
+	TextureConfig cfg = cfgRepeat;
+	if (figurinePacker.pack(figurineArrays, WithCompression(cfg, TextureCompression::COLOUR), WithCompression(cfg, TextureCompression::COLOUR),
+		WithCompression(cfg, TextureCompression::NORMAL))) return;
+
+	// The entities keep their default maps rather than sample missing arrays
+	for (RenderableEntity* entity : entities_lit)
+	{
+		if (entity->materialArrays == &figurineArrays) entity->materialArrays = nullptr;
+	}
+}
+
 void Scene_ASGN::load()
 {
 	LoadHierarchy();
+	meshBatch.load();
+
+	// Mipmapped textures come up at their small levels and stream in the rest from update()
+	TextureStreaming::setEnabled(EnableTextureStreaming);
+	TextureStreaming::setFrameBudget((size_t)TextureStreamingBudgetKB * 1024);
+	TextureStreaming::setResidencyBudget((size_t)TextureResidencyBudgetMB * 1024 * 1024);
+	textureBatch.load();
+	PackFigurineMaterials();
+	LoadVirtualTextures();
 
 	CreateShadowMap();
+	CreateUniformBuffers();
+	CreateObjectUniforms();
 
 	LoadFBO();
+
+	MeshCache::printStats();
+	TextureUtils::printTextureCacheStats();
+	TextureStreaming::printStats();
+	LoadArena::printStats();
 }
 
 
@@ -1187,6 +1514,12 @@ void Scene_ASGN::update()
 	WaveGemsAnim(t);
 	RainbowGemsAnim(t, 0.5);
 	SpinFireAnim(t);
+
+	// Uploads what the last frame's draws asked for
+	TextureStreaming::update();
+
+	// Loads the pages the feedback of two frames ago asked for
+	if (EnableVirtualTexture && baseVirtualTexture) baseVirtualTexture->update(VirtualPagesPerFrame);
 }
 
 
@@ -1196,17 +1529,32 @@ static bool debugLights = false;
 
 void Scene_ASGN::draw(CameraBase* camera)
 {
+	TextureStreaming::beginFrame(camera->getPosition(), App::getDeltaTime());
+
+	SimpleRenderer::resetUniformStats();
+	UniformBuffer::resetStats();
+
+	// camera, lights and every entity's transform and material, for every shader at once
+	size_t allocationsBefore = AllocationCounter::getThreadCount();
+	UpdateFrameUniforms(camera);
+	RenderLights();
+	UpdateObjectUniforms(camera);
+	uniformAllocations = AllocationCounter::getThreadCount() - allocationsBefore;
+
+	SelectShaderVariants();
+
+	RenderVirtualTextureFeedback();
+
 	BindFBO();
 
 	glEnable(GL_DEPTH_TEST);
 
-	// lights
-	RenderDirectionalLights();
-	RenderPointLights();
-	RenderSpotLights();
 	UpdateLightsParenting();
 
 	// objects
+	meshletStats = {};
+	boundMaterialArrays = nullptr;
+	materialArrayDraws = materialArrayBinds = 0;
 	RenderLitObjects(camera);
 	RenderSkybox(camera);
 	RenderAlphaBlends(camera);	
@@ -1223,6 +1571,9 @@ void Scene_ASGN::postDraw(CameraBase* camera)
 void Scene_ASGN::onFrameBufferResized(int width, int height)
 {
 	fbo->resize(width, height);
+
+	glm::uvec2 feedbackSize = GetFeedbackSize(width, height);
+	feedbackFbo->resize(feedbackSize.x, feedbackSize.y);
 }
 
 
@@ -1277,6 +1628,11 @@ static void ImGui_Entity(RenderableEntity* ent, bool opaque)
 			ImGui::Text("Double Sided");
 			ImGui::Checkbox("##doubleSided", &entt->doubleSided);
 
+			if (entt->mesh)
+			{
+				ImGui::Text("LOD %u of %u (%u triangles)", entt->lod, entt->mesh->getLodCount(), entt->mesh->getLod(entt->lod).indexCount / 3);
+			}
+
 			if (!opaque)
 			{
 				ImGui::Text("Opacity");
@@ -1341,6 +1697,118 @@ static void ImGui_Textures()
 }
 
 
+static void ImGui_Lod()
+{
+	ImGui::Text("Enable LOD");
+	ImGui::Checkbox("##EnableLod", &EnableLod);
+
+	if (!EnableLod) return;
+
+	ImGui::Text("Max Pixel Error");
+	ImGui::DragFloat("##LodPixelError", &LodPixelError, 0.1, 0, 100);
+}
+
+static void ImGui_MeshletCulling()
+{
+	ImGui::Text("Meshlet Culling");
+	ImGui::Checkbox("##EnableMeshletCulling", &EnableMeshletCulling);
+
+	if (!EnableMeshletCulling) return;
+
+	ImGui::Text("Triangles: %u of %u", meshletStats.trianglesDrawn, meshletStats.triangles);
+	ImGui::Text("Meshlets culled: %u frustum, %u cone of %u", meshletStats.frustumCulled, meshletStats.coneCulled, meshletStats.meshlets);
+}
+
+
+static void ImGui_MeshCache()
+{
+	const MeshCacheStats& stats = MeshCache::getStats();
+
+	ImGui::Text("Mesh Cache");
+	ImGui::Text("Meshes: %zu (%zu KB)", MeshCache::getMeshCount(), stats.gpuBytes / 1024);
+	ImGui::Text("Hits: %u, misses: %u", stats.hits, stats.misses);
+	ImGui::Text("Saved: %zu KB", stats.gpuBytesSaved / 1024);
+}
+
+static void ImGui_TextureCache()
+{
+	const TextureCacheStats& stats = TextureUtils::getTextureCacheStats();
+
+	ImGui::Text("Texture Cache");
+	ImGui::Text("Textures: %zu (%zu KB, %zu KB as RGBA8)", TextureUtils::getCachedTextureCount(), stats.gpuBytes / 1024, stats.gpuBytesUncompressed / 1024);
+	ImGui::Text("Hits: %u path, %u content; misses: %u", stats.hits, stats.contentHits, stats.misses);
+	ImGui::Text("Decoding: %.1f ms, saved: %zu KB", stats.decodeMs, stats.gpuBytesSaved / 1024);
+	ImGui::Text("Cooked: %u, mips %.1f ms, compressing %.1f ms", stats.cooked, stats.mipMs, stats.compressMs);
+	ImGui::Text("Material array draws: %u, texture binds saved: %u", materialArrayDraws, (materialArrayDraws - materialArrayBinds) * 3);
+}
+
+static void ImGui_TextureStreaming()
+{
+	// Switched off, whatever is left goes up at once
+	ImGui::Text("Texture Streaming");
+	if (ImGui::Checkbox("##EnableTextureStreaming", &EnableTextureStreaming))
+	{
+		TextureStreaming::setEnabled(EnableTextureStreaming);
+	}
+
+	if (!EnableTextureStreaming) return;
+
+	ImGui::Text("Budget (KB per frame)");
+	if (ImGui::DragInt("##TextureStreamingBudgetKB", &TextureStreamingBudgetKB, 64, 64, 65536))
+	{
+		TextureStreaming::setFrameBudget((size_t)TextureStreamingBudgetKB * 1024);
+	}
+
+	const TextureStreamingStats& stats = TextureStreaming::getStats();
+	ImGui::Text("Streaming: %u textures, %zu KB wanted", stats.streaming, stats.bytesPending / 1024);
+	ImGui::Text("Uploaded: %u levels (%zu KB), %zu KB last frame", stats.uploads, stats.bytesUploaded / 1024, stats.bytesThisFrame / 1024);
+}
+
+static void ImGui_TextureResidency()
+{
+	ImGui::Text("Texture Residency Budget (MB)");
+	if (ImGui::DragInt("##TextureResidencyBudgetMB", &TextureResidencyBudgetMB, 1, 1, 4096))
+	{
+		TextureStreaming::setResidencyBudget((size_t)TextureResidencyBudgetMB * 1024 * 1024);
+	}
+
+	const TextureStreamingStats& stats = TextureStreaming::getStats();
+	ImGui::Text("Resident: %zu KB", stats.residentBytes / 1024);
+	ImGui::Text("Evicted: %u levels (%zu KB), reloaded: %u", stats.evictions, stats.bytesEvicted / 1024, stats.reloads);
+}
+
+
+static void ImGui_VirtualTexture()
+{
+	ImGui::Text("Virtual Texture (base)");
+	ImGui::Checkbox("##EnableVirtualTexture", &EnableVirtualTexture);
+
+	if (!EnableVirtualTexture || !baseVirtualTexture) return;
+
+	ImGui::Text("Pages per frame");
+	ImGui::DragInt("##VirtualPagesPerFrame", &VirtualPagesPerFrame, 1, 1, 64);
+
+	const VirtualTextureStats& stats = baseVirtualTexture->getStats();
+	ImGui::Text("Pages: %u resident, %u requested, %u missing", stats.resident, stats.requested, stats.missing);
+	ImGui::Text("Loaded: %u, evicted: %u", stats.loads, stats.evictions);
+}
+
+
+static void ImGui_Uniforms()
+{
+	const UniformStats& stats = SimpleRenderer::getUniformStats();
+
+	ImGui::Text("Uniforms");
+	ImGui::Text("Set last frame: %u, %u not in their shader", stats.sets, stats.inactive);
+	if (AllocationCounter::isEnabled()) ImGui::Text("Heap allocations setting them: %zu", uniformAllocations);
+
+	const UniformBufferStats& bufferStats = UniformBuffer::getStats();
+	ImGui::Text("Uniform buffers updated: %u (%zu bytes), %u unchanged", bufferStats.updates, bufferStats.bytes, bufferStats.skipped);
+	ImGui::Text("Object ranges bound: %u", bufferStats.rangeBinds);
+	ImGui::Text("Shader variants built: %zu lit, %zu screen", litVariants->getVariantCount(), screenVariants->getVariantCount());
+}
+
+
 static bool editLights = false;
 
 static void ImGui_Lights()
@@ -1508,6 +1976,38 @@ void Scene_ASGN::imgui_draw()
 
 	ImGui::Separator();
 
+	ImGui_Lod();
+
+	ImGui::Separator();
+
+	ImGui_MeshletCulling();
+
+	ImGui::Separator();
+
+	ImGui_MeshCache();
+
+	ImGui::Separator();
+
+	ImGui_TextureCache();
+
+	ImGui::Separator();
+
+	ImGui_TextureStreaming();
+
+	ImGui::Separator();
+
+	ImGui_TextureResidency();
+
+	ImGui::Separator();
+
+	ImGui_VirtualTexture();
+
+	ImGui::Separator();
+
+	ImGui_Uniforms();
+
+	ImGui::Separator();
+
 	ImGui_Lights();
 
 	ImGui::Separator();
@@ -1,6 +1,8 @@
 #include "shader.h"
 #include <glad/glad.h>
+#include <stdio.h>
 #include "shader_utils.h"
+#include "uniform_buffer.h"
 
 static std::string error;
 
@@ -16,4 +18,95 @@ Shader::~Shader()
 unsigned int Shader::getNativeHandle()
 {
 	return handle;
+}
+
+void Shader::buildUniformTable()
+{
+	uniformTable.clear();
+
+	int uniformCount = 0, maxNameLength = 0;
+	glGetProgramiv(handle, GL_ACTIVE_UNIFORMS, &uniformCount);
+	glGetProgramiv(handle, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+	if (uniformCount <= 0) return;
+
+	// Every element of a plain array gets its own entry, and the array's name alone means element 0 as in GL
+	std::vector<std::pair<std::string, int>> uniforms;
+	std::vector<char> nameBuffer(maxNameLength + 1);
+	for (int i = 0; i < uniformCount; i++)
+	{
+		GLsizei length = 0;
+		GLint size = 0;
+		GLenum type;
+		glGetActiveUniform(handle, (GLuint)i, (GLsizei)nameBuffer.size(), &length, &size, &type, nameBuffer.data());
+
+		std::string name(nameBuffer.data(), length);
+		int location = glGetUniformLocation(handle, name.c_str());
+		if (location < 0) continue;	// in a uniform block
+
+		size_t suffix = name.size() >= 3 ? name.rfind("[0]") : std::string::npos;
+		if (suffix == std::string::npos || suffix != name.size() - 3)
+		{
+			uniforms.emplace_back(name, location);
+			continue;
+		}
+
+		std::string base = name.substr(0, suffix);
+		uniforms.emplace_back(base, location);
+		for (int element = 0; element < size; element++)
+		{
+			std::string elementName = base + "[" + std::to_string(element) + "]";
+			uniforms.emplace_back(elementName, glGetUniformLocation(handle, elementName.c_str()));
+		}
+	}
+
+	size_t capacity = 1;
+	while (capacity < uniforms.size() * 2) capacity *= 2;
+	uniformTable.assign(capacity, UniformSlot{ 0, -1 });
+
+	std::vector<const std::string*> slotNames(capacity, nullptr);
+	for (const auto& uniform : uniforms)
+	{
+		if (uniform.second < 0) continue;
+
+		uint32_t hash = UniformId(uniform.first).getHash();
+		size_t mask = capacity - 1;
+		size_t i = hash & mask;
+		while (uniformTable[i].location >= 0 && uniformTable[i].hash != hash) i = (i + 1) & mask;
+
+		if (uniformTable[i].location >= 0)
+		{
+			if (*slotNames[i] != uniform.first)
+			{
+				printf("Shader '%s': uniforms %s and %s have the same hash; only the first can be set\n",
+					shaderName.c_str(), slotNames[i]->c_str(), uniform.first.c_str());
+			}
+			continue;
+		}
+
+		uniformTable[i] = { hash, uniform.second };
+		slotNames[i] = &uniform.first;
+	}
+}
+
+void Shader::bindUniformBlocks()
+{
+	int blockCount = 0, maxNameLength = 0;
+	glGetProgramiv(handle, GL_ACTIVE_UNIFORM_BLOCKS, &blockCount);
+	glGetProgramiv(handle, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxNameLength);
+
+	std::vector<char> nameBuffer(maxNameLength + 1);
+	for (int i = 0; i < blockCount; i++)
+	{
+		GLsizei length = 0;
+		glGetActiveUniformBlockName(handle, (GLuint)i, (GLsizei)nameBuffer.size(), &length, nameBuffer.data());
+		nameBuffer[length] = 0;
+
+		int binding = UniformBuffer::getBinding(nameBuffer.data());
+		if (binding < 0)
+		{
+			printf("Shader '%s': uniform block %s has no binding point\n", shaderName.c_str(), nameBuffer.data());
+			continue;
+		}
+		glUniformBlockBinding(handle, (GLuint)i, (GLuint)binding);
+	}
 }
\ No newline at end of file
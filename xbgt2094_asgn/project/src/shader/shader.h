@@ -1,17 +1,46 @@
 #pragma once
 // Based on LearnOpenGL.com with some changes.
 #include <string>
+#include <vector>
 #include <glm/glm.hpp>
+#include "uniform_id.h"
 
 class Shader
 {
 private:
 	friend class ShaderUtils;
+
+	// Open addressing by name hash; location -1 marks an empty slot
+	struct UniformSlot
+	{
+		uint32_t hash;
+		int location;
+	};
+
 	std::string shaderName;
 	unsigned int handle;
+	std::vector<UniformSlot> uniformTable;	// power of two size
 	Shader();
 
+	// Reflects GL_ACTIVE_UNIFORMS of the linked program into the table
+	void buildUniformTable();
+	// Binds the program's uniform blocks to the fixed points UniformBuffer has for their names
+	void bindUniformBlocks();
+
 public:
 	~Shader();
 	unsigned int getNativeHandle();
-};
+
+	// -1, which glUniform* ignores, when the program has no such active uniform
+	int getUniformLocation(UniformId id) const
+	{
+		if (uniformTable.empty()) return -1;
+
+		size_t mask = uniformTable.size() - 1;
+		for (size_t i = id.getHash() & mask; ; i = (i + 1) & mask)
+		{
+			const UniformSlot& slot = uniformTable[i];
+			if (slot.location < 0 || slot.hash == id.getHash()) return slot.location;
+		}
+	}
+};
\ No newline at end of file
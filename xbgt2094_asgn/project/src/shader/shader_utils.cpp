@@ -1,11 +1,47 @@
 #include "shader_utils.h"
 #include <glad/glad.h>
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
 #include <fstream>
 #include <sstream>
 #include <stdio.h>
+#include <vector>
+#include "../framework/bench_utils.h"
+#include "../framework/file_utils.h"
+
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
 
 static std::string errorString;
 
+struct ProgramCacheStats
+{
+	unsigned int hits;
+	unsigned int compiles;
+	double hitMs;
+	double compileMs;
+};
+
+static ProgramCacheStats programCacheStats = {};
+
+static bool isProgramCacheAvailable();
+static uint64_t getProgramKey(const std::string& vString, const std::string& fString);
+static std::string getProgramCachePath(const std::string& vertexFilePath, const std::string& fragmentFilePath, const std::string& variant);
+static unsigned int loadProgramBinary(const std::string& cachePath, uint64_t key);
+static void saveProgramBinary(const std::string& cachePath, uint64_t key, unsigned int programId);
+
+static std::string injectDefines(const std::string& source, const std::string& defines);
 static unsigned int compileSourcesToShaderProgram(const std::string& vString, const std::string& fString);
 static unsigned int assembleProgram(unsigned int vShader, unsigned int fShader);
 static unsigned int compileShader(const GLenum shaderType, const char* shaderCode, const char* shaderTypeString);
@@ -20,6 +56,8 @@ void ShaderUtils::injectData(Shader* shaderPtr, const unsigned int shaderId, con
 	glDeleteProgram(shaderPtr->getNativeHandle());
 	shaderPtr->handle = shaderId;
 	shaderPtr->shaderName = shaderName;
+	shaderPtr->buildUniformTable();
+	shaderPtr->bindUniformBlocks();
 }
 
 Shader* ShaderUtils::createShaderInternal(const std::string& shaderName, const std::string& vString, const std::string& fString)
@@ -44,7 +82,8 @@ Shader* ShaderUtils::createShaderInternal(const std::string& shaderName, const s
 	return shader;
 }
 
-void ShaderUtils::loadShader(Shader** shaderPtr, const std::string& shaderName, const std::string& vertexFilePath, const std::string& fragmentFilePath)
+void ShaderUtils::loadShader(Shader** shaderPtr, const std::string& shaderName, const std::string& vertexFilePath, const std::string& fragmentFilePath,
+	const std::string& defines, const std::string& variant)
 {
 	validateShaderObject(shaderPtr);
 
@@ -52,12 +91,33 @@ void ShaderUtils::loadShader(Shader** shaderPtr, const std::string& shaderName,
 
 	try
 	{
-		std::string vString = readFile(vertexFilePath);
-		std::string fString = readFile(fragmentFilePath);
+		auto start = std::chrono::steady_clock::now();
+		std::string vString = injectDefines(readFile(vertexFilePath), defines);
+		std::string fString = injectDefines(readFile(fragmentFilePath), defines);
+
+		// The driver's binary from an earlier run is reused while the sources and the driver are unchanged
+		uint64_t key = getProgramKey(vString, fString);
+		std::string cachePath = getProgramCachePath(vertexFilePath, fragmentFilePath, variant);
+		unsigned int newShaderId = loadProgramBinary(cachePath, key);
+		bool cached = newShaderId != 0;
+		if (!cached) newShaderId = compileSourcesToShaderProgram(vString, fString);
 
-		unsigned int newShaderId = compileSourcesToShaderProgram(vString, fString);
 		injectData(*shaderPtr, newShaderId, shaderName);
-		printf("\x1b[32mSuccess\x1b[0m\n");
+
+		double elapsedMs = BenchUtils::getElapsedMs(start);
+		if (cached)
+		{
+			programCacheStats.hits++;
+			programCacheStats.hitMs += elapsedMs;
+		}
+		else
+		{
+			programCacheStats.compiles++;
+			programCacheStats.compileMs += elapsedMs;
+		}
+		printf("\x1b[32mSuccess\x1b[0m (%s, %.2f ms)\n", cached ? "cached binary" : "compiled", elapsedMs);
+
+		if (!cached) saveProgramBinary(cachePath, key, newShaderId);
 	}
 	catch (std::string err)
 	{
@@ -65,6 +125,14 @@ void ShaderUtils::loadShader(Shader** shaderPtr, const std::string& shaderName,
 	}
 }
 
+void ShaderUtils::printProgramCacheStats()
+{
+	printf("Shader programs: %u from the binary cache in %.2f ms, %u compiled in %.2f ms%s\n",
+		programCacheStats.hits, programCacheStats.hitMs, programCacheStats.compiles, programCacheStats.compileMs,
+		isProgramCacheAvailable() ? "" : " (no program binaries on this driver)");
+	programCacheStats = {};
+}
+
 void ShaderUtils::loadShader_String(Shader** shaderPtr, const std::string& shaderName, const std::string& vString, const std::string& fString)
 {
 	validateShaderObject(shaderPtr);
@@ -123,6 +191,181 @@ void ShaderUtils::loadShader_VString_FFile(Shader** shaderPtr, const std::string
 	}
 }
 
+#pragma region Program Binary Cache
+
+// Bump whenever the key or the file layout changes.
+static const uint32_t PROGRAM_BINARY_VERSION = 1;
+static const char PROGRAM_BINARY_MAGIC[4] = { 'P', 'R', 'G', 'B' };
+
+// File layout: header, then length bytes of the driver's binary
+struct ProgramBinaryHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint64_t key;
+	uint32_t format;
+	uint32_t length;
+};
+
+typedef void (APIENTRYP GetProgramBinaryProc)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+typedef void (APIENTRYP ProgramBinaryProc)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+typedef void (APIENTRYP ProgramParameteriProc)(GLuint program, GLenum pname, GLint value);
+
+struct ProgramBinaryFunctions
+{
+	GetProgramBinaryProc getProgramBinary;
+	ProgramBinaryProc programBinary;
+	ProgramParameteriProc programParameteri;
+};
+
+// Core since 4.1 and in ARB_get_program_binary on 3.3 drivers. glad here only loads 3.3, so they are looked up once.
+// All null when the driver offers no binary formats, which turns the cache off.
+static const ProgramBinaryFunctions& getProgramBinaryFunctions()
+{
+	static ProgramBinaryFunctions functions = []() -> ProgramBinaryFunctions
+	{
+		ProgramBinaryFunctions found = {};
+
+		GLint major = 0, minor = 0;
+		glGetIntegerv(GL_MAJOR_VERSION, &major);
+		glGetIntegerv(GL_MINOR_VERSION, &minor);
+
+		bool core = major > 4 || (major == 4 && minor >= 1);
+		if (!core && !glfwExtensionSupported("GL_ARB_get_program_binary")) return found;
+
+		GLint formatCount = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+		if (formatCount <= 0) return found;
+
+		found.getProgramBinary = (GetProgramBinaryProc)glfwGetProcAddress("glGetProgramBinary");
+		found.programBinary = (ProgramBinaryProc)glfwGetProcAddress("glProgramBinary");
+		found.programParameteri = (ProgramParameteriProc)glfwGetProcAddress("glProgramParameteri");
+		if (!found.getProgramBinary || !found.programBinary || !found.programParameteri) found = {};
+		return found;
+	}();
+	return functions;
+}
+
+static bool isProgramCacheAvailable()
+{
+	return getProgramBinaryFunctions().programBinary != nullptr;
+}
+
+// Both sources and the driver that compiles them, so a new driver or GPU misses instead of being handed a binary it rejects
+static uint64_t getProgramKey(const std::string& vString, const std::string& fString)
+{
+	uint64_t sizes[2] = { vString.size(), fString.size() };
+	uint64_t key = FileUtils::hashBytes(sizes, sizeof(sizes));
+	key = FileUtils::hashBytes(vString.data(), vString.size(), key);
+	key = FileUtils::hashBytes(fString.data(), fString.size(), key);
+
+	for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION })
+	{
+		const char* value = reinterpret_cast<const char*>(glGetString(name));
+		if (value) key = FileUtils::hashBytes(value, strlen(value) + 1, key);
+	}
+	return key;
+}
+
+// <vertex file>.<fragment file>[.<variant>].progcache next to the fragment shader, one per pair of files and variant
+static std::string getProgramCachePath(const std::string& vertexFilePath, const std::string& fragmentFilePath, const std::string& variant)
+{
+	std::filesystem::path fragmentPath(fragmentFilePath);
+	std::string fileName = std::filesystem::path(vertexFilePath).filename().string() + "." + fragmentPath.filename().string();
+	if (!variant.empty()) fileName += "." + variant;
+	fileName += ".progcache";
+	return (fragmentPath.parent_path() / fileName).generic_string();
+}
+
+// A linked program from the cache, or 0 when there is no cache for key or the driver refuses the binary
+static unsigned int loadProgramBinary(const std::string& cachePath, uint64_t key)
+{
+	const ProgramBinaryFunctions& functions = getProgramBinaryFunctions();
+	if (!functions.programBinary) return 0;
+
+	FileUtils::MappedFile file;
+	if (!file.open(cachePath) || file.size() < sizeof(ProgramBinaryHeader)) return 0;
+
+	ProgramBinaryHeader header;
+	std::memcpy(&header, file.data(), sizeof(header));
+	if (std::memcmp(header.magic, PROGRAM_BINARY_MAGIC, sizeof(PROGRAM_BINARY_MAGIC)) != 0 ||
+		header.version != PROGRAM_BINARY_VERSION ||
+		header.key != key ||
+		header.length != file.size() - sizeof(header))
+	{
+		return 0;
+	}
+
+	unsigned int programId = glCreateProgram();
+	functions.programBinary(programId, header.format, file.data() + sizeof(header), (GLsizei)header.length);
+
+	// Drivers may reject their own binaries after an update the key did not catch; compiling again replaces it
+	int success;
+	glGetProgramiv(programId, GL_LINK_STATUS, &success);
+	if (!success)
+	{
+		glDeleteProgram(programId);
+		return 0;
+	}
+
+	return programId;
+}
+
+static void saveProgramBinary(const std::string& cachePath, uint64_t key, unsigned int programId)
+{
+	const ProgramBinaryFunctions& functions = getProgramBinaryFunctions();
+	if (!functions.getProgramBinary) return;
+
+	GLint length = 0;
+	glGetProgramiv(programId, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0) return;
+
+	std::vector<unsigned char> binary(length);
+	GLsizei written = 0;
+	GLenum format = 0;
+	functions.getProgramBinary(programId, length, &written, &format, binary.data());
+	if (written <= 0) return;
+
+	ProgramBinaryHeader header;
+	std::memcpy(header.magic, PROGRAM_BINARY_MAGIC, sizeof(PROGRAM_BINARY_MAGIC));
+	header.version = PROGRAM_BINARY_VERSION;
+	header.key = key;
+	header.format = format;
+	header.length = (uint32_t)written;
+
+	std::ofstream file(cachePath, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!file)
+	{
+		printf("Failed to write program cache: %s\n", cachePath.c_str());
+		return;
+	}
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(binary.data()), written);
+}
+
+#pragma endregion
+
+// The #version line must stay first, so defines go on the line after it
+static std::string injectDefines(const std::string& source, const std::string& defines)
+{
+	if (defines.empty()) return source;
+
+	size_t insertAt = 0;
+	size_t version = source.find("#version");
+	if (version != std::string::npos)
+	{
+		size_t lineEnd = source.find('\n', version);
+		insertAt = lineEnd == std::string::npos ? source.size() : lineEnd + 1;
+	}
+
+	std::string result = source.substr(0, insertAt);
+	if (!result.empty() && result.back() != '\n') result += '\n';
+	result += defines;
+	result.append(source, insertAt, std::string::npos);
+	return result;
+}
+
 static unsigned int compileSourcesToShaderProgram(const std::string& vString, const std::string& fString)
 {
 	// Clear any data written to the string so we can write errors if any.
@@ -146,6 +389,10 @@ static unsigned int assembleProgram(unsigned int vShader, unsigned int fShader)
 	// Create program
 	unsigned int programId = glCreateProgram();
 
+	// Lets the binary cache read the linked program back
+	const ProgramBinaryFunctions& binaryFunctions = getProgramBinaryFunctions();
+	if (binaryFunctions.programParameteri) binaryFunctions.programParameteri(programId, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
 	// Attach shaders to this program and start linking
 	glAttachShader(programId, vShader);
 	glAttachShader(programId, fShader);
@@ -24,5 +24,13 @@ private:
 	static void loadShader_VString_FFile(Shader** shaderPtr, const std::string& shaderName, const std::string& vString, const std::string& fragmentFilePath);
 
 public:
-	static void loadShader(Shader** shaderPtr, const std::string& shaderName, const std::string& vertexFilePath, const std::string& fragmentFilePath);
+	// Links the program from a cached binary (<vertex file>.<fragment file>.progcache) when the sources and driver
+	// match the ones it was built from; otherwise compiles it and caches its binary for next time.
+	// defines, #define lines, go after the #version line of both sources; each variant names its own cache file,
+	// <vertex file>.<fragment file>.<variant>.progcache.
+	static void loadShader(Shader** shaderPtr, const std::string& shaderName, const std::string& vertexFilePath, const std::string& fragmentFilePath,
+		const std::string& defines = "", const std::string& variant = "");
+
+	// Programs loaded from the cache and compiled since the last call, with the time each took
+	static void printProgramCacheStats();
 };
\ No newline at end of file
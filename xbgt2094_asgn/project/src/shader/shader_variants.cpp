@@ -0,0 +1,89 @@
+#include "shader_variants.h"
+#include <stdio.h>
+#include "shader_utils.h"
+
+ShaderVariants::ShaderVariants(const std::string& name, const std::string& vertexFilePath, const std::string& fragmentFilePath,
+	const std::vector<ShaderVariantOption>& options, std::function<void(Shader*)> onLoad)
+	: name(name), vertexFilePath(vertexFilePath), fragmentFilePath(fragmentFilePath), options(options), onLoad(onLoad)
+{
+	unsigned int bits = 0;
+	for (const ShaderVariantOption& option : options) bits += option.bits;
+
+	if (bits > 32) printf("Shader variants '%s': options take %u bits of a 32 bit key\n", name.c_str(), bits);
+}
+
+ShaderVariants::~ShaderVariants()
+{
+	for (auto& variant : variants)
+	{
+		delete variant.second;
+	}
+}
+
+uint32_t ShaderVariants::makeKey(std::initializer_list<unsigned int> values) const
+{
+	uint32_t key = 0;
+	unsigned int shift = 0;
+
+	size_t i = 0;
+	for (unsigned int value : values)
+	{
+		if (i == options.size() || shift >= 32) break;
+
+		unsigned int bits = options[i++].bits;
+		uint32_t mask = bits >= 32 ? 0xffffffffu : (1u << bits) - 1;
+		key |= (value & mask) << shift;
+		shift += bits;
+	}
+	return key;
+}
+
+Shader* ShaderVariants::get(uint32_t key)
+{
+	auto found = variants.find(key);
+	if (found != variants.end()) return found->second;
+
+	Shader* shader = nullptr;
+	load(&shader, key);
+	variants[key] = shader;
+	return shader;
+}
+
+void ShaderVariants::reload()
+{
+	for (auto& variant : variants)
+	{
+		load(&variant.second, variant.first);
+	}
+}
+
+size_t ShaderVariants::getVariantCount() const
+{
+	return variants.size();
+}
+
+void ShaderVariants::load(Shader** shader, uint32_t key)
+{
+	std::string defines;
+	std::string shaderName = name + " (";
+
+	unsigned int shift = 0;
+	for (size_t i = 0; i < options.size(); i++)
+	{
+		const ShaderVariantOption& option = options[i];
+		uint32_t mask = option.bits >= 32 ? 0xffffffffu : (1u << option.bits) - 1;
+		std::string value = std::to_string(shift < 32 ? (key >> shift) & mask : 0);
+		shift += option.bits;
+
+		defines += "#define " + option.name + " " + value + "\n";
+		shaderName += (i > 0 ? " " : "") + option.name + "=" + value;
+	}
+	shaderName += ")";
+
+	char variant[9];
+	snprintf(variant, sizeof(variant), "%08x", key);
+
+	ShaderUtils::loadShader(shader, shaderName, vertexFilePath, fragmentFilePath, defines, variant);
+
+	if (onLoad && (*shader)->getNativeHandle() != 0) onLoad(*shader);
+}
\ No newline at end of file
@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "shader.h"
+
+// A #define of a shader variant, and how many bits of the variant key hold its value; 1 for a feature flag
+struct ShaderVariantOption
+{
+	std::string name;
+	unsigned int bits;
+};
+
+// The programs one pair of shader files builds for different options. Every option is #defined to its value in
+// the key, so branches and loop bounds on it are fixed when the variant compiles and the driver drops the code
+// it never reaches. A variant is compiled, or loaded from the program binary cache, the first time it is asked for.
+class ShaderVariants
+{
+public:
+	// Options take the key's bits in order from the lowest, 32 at most. onLoad runs on each variant after it links,
+	// to set what the scene sets once per program, like sampler units.
+	ShaderVariants(const std::string& name, const std::string& vertexFilePath, const std::string& fragmentFilePath,
+		const std::vector<ShaderVariantOption>& options, std::function<void(Shader*)> onLoad = nullptr);
+	~ShaderVariants();
+
+	ShaderVariants(const ShaderVariants&) = delete;
+	ShaderVariants& operator=(const ShaderVariants&) = delete;
+
+	// One value per option, in their order; each is cut to the option's bits
+	uint32_t makeKey(std::initializer_list<unsigned int> values) const;
+
+	// Compiles it on first use; its handle is 0 if that failed, as with ShaderUtils::loadShader
+	Shader* get(uint32_t key);
+
+	// Builds every variant made so far again from the files, in place, so pointers to them stay valid
+	void reload();
+
+	size_t getVariantCount() const;
+
+private:
+	std::string name;
+	std::string vertexFilePath, fragmentFilePath;
+	std::vector<ShaderVariantOption> options;
+	std::function<void(Shader*)> onLoad;
+	std::unordered_map<uint32_t, Shader*> variants;
+
+	void load(Shader** shader, uint32_t key);
+};
\ No newline at end of file
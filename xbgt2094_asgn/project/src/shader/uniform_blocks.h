@@ -0,0 +1,84 @@
+#pragma once
+#include <glm/glm.hpp>
+
+// C++ mirrors of the std140 uniform blocks the shaders declare. Members are ordered so no vec3 is split and
+// padding is spelled out; the static_asserts hold each to the offsets GLSL gives it.
+
+// "Frame" in standard.vert, fire.vert and lit.frag: set once per frame
+struct FrameBlock
+{
+	glm::mat4 projection;
+	glm::mat4 view;
+	glm::mat4 lightProjection;	// the shadow casting directional light's view projection
+	glm::vec3 cameraPosition;
+	float time;
+};
+
+static_assert(sizeof(FrameBlock) == 208, "FrameBlock must match the std140 layout of Frame");
+
+// MAX_LIGHTS in lit.frag
+static const int MAX_LIGHTS = 30;
+
+struct DirectionalLightBlock
+{
+	glm::vec3 col;
+	float pad0;
+	glm::vec3 dir;
+	float pad1;
+};
+
+struct PointLightBlock
+{
+	glm::vec3 col;
+	float range;	// inverse squared
+	glm::vec3 pos;
+	float pad0;
+};
+
+struct SpotLightBlock
+{
+	glm::vec3 col;
+	float range;	// inverse squared
+	glm::vec3 dir;
+	float pad0;
+	glm::vec3 pos;
+	float pad1;
+	glm::vec2 angles;
+	glm::vec2 pad2;
+};
+
+// "Lights" in lit.frag: the active lights only, packed to the front of each array
+struct LightsBlock
+{
+	int directionalCount;
+	int pointCount;
+	int spotCount;
+	int enableShadow;		// a bool is 4 bytes in std140
+	float shadowStrength;
+	float shadowBias;
+	float pad0[2];
+	DirectionalLightBlock directionalLights[MAX_LIGHTS];
+	PointLightBlock pointLights[MAX_LIGHTS];
+	SpotLightBlock spotLights[MAX_LIGHTS];
+};
+
+static_assert(sizeof(DirectionalLightBlock) == 32 && sizeof(PointLightBlock) == 32 && sizeof(SpotLightBlock) == 64,
+	"light structs must match their std140 array strides");
+static_assert(sizeof(LightsBlock) == 32 + MAX_LIGHTS * (32 + 32 + 64), "LightsBlock must match the std140 layout of Lights");
+
+// "Object" in standard.vert, fire.vert, lit.frag and unlit.frag: one per entity drawn, each in its own range
+// of one buffer, bound for its draw
+struct ObjectBlock
+{
+	glm::mat4 model;
+	glm::vec4 normalMatrix[3];	// mat3 columns, each padded to a vec4 as std140 stores them
+	glm::mat4 modelViewProjection;
+	glm::vec3 tint;
+	float shininess;
+	float opacity;
+	float alphaClip;
+	float breathingSpeed;
+	float pad0;
+};
+
+static_assert(sizeof(ObjectBlock) == 208, "ObjectBlock must match the std140 layout of Object");
\ No newline at end of file
@@ -0,0 +1,97 @@
+#include "uniform_buffer.h"
+#include <glad/glad.h>
+#include <cstring>
+
+struct NamedBlock
+{
+	const char* name;
+	UniformBlockBinding binding;
+};
+
+static const NamedBlock namedBlocks[] =
+{
+	{ "Frame", UniformBlockBinding::FRAME },
+	{ "Lights", UniformBlockBinding::LIGHTS },
+	{ "Object", UniformBlockBinding::OBJECT },
+};
+
+static UniformBufferStats stats = {};
+
+UniformBuffer::UniformBuffer(UniformBlockBinding binding, size_t size) : handle(0), binding(binding), uploaded(size), empty(true)
+{
+	glGenBuffers(1, &handle);
+	glBindBuffer(GL_UNIFORM_BUFFER, handle);
+	glBufferData(GL_UNIFORM_BUFFER, (GLsizeiptr)size, nullptr, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	bind();
+}
+
+UniformBuffer::~UniformBuffer()
+{
+	glDeleteBuffers(1, &handle);
+}
+
+bool UniformBuffer::update(const void* data, size_t size)
+{
+	if (size != uploaded.size()) return false;
+
+	if (!empty && memcmp(uploaded.data(), data, size) == 0)
+	{
+		stats.skipped++;
+		return false;
+	}
+
+	memcpy(uploaded.data(), data, size);
+	empty = false;
+
+	glBindBuffer(GL_UNIFORM_BUFFER, handle);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, (GLsizeiptr)size, data);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	stats.updates++;
+	stats.bytes += size;
+	return true;
+}
+
+void UniformBuffer::bind() const
+{
+	glBindBufferBase(GL_UNIFORM_BUFFER, (GLuint)binding, handle);
+}
+
+void UniformBuffer::bindRange(size_t offset, size_t size) const
+{
+	glBindBufferRange(GL_UNIFORM_BUFFER, (GLuint)binding, handle, (GLintptr)offset, (GLsizeiptr)size);
+	stats.rangeBinds++;
+}
+
+unsigned int UniformBuffer::getHandle() const
+{
+	return handle;
+}
+
+size_t UniformBuffer::getOffsetAlignment()
+{
+	static GLint alignment = 0;
+	if (alignment <= 0) glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	return alignment > 0 ? (size_t)alignment : 256;
+}
+
+int UniformBuffer::getBinding(const char* blockName)
+{
+	for (const NamedBlock& block : namedBlocks)
+	{
+		if (strcmp(block.name, blockName) == 0) return (int)block.binding;
+	}
+	return -1;
+}
+
+const UniformBufferStats& UniformBuffer::getStats()
+{
+	return stats;
+}
+
+void UniformBuffer::resetStats()
+{
+	stats = {};
+}
\ No newline at end of file
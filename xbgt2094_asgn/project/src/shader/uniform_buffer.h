@@ -0,0 +1,61 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+// Binding points of the uniform blocks shaders share. Every program has the blocks it declares bound to these
+// by name when it is linked, so one buffer bound per point serves all of them.
+enum class UniformBlockBinding : unsigned int
+{
+	FRAME = 0,		// "Frame"
+	LIGHTS = 1,		// "Lights"
+	OBJECT = 2,		// "Object"
+};
+
+struct UniformBufferStats
+{
+	unsigned int updates;	// buffers uploaded
+	unsigned int skipped;	// updates whose contents matched the last upload
+	size_t bytes;			// uploaded
+	unsigned int rangeBinds;	// bindRange calls
+};
+
+// The buffer behind a std140 uniform block. Keeps a copy of what it last uploaded, so an update with nothing
+// changed costs a compare and no GL call.
+class UniformBuffer
+{
+public:
+	UniformBuffer(UniformBlockBinding binding, size_t size);
+	~UniformBuffer();
+
+	UniformBuffer(const UniformBuffer&) = delete;
+	UniformBuffer& operator=(const UniformBuffer&) = delete;
+
+	// size must be the size the buffer was made with. True when it uploaded.
+	bool update(const void* data, size_t size);
+	template <typename T>
+	bool update(const T& block) { return update(&block, sizeof(T)); }
+
+	// To the binding point it was made for
+	void bind() const;
+	// Just size bytes from offset, which must be a multiple of getOffsetAlignment(), for a buffer holding one
+	// block per draw
+	void bindRange(size_t offset, size_t size) const;
+
+	unsigned int getHandle() const;
+
+	// GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+	static size_t getOffsetAlignment();
+
+	// Binding point of the shared block with this name, or -1 for a block that is not one of them
+	static int getBinding(const char* blockName);
+
+	// Since the last reset; the scene resets them every frame
+	static const UniformBufferStats& getStats();
+	static void resetStats();
+
+private:
+	unsigned int handle;
+	UniformBlockBinding binding;
+	std::vector<unsigned char> uploaded;
+	bool empty;		// nothing uploaded yet
+};
\ No newline at end of file
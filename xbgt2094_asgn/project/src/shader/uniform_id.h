@@ -0,0 +1,34 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// A uniform name hashed with 32-bit FNV-1a. Literals hash through the constexpr constructor, so setting a
+// uniform by name builds no string; Shader finds the location in a table of its active uniforms made at link.
+class UniformId
+{
+public:
+	template <size_t N>
+	constexpr UniformId(const char (&name)[N]) : hash(hashName(name, N - 1, OFFSET_BASIS)) {}
+	// For names only known at runtime; hashed on every call
+	UniformId(const std::string& name) : hash(hashName(name.data(), name.size(), OFFSET_BASIS)) {}
+
+	constexpr uint32_t getHash() const { return hash; }
+
+private:
+	static constexpr uint32_t OFFSET_BASIS = 2166136261u;
+	static constexpr uint32_t PRIME = 16777619u;
+
+	uint32_t hash;
+
+	static constexpr uint32_t hashChar(char c, uint32_t hash)
+	{
+		return (hash ^ (uint8_t)c) * PRIME;
+	}
+
+	static constexpr uint32_t hashName(const char* name, size_t length, uint32_t hash)
+	{
+		for (size_t i = 0; i < length; i++) hash = hashChar(name[i], hash);
+		return hash;
+	}
+};
\ No newline at end of file
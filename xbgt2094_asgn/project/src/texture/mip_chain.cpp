@@ -0,0 +1,533 @@
+#include "mip_chain.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <stb_image/stb_image.h>
+#include "../framework/bench_utils.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MIP_CHAIN_SSE2
+#include <emmintrin.h>
+#endif
+
+static const double PI = 3.14159265358979323846;
+static const float KAISER_RADIUS = 2.0f;	// in pixels of the smaller level, either side of the centre
+static const double KAISER_ALPHA = 4.0;
+static const int LINEAR_TO_SRGB_STEPS = 16384;
+
+#pragma region Colour Space
+
+struct SrgbTables
+{
+	float toLinear[256];
+	unsigned char toSrgb[LINEAR_TO_SRGB_STEPS];
+
+	SrgbTables()
+	{
+		for (int i = 0; i < 256; i++)
+		{
+			float c = i / 255.0f;
+			toLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+		}
+		for (int i = 0; i < LINEAR_TO_SRGB_STEPS; i++)
+		{
+			float c = i / (float)(LINEAR_TO_SRGB_STEPS - 1);
+			float s = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+			toSrgb[i] = (unsigned char)std::lround(std::min(std::max(s, 0.0f), 1.0f) * 255.0f);
+		}
+	}
+};
+
+// Built once, on first use from any thread
+static const SrgbTables& getSrgbTables()
+{
+	static SrgbTables tables;
+	return tables;
+}
+
+// RGBA8 to float RGBA, with colour decoded to linear when srgb. Alpha is always linear.
+static void toFloat(const unsigned char* rgba, size_t pixelCount, bool srgb, float* result)
+{
+	const SrgbTables& tables = getSrgbTables();
+	for (size_t i = 0; i < pixelCount * 4; i++)
+	{
+		bool colour = srgb && (i & 3) != 3;
+		result[i] = colour ? tables.toLinear[rgba[i]] : rgba[i] / 255.0f;
+	}
+}
+
+// Float RGBA back to RGBA8 with alpha scaled by alphaScale, clamped and rounded
+static void toBytes(const float* level, size_t pixelCount, bool srgb, float alphaScale, unsigned char* result)
+{
+	const SrgbTables& tables = getSrgbTables();
+
+#ifdef MIP_CHAIN_SSE2
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 scale = _mm_set_ps(alphaScale, 1.0f, 1.0f, 1.0f);
+	const __m128 toByte = _mm_set1_ps(255.0f);
+	const __m128 toStep = _mm_set1_ps((float)(LINEAR_TO_SRGB_STEPS - 1));
+
+	for (size_t i = 0; i < pixelCount; i++)
+	{
+		__m128 v = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(level + i * 4), scale), zero), one);
+
+		__m128i bytes = _mm_cvtps_epi32(_mm_mul_ps(v, toByte));
+		bytes = _mm_packs_epi32(bytes, bytes);
+		bytes = _mm_packus_epi16(bytes, bytes);
+		int packed = _mm_cvtsi128_si32(bytes);
+		std::memcpy(result + i * 4, &packed, 4);
+
+		if (srgb)
+		{
+			alignas(16) int steps[4];
+			_mm_store_si128(reinterpret_cast<__m128i*>(steps), _mm_cvtps_epi32(_mm_mul_ps(v, toStep)));
+			for (int c = 0; c < 3; c++) result[i * 4 + c] = tables.toSrgb[steps[c]];
+		}
+	}
+#else
+	for (size_t i = 0; i < pixelCount; i++)
+	{
+		for (int c = 0; c < 4; c++)
+		{
+			float v = level[i * 4 + c] * (c == 3 ? alphaScale : 1.0f);
+			v = std::min(std::max(v, 0.0f), 1.0f);
+
+			if (srgb && c != 3) result[i * 4 + c] = tables.toSrgb[(int)std::lround(v * (LINEAR_TO_SRGB_STEPS - 1))];
+			else result[i * 4 + c] = (unsigned char)std::lround(v * 255.0f);
+		}
+	}
+#endif
+}
+
+#pragma endregion
+
+#pragma region Filters
+
+// Averages 2x2 source pixels into each result pixel. An odd last row or column is dropped, as GL does.
+static void downsampleBox(const float* source, int width, int height, float* result, int resultWidth, int resultHeight)
+{
+	for (int y = 0; y < resultHeight; y++)
+	{
+		const float* row0 = source + (size_t)std::min(y * 2, height - 1) * width * 4;
+		const float* row1 = source + (size_t)std::min(y * 2 + 1, height - 1) * width * 4;
+
+		for (int x = 0; x < resultWidth; x++)
+		{
+			size_t x0 = (size_t)std::min(x * 2, width - 1) * 4;
+			size_t x1 = (size_t)std::min(x * 2 + 1, width - 1) * 4;
+			float* out = result + ((size_t)y * resultWidth + x) * 4;
+
+#ifdef MIP_CHAIN_SSE2
+			__m128 sum = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(row0 + x0), _mm_loadu_ps(row0 + x1)),
+				_mm_add_ps(_mm_loadu_ps(row1 + x0), _mm_loadu_ps(row1 + x1)));
+			_mm_storeu_ps(out, _mm_mul_ps(sum, _mm_set1_ps(0.25f)));
+#else
+			for (int c = 0; c < 4; c++)
+			{
+				out[c] = (row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c]) * 0.25f;
+			}
+#endif
+		}
+	}
+}
+
+// Modified Bessel function of the first kind, order 0
+static double besselI0(double x)
+{
+	double sum = 1.0, term = 1.0;
+	for (int k = 1; k < 32; k++)
+	{
+		double half = x / (2.0 * k);
+		term *= half * half;
+		sum += term;
+		if (term < sum * 1e-12) break;
+	}
+	return sum;
+}
+
+// Windowed sinc at a distance in result pixels
+static float kaiserSinc(float distance)
+{
+	if (std::fabs(distance) >= KAISER_RADIUS) return 0.0f;
+
+	double x = distance / KAISER_RADIUS;
+	double window = besselI0(KAISER_ALPHA * std::sqrt(1.0 - x * x)) / besselI0(KAISER_ALPHA);
+	double sinc = distance == 0.0f ? 1.0 : std::sin(PI * distance) / (PI * distance);
+	return (float)(window * sinc);
+}
+
+// Source pixel and weight of every tap of every result pixel along one axis
+struct FilterTaps
+{
+	int tapCount;
+	std::vector<int> indices;
+	std::vector<float> weights;
+};
+
+// Any ratio: shrinking widens the filter to the result's pixels, enlarging keeps it at the source's
+static void buildKaiserTaps(int sourceSize, int resultSize, bool wrap, FilterTaps& taps)
+{
+	float scale = (float)sourceSize / resultSize;
+	float support = std::max(scale, 1.0f);
+	taps.tapCount = (int)std::ceil(2.0f * KAISER_RADIUS * support) + 1;
+	taps.indices.resize((size_t)resultSize * taps.tapCount);
+	taps.weights.resize((size_t)resultSize * taps.tapCount);
+
+	for (int i = 0; i < resultSize; i++)
+	{
+		float center = (i + 0.5f) * scale;
+		int first = (int)std::floor(center - KAISER_RADIUS * support);
+		int* indices = &taps.indices[(size_t)i * taps.tapCount];
+		float* weights = &taps.weights[(size_t)i * taps.tapCount];
+
+		float total = 0.0f;
+		for (int t = 0; t < taps.tapCount; t++)
+		{
+			int s = first + t;
+			indices[t] = wrap ? ((s % sourceSize) + sourceSize) % sourceSize : std::min(std::max(s, 0), sourceSize - 1);
+			weights[t] = kaiserSinc((s + 0.5f - center) / support);
+			total += weights[t];
+		}
+		for (int t = 0; t < taps.tapCount; t++)
+		{
+			weights[t] /= total;
+		}
+	}
+}
+
+// Horizontal pass: every row of source to resultWidth pixels
+static void filterRows(const float* source, int width, int height, const FilterTaps& taps, int resultWidth, float* result)
+{
+	for (int y = 0; y < height; y++)
+	{
+		const float* row = source + (size_t)y * width * 4;
+		for (int x = 0; x < resultWidth; x++)
+		{
+			const int* indices = &taps.indices[(size_t)x * taps.tapCount];
+			const float* weights = &taps.weights[(size_t)x * taps.tapCount];
+			float* out = result + ((size_t)y * resultWidth + x) * 4;
+
+#ifdef MIP_CHAIN_SSE2
+			__m128 sum = _mm_setzero_ps();
+			for (int t = 0; t < taps.tapCount; t++)
+			{
+				sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(row + (size_t)indices[t] * 4), _mm_set1_ps(weights[t])));
+			}
+			_mm_storeu_ps(out, sum);
+#else
+			for (int c = 0; c < 4; c++)
+			{
+				float sum = 0.0f;
+				for (int t = 0; t < taps.tapCount; t++) sum += row[(size_t)indices[t] * 4 + c] * weights[t];
+				out[c] = sum;
+			}
+#endif
+		}
+	}
+}
+
+// Vertical pass: whole rows of source weighted into each of resultHeight rows
+static void filterColumns(const float* source, int width, const FilterTaps& taps, int resultHeight, float* result)
+{
+	size_t rowFloats = (size_t)width * 4;
+
+	for (int y = 0; y < resultHeight; y++)
+	{
+		const int* indices = &taps.indices[(size_t)y * taps.tapCount];
+		const float* weights = &taps.weights[(size_t)y * taps.tapCount];
+		float* out = result + (size_t)y * rowFloats;
+		std::fill(out, out + rowFloats, 0.0f);
+
+		for (int t = 0; t < taps.tapCount; t++)
+		{
+			const float* row = source + (size_t)indices[t] * rowFloats;
+
+#ifdef MIP_CHAIN_SSE2
+			__m128 weight = _mm_set1_ps(weights[t]);
+			for (size_t i = 0; i < rowFloats; i += 4)
+			{
+				_mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), _mm_mul_ps(_mm_loadu_ps(row + i), weight)));
+			}
+#else
+			for (size_t i = 0; i < rowFloats; i++) out[i] += row[i] * weights[t];
+#endif
+		}
+	}
+}
+
+// Sinc lobes can overshoot; clamp before the next level is filtered from this one
+static void finishLevel(float* level, size_t pixelCount, bool normals)
+{
+#ifdef MIP_CHAIN_SSE2
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	for (size_t i = 0; i < pixelCount * 4; i += 4)
+	{
+		_mm_storeu_ps(level + i, _mm_min_ps(_mm_max_ps(_mm_loadu_ps(level + i), zero), one));
+	}
+#else
+	for (size_t i = 0; i < pixelCount * 4; i++) level[i] = std::min(std::max(level[i], 0.0f), 1.0f);
+#endif
+
+	if (!normals) return;
+
+	for (size_t i = 0; i < pixelCount; i++)
+	{
+		float* pixel = level + i * 4;
+		float n[3] = { pixel[0] * 2.0f - 1.0f, pixel[1] * 2.0f - 1.0f, pixel[2] * 2.0f - 1.0f };
+		float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		if (length < 1e-6f) continue;
+
+		for (int c = 0; c < 3; c++) pixel[c] = n[c] / length * 0.5f + 0.5f;
+	}
+}
+
+#pragma endregion
+
+#pragma region Alpha Coverage
+
+// Same test as lit.frag: a pixel survives when its alpha is above the cutoff
+static float measureLevelCoverage(const float* level, size_t pixelCount, float cutoff, float alphaScale)
+{
+	size_t passed = 0;
+	for (size_t i = 0; i < pixelCount; i++)
+	{
+		if (level[i * 4 + 3] * alphaScale > cutoff) passed++;
+	}
+	return (float)passed / pixelCount;
+}
+
+// Filtering averages alpha toward the middle, so fewer texels pass a high cutoff at each level and alpha tested
+// leaves thin out with distance. Scaling a level's alpha so that the same fraction passes keeps them (Castano).
+static float findAlphaScale(const float* level, size_t pixelCount, float cutoff, float targetCoverage)
+{
+	float low = 0.0f, high = 4.0f;
+	float best = 1.0f;
+	float bestError = std::fabs(measureLevelCoverage(level, pixelCount, cutoff, 1.0f) - targetCoverage);
+
+	for (int i = 0; i < 12; i++)
+	{
+		float scale = (low + high) * 0.5f;
+		float coverage = measureLevelCoverage(level, pixelCount, cutoff, scale);
+		float error = std::fabs(coverage - targetCoverage);
+
+		if (error < bestError)
+		{
+			best = scale;
+			bestError = error;
+		}
+
+		if (coverage < targetCoverage) low = scale;
+		else high = scale;
+	}
+	return best;
+}
+
+#pragma endregion
+
+MipSettings MipChainUtils::getSettings(const TextureConfig& cfg)
+{
+	MipSettings settings;
+	settings.filter = cfg.mipFilter;
+	settings.srgb = cfg.internalFormat == GL_SRGB_ALPHA || cfg.internalFormat == GL_SRGB8_ALPHA8;
+	settings.normals = cfg.compression == TextureCompression::NORMAL;
+	settings.wrapX = cfg.hWrap == GL_REPEAT;
+	settings.wrapY = cfg.vWrap == GL_REPEAT;
+	settings.alphaCoverage = cfg.alphaCoverage;
+	return settings;
+}
+
+void MipChainUtils::createBaseLevel(const unsigned char* rgba, int width, int height, MipmappedImage& image)
+{
+	image.format = GL_RGBA8;
+	image.width = width;
+	image.height = height;
+	image.data.assign(rgba, rgba + (size_t)width * height * 4);
+	image.levelOffsets = { 0, image.data.size() };
+}
+
+void MipChainUtils::generate(const unsigned char* rgba, int width, int height, const MipSettings& settings, MipmappedImage& chain)
+{
+	size_t pixelCount = (size_t)width * height;
+
+	// The whole chain is a third more than the first level
+	chain.data.reserve(pixelCount * 4 + pixelCount * 4 / 3 + 64);
+	createBaseLevel(rgba, width, height, chain);
+	chain.levelOffsets.pop_back();
+
+	std::vector<float> level(pixelCount * 4), next, rows;
+	toFloat(rgba, pixelCount, settings.srgb, level.data());
+
+	bool keepCoverage = settings.alphaCoverage > 0.0f;
+	float targetCoverage = keepCoverage ? measureLevelCoverage(level.data(), pixelCount, settings.alphaCoverage, 1.0f) : 0.0f;
+
+	FilterTaps xTaps, yTaps;
+	while (width > 1 || height > 1)
+	{
+		int nextWidth = std::max(1, width / 2), nextHeight = std::max(1, height / 2);
+		size_t nextCount = (size_t)nextWidth * nextHeight;
+		next.resize(nextCount * 4);
+
+		if (settings.filter == TextureMipFilter::KAISER)
+		{
+			buildKaiserTaps(width, nextWidth, settings.wrapX, xTaps);
+			buildKaiserTaps(height, nextHeight, settings.wrapY, yTaps);
+			rows.resize((size_t)nextWidth * height * 4);
+
+			filterRows(level.data(), width, height, xTaps, nextWidth, rows.data());
+			filterColumns(rows.data(), nextWidth, yTaps, nextHeight, next.data());
+		}
+		else
+		{
+			downsampleBox(level.data(), width, height, next.data(), nextWidth, nextHeight);
+		}
+
+		finishLevel(next.data(), nextCount, settings.normals);
+
+		// Only the stored level is scaled; the next one is filtered from the unscaled alpha
+		float alphaScale = keepCoverage ? findAlphaScale(next.data(), nextCount, settings.alphaCoverage, targetCoverage) : 1.0f;
+
+		size_t offset = chain.data.size();
+		chain.levelOffsets.push_back(offset);
+		chain.data.resize(offset + nextCount * 4);
+		toBytes(next.data(), nextCount, settings.srgb, alphaScale, &chain.data[offset]);
+
+		level.swap(next);
+		width = nextWidth;
+		height = nextHeight;
+	}
+
+	chain.levelOffsets.push_back(chain.data.size());
+}
+
+void MipChainUtils::resample(const unsigned char* rgba, int width, int height, int resultWidth, int resultHeight,
+	const MipSettings& settings, std::vector<unsigned char>& result)
+{
+	size_t pixelCount = (size_t)width * height;
+	size_t resultCount = (size_t)resultWidth * resultHeight;
+	result.resize(resultCount * 4);
+	if (width == resultWidth && height == resultHeight)
+	{
+		std::copy(rgba, rgba + pixelCount * 4, result.begin());
+		return;
+	}
+
+	std::vector<float> source(pixelCount * 4), rows((size_t)resultWidth * height * 4), resampled(resultCount * 4);
+	toFloat(rgba, pixelCount, settings.srgb, source.data());
+
+	FilterTaps xTaps, yTaps;
+	buildKaiserTaps(width, resultWidth, settings.wrapX, xTaps);
+	buildKaiserTaps(height, resultHeight, settings.wrapY, yTaps);
+	filterRows(source.data(), width, height, xTaps, resultWidth, rows.data());
+	filterColumns(rows.data(), resultWidth, yTaps, resultHeight, resampled.data());
+
+	finishLevel(resampled.data(), resultCount, settings.normals);
+	toBytes(resampled.data(), resultCount, settings.srgb, 1.0f, result.data());
+}
+
+float MipChainUtils::measureCoverage(const unsigned char* rgba, size_t pixelCount, float cutoff)
+{
+	size_t passed = 0;
+	for (size_t i = 0; i < pixelCount; i++)
+	{
+		if (rgba[i * 4 + 3] / 255.0f > cutoff) passed++;
+	}
+	return (float)passed / pixelCount;
+}
+
+void MipChainUtils::runBenchmark(const std::string& assetDirectory)
+{
+	std::vector<std::string> filePaths = BenchUtils::findImages(assetDirectory);
+
+	MipSettings box = { TextureMipFilter::BOX, false, false, true, true, 0.0f };
+	MipSettings kaiser = { TextureMipFilter::KAISER, false, false, true, true, 0.0f };
+	MipSettings kaiserSrgb = { TextureMipFilter::KAISER, true, false, true, true, 0.0f };
+
+	BenchUtils::printTitle("Mip chain benchmark, %s",
+#ifdef MIP_CHAIN_SSE2
+		"SSE2"
+#else
+		"scalar"
+#endif
+	);
+	printf("%-48s %11s %10s %10s %14s\n", "File", "Size", "Box ms", "Kaiser ms", "Kaiser sRGB ms");
+
+	std::vector<std::string> alphaPaths;
+	double totals[3] = {};
+	size_t totalPixels = 0;
+
+	for (const std::string& path : filePaths)
+	{
+		int width, height, channels;
+		unsigned char* rgba = stbi_load(path.c_str(), &width, &height, &channels, 4);
+		if (!rgba) continue;
+
+		size_t pixelCount = (size_t)width * height;
+		if (MipChainUtils::measureCoverage(rgba, pixelCount, 254.5f / 255.0f) < 1.0f) alphaPaths.push_back(path);
+
+		double ms[3];
+		const MipSettings* settings[3] = { &box, &kaiser, &kaiserSrgb };
+		for (int i = 0; i < 3; i++)
+		{
+			MipmappedImage chain;
+			auto start = std::chrono::steady_clock::now();
+			generate(rgba, width, height, *settings[i], chain);
+			ms[i] = BenchUtils::getElapsedMs(start);
+			totals[i] += ms[i];
+		}
+		totalPixels += pixelCount;
+		stbi_image_free(rgba);
+
+		char size[32];
+		snprintf(size, sizeof(size), "%dx%d", width, height);
+		printf("%-48s %11s %10.1f %10.1f %14.1f\n", BenchUtils::getRelativePath(path, assetDirectory).c_str(), size, ms[0], ms[1], ms[2]);
+	}
+
+	if (totalPixels > 0)
+	{
+		printf("%-48s %11s %10.1f %10.1f %14.1f\n", "Total", "", totals[0], totals[1], totals[2]);
+		printf("%-48s %11s %10.1f %10.1f %14.1f\n", "MPixel/s", "", totalPixels / (totals[0] * 1000.0),
+			totalPixels / (totals[1] * 1000.0), totalPixels / (totals[2] * 1000.0));
+	}
+
+	// What fraction passes an alpha test at each level, as filtered and with coverage kept
+	static const float CUTOFFS[2] = { 0.5f, 0.9f };
+	static const size_t COVERAGE_LEVELS = 8;
+
+	BenchUtils::printTitle("Alpha tested coverage per level, %% of texels");
+	printf("%-48s %6s %5s", "File", "Cutoff", "");
+	for (size_t level = 0; level < COVERAGE_LEVELS; level++) printf(" %6zu", level);
+	printf("\n");
+
+	for (const std::string& path : alphaPaths)
+	{
+		int width, height, channels;
+		unsigned char* rgba = stbi_load(path.c_str(), &width, &height, &channels, 4);
+		if (!rgba) continue;
+
+		for (float cutoff : CUTOFFS)
+		{
+			for (int keep = 0; keep < 2; keep++)
+			{
+				MipSettings settings = kaiser;
+				settings.alphaCoverage = keep ? cutoff : 0.0f;
+
+				MipmappedImage chain;
+				generate(rgba, width, height, settings, chain);
+
+				printf("%-48s %6.2f %5s", BenchUtils::getRelativePath(path, assetDirectory).c_str(), cutoff, keep ? "kept" : "");
+				for (size_t level = 0; level < std::min(COVERAGE_LEVELS, chain.getLevelCount()); level++)
+				{
+					size_t levelPixels = (size_t)std::max(1, width >> level) * std::max(1, height >> level);
+					printf(" %6.1f", 100.0f * measureCoverage(&chain.data[chain.levelOffsets[level]], levelPixels, cutoff));
+				}
+				printf("\n");
+			}
+		}
+		stbi_image_free(rgba);
+	}
+}
\ No newline at end of file
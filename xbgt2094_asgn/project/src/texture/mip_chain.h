@@ -0,0 +1,39 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "texture2d.h"
+
+// Everything besides the pixels that decides what the mip levels of an image look like
+struct MipSettings
+{
+	TextureMipFilter filter;
+	bool srgb;				// filter in linear space and encode the result back to sRGB
+	bool normals;			// xyz stored as 0.5 * n + 0.5, renormalised at every level
+	bool wrapX, wrapY;		// filter across the edge as GL_REPEAT samples it, else clamp
+	float alphaCoverage;	// see TextureConfig::alphaCoverage
+};
+
+// CPU mip chain generation, so uploads need no glGenerateMipmap and the chain can be cached with the texture.
+// Levels are filtered in float with SSE2 where available, each from the one before it.
+class MipChainUtils
+{
+public:
+	static MipSettings getSettings(const TextureConfig& cfg);
+
+	// rgba is width * height RGBA8 pixels. chain gets it as the first level, then every level down to 1x1.
+	static void generate(const unsigned char* rgba, int width, int height, const MipSettings& settings, MipmappedImage& chain);
+
+	// Scales width x height RGBA8 pixels to any other size with the Kaiser filter, in linear space when srgb
+	static void resample(const unsigned char* rgba, int width, int height, int resultWidth, int resultHeight,
+		const MipSettings& settings, std::vector<unsigned char>& result);
+
+	// Only the first level, for textures without mipmaps
+	static void createBaseLevel(const unsigned char* rgba, int width, int height, MipmappedImage& image);
+
+	// Fraction of pixels of one RGBA8 level that pass an alpha test against cutoff
+	static float measureCoverage(const unsigned char* rgba, size_t pixelCount, float cutoff);
+
+	// Times the box and Kaiser filters, in gamma and linear space, on every texture under assetDirectory, and
+	// prints how alpha tested coverage holds up down the chain with and without preserving it
+	static void runBenchmark(const std::string& assetDirectory);
+};
\ No newline at end of file
@@ -1,6 +1,54 @@
 #include "texture2d.h"
+#include "texture_compressor.h"
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <iostream>
 
+typedef void (APIENTRYP TexStorage2DProc)(GLenum target, GLsizei levels, GLenum internalFormat, GLsizei width, GLsizei height);
+
+// Core since 4.2 and in ARB_texture_storage on 3.3 drivers. glad here only loads 3.3, so it is looked up once.
+static TexStorage2DProc getTexStorage2D()
+{
+	static TexStorage2DProc texStorage2D = []() -> TexStorage2DProc
+	{
+		GLint major = 0, minor = 0;
+		glGetIntegerv(GL_MAJOR_VERSION, &major);
+		glGetIntegerv(GL_MINOR_VERSION, &minor);
+
+		bool core = major > 4 || (major == 4 && minor >= 2);
+		if (!core && !glfwExtensionSupported("GL_ARB_texture_storage")) return nullptr;
+		return (TexStorage2DProc)glfwGetProcAddress("glTexStorage2D");
+	}();
+	return texStorage2D;
+}
+
+// Every upload goes through this one unpack buffer. It is orphaned each time, so the copy into it never waits
+// for the driver to finish with the last upload.
+static GLuint getUploadBuffer()
+{
+	static GLuint buffer = 0;
+	if (buffer == 0) glGenBuffers(1, &buffer);
+	return buffer;
+}
+
+// Copies one level as GL wants it, bottom row first, unless the image keeps its rows as stored
+static void stageLevel(const MipmappedImageView& image, size_t level, unsigned char* staging)
+{
+	const unsigned char* source = image.data + image.levelOffsets[level];
+	if (!image.topDown || image.keepTopDown)
+	{
+		std::memcpy(staging, source, image.levelSizes[level]);
+		return;
+	}
+
+	int width = std::max(1, image.width >> level);
+	int height = std::max(1, image.height >> level);
+	TextureCompressorUtils::copyLevelFlipped(image.format, width, height, source, staging);
+}
+
 static void getTextureConfig(unsigned int handle, TextureConfig* cfg, int* width, int* height)
 {
 	GLint minFilter;
@@ -23,8 +71,8 @@ static void getTextureConfig(unsigned int handle, TextureConfig* cfg, int* width
 	cfg->mipmap = minFilter != GL_LINEAR && minFilter != GL_NEAREST;
 }
 
-Texture2D::Texture2D(int width, int height, TextureConfig cfg) : width(width), height(height), cfg(cfg) {}
-Texture2D::Texture2D(int width, int height) : width(width), height(height) {}
+Texture2D::Texture2D(int width, int height, TextureConfig cfg) : width(width), height(height), cfg(cfg), immutable(false), topDown(false), baseLevel(0), levelCount(1) {}
+Texture2D::Texture2D(int width, int height) : width(width), height(height), immutable(false), topDown(false), baseLevel(0), levelCount(1) {}
 
 Texture2D::~Texture2D()
 {
@@ -36,6 +84,16 @@ bool Texture2D::hasMipMap()
 	return mipmap;
 }
 
+bool Texture2D::hasImmutableStorage()
+{
+	return immutable;
+}
+
+bool Texture2D::isTopDown()
+{
+	return topDown;
+}
+
 GLint Texture2D::getWrapModeHorizontal()
 {
 	return cfg.hWrap;
@@ -102,6 +160,173 @@ Texture2D* Texture2D::createColourTexture(int width, int height, TextureConfig c
 	return tex;
 }
 
+// Uploads levels [first, last) of image into the bound texture. Every level is staged in the unpack buffer with
+// one copy, and the driver transfers from there. internalFormat is the sRGB variant where the texture is sRGB.
+static void uploadLevelRange(const MipmappedImageView& image, size_t first, size_t last, GLenum internalFormat, bool immutable)
+{
+	bool compressed = image.format != GL_RGBA8;
+
+	std::vector<size_t> stagedOffsets(last);
+	size_t stagedSize = 0;
+	for (size_t level = first; level < last; level++)
+	{
+		stagedOffsets[level] = stagedSize;
+		stagedSize += image.levelSizes[level];
+	}
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, getUploadBuffer());
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, (GLsizeiptr)stagedSize, nullptr, GL_STREAM_DRAW);
+	unsigned char* staging = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, (GLsizeiptr)stagedSize,
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+
+	if (staging)
+	{
+		for (size_t level = first; level < last; level++)
+		{
+			stageLevel(image, level, staging + stagedOffsets[level]);
+		}
+
+		// The contents can be lost, on a display mode change for one
+		if (!glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER)) staging = nullptr;
+	}
+
+	// Without the buffer, the same staging happens in client memory
+	std::vector<unsigned char> fallback;
+	uintptr_t base = 0;
+	if (!staging)
+	{
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		fallback.resize(stagedSize);
+		for (size_t level = first; level < last; level++)
+		{
+			stageLevel(image, level, fallback.data() + stagedOffsets[level]);
+		}
+		base = reinterpret_cast<uintptr_t>(fallback.data());
+	}
+
+	for (size_t level = first; level < last; level++)
+	{
+		int width = std::max(1, image.width >> level);
+		int height = std::max(1, image.height >> level);
+		GLsizei size = (GLsizei)image.levelSizes[level];
+		const void* pixels = reinterpret_cast<const void*>(base + stagedOffsets[level]);	// an offset into the bound buffer
+
+		if (immutable && compressed)
+		{
+			glCompressedTexSubImage2D(GL_TEXTURE_2D, (GLint)level, 0, 0, width, height, internalFormat, size, pixels);
+		}
+		else if (immutable)
+		{
+			glTexSubImage2D(GL_TEXTURE_2D, (GLint)level, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+		}
+		else if (compressed)
+		{
+			glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)level, internalFormat, width, height, 0, size, pixels);
+		}
+		else
+		{
+			glTexImage2D(GL_TEXTURE_2D, (GLint)level, internalFormat, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+		}
+	}
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+Texture2D* Texture2D::createMipmappedTexture(const MipmappedImageView& image, TextureConfig cfg, size_t firstLevel, bool resizable)
+{
+	size_t levelCount = cfg.mipmap ? image.getLevelCount() : std::min<size_t>(1, image.getLevelCount());
+	if (levelCount == 0) return nullptr;
+	firstLevel = std::min(firstLevel, levelCount - 1);
+
+	// Block data is the same for linear and sRGB; only the format tells the sampler how to decode it
+	bool srgb = cfg.internalFormat == GL_SRGB_ALPHA || cfg.internalFormat == GL_SRGB8_ALPHA8;
+	bool compressed = image.format != GL_RGBA8;
+	if (compressed)
+	{
+		cfg.internalFormat = srgb ? TextureCompressorUtils::getSrgbFormat(image.format) : image.format;
+	}
+
+	Texture2D* tex = new Texture2D(image.width, image.height, cfg);
+	tex->levelCount = levelCount;
+	tex->baseLevel = firstLevel;
+	tex->topDown = image.topDown && image.keepTopDown;
+
+	glGenTextures(1, &(tex->handle));
+	glBindTexture(GL_TEXTURE_2D, (tex->handle));
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, cfg.hWrap);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, cfg.vWrap);
+
+	int minFilter = cfg.textureFilter == GL_NEAREST ? GL_NEAREST : GL_LINEAR;
+	if (cfg.mipmap) minFilter = GL_LINEAR_MIPMAP_LINEAR;
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, minFilter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, cfg.textureFilter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, (GLint)firstLevel);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)levelCount - 1);
+
+	// Textures that start without their top levels stay mutable, so levels can be added and dropped later
+	TexStorage2DProc texStorage2D = firstLevel == 0 && !resizable ? getTexStorage2D() : nullptr;
+	if (texStorage2D)
+	{
+		GLenum storageFormat = compressed ? cfg.internalFormat : srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+		texStorage2D(GL_TEXTURE_2D, (GLsizei)levelCount, storageFormat, image.width, image.height);
+		tex->immutable = true;
+	}
+
+	uploadLevelRange(image, firstLevel, levelCount, cfg.internalFormat, tex->immutable);
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+	return tex;
+}
+
+void Texture2D::uploadLevels(const MipmappedImageView& image, size_t first, size_t last)
+{
+	last = std::min(last, levelCount);
+	if (first >= last) return;
+
+	glBindTexture(GL_TEXTURE_2D, handle);
+	uploadLevelRange(image, first, last, cfg.internalFormat, immutable);
+
+	if (first < baseLevel)
+	{
+		baseLevel = first;
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, (GLint)baseLevel);
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void Texture2D::dropLevels(size_t newBase)
+{
+	newBase = std::min(newBase, levelCount - 1);
+	if (immutable || newBase <= baseLevel) return;
+
+	glBindTexture(GL_TEXTURE_2D, handle);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, (GLint)newBase);
+
+	// Respecified as empty, the driver can free them
+	GLint format = cfg.internalFormat;
+	bool compressed = format != GL_RGBA && format != GL_SRGB_ALPHA && format != GL_RGBA8 && format != GL_SRGB8_ALPHA8;
+	for (size_t level = baseLevel; level < newBase; level++)
+	{
+		if (compressed) glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)level, cfg.internalFormat, 0, 0, 0, 0, nullptr);
+		else glTexImage2D(GL_TEXTURE_2D, (GLint)level, cfg.internalFormat, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	}
+
+	baseLevel = newBase;
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+size_t Texture2D::getBaseLevel()
+{
+	return baseLevel;
+}
+
+size_t Texture2D::getLevelCount()
+{
+	return levelCount;
+}
+
 Texture2D* Texture2D::createDepthTexture(int width, int height, GLint bits, bool hasBorder)
 {
 	GLint wrapMode = (hasBorder ? GL_CLAMP_TO_BORDER : GL_CLAMP_TO_EDGE);
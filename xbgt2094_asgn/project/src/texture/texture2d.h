@@ -1,5 +1,7 @@
 #pragma once
 #include <glad/glad.h>
+#include <cstddef>
+#include <vector>
 
 enum class TextureWrapMode
 {
@@ -14,6 +16,22 @@ enum class TextureFilterMode
 	LINEAR
 };
 
+// Block compression a loaded texture is cooked to, chosen by what the shader reads from it
+enum class TextureCompression
+{
+	NONE,		// uploaded as RGBA8
+	COLOUR,		// BC1, or BC3 when any pixel is not opaque
+	SINGLE,		// BC4 of the red channel, for maps sampled as .r (specular, AO, emissive)
+	NORMAL		// BC5 of red and green; the shader rebuilds z
+};
+
+// How mip levels are filtered when they are built on the CPU
+enum class TextureMipFilter
+{
+	BOX,		// 2x2 average, as glGenerateMipmap does
+	KAISER		// Kaiser windowed sinc, two smaller level pixels either side; sharper than a box without aliasing
+};
+
 // This struct is to provide means to control texture settings when loading texture
 struct TextureConfig
 {
@@ -25,10 +43,15 @@ struct TextureConfig
 	bool mipmap;
 	bool isDepth;
 
+	TextureCompression compression;
+	TextureMipFilter mipFilter;
+	float alphaCoverage;	// alpha test cutoff whose coverage every mip level keeps; 0 leaves alpha as filtered
+
 	TextureConfig()
-		: hWrap(GL_REPEAT), vWrap(GL_REPEAT), textureFilter(GL_LINEAR), mipmap(false), isDepth(false) {}
+		: hWrap(GL_REPEAT), vWrap(GL_REPEAT), textureFilter(GL_LINEAR), mipmap(false), isDepth(false), compression(TextureCompression::NONE),
+		mipFilter(TextureMipFilter::KAISER), alphaCoverage(0.0f) {}
 	TextureConfig(TextureWrapMode wrapHorizontal, TextureWrapMode wrapVertical, TextureFilterMode filter, bool enableMipmap)
-		: mipmap(enableMipmap), isDepth(false)
+		: mipmap(enableMipmap), isDepth(false), compression(TextureCompression::NONE), mipFilter(TextureMipFilter::KAISER), alphaCoverage(0.0f)
 	{
 		switch (wrapHorizontal)
 		{
@@ -52,6 +75,43 @@ struct TextureConfig
 	}
 };
 
+// Levels of an image in memory owned by someone else, such as a mapped file. They need not be in order or
+// back to back: KTX2 stores the smallest first.
+struct MipmappedImageView
+{
+	GLenum format;						// GL_RGBA8, or GL_COMPRESSED_* of the linear variant
+	int width, height;
+	bool topDown;						// rows stored top first, as DDS and KTX2 usually are; flipped on upload
+	bool keepTopDown;					// unless a block level cannot be flipped whole: then all go up as stored
+	const unsigned char* data;
+	std::vector<size_t> levelOffsets;	// start of each level in data, largest level first
+	std::vector<size_t> levelSizes;
+
+	size_t getLevelCount() const { return levelOffsets.size(); }
+};
+
+// Pixels of an image and its mip chain in one buffer, as RGBA8 or block compressed
+struct MipmappedImage
+{
+	GLenum format;						// GL_RGBA8, or GL_COMPRESSED_* of the linear variant
+	int width, height;
+	std::vector<unsigned char> data;	// every level, largest first
+	std::vector<size_t> levelOffsets;	// start of each level in data, plus data.size() at the end
+
+	size_t getLevelCount() const { return levelOffsets.empty() ? 0 : levelOffsets.size() - 1; }
+
+	MipmappedImageView getView() const
+	{
+		MipmappedImageView view = { format, width, height, false, false, data.data(), {}, {} };
+		for (size_t level = 0; level < getLevelCount(); level++)
+		{
+			view.levelOffsets.push_back(levelOffsets[level]);
+			view.levelSizes.push_back(levelOffsets[level + 1] - levelOffsets[level]);
+		}
+		return view;
+	}
+};
+
 class Texture2D
 {
 private:
@@ -60,6 +120,10 @@ private:
 	bool mipmap;
 	int width, height;
 	unsigned int handle;
+	bool immutable;
+	bool topDown;			// uploaded with its rows top first
+	size_t baseLevel;		// finest level uploaded and sampled
+	size_t levelCount;
 
 	Texture2D(int width, int height, TextureConfig cfg);
 	Texture2D(int width, int height);
@@ -68,6 +132,12 @@ public:
 	~Texture2D();
 
 	bool hasMipMap();
+	// Allocated with glTexStorage2D: its size, format and level count can no longer change
+	bool hasImmutableStorage();
+	// Its rows are stored top first, so it is upright when sampled at 1 - v
+	bool isTopDown();
+	size_t getBaseLevel();
+	size_t getLevelCount();
 	GLint getWrapModeHorizontal();
 	GLint getWrapModeVertical();
 	GLint getTextureFilter();
@@ -77,6 +147,16 @@ public:
 	unsigned int getNativeHandle();
 
 	static Texture2D* createColourTexture(int width, int height, TextureConfig cfg, GLenum format, unsigned char* data);
+	// Uploads every level of image when cfg.mipmap is set, else only the first; sRGB when cfg.internalFormat is.
+	// No glGenerateMipmap: the levels are already built. The levels are copied once, into a pixel buffer the
+	// driver transfers from, and go into immutable storage where the driver has glTexStorage2D.
+	// With firstLevel above 0 only the levels from there down are uploaded, and sampled, for streaming the rest
+	// in later with uploadLevels. Those textures, and resizable ones, never get immutable storage.
+	static Texture2D* createMipmappedTexture(const MipmappedImageView& image, TextureConfig cfg, size_t firstLevel = 0, bool resizable = false);
+	// Uploads levels [first, last) of the image the texture was created from, and samples from first if finer
+	void uploadLevels(const MipmappedImageView& image, size_t first, size_t last);
+	// Frees the levels above newBase and samples from there. Does nothing to immutable storage.
+	void dropLevels(size_t newBase);
 	static Texture2D* createDepthTexture(int width, int height, GLint bits, bool hasBorder);
 	static Texture2D* createFromNativeHandle(unsigned int handle);
 
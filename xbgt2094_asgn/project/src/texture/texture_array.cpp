@@ -0,0 +1,99 @@
+#include "texture_array.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include "texture_compressor.h"
+
+TextureArray::TextureArray(int width, int height, unsigned int layerCount, TextureConfig cfg) :
+	cfg(cfg), width(width), height(height), layerCount(layerCount), handle(0) {}
+
+TextureArray::~TextureArray()
+{
+	glDeleteTextures(1, &handle);
+}
+
+void TextureArray::getSize(int* w, int* h)
+{
+	*w = width;
+	*h = height;
+}
+
+unsigned int TextureArray::getLayerCount()
+{
+	return layerCount;
+}
+
+GLint TextureArray::getInternalFormat()
+{
+	return cfg.internalFormat;
+}
+
+unsigned int TextureArray::getNativeHandle()
+{
+	return handle;
+}
+
+TextureArray* TextureArray::create(const std::vector<MipmappedImage>& layers, TextureConfig cfg)
+{
+	if (layers.empty()) return nullptr;
+
+	const MipmappedImage& first = layers[0];
+	for (const MipmappedImage& layer : layers)
+	{
+		if (layer.format != first.format || layer.width != first.width || layer.height != first.height || layer.getLevelCount() != first.getLevelCount())
+		{
+			std::cout << "Texture array layers differ in format, size or levels" << std::endl;
+			return nullptr;
+		}
+	}
+
+	bool srgb = cfg.internalFormat == GL_SRGB_ALPHA || cfg.internalFormat == GL_SRGB8_ALPHA8;
+	bool compressed = first.format != GL_RGBA8;
+	if (compressed)
+	{
+		cfg.internalFormat = srgb ? TextureCompressorUtils::getSrgbFormat(first.format) : first.format;
+	}
+
+	TextureArray* tex = new TextureArray(first.width, first.height, (unsigned int)layers.size(), cfg);
+	size_t levelCount = cfg.mipmap ? first.getLevelCount() : 1;
+
+	glGenTextures(1, &(tex->handle));
+	glBindTexture(GL_TEXTURE_2D_ARRAY, tex->handle);
+
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, cfg.hWrap);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, cfg.vWrap);
+
+	int minFilter = cfg.textureFilter == GL_NEAREST ? GL_NEAREST : GL_LINEAR;
+	if (cfg.mipmap) minFilter = GL_LINEAR_MIPMAP_LINEAR;
+
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, minFilter);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, cfg.textureFilter);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, (GLint)levelCount - 1);
+
+	// Each level of the array holds that level of every layer, one after another
+	std::vector<unsigned char> level;
+	for (size_t i = 0; i < levelCount; i++)
+	{
+		size_t layerSize = first.levelOffsets[i + 1] - first.levelOffsets[i];
+		level.resize(layerSize * layers.size());
+		for (size_t l = 0; l < layers.size(); l++)
+		{
+			std::memcpy(&level[l * layerSize], &layers[l].data[layers[l].levelOffsets[i]], layerSize);
+		}
+
+		int levelWidth = std::max(1, first.width >> i), levelHeight = std::max(1, first.height >> i);
+		if (compressed)
+		{
+			glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, (GLint)i, cfg.internalFormat, levelWidth, levelHeight, (GLsizei)layers.size(), 0,
+				(GLsizei)level.size(), level.data());
+		}
+		else
+		{
+			glTexImage3D(GL_TEXTURE_2D_ARRAY, (GLint)i, cfg.internalFormat, levelWidth, levelHeight, (GLsizei)layers.size(), 0,
+				GL_RGBA, GL_UNSIGNED_BYTE, level.data());
+		}
+	}
+
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	return tex;
+}
\ No newline at end of file
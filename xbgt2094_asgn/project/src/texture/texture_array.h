@@ -0,0 +1,30 @@
+#pragma once
+#include <glad/glad.h>
+#include <vector>
+#include "texture2d.h"
+
+// A GL_TEXTURE_2D_ARRAY: maps of the same size and format as the layers of one texture, so everything drawn
+// with them shares one binding and picks its map by layer index
+class TextureArray
+{
+private:
+
+	TextureConfig cfg;
+	int width, height;
+	unsigned int layerCount;
+	unsigned int handle;
+
+	TextureArray(int width, int height, unsigned int layerCount, TextureConfig cfg);
+
+public:
+	~TextureArray();
+
+	void getSize(int* w, int* h);
+	unsigned int getLayerCount();
+	GLint getInternalFormat();
+	unsigned int getNativeHandle();
+
+	// Every layer must have the same format, size and level count. Uploads every level when cfg.mipmap is set,
+	// else only the first; sRGB when cfg.internalFormat is. Null, saying why, when the layers do not match.
+	static TextureArray* create(const std::vector<MipmappedImage>& layers, TextureConfig cfg);
+};
\ No newline at end of file
@@ -0,0 +1,924 @@
+#include "texture_compressor.h"
+#include <algorithm>
+#include <cctype>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <thread>
+#include <stb_image/stb_image.h>
+#include "../framework/bench_utils.h"
+#include "../framework/file_utils.h"
+#include "../framework/job_utils.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TEXTURE_COMPRESSOR_SSE2
+#include <emmintrin.h>
+#endif
+
+// Bump whenever the encoder or mip generation changes what gets cached.
+static const uint32_t TEXTURE_BINARY_VERSION = 2;
+static const char TEXTURE_BINARY_MAGIC[4] = { 'T', 'E', 'X', 'B' };
+
+enum TextureBinaryMipFlags : uint16_t
+{
+	MIP_SRGB = 1 << 0,
+	MIP_NORMALS = 1 << 1,
+	MIP_WRAP_X = 1 << 2,
+	MIP_WRAP_Y = 1 << 3,
+};
+
+// File layout: header, (levelCount + 1) * uint64_t level offsets into the data, data
+struct TextureBinaryHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t compression;
+	uint32_t format;
+	uint32_t width;
+	uint32_t height;
+	uint32_t levelCount;
+	uint16_t mipFilter;
+	uint16_t mipFlags;
+	float alphaCoverage;
+	uint32_t reserved;
+	uint64_t sourceSize;
+	uint64_t sourceHash;
+};
+
+static size_t getBlockBytes(GLenum format)
+{
+	return format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT || format == GL_COMPRESSED_RGBA_S3TC_DXT1_EXT || format == GL_COMPRESSED_RED_RGTC1 ? 8 : 16;
+}
+
+#pragma region Palette Search
+
+// Index of the nearest of paletteSize values for each of 16 values; ties go to the lower index
+static void selectNearest(const unsigned char values[16], const unsigned char* palette, int paletteSize, unsigned char indices[16])
+{
+#ifdef TEXTURE_COMPRESSOR_SSE2
+	// All 16 pixels at once: |v - p| from two saturating subtractions, strictly-closer mask from unsigned min
+	const __m128i allSet = _mm_set1_epi8((char)0xff);
+	__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values));
+	__m128i best = allSet;
+	__m128i bestIndex = _mm_setzero_si128();
+
+	for (int k = 0; k < paletteSize; k++)
+	{
+		__m128i p = _mm_set1_epi8((char)palette[k]);
+		__m128i distance = _mm_or_si128(_mm_subs_epu8(v, p), _mm_subs_epu8(p, v));
+		__m128i closer = _mm_andnot_si128(_mm_cmpeq_epi8(_mm_min_epu8(distance, best), best), allSet);
+
+		best = _mm_min_epu8(distance, best);
+		bestIndex = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi8((char)k)), _mm_andnot_si128(closer, bestIndex));
+	}
+
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(indices), bestIndex);
+#else
+	for (int i = 0; i < 16; i++)
+	{
+		int best = 256;
+		for (int k = 0; k < paletteSize; k++)
+		{
+			int distance = std::abs((int)values[i] - (int)palette[k]);
+			if (distance < best)
+			{
+				best = distance;
+				indices[i] = (unsigned char)k;
+			}
+		}
+	}
+#endif
+}
+
+// Nearest of 4 RGB palette colours for 16 pixels stored as separate r, g and b rows. Returns the squared error.
+static float selectNearestColour(const float pixels[3][16], const float palette[4][3], unsigned char indices[16])
+{
+#ifdef TEXTURE_COMPRESSOR_SSE2
+	__m128 total = _mm_setzero_ps();
+
+	for (int i = 0; i < 16; i += 4)
+	{
+		__m128 r = _mm_loadu_ps(pixels[0] + i);
+		__m128 g = _mm_loadu_ps(pixels[1] + i);
+		__m128 b = _mm_loadu_ps(pixels[2] + i);
+
+		__m128 best = _mm_set1_ps(FLT_MAX);
+		__m128i bestIndex = _mm_setzero_si128();
+
+		for (int k = 0; k < 4; k++)
+		{
+			__m128 dr = _mm_sub_ps(r, _mm_set1_ps(palette[k][0]));
+			__m128 dg = _mm_sub_ps(g, _mm_set1_ps(palette[k][1]));
+			__m128 db = _mm_sub_ps(b, _mm_set1_ps(palette[k][2]));
+			__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dr, dr), _mm_mul_ps(dg, dg)), _mm_mul_ps(db, db));
+
+			__m128i closer = _mm_castps_si128(_mm_cmplt_ps(distance, best));
+			best = _mm_min_ps(distance, best);
+			bestIndex = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(k)), _mm_andnot_si128(closer, bestIndex));
+		}
+
+		total = _mm_add_ps(total, best);
+
+		alignas(16) int lanes[4];
+		_mm_store_si128(reinterpret_cast<__m128i*>(lanes), bestIndex);
+		for (int lane = 0; lane < 4; lane++) indices[i + lane] = (unsigned char)lanes[lane];
+	}
+
+	alignas(16) float sums[4];
+	_mm_store_ps(sums, total);
+	return (sums[0] + sums[1]) + (sums[2] + sums[3]);
+#else
+	float total = 0.0f;
+	for (int i = 0; i < 16; i++)
+	{
+		float best = FLT_MAX;
+		for (int k = 0; k < 4; k++)
+		{
+			float dr = pixels[0][i] - palette[k][0];
+			float dg = pixels[1][i] - palette[k][1];
+			float db = pixels[2][i] - palette[k][2];
+			float distance = dr * dr + dg * dg + db * db;
+			if (distance < best)
+			{
+				best = distance;
+				indices[i] = (unsigned char)k;
+			}
+		}
+		total += best;
+	}
+	return total;
+#endif
+}
+
+#pragma endregion
+
+#pragma region Block Encoding
+
+// 4x4 block at (blockX, blockY), repeating edge pixels past the image
+static void loadBlock(const unsigned char* rgba, int width, int height, int blockX, int blockY, unsigned char block[64])
+{
+	for (int y = 0; y < 4; y++)
+	{
+		int sourceY = std::min(blockY * 4 + y, height - 1);
+		for (int x = 0; x < 4; x++)
+		{
+			int sourceX = std::min(blockX * 4 + x, width - 1);
+			std::memcpy(block + (y * 4 + x) * 4, rgba + ((size_t)sourceY * width + sourceX) * 4, 4);
+		}
+	}
+}
+
+// BC4 interpolated values for a0 > a1, in index order
+static void makeBc4Palette(int a0, int a1, unsigned char palette[8])
+{
+	palette[0] = (unsigned char)a0;
+	palette[1] = (unsigned char)a1;
+	for (int k = 2; k < 8; k++)
+	{
+		palette[k] = (unsigned char)(((8 - k) * a0 + (k - 1) * a1 + 3) / 7);
+	}
+}
+
+// One channel of the block into 8 bytes: two endpoints, then sixteen 3-bit indices
+static void encodeBc4(const unsigned char block[64], int channel, unsigned char out[8])
+{
+	unsigned char values[16];
+	int minValue = 255, maxValue = 0;
+	for (int i = 0; i < 16; i++)
+	{
+		values[i] = block[i * 4 + channel];
+		minValue = std::min(minValue, (int)values[i]);
+		maxValue = std::max(maxValue, (int)values[i]);
+	}
+
+	out[0] = (unsigned char)maxValue;
+	out[1] = (unsigned char)minValue;
+
+	if (maxValue == minValue)
+	{
+		std::memset(out + 2, 0, 6);
+		return;
+	}
+
+	unsigned char palette[8], indices[16];
+	makeBc4Palette(maxValue, minValue, palette);
+	selectNearest(values, palette, 8, indices);
+
+	uint64_t bits = 0;
+	for (int i = 0; i < 16; i++)
+	{
+		bits |= (uint64_t)indices[i] << (3 * i);
+	}
+	for (int i = 0; i < 6; i++)
+	{
+		out[2 + i] = (unsigned char)(bits >> (8 * i));
+	}
+}
+
+static uint16_t packRgb565(const float colour[3])
+{
+	int r = (int)std::lround(std::min(std::max(colour[0], 0.0f), 255.0f) * 31.0f / 255.0f);
+	int g = (int)std::lround(std::min(std::max(colour[1], 0.0f), 255.0f) * 63.0f / 255.0f);
+	int b = (int)std::lround(std::min(std::max(colour[2], 0.0f), 255.0f) * 31.0f / 255.0f);
+	return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+static void unpackRgb565(uint16_t packed, int colour[3])
+{
+	int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+	colour[0] = (r << 3) | (r >> 2);
+	colour[1] = (g << 2) | (g >> 4);
+	colour[2] = (b << 3) | (b >> 2);
+}
+
+// Palette of a BC1 block as the sampler decodes it; four colours when c0 > c1, else three and black
+static void makeBc1Palette(uint16_t c0, uint16_t c1, int palette[4][3])
+{
+	unpackRgb565(c0, palette[0]);
+	unpackRgb565(c1, palette[1]);
+	for (int c = 0; c < 3; c++)
+	{
+		if (c0 > c1)
+		{
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+		else
+		{
+			palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+			palette[3][c] = 0;
+		}
+	}
+}
+
+// Indices and error for two endpoints, put in the order that selects the four colour mode
+static float evaluateBc1(const float pixels[3][16], uint16_t& c0, uint16_t& c1, unsigned char indices[16])
+{
+	if (c0 < c1) std::swap(c0, c1);
+
+	int palette[4][3];
+	makeBc1Palette(c0, c1, palette);
+
+	// Equal endpoints are three colour mode; every pixel uses c0
+	float paletteF[4][3];
+	for (int k = 0; k < 4; k++)
+	{
+		const int* entry = c0 == c1 ? palette[0] : palette[k];
+		for (int c = 0; c < 3; c++) paletteF[k][c] = (float)entry[c];
+	}
+
+	return selectNearestColour(pixels, paletteF, indices);
+}
+
+// Endpoints along the principal axis of the block's colours, refined by least squares on the chosen indices
+static void encodeBc1(const unsigned char block[64], unsigned char out[8])
+{
+	float pixels[3][16];
+	float mean[3] = { 0.0f, 0.0f, 0.0f };
+	float minColour[3] = { 255.0f, 255.0f, 255.0f }, maxColour[3] = { 0.0f, 0.0f, 0.0f };
+
+	for (int i = 0; i < 16; i++)
+	{
+		for (int c = 0; c < 3; c++)
+		{
+			pixels[c][i] = block[i * 4 + c];
+			mean[c] += pixels[c][i];
+			minColour[c] = std::min(minColour[c], pixels[c][i]);
+			maxColour[c] = std::max(maxColour[c], pixels[c][i]);
+		}
+	}
+	for (int c = 0; c < 3; c++) mean[c] /= 16.0f;
+
+	float covariance[6] = {};	// rr, rg, rb, gg, gb, bb
+	for (int i = 0; i < 16; i++)
+	{
+		float r = pixels[0][i] - mean[0], g = pixels[1][i] - mean[1], b = pixels[2][i] - mean[2];
+		covariance[0] += r * r; covariance[1] += r * g; covariance[2] += r * b;
+		covariance[3] += g * g; covariance[4] += g * b; covariance[5] += b * b;
+	}
+
+	// Power iteration from the box diagonal
+	float axis[3] = { maxColour[0] - minColour[0], maxColour[1] - minColour[1], maxColour[2] - minColour[2] };
+	for (int iteration = 0; iteration < 8; iteration++)
+	{
+		float x = covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2];
+		float y = covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2];
+		float z = covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2];
+		float length = std::max(std::fabs(x), std::max(std::fabs(y), std::fabs(z)));
+		if (length < 1e-6f) break;
+
+		axis[0] = x / length; axis[1] = y / length; axis[2] = z / length;
+	}
+
+	float axisLength = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+	float minT = 0.0f, maxT = 0.0f;
+	if (axisLength > 1e-6f)
+	{
+		for (int c = 0; c < 3; c++) axis[c] /= axisLength;
+
+		minT = FLT_MAX; maxT = -FLT_MAX;
+		for (int i = 0; i < 16; i++)
+		{
+			float t = (pixels[0][i] - mean[0]) * axis[0] + (pixels[1][i] - mean[1]) * axis[1] + (pixels[2][i] - mean[2]) * axis[2];
+			minT = std::min(minT, t);
+			maxT = std::max(maxT, t);
+		}
+	}
+
+	float end0[3], end1[3];
+	for (int c = 0; c < 3; c++)
+	{
+		end0[c] = mean[c] + axis[c] * maxT;
+		end1[c] = mean[c] + axis[c] * minT;
+	}
+
+	uint16_t c0 = packRgb565(end0), c1 = packRgb565(end1);
+	unsigned char indices[16];
+	float error = evaluateBc1(pixels, c0, c1, indices);
+
+	// Each index is a fixed blend of c0 and c1, so the best endpoints for it are a 2x2 least squares solve
+	static const float WEIGHT0[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+	for (int iteration = 0; iteration < 2 && error > 0.0f && c0 != c1; iteration++)
+	{
+		float aa = 0.0f, bb = 0.0f, ab = 0.0f, ap[3] = {}, bp[3] = {};
+		for (int i = 0; i < 16; i++)
+		{
+			float a = WEIGHT0[indices[i]], b = 1.0f - a;
+			aa += a * a; bb += b * b; ab += a * b;
+			for (int c = 0; c < 3; c++)
+			{
+				ap[c] += a * pixels[c][i];
+				bp[c] += b * pixels[c][i];
+			}
+		}
+
+		float determinant = aa * bb - ab * ab;
+		if (std::fabs(determinant) < 1e-6f) break;
+
+		for (int c = 0; c < 3; c++)
+		{
+			end0[c] = (bb * ap[c] - ab * bp[c]) / determinant;
+			end1[c] = (aa * bp[c] - ab * ap[c]) / determinant;
+		}
+
+		uint16_t refined0 = packRgb565(end0), refined1 = packRgb565(end1);
+		unsigned char refinedIndices[16];
+		float refinedError = evaluateBc1(pixels, refined0, refined1, refinedIndices);
+		if (refinedError >= error) break;
+
+		c0 = refined0; c1 = refined1; error = refinedError;
+		std::memcpy(indices, refinedIndices, sizeof(indices));
+	}
+
+	uint32_t bits = 0;
+	for (int i = 0; i < 16; i++)
+	{
+		bits |= (uint32_t)(c0 == c1 ? 0 : indices[i]) << (2 * i);
+	}
+
+	out[0] = (unsigned char)c0; out[1] = (unsigned char)(c0 >> 8);
+	out[2] = (unsigned char)c1; out[3] = (unsigned char)(c1 >> 8);
+	for (int i = 0; i < 4; i++)
+	{
+		out[4 + i] = (unsigned char)(bits >> (8 * i));
+	}
+}
+
+static void encodeBlock(GLenum format, const unsigned char block[64], unsigned char* out)
+{
+	switch (format)
+	{
+	case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+		encodeBc1(block, out);
+		break;
+	case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+		encodeBc4(block, 3, out);
+		encodeBc1(block, out + 8);
+		break;
+	case GL_COMPRESSED_RED_RGTC1:
+		encodeBc4(block, 0, out);
+		break;
+	case GL_COMPRESSED_RG_RGTC2:
+		encodeBc4(block, 0, out);
+		encodeBc4(block, 1, out + 8);
+		break;
+	}
+}
+
+#pragma endregion
+
+#pragma region Block Decoding
+
+static void decodeBc4(const unsigned char* in, int channel, unsigned char block[64])
+{
+	int a0 = in[0], a1 = in[1];
+	unsigned char palette[8];
+
+	if (a0 > a1)
+	{
+		makeBc4Palette(a0, a1, palette);
+	}
+	else
+	{
+		palette[0] = (unsigned char)a0;
+		palette[1] = (unsigned char)a1;
+		for (int k = 2; k < 6; k++) palette[k] = (unsigned char)(((6 - k) * a0 + (k - 1) * a1 + 2) / 5);
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+
+	uint64_t bits = 0;
+	for (int i = 0; i < 6; i++) bits |= (uint64_t)in[2 + i] << (8 * i);
+	for (int i = 0; i < 16; i++) block[i * 4 + channel] = palette[(bits >> (3 * i)) & 7];
+}
+
+static void decodeBc1(const unsigned char* in, unsigned char block[64])
+{
+	uint16_t c0 = (uint16_t)(in[0] | (in[1] << 8));
+	uint16_t c1 = (uint16_t)(in[2] | (in[3] << 8));
+	int palette[4][3];
+	makeBc1Palette(c0, c1, palette);
+
+	uint32_t bits = (uint32_t)in[4] | ((uint32_t)in[5] << 8) | ((uint32_t)in[6] << 16) | ((uint32_t)in[7] << 24);
+	for (int i = 0; i < 16; i++)
+	{
+		const int* colour = palette[(bits >> (2 * i)) & 3];
+		for (int c = 0; c < 3; c++) block[i * 4 + c] = (unsigned char)colour[c];
+	}
+}
+
+// What the sampler returns: missing channels read as 0, missing alpha as 1
+static void decodeBlock(GLenum format, const unsigned char* in, unsigned char block[64])
+{
+	for (int i = 0; i < 16; i++)
+	{
+		block[i * 4 + 0] = 0; block[i * 4 + 1] = 0; block[i * 4 + 2] = 0; block[i * 4 + 3] = 255;
+	}
+
+	switch (format)
+	{
+	case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+		decodeBc1(in, block);
+		break;
+	case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+		decodeBc4(in, 3, block);
+		decodeBc1(in + 8, block);
+		break;
+	case GL_COMPRESSED_RED_RGTC1:
+		decodeBc4(in, 0, block);
+		break;
+	case GL_COMPRESSED_RG_RGTC2:
+		decodeBc4(in, 0, block);
+		decodeBc4(in + 8, 1, block);
+		break;
+	}
+}
+
+#pragma endregion
+
+GLenum TextureCompressorUtils::chooseFormat(const MipmappedImage& levels, TextureCompression compression)
+{
+	switch (compression)
+	{
+	case TextureCompression::SINGLE: return GL_COMPRESSED_RED_RGTC1;
+	case TextureCompression::NORMAL: return GL_COMPRESSED_RG_RGTC2;
+	default:
+		// BC1 has no usable alpha once the four colour mode is forced, so anything translucent goes to BC3
+		for (size_t i = 0; i < (size_t)levels.width * levels.height; i++)
+		{
+			if (levels.data[i * 4 + 3] != 255) return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+		}
+		return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	}
+}
+
+void TextureCompressorUtils::compress(const MipmappedImage& levels, TextureCompression compression, MipmappedImage& result,
+	TextureCompressionReport* report, unsigned int threadCount)
+{
+	compress(levels, chooseFormat(levels, compression), result, report, threadCount);
+}
+
+void TextureCompressorUtils::compress(const MipmappedImage& levels, GLenum format, MipmappedImage& result,
+	TextureCompressionReport* report, unsigned int threadCount)
+{
+	const unsigned char* rgba = levels.data.data();
+	int width = levels.width, height = levels.height;
+
+	auto start = std::chrono::steady_clock::now();
+	if (threadCount == 0) threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+	size_t blockBytes = getBlockBytes(format);
+	result.format = format;
+	result.width = width;
+	result.height = height;
+	result.data.clear();
+	result.levelOffsets.clear();
+
+	for (size_t i = 0; i < levels.getLevelCount(); i++)
+	{
+		const unsigned char* level = &levels.data[levels.levelOffsets[i]];
+		int levelWidth = std::max(1, width >> i), levelHeight = std::max(1, height >> i);
+		size_t blocksX = (levelWidth + 3) / 4, blocksY = (levelHeight + 3) / 4;
+		size_t offset = result.data.size();
+		result.levelOffsets.push_back(offset);
+		result.data.resize(offset + blocksX * blocksY * blockBytes);
+
+		// One row of blocks per job
+		JobUtils::run(blocksY, threadCount, [&](size_t blockY)
+		{
+			unsigned char block[64];
+			for (size_t blockX = 0; blockX < blocksX; blockX++)
+			{
+				loadBlock(level, levelWidth, levelHeight, (int)blockX, (int)blockY, block);
+				encodeBlock(format, block, &result.data[offset + (blockY * blocksX + blockX) * blockBytes]);
+			}
+		});
+	}
+
+	result.levelOffsets.push_back(result.data.size());
+
+	if (report)
+	{
+		report->encodeMs = BenchUtils::getElapsedMs(start);
+		report->psnr = measurePsnr(rgba, result);
+	}
+}
+
+void TextureCompressorUtils::decompress(const MipmappedImage& image, std::vector<unsigned char>& rgba)
+{
+	int width = image.width, height = image.height;
+	size_t blockBytes = getBlockBytes(image.format);
+	size_t blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+	rgba.assign((size_t)width * height * 4, 0);
+
+	unsigned char block[64];
+	for (size_t blockY = 0; blockY < blocksY; blockY++)
+	{
+		for (size_t blockX = 0; blockX < blocksX; blockX++)
+		{
+			decodeBlock(image.format, &image.data[(blockY * blocksX + blockX) * blockBytes], block);
+
+			for (size_t y = 0; y < 4 && blockY * 4 + y < (size_t)height; y++)
+			{
+				for (size_t x = 0; x < 4 && blockX * 4 + x < (size_t)width; x++)
+				{
+					std::memcpy(&rgba[((blockY * 4 + y) * width + blockX * 4 + x) * 4], block + (y * 4 + x) * 4, 4);
+				}
+			}
+		}
+	}
+}
+
+double TextureCompressorUtils::measurePsnr(const unsigned char* rgba, const MipmappedImage& image)
+{
+	std::vector<unsigned char> decoded;
+	decompress(image, decoded);
+
+	// Only the channels the format keeps; the others were never meant to survive
+	int channels = 3;
+	switch (image.format)
+	{
+	case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT: channels = 4; break;
+	case GL_COMPRESSED_RED_RGTC1: channels = 1; break;
+	case GL_COMPRESSED_RG_RGTC2: channels = 2; break;
+	}
+
+	double squaredError = 0.0;
+	size_t pixelCount = (size_t)image.width * image.height;
+	for (size_t i = 0; i < pixelCount; i++)
+	{
+		for (int c = 0; c < channels; c++)
+		{
+			double difference = (double)rgba[i * 4 + c] - decoded[i * 4 + c];
+			squaredError += difference * difference;
+		}
+	}
+
+	double meanSquaredError = squaredError / ((double)pixelCount * channels);
+	if (meanSquaredError == 0.0) return std::numeric_limits<double>::infinity();
+	return 10.0 * std::log10(255.0 * 255.0 / meanSquaredError);
+}
+
+GLenum TextureCompressorUtils::getSrgbFormat(GLenum format)
+{
+	switch (format)
+	{
+	case GL_COMPRESSED_RGB_S3TC_DXT1_EXT: return GL_COMPRESSED_SRGB_S3TC_DXT1_EXT;
+	case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT: return GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT;
+	case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT: return GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT;
+	default: return format;	// RGTC has no sRGB variant
+	}
+}
+
+const char* TextureCompressorUtils::getFormatName(GLenum format)
+{
+	switch (format)
+	{
+	case GL_COMPRESSED_RGB_S3TC_DXT1_EXT: return "BC1";
+	case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT: return "BC1A";
+	case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT: return "BC3";
+	case GL_COMPRESSED_RED_RGTC1: return "BC4";
+	case GL_COMPRESSED_RG_RGTC2: return "BC5";
+	default: return "RGBA8";
+	}
+}
+
+size_t TextureCompressorUtils::getLevelSize(GLenum format, int width, int height)
+{
+	if (format == GL_RGBA8) return (size_t)width * height * 4;
+	return (size_t)((width + 3) / 4) * ((height + 3) / 4) * getBlockBytes(format);
+}
+
+// Reverses the first rowCount rows of a BC4 block: 16 bits of endpoints, then 3 bit indices, 12 bits a row
+static void flipBc4Rows(const unsigned char* source, int rowCount, unsigned char* result)
+{
+	uint64_t indices = 0, flipped = 0;
+	for (int i = 0; i < 6; i++) indices |= (uint64_t)source[2 + i] << (8 * i);
+	for (int row = 0; row < 4; row++)
+	{
+		int from = row < rowCount ? rowCount - 1 - row : row;
+		flipped |= ((indices >> (12 * from)) & 0xfff) << (12 * row);
+	}
+
+	result[0] = source[0];
+	result[1] = source[1];
+	for (int i = 0; i < 6; i++) result[2 + i] = (unsigned char)(flipped >> (8 * i));
+}
+
+// Reverses the first rowCount rows of a BC1 block: 32 bits of endpoints, then one byte of indices a row
+static void flipBc1Rows(const unsigned char* source, int rowCount, unsigned char* result)
+{
+	std::memcpy(result, source, 4);
+	for (int row = 0; row < 4; row++)
+	{
+		result[4 + row] = source[4 + (row < rowCount ? rowCount - 1 - row : row)];
+	}
+}
+
+void TextureCompressorUtils::copyLevelFlipped(GLenum format, int width, int height, const unsigned char* source, unsigned char* result)
+{
+	if (format == GL_RGBA8)
+	{
+		size_t rowBytes = (size_t)width * 4;
+		for (int y = 0; y < height; y++)
+		{
+			std::memcpy(result + (size_t)y * rowBytes, source + (size_t)(height - 1 - y) * rowBytes, rowBytes);
+		}
+		return;
+	}
+
+	size_t blockBytes = getBlockBytes(format);
+	size_t blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+	int rowCount = std::min(height, 4);
+
+	for (size_t blockY = 0; blockY < blocksY; blockY++)
+	{
+		for (size_t blockX = 0; blockX < blocksX; blockX++)
+		{
+			const unsigned char* in = source + ((blocksY - 1 - blockY) * blocksX + blockX) * blockBytes;
+			unsigned char* out = result + (blockY * blocksX + blockX) * blockBytes;
+
+			switch (format)
+			{
+			case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+				flipBc4Rows(in, rowCount, out);
+				flipBc1Rows(in + 8, rowCount, out + 8);
+				break;
+			case GL_COMPRESSED_RED_RGTC1:
+				flipBc4Rows(in, rowCount, out);
+				break;
+			case GL_COMPRESSED_RG_RGTC2:
+				flipBc4Rows(in, rowCount, out);
+				flipBc4Rows(in + 8, rowCount, out + 8);
+				break;
+			default:
+				flipBc1Rows(in, rowCount, out);
+				break;
+			}
+		}
+	}
+}
+
+#pragma region Cache
+
+static const char* getCompressionName(TextureCompression compression)
+{
+	switch (compression)
+	{
+	case TextureCompression::COLOUR: return "colour";
+	case TextureCompression::SINGLE: return "single";
+	case TextureCompression::NORMAL: return "normal";
+	default: return "rgba";
+	}
+}
+
+static uint16_t getMipFlags(const MipSettings& settings)
+{
+	return (uint16_t)((settings.srgb ? MIP_SRGB : 0) | (settings.normals ? MIP_NORMALS : 0) |
+		(settings.wrapX ? MIP_WRAP_X : 0) | (settings.wrapY ? MIP_WRAP_Y : 0));
+}
+
+std::string TextureCompressorUtils::getCachePath(const std::string& sourcePath, TextureCompression compression)
+{
+	return sourcePath + "." + getCompressionName(compression) + ".texcache";
+}
+
+// Points image at the levels of a mapped cache of this version, whatever it was cooked from
+static bool readCacheLevels(const FileUtils::MappedFile& cache, MipmappedImageView& image)
+{
+	if (cache.size() < sizeof(TextureBinaryHeader)) return false;
+
+	TextureBinaryHeader header;
+	std::memcpy(&header, cache.data(), sizeof(TextureBinaryHeader));
+
+	if (std::memcmp(header.magic, TEXTURE_BINARY_MAGIC, sizeof(TEXTURE_BINARY_MAGIC)) != 0 ||
+		header.version != TEXTURE_BINARY_VERSION ||
+		header.levelCount == 0 || header.width == 0 || header.height == 0)
+	{
+		return false;
+	}
+
+	size_t offsetsSize = ((size_t)header.levelCount + 1) * sizeof(uint64_t);
+	if (cache.size() < sizeof(TextureBinaryHeader) + offsetsSize) return false;
+
+	const unsigned char* offsetData = cache.data() + sizeof(TextureBinaryHeader);
+	size_t dataSize = cache.size() - sizeof(TextureBinaryHeader) - offsetsSize;
+
+	std::vector<size_t> offsets(header.levelCount + 1);
+	for (uint32_t i = 0; i <= header.levelCount; i++)
+	{
+		uint64_t offset;
+		std::memcpy(&offset, offsetData + i * sizeof(uint64_t), sizeof(uint64_t));
+		if (offset > dataSize || (i > 0 && offset < offsets[i - 1])) return false;
+		offsets[i] = (size_t)offset;
+	}
+	if (offsets.back() != dataSize) return false;
+
+	image.format = header.format;
+	image.width = (int)header.width;
+	image.height = (int)header.height;
+	image.topDown = false;
+	image.keepTopDown = false;
+	image.data = offsetData + offsetsSize;
+	image.levelOffsets.assign(offsets.begin(), offsets.end() - 1);
+	image.levelSizes.resize(header.levelCount);
+	for (uint32_t i = 0; i < header.levelCount; i++)
+	{
+		image.levelSizes[i] = offsets[i + 1] - offsets[i];
+	}
+	return true;
+}
+
+// Checks a mapped cache against what it should have been cooked from, and points image at its levels
+static bool readCache(const FileUtils::MappedFile& cache, TextureCompression compression, const MipSettings& mips,
+	uint64_t sourceSize, uint64_t sourceHash, MipmappedImageView& image)
+{
+	if (cache.size() < sizeof(TextureBinaryHeader)) return false;
+
+	TextureBinaryHeader header;
+	std::memcpy(&header, cache.data(), sizeof(TextureBinaryHeader));
+
+	if (header.compression != (uint32_t)compression ||
+		header.mipFilter != (uint16_t)mips.filter ||
+		header.mipFlags != getMipFlags(mips) ||
+		header.alphaCoverage != mips.alphaCoverage ||
+		header.sourceSize != sourceSize ||
+		header.sourceHash != sourceHash)
+	{
+		return false;
+	}
+	return readCacheLevels(cache, image);
+}
+
+bool TextureCompressorUtils::openCache(const std::string& cachePath, FileUtils::MappedFile& cache, MipmappedImageView& image)
+{
+	if (!cache.open(cachePath)) return false;
+
+	if (readCacheLevels(cache, image)) return true;
+
+	cache.close();
+	return false;
+}
+
+bool TextureCompressorUtils::loadCache(const std::string& sourcePath, TextureCompression compression, const MipSettings& mips,
+	uint64_t sourceSize, uint64_t sourceHash, FileUtils::MappedFile& cache, MipmappedImageView& image)
+{
+	if (!cache.open(getCachePath(sourcePath, compression))) return false;
+	if (readCache(cache, compression, mips, sourceSize, sourceHash, image)) return true;
+
+	cache.close();
+	return false;
+}
+
+bool TextureCompressorUtils::saveCache(const std::string& sourcePath, TextureCompression compression, const MipSettings& mips,
+	uint64_t sourceSize, uint64_t sourceHash, const MipmappedImage& image)
+{
+	TextureBinaryHeader header;
+	std::memcpy(header.magic, TEXTURE_BINARY_MAGIC, sizeof(TEXTURE_BINARY_MAGIC));
+	header.version = TEXTURE_BINARY_VERSION;
+	header.compression = (uint32_t)compression;
+	header.format = image.format;
+	header.width = (uint32_t)image.width;
+	header.height = (uint32_t)image.height;
+	header.levelCount = (uint32_t)image.getLevelCount();
+	header.mipFilter = (uint16_t)mips.filter;
+	header.mipFlags = getMipFlags(mips);
+	header.alphaCoverage = mips.alphaCoverage;
+	header.reserved = 0;
+	header.sourceSize = sourceSize;
+	header.sourceHash = sourceHash;
+
+	std::string cachePath = getCachePath(sourcePath, compression);
+	std::ofstream file(cachePath, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!file)
+	{
+		std::cout << "Failed to write texture cache: " << cachePath << std::endl;
+		return false;
+	}
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	for (size_t offset : image.levelOffsets)
+	{
+		uint64_t offset64 = offset;
+		file.write(reinterpret_cast<const char*>(&offset64), sizeof(offset64));
+	}
+	file.write(reinterpret_cast<const char*>(image.data.data()), image.data.size());
+
+	return (bool)file;
+}
+
+#pragma endregion
+
+#pragma region Benchmark
+
+// The scene's naming: _n normal maps, _s/_ao/_e maps read as .r, everything else colour
+static TextureCompression guessCompression(const std::filesystem::path& path)
+{
+	std::string stem = path.stem().string();
+	std::transform(stem.begin(), stem.end(), stem.begin(), ::tolower);
+
+	auto endsWith = [&](const char* suffix)
+	{
+		size_t length = std::strlen(suffix);
+		return stem.size() >= length && stem.compare(stem.size() - length, length, suffix) == 0;
+	};
+
+	if (endsWith("_n")) return TextureCompression::NORMAL;
+	if (endsWith("_s") || endsWith("_ao") || endsWith("_e")) return TextureCompression::SINGLE;
+	return TextureCompression::COLOUR;
+}
+
+void TextureCompressorUtils::runBenchmark(const std::string& assetDirectory)
+{
+	std::vector<std::string> filePaths = BenchUtils::findImages(assetDirectory);
+
+	BenchUtils::printTitle("BCn compression benchmark%s", BenchUtils::getThreadsNote().c_str());
+	printf("%-48s %11s %6s %11s %11s %7s %9s %10s\n", "File", "Size", "Format", "RGBA8 KB", "BCn KB", "Ratio", "PSNR dB", "Encode ms");
+
+	size_t totalUncompressed = 0, totalCompressed = 0;
+	double totalMs = 0.0;
+
+	for (const std::string& path : filePaths)
+	{
+		int width, height, channels;
+		unsigned char* rgba = stbi_load(path.c_str(), &width, &height, &channels, 4);
+		if (!rgba) continue;
+
+		TextureCompression compression = guessCompression(path);
+		MipSettings mips = { TextureMipFilter::KAISER, compression == TextureCompression::COLOUR, compression == TextureCompression::NORMAL, true, true, 0.0f };
+
+		MipmappedImage levels, image;
+		MipChainUtils::generate(rgba, width, height, mips, levels);
+		stbi_image_free(rgba);
+
+		TextureCompressionReport report;
+		compress(levels, compression, image, &report);
+
+		// RGBA8 with a full mip chain is a third larger than its first level
+		size_t uncompressed = (size_t)width * height * 4;
+		uncompressed += uncompressed / 3;
+
+		totalUncompressed += uncompressed;
+		totalCompressed += image.data.size();
+		totalMs += report.encodeMs;
+
+		char size[32];
+		snprintf(size, sizeof(size), "%dx%d", width, height);
+		printf("%-48s %11s %6s %11zu %11zu %6.1fx %9.2f %10.1f\n", BenchUtils::getRelativePath(path, assetDirectory).c_str(), size, getFormatName(image.format),
+			uncompressed / 1024, image.data.size() / 1024, (double)uncompressed / image.data.size(), report.psnr, report.encodeMs);
+	}
+
+	if (totalCompressed > 0)
+	{
+		printf("%-48s %11s %6s %11zu %11zu %6.1fx %9s %10.1f\n", "Total", "", "", totalUncompressed / 1024, totalCompressed / 1024,
+			(double)totalUncompressed / totalCompressed, "", totalMs);
+	}
+}
+
+#pragma endregion
\ No newline at end of file
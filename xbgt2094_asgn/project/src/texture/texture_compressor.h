@@ -0,0 +1,80 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include "mip_chain.h"
+#include "../framework/file_utils.h"
+
+// S3TC is an extension to GL 3.3 (available on every desktop driver), so glad has no enums for it.
+// RGTC (BC4/BC5) is core since 3.0.
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT1_EXT 0x83F1
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#endif
+#ifndef GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT 0x8C4D
+#endif
+#ifndef GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+
+// Quality of a cooked texture against its source, over the channels the format keeps
+struct TextureCompressionReport
+{
+	double psnr;		// dB over the first level; infinite when lossless
+	double encodeMs;
+};
+
+// CPU block compressor for the cook step: encodes every level of an RGBA8 mip chain to
+// BC1/BC3 (colour), BC4 (one channel) or BC5 (two channel normals). Blocks are split across threads, and
+// palette index selection uses SSE2 where available. Cooked results are cached next to the source file.
+class TextureCompressorUtils
+{
+public:
+	// levels is an RGBA8 chain from MipChainUtils; result gets as many levels. threadCount 0 uses every hardware thread.
+	static void compress(const MipmappedImage& levels, TextureCompression compression, MipmappedImage& result,
+		TextureCompressionReport* report = nullptr, unsigned int threadCount = 0);
+	// To a format of chooseFormat's, for images that must share one, such as the layers of an array
+	static void compress(const MipmappedImage& levels, GLenum format, MipmappedImage& result,
+		TextureCompressionReport* report = nullptr, unsigned int threadCount = 0);
+
+	// The format compress picks: BC1 unless any pixel of the first level is not opaque, BC3 then, for COLOUR
+	static GLenum chooseFormat(const MipmappedImage& levels, TextureCompression compression);
+
+	// Decodes the first level back to RGBA8, for measuring
+	static void decompress(const MipmappedImage& image, std::vector<unsigned char>& rgba);
+
+	static double measurePsnr(const unsigned char* rgba, const MipmappedImage& image);
+
+	static GLenum getSrgbFormat(GLenum format);
+	static const char* getFormatName(GLenum format);
+
+	// Bytes of one width x height level: whole 4x4 blocks for BCn formats, else RGBA8
+	static size_t getLevelSize(GLenum format, int width, int height);
+
+	// Copies one level with its rows in reverse order. Blocks are reordered and have their rows swapped, which
+	// is exact when height is a whole number of blocks or fits in one.
+	static void copyLevelFlipped(GLenum format, int width, int height, const unsigned char* source, unsigned char* result);
+
+	// Every cooked texture is kept as <source>.<compression>.texcache, checked against the source's size and hash
+	// and the settings its mips were built with. Uncompressed chains are cooked the same way, as RGBA8.
+	// A loaded cache stays mapped in file, and image points into it.
+	static std::string getCachePath(const std::string& sourcePath, TextureCompression compression);
+	static bool loadCache(const std::string& sourcePath, TextureCompression compression, const MipSettings& mips,
+		uint64_t sourceSize, uint64_t sourceHash, FileUtils::MappedFile& file, MipmappedImageView& image);
+	static bool saveCache(const std::string& sourcePath, TextureCompression compression, const MipSettings& mips,
+		uint64_t sourceSize, uint64_t sourceHash, const MipmappedImage& image);
+	// Maps the cache at cachePath whatever it was cooked from, for tools that only want its levels
+	static bool openCache(const std::string& cachePath, FileUtils::MappedFile& file, MipmappedImageView& image);
+
+	// Cooks every texture under assetDirectory as the scene would (by its _n/_s/_ao/_e suffix) and prints
+	// size, ratio, PSNR and encode time. Writes no cache.
+	static void runBenchmark(const std::string& assetDirectory);
+};
\ No newline at end of file
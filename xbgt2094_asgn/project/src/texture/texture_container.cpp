@@ -0,0 +1,733 @@
+#include "texture_container.h"
+#include "texture_compressor.h"
+#include "texture_streaming.h"
+#include "mip_chain.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include "../framework/bench_utils.h"
+
+static void appendBytes(std::vector<unsigned char>& bytes, const void* data, size_t size)
+{
+	const unsigned char* begin = (const unsigned char*)data;
+	bytes.insert(bytes.end(), begin, begin + size);
+}
+
+// Blocks can only be flipped whole, or within the one block a short level fits in
+static bool canFlipLevels(const MipmappedImageView& image)
+{
+	if (image.format == GL_RGBA8) return true;
+
+	for (size_t level = 0; level < image.getLevelCount(); level++)
+	{
+		int height = std::max(1, image.height >> level);
+		if (height > 4 && height % 4 != 0) return false;
+	}
+	return true;
+}
+
+#pragma region DDS
+
+struct DdsPixelFormat
+{
+	uint32_t size;
+	uint32_t flags;
+	uint32_t fourCC;
+	uint32_t rgbBitCount;
+	uint32_t rBitMask;
+	uint32_t gBitMask;
+	uint32_t bBitMask;
+	uint32_t aBitMask;
+};
+
+struct DdsHeader
+{
+	uint32_t size;
+	uint32_t flags;
+	uint32_t height;
+	uint32_t width;
+	uint32_t pitchOrLinearSize;
+	uint32_t depth;
+	uint32_t mipMapCount;
+	uint32_t reserved1[11];
+	DdsPixelFormat pixelFormat;
+	uint32_t caps;
+	uint32_t caps2;
+	uint32_t caps3;
+	uint32_t caps4;
+	uint32_t reserved2;
+};
+
+struct DdsHeaderDx10
+{
+	uint32_t dxgiFormat;
+	uint32_t resourceDimension;
+	uint32_t miscFlag;
+	uint32_t arraySize;
+	uint32_t miscFlags2;
+};
+
+static const uint32_t DDS_MAGIC = 0x20534444;	// "DDS "
+static const uint32_t DDSD_CAPS = 0x1;
+static const uint32_t DDSD_HEIGHT = 0x2;
+static const uint32_t DDSD_WIDTH = 0x4;
+static const uint32_t DDSD_PITCH = 0x8;
+static const uint32_t DDSD_PIXELFORMAT = 0x1000;
+static const uint32_t DDSD_MIPMAPCOUNT = 0x20000;
+static const uint32_t DDSD_LINEARSIZE = 0x80000;
+static const uint32_t DDPF_FOURCC = 0x4;
+static const uint32_t DDPF_RGB = 0x40;
+static const uint32_t DDSCAPS_COMPLEX = 0x8;
+static const uint32_t DDSCAPS_TEXTURE = 0x1000;
+static const uint32_t DDSCAPS_MIPMAP = 0x400000;
+static const uint32_t DDSCAPS2_CUBEMAP = 0x200;
+static const uint32_t DDSCAPS2_VOLUME = 0x200000;
+static const uint32_t DDS_DIMENSION_TEXTURE2D = 3;
+static const uint32_t DDS_MISC_TEXTURECUBE = 0x4;
+
+static uint32_t makeFourCC(const char* code)
+{
+	return (uint32_t)code[0] | ((uint32_t)code[1] << 8) | ((uint32_t)code[2] << 16) | ((uint32_t)code[3] << 24);
+}
+
+// 0 when unsupported
+static GLenum getDxgiFormat(uint32_t dxgiFormat, bool* srgb)
+{
+	*srgb = false;
+	switch (dxgiFormat)
+	{
+	case 28: return GL_RGBA8;									// R8G8B8A8_UNORM
+	case 29: *srgb = true; return GL_RGBA8;						// R8G8B8A8_UNORM_SRGB
+	case 71: return GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;			// BC1_UNORM
+	case 72: *srgb = true; return GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+	case 77: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;			// BC3_UNORM
+	case 78: *srgb = true; return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+	case 80: return GL_COMPRESSED_RED_RGTC1;					// BC4_UNORM
+	case 83: return GL_COMPRESSED_RG_RGTC2;						// BC5_UNORM
+	default: return 0;
+	}
+}
+
+// The reverse of getDxgiFormat; BC1 has one DXGI format with or without alpha
+static uint32_t toDxgiFormat(GLenum format, bool srgb)
+{
+	switch (format)
+	{
+	case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT: return srgb ? 72 : 71;
+	case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT: return srgb ? 78 : 77;
+	case GL_COMPRESSED_RED_RGTC1: return 80;
+	case GL_COMPRESSED_RG_RGTC2: return 83;
+	default: return srgb ? 29 : 28;
+	}
+}
+
+static GLenum getLegacyDdsFormat(const DdsPixelFormat& pixelFormat)
+{
+	if (pixelFormat.flags & DDPF_FOURCC)
+	{
+		// DXT1 may use its punch through alpha, so it is always read as RGBA
+		if (pixelFormat.fourCC == makeFourCC("DXT1")) return GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+		if (pixelFormat.fourCC == makeFourCC("DXT5")) return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+		if (pixelFormat.fourCC == makeFourCC("ATI1") || pixelFormat.fourCC == makeFourCC("BC4U")) return GL_COMPRESSED_RED_RGTC1;
+		if (pixelFormat.fourCC == makeFourCC("ATI2") || pixelFormat.fourCC == makeFourCC("BC5U")) return GL_COMPRESSED_RG_RGTC2;
+		return 0;
+	}
+
+	if ((pixelFormat.flags & DDPF_RGB) && pixelFormat.rgbBitCount == 32 &&
+		pixelFormat.rBitMask == 0x000000ff && pixelFormat.gBitMask == 0x0000ff00 && pixelFormat.bBitMask == 0x00ff0000)
+	{
+		return GL_RGBA8;
+	}
+	return 0;
+}
+
+// DDS keeps levels back to back, largest first, after the headers
+static bool parseDds(const unsigned char* bytes, size_t size, const std::string& path, MipmappedImageView& image, bool* srgb)
+{
+	DdsHeader header;
+	if (size < 4 + sizeof(DdsHeader))
+	{
+		std::cout << "Truncated DDS: " << path << std::endl;
+		return false;
+	}
+	std::memcpy(&header, bytes + 4, sizeof(DdsHeader));
+
+	if (header.size != sizeof(DdsHeader) || header.pixelFormat.size != sizeof(DdsPixelFormat))
+	{
+		std::cout << "Bad DDS header: " << path << std::endl;
+		return false;
+	}
+	if (header.caps2 & (DDSCAPS2_CUBEMAP | DDSCAPS2_VOLUME))
+	{
+		std::cout << "DDS is a cubemap or volume, not a 2D texture: " << path << std::endl;
+		return false;
+	}
+
+	size_t dataOffset = 4 + sizeof(DdsHeader);
+	GLenum format = 0;
+	*srgb = false;
+
+	if ((header.pixelFormat.flags & DDPF_FOURCC) && header.pixelFormat.fourCC == makeFourCC("DX10"))
+	{
+		DdsHeaderDx10 dx10;
+		if (size < dataOffset + sizeof(DdsHeaderDx10))
+		{
+			std::cout << "Truncated DDS: " << path << std::endl;
+			return false;
+		}
+		std::memcpy(&dx10, bytes + dataOffset, sizeof(DdsHeaderDx10));
+		dataOffset += sizeof(DdsHeaderDx10);
+
+		if (dx10.resourceDimension != DDS_DIMENSION_TEXTURE2D || dx10.arraySize != 1 || (dx10.miscFlag & DDS_MISC_TEXTURECUBE))
+		{
+			std::cout << "DDS is an array, cubemap or not 2D: " << path << std::endl;
+			return false;
+		}
+		format = getDxgiFormat(dx10.dxgiFormat, srgb);
+	}
+	else
+	{
+		format = getLegacyDdsFormat(header.pixelFormat);
+	}
+
+	if (format == 0)
+	{
+		std::cout << "Unsupported DDS format, expected BC1, BC3, BC4, BC5 or RGBA8: " << path << std::endl;
+		return false;
+	}
+
+	size_t levelCount = (header.flags & DDSD_MIPMAPCOUNT) ? std::max<uint32_t>(1, header.mipMapCount) : 1;
+
+	image.format = format;
+	image.width = (int)header.width;
+	image.height = (int)header.height;
+	image.topDown = true;
+	image.keepTopDown = false;
+	image.data = bytes;
+	image.levelOffsets.clear();
+	image.levelSizes.clear();
+
+	size_t offset = dataOffset;
+	for (size_t level = 0; level < levelCount; level++)
+	{
+		size_t levelSize = TextureCompressorUtils::getLevelSize(format, std::max(1, image.width >> level), std::max(1, image.height >> level));
+		if (offset + levelSize > size)
+		{
+			std::cout << "Truncated DDS at level " << level << ": " << path << std::endl;
+			return false;
+		}
+
+		image.levelOffsets.push_back(offset);
+		image.levelSizes.push_back(levelSize);
+		offset += levelSize;
+	}
+	return true;
+}
+
+#pragma endregion
+
+#pragma region KTX2
+
+struct Ktx2Header
+{
+	unsigned char identifier[12];
+	uint32_t vkFormat;
+	uint32_t typeSize;
+	uint32_t pixelWidth;
+	uint32_t pixelHeight;
+	uint32_t pixelDepth;
+	uint32_t layerCount;
+	uint32_t faceCount;
+	uint32_t levelCount;
+	uint32_t supercompressionScheme;
+	uint32_t dfdByteOffset;
+	uint32_t dfdByteLength;
+	uint32_t kvdByteOffset;
+	uint32_t kvdByteLength;
+	uint64_t sgdByteOffset;
+	uint64_t sgdByteLength;
+};
+
+struct Ktx2LevelIndex
+{
+	uint64_t byteOffset;
+	uint64_t byteLength;
+	uint64_t uncompressedByteLength;
+};
+
+static const unsigned char KTX2_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+// 0 when unsupported
+static GLenum getVkFormat(uint32_t vkFormat, bool* srgb)
+{
+	*srgb = false;
+	switch (vkFormat)
+	{
+	case 37: return GL_RGBA8;									// R8G8B8A8_UNORM
+	case 43: *srgb = true; return GL_RGBA8;						// R8G8B8A8_SRGB
+	case 131: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;			// BC1_RGB_UNORM_BLOCK
+	case 132: *srgb = true; return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	case 133: return GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;			// BC1_RGBA_UNORM_BLOCK
+	case 134: *srgb = true; return GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+	case 137: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;			// BC3_UNORM_BLOCK
+	case 138: *srgb = true; return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+	case 139: return GL_COMPRESSED_RED_RGTC1;					// BC4_UNORM_BLOCK
+	case 141: return GL_COMPRESSED_RG_RGTC2;					// BC5_UNORM_BLOCK
+	default: return 0;
+	}
+}
+
+// The reverse of getVkFormat
+static uint32_t toVkFormat(GLenum format, bool srgb)
+{
+	switch (format)
+	{
+	case GL_COMPRESSED_RGB_S3TC_DXT1_EXT: return srgb ? 132 : 131;
+	case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT: return srgb ? 134 : 133;
+	case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT: return srgb ? 138 : 137;
+	case GL_COMPRESSED_RED_RGTC1: return 139;
+	case GL_COMPRESSED_RG_RGTC2: return 141;
+	default: return srgb ? 43 : 37;
+	}
+}
+
+// Khronos Data Format basic descriptor of a format, which KTX2 requires though parse does not read it
+static void makeKtx2Dfd(GLenum format, bool srgb, std::vector<uint32_t>& words)
+{
+	struct Sample
+	{
+		uint32_t bitOffset, bitLength, channel, upper;
+	};
+
+	static const uint32_t ALPHA = 15, LINEAR = 0x10;	// channel id, and the qualifier alpha has in sRGB formats
+	uint32_t alpha = srgb ? ALPHA | LINEAR : ALPHA;
+
+	uint32_t model, blockBytes;
+	std::vector<Sample> samples;
+	switch (format)
+	{
+	case GL_COMPRESSED_RGB_S3TC_DXT1_EXT: model = 128; blockBytes = 8; samples = { { 0, 64, 0, UINT32_MAX } }; break;
+	case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT: model = 128; blockBytes = 8; samples = { { 0, 64, 1, UINT32_MAX } }; break;
+	case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT: model = 130; blockBytes = 16; samples = { { 0, 64, alpha, UINT32_MAX }, { 64, 64, 0, UINT32_MAX } }; break;
+	case GL_COMPRESSED_RED_RGTC1: model = 131; blockBytes = 8; samples = { { 0, 64, 0, UINT32_MAX } }; break;
+	case GL_COMPRESSED_RG_RGTC2: model = 132; blockBytes = 16; samples = { { 0, 64, 0, UINT32_MAX }, { 64, 64, 1, UINT32_MAX } }; break;
+	default: model = 1; blockBytes = 4; samples = { { 0, 8, 0, 255 }, { 8, 8, 1, 255 }, { 16, 8, 2, 255 }, { 24, 8, alpha, 255 } }; break;
+	}
+
+	uint32_t blockSize = 24 + 16 * (uint32_t)samples.size();
+	uint32_t blockDimension = format == GL_RGBA8 ? 0 : 3;	// 4x4 texels, stored minus one
+
+	words.clear();
+	words.push_back(4 + blockSize);				// total size
+	words.push_back(0);							// Khronos vendor, basic descriptor
+	words.push_back(2 | (blockSize << 16));		// version 1.3
+	words.push_back(model | (1 << 8) | ((srgb ? 2u : 1u) << 16));	// BT.709 primaries, sRGB or linear transfer
+	words.push_back(blockDimension | (blockDimension << 8));
+	words.push_back(blockBytes);
+	words.push_back(0);
+
+	for (const Sample& sample : samples)
+	{
+		words.push_back(sample.bitOffset | ((sample.bitLength - 1) << 16) | (sample.channel << 24));
+		words.push_back(0);
+		words.push_back(0);
+		words.push_back(sample.upper);
+	}
+}
+
+// KTXorientation is "rd" (rows go down) unless the writer said otherwise, e.g. toktx --lower_left_maps_to_s0t0
+static bool isKtx2TopDown(const unsigned char* bytes, size_t size, const Ktx2Header& header)
+{
+	if ((uint64_t)header.kvdByteOffset + header.kvdByteLength > size) return true;
+
+	const unsigned char* entry = bytes + header.kvdByteOffset;
+	const unsigned char* end = entry + header.kvdByteLength;
+	static const char KEY[] = "KTXorientation";
+
+	while (end - entry >= 4)
+	{
+		uint32_t length;
+		std::memcpy(&length, entry, 4);
+		entry += 4;
+		if (length > (size_t)(end - entry)) break;
+
+		// key\0value
+		if (length > sizeof(KEY) + 1 && std::memcmp(entry, KEY, sizeof(KEY)) == 0)
+		{
+			return entry[sizeof(KEY) + 1] != 'u';
+		}
+
+		entry += (length + 3) & ~3u;
+	}
+	return true;
+}
+
+static bool parseKtx2(const unsigned char* bytes, size_t size, const std::string& path, MipmappedImageView& image, bool* srgb)
+{
+	Ktx2Header header;
+	if (size < sizeof(Ktx2Header))
+	{
+		std::cout << "Truncated KTX2: " << path << std::endl;
+		return false;
+	}
+	std::memcpy(&header, bytes, sizeof(Ktx2Header));
+
+	if (header.supercompressionScheme != 0)
+	{
+		std::cout << "KTX2 is supercompressed (Basis or Zstandard), which would need decoding: " << path << std::endl;
+		return false;
+	}
+	if (header.pixelDepth > 0 || header.layerCount > 1 || header.faceCount != 1)
+	{
+		std::cout << "KTX2 is a volume, array or cubemap, not a 2D texture: " << path << std::endl;
+		return false;
+	}
+
+	GLenum format = getVkFormat(header.vkFormat, srgb);
+	if (format == 0)
+	{
+		std::cout << "Unsupported KTX2 format, expected BC1, BC3, BC4, BC5 or RGBA8: " << path << std::endl;
+		return false;
+	}
+
+	// A level count of 0 asks the loader to generate mips; there is still the one level
+	size_t levelCount = std::max<uint32_t>(1, header.levelCount);
+	if (size < sizeof(Ktx2Header) + levelCount * sizeof(Ktx2LevelIndex))
+	{
+		std::cout << "Truncated KTX2: " << path << std::endl;
+		return false;
+	}
+
+	image.format = format;
+	image.width = (int)header.pixelWidth;
+	image.height = (int)header.pixelHeight;
+	image.topDown = isKtx2TopDown(bytes, size, header);
+	image.keepTopDown = false;
+	image.data = bytes;
+	image.levelOffsets.clear();
+	image.levelSizes.clear();
+
+	// The index lists the largest level first, though the data stores it last
+	for (size_t level = 0; level < levelCount; level++)
+	{
+		Ktx2LevelIndex index;
+		std::memcpy(&index, bytes + sizeof(Ktx2Header) + level * sizeof(Ktx2LevelIndex), sizeof(Ktx2LevelIndex));
+
+		size_t levelSize = TextureCompressorUtils::getLevelSize(format, std::max(1, image.width >> level), std::max(1, image.height >> level));
+		if (index.byteLength != levelSize || index.byteOffset > size || index.byteLength > size - index.byteOffset)
+		{
+			std::cout << "Bad KTX2 level " << level << ": " << path << std::endl;
+			return false;
+		}
+
+		image.levelOffsets.push_back((size_t)index.byteOffset);
+		image.levelSizes.push_back(levelSize);
+	}
+	return true;
+}
+
+#pragma endregion
+
+bool TextureContainerUtils::isContainerPath(const std::string& path)
+{
+	std::string extension = std::filesystem::path(path).extension().string();
+	std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+	return extension == ".dds" || extension == ".ktx2";
+}
+
+bool TextureContainerUtils::parse(const unsigned char* bytes, size_t size, const std::string& path, MipmappedImageView& image, bool* srgb)
+{
+	bool parsed = false;
+	uint32_t magic = 0;
+	if (size >= 4) std::memcpy(&magic, bytes, 4);
+
+	if (magic == DDS_MAGIC)
+	{
+		parsed = parseDds(bytes, size, path, image, srgb);
+	}
+	else if (size >= sizeof(KTX2_IDENTIFIER) && std::memcmp(bytes, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) == 0)
+	{
+		parsed = parseKtx2(bytes, size, path, image, srgb);
+	}
+	else
+	{
+		std::cout << "Not a DDS or KTX2 file: " << path << std::endl;
+	}
+
+	if (!parsed) return false;
+
+	if (image.width <= 0 || image.height <= 0)
+	{
+		std::cout << "Texture container has no pixels: " << path << std::endl;
+		return false;
+	}
+
+	// A chain with a level that cannot be flipped, such as 75 rows under a 600 row top level, goes up as stored,
+	// and is sampled upside down instead
+	if (image.topDown && !canFlipLevels(image)) image.keepTopDown = true;
+	return true;
+}
+
+bool TextureContainerUtils::writeDds(const MipmappedImageView& image, bool srgb, std::vector<unsigned char>& bytes)
+{
+	bool flip = !image.topDown;
+	if (flip && !canFlipLevels(image))
+	{
+		std::cout << "DDS rows go top first, and these levels cannot be flipped to that" << std::endl;
+		return false;
+	}
+
+	bool compressed = image.format != GL_RGBA8;
+	size_t levelCount = image.getLevelCount();
+
+	DdsHeader header = {};
+	header.size = sizeof(DdsHeader);
+	header.flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | (compressed ? DDSD_LINEARSIZE : DDSD_PITCH);
+	header.height = (uint32_t)image.height;
+	header.width = (uint32_t)image.width;
+	header.pitchOrLinearSize = compressed ? (uint32_t)image.levelSizes[0] : (uint32_t)image.width * 4;
+	header.pixelFormat.size = sizeof(DdsPixelFormat);
+	header.pixelFormat.flags = DDPF_FOURCC;
+	header.pixelFormat.fourCC = makeFourCC("DX10");
+	header.caps = DDSCAPS_TEXTURE;
+	if (levelCount > 1)
+	{
+		header.flags |= DDSD_MIPMAPCOUNT;
+		header.mipMapCount = (uint32_t)levelCount;
+		header.caps |= DDSCAPS_COMPLEX | DDSCAPS_MIPMAP;
+	}
+
+	DdsHeaderDx10 dx10 = { toDxgiFormat(image.format, srgb), DDS_DIMENSION_TEXTURE2D, 0, 1, 0 };
+
+	bytes.clear();
+	appendBytes(bytes, &DDS_MAGIC, 4);
+	appendBytes(bytes, &header, sizeof(DdsHeader));
+	appendBytes(bytes, &dx10, sizeof(DdsHeaderDx10));
+
+	for (size_t level = 0; level < levelCount; level++)
+	{
+		const unsigned char* source = image.data + image.levelOffsets[level];
+		if (!flip)
+		{
+			appendBytes(bytes, source, image.levelSizes[level]);
+			continue;
+		}
+
+		size_t offset = bytes.size();
+		bytes.resize(offset + image.levelSizes[level]);
+		TextureCompressorUtils::copyLevelFlipped(image.format, std::max(1, image.width >> level), std::max(1, image.height >> level),
+			source, bytes.data() + offset);
+	}
+	return true;
+}
+
+void TextureContainerUtils::writeKtx2(const MipmappedImageView& image, bool srgb, std::vector<unsigned char>& bytes)
+{
+	size_t levelCount = image.getLevelCount();
+
+	std::vector<uint32_t> dfd;
+	makeKtx2Dfd(image.format, srgb, dfd);
+
+	// key\0value\0, then padding to 4 bytes
+	static const char KEY[] = "KTXorientation";
+	const char* value = image.topDown ? "rd" : "ru";
+	uint32_t entryLength = sizeof(KEY) + 3;
+
+	Ktx2Header header = {};
+	std::memcpy(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+	header.vkFormat = toVkFormat(image.format, srgb);
+	header.typeSize = 1;
+	header.pixelWidth = (uint32_t)image.width;
+	header.pixelHeight = (uint32_t)image.height;
+	header.faceCount = 1;
+	header.levelCount = (uint32_t)levelCount;
+	header.dfdByteOffset = (uint32_t)(sizeof(Ktx2Header) + levelCount * sizeof(Ktx2LevelIndex));
+	header.dfdByteLength = (uint32_t)(dfd.size() * 4);
+	header.kvdByteOffset = header.dfdByteOffset + header.dfdByteLength;
+	header.kvdByteLength = (4 + entryLength + 3) & ~3u;
+
+	// Levels go smallest first, each aligned to its block size
+	size_t alignment = image.format == GL_RGBA8 ? 4 : TextureCompressorUtils::getLevelSize(image.format, 1, 1);
+	std::vector<Ktx2LevelIndex> levels(levelCount);
+	size_t offset = header.kvdByteOffset + header.kvdByteLength;
+	for (size_t level = levelCount; level-- > 0;)
+	{
+		offset = (offset + alignment - 1) / alignment * alignment;
+		levels[level] = { offset, image.levelSizes[level], image.levelSizes[level] };
+		offset += image.levelSizes[level];
+	}
+
+	bytes.assign(offset, 0);
+	std::memcpy(bytes.data(), &header, sizeof(Ktx2Header));
+	std::memcpy(bytes.data() + sizeof(Ktx2Header), levels.data(), levelCount * sizeof(Ktx2LevelIndex));
+	std::memcpy(bytes.data() + header.dfdByteOffset, dfd.data(), header.dfdByteLength);
+
+	unsigned char* entry = bytes.data() + header.kvdByteOffset;
+	std::memcpy(entry, &entryLength, 4);
+	std::memcpy(entry + 4, KEY, sizeof(KEY));
+	std::memcpy(entry + 4 + sizeof(KEY), value, 3);
+
+	for (size_t level = 0; level < levelCount; level++)
+	{
+		std::memcpy(bytes.data() + levels[level].byteOffset, image.data + image.levelOffsets[level], image.levelSizes[level]);
+	}
+}
+
+#pragma region Benchmark
+
+// Every level as Texture2D stages it for upload
+static void stageLevels(const MipmappedImageView& image, std::vector<unsigned char>& staged)
+{
+	staged.clear();
+	for (size_t level = 0; level < image.getLevelCount(); level++)
+	{
+		size_t offset = staged.size();
+		staged.resize(offset + image.levelSizes[level]);
+
+		const unsigned char* source = image.data + image.levelOffsets[level];
+		if (!image.topDown || image.keepTopDown)
+		{
+			std::memcpy(staged.data() + offset, source, image.levelSizes[level]);
+		}
+		else
+		{
+			TextureCompressorUtils::copyLevelFlipped(image.format, std::max(1, image.width >> level), std::max(1, image.height >> level),
+				source, staged.data() + offset);
+		}
+	}
+}
+
+static const char* getUploadName(const MipmappedImageView& image)
+{
+	if (!image.topDown) return "as is";
+	return image.keepTopDown ? "kept top down" : "flipped";
+}
+
+struct ContainerRoundTrip
+{
+	size_t bytes;
+	double writeMs, parseMs, readMs, stageMs;
+	std::string upload;		// how the parsed levels went up, or why there are none
+	bool identical;
+};
+
+// Writes image with write, parses it back and stages it, which must give the bytes and orientation the source
+// itself uploads with. DDS may store BC1 without alpha as BC1 with it, which decodes the same.
+static ContainerRoundTrip roundTrip(const MipmappedImageView& image, bool srgb, const std::vector<unsigned char>& expected,
+	bool (*write)(const MipmappedImageView&, bool, std::vector<unsigned char>&))
+{
+	ContainerRoundTrip result = { 0, 0.0, 0.0, 0.0, 0.0, "-", false };
+
+	std::vector<unsigned char> bytes;
+	auto start = std::chrono::steady_clock::now();
+	bool written = write(image, srgb, bytes);
+	result.writeMs = BenchUtils::getElapsedMs(start);
+	if (!written) return result;
+	result.bytes = bytes.size();
+
+	MipmappedImageView parsed;
+	bool parsedSrgb;
+	start = std::chrono::steady_clock::now();
+	bool ok = TextureContainerUtils::parse(bytes.data(), bytes.size(), "round trip", parsed, &parsedSrgb);
+	result.parseMs = BenchUtils::getElapsedMs(start);
+	if (!ok) return result;
+
+	// Streamed in from the smallest level, as TextureStreaming reads them
+	size_t levelCount = parsed.getLevelCount();
+	start = std::chrono::steady_clock::now();
+	for (size_t level = levelCount; level-- > 0;) TextureStreaming::readLevels(parsed, level, level + 1);
+	result.readMs = BenchUtils::getElapsedMs(start);
+
+	std::vector<unsigned char> staged;
+	start = std::chrono::steady_clock::now();
+	stageLevels(parsed, staged);
+	result.stageMs = BenchUtils::getElapsedMs(start);
+	result.upload = getUploadName(parsed);
+
+	bool bc1 = image.format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT && parsed.format == GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+	result.identical = (parsed.format == image.format || bc1) && parsedSrgb == srgb &&
+		parsed.width == image.width && parsed.height == image.height && parsed.getLevelCount() == image.getLevelCount() &&
+		(parsed.topDown && parsed.keepTopDown) == (image.topDown && image.keepTopDown) &&
+		TextureStreaming::getLevelsSize(parsed, 0, levelCount) == expected.size() && staged == expected;
+	return result;
+}
+
+static bool printRoundTrip(const std::string& name, const MipmappedImageView& image, bool srgb)
+{
+	std::vector<unsigned char> expected;
+	stageLevels(image, expected);
+
+	ContainerRoundTrip dds = roundTrip(image, srgb, expected, TextureContainerUtils::writeDds);
+	ContainerRoundTrip ktx2 = roundTrip(image, srgb, expected, [](const MipmappedImageView& view, bool viewSrgb, std::vector<unsigned char>& bytes)
+	{
+		TextureContainerUtils::writeKtx2(view, viewSrgb, bytes);
+		return true;
+	});
+
+	// A bottom up chain DDS cannot hold is not a failure of the round trip
+	bool identical = (dds.identical || dds.bytes == 0) && ktx2.identical;
+
+	char size[32];
+	snprintf(size, sizeof(size), "%dx%d", image.width, image.height);
+	printf("%-48s %11s %6s %9zu %9.3f %9.3f %9.3f %9.3f %9.3f %9.3f %-14s %s\n", name.c_str(), size,
+		TextureCompressorUtils::getFormatName(image.format), expected.size() / 1024,
+		dds.writeMs, dds.parseMs, ktx2.writeMs, ktx2.parseMs, ktx2.readMs, dds.stageMs, dds.upload.c_str(), identical ? "identical" : "MISMATCH");
+	return identical;
+}
+
+void TextureContainerUtils::runBenchmark(const std::string& assetDirectory)
+{
+	std::vector<std::string> cachePaths = BenchUtils::findFiles(assetDirectory, { ".texcache" });
+
+	BenchUtils::printTitle("DDS and KTX2 round trip benchmark");
+	if (cachePaths.empty()) printf("No .texcache files under %s; run the scene once to cook them\n", assetDirectory.c_str());
+	printf("%-48s %11s %6s %9s %9s %9s %9s %9s %9s %9s %-14s %s\n", "File", "Size", "Format", "KB",
+		"DDS w ms", "DDS r ms", "KTX2 w ms", "KTX2 r ms", "KTX2 s ms", "Stage ms", "DDS upload", "Output");
+
+	unsigned int mismatches = 0;
+	for (const std::string& path : cachePaths)
+	{
+		FileUtils::MappedFile cache;
+		MipmappedImageView image;
+		if (!TextureCompressorUtils::openCache(path, cache, image)) continue;
+
+		// Only colour is cooked from sRGB
+		bool srgb = path.find(".colour.texcache") != std::string::npos;
+		if (!printRoundTrip(BenchUtils::getRelativePath(path, assetDirectory), image, srgb)) mismatches++;
+	}
+
+	// Rows top first, as a container would hold them, with 75 rows at level 3 that no flip can keep whole
+	const int SIZE = 600;
+	std::vector<unsigned char> rgba((size_t)SIZE * SIZE * 4);
+	for (int y = 0; y < SIZE; y++)
+	{
+		for (int x = 0; x < SIZE; x++)
+		{
+			unsigned char* pixel = &rgba[((size_t)y * SIZE + x) * 4];
+			pixel[0] = (unsigned char)(x * 255 / SIZE);
+			pixel[1] = (unsigned char)(y * 255 / SIZE);
+			pixel[2] = (unsigned char)((x / 32 + y / 32) % 2 * 255);
+			pixel[3] = 255;
+		}
+	}
+
+	MipSettings mips = { TextureMipFilter::KAISER, true, false, true, true, 0.0f };
+	MipmappedImage levels, compressed;
+	MipChainUtils::generate(rgba.data(), SIZE, SIZE, mips, levels);
+	TextureCompressorUtils::compress(levels, TextureCompression::COLOUR, compressed);
+
+	MipmappedImageView synthetic = compressed.getView();
+	synthetic.topDown = true;
+	synthetic.keepTopDown = !canFlipLevels(synthetic);
+	if (!printRoundTrip("600x600 top down, generated", synthetic, true)) mismatches++;
+
+	printf("%u of %zu round trips differ\n", mismatches, cachePaths.size() + 1);
+}
+
+#pragma endregion
\ No newline at end of file
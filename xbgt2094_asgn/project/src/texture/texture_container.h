@@ -0,0 +1,30 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "texture2d.h"
+
+// Textures cooked by other tools: DDS, with the legacy or DX10 header, and KTX2 without supercompression,
+// holding one 2D image as BC1, BC3, BC4, BC5 or RGBA8 with its mip levels laid out ready to upload.
+// Nothing is decoded; the result points into the bytes it was parsed from, usually a mapped file.
+class TextureContainerUtils
+{
+public:
+	// True for paths ending in .dds or .ktx2
+	static bool isContainerPath(const std::string& path);
+
+	// Fails, saying why, on anything else: cubemaps, arrays, volumes or other formats. srgb is set when the file
+	// says its colour is sRGB encoded.
+	static bool parse(const unsigned char* bytes, size_t size, const std::string& path, MipmappedImageView& image, bool* srgb);
+
+	// The other way, for tools: image's levels in a DDS with the DX10 header, or as they are in a KTX2 whose
+	// KTXorientation says whether they are top down. DDS has no such key and is read as top down, so bottom up
+	// levels are flipped for it, and it fails on a chain with a level that cannot be.
+	static bool writeDds(const MipmappedImageView& image, bool srgb, std::vector<unsigned char>& bytes);
+	static void writeKtx2(const MipmappedImageView& image, bool srgb, std::vector<unsigned char>& bytes);
+
+	// Writes every cooked .texcache under assetDirectory, and a 600x600 chain whose 75 row level cannot be
+	// flipped, out as DDS and KTX2 in memory, parses them back and checks every level is byte-identical, and
+	// times writing, parsing, streaming the levels in as TextureStreaming reads them, and staging them as an
+	// upload would. The scene must have run once to cook them.
+	static void runBenchmark(const std::string& assetDirectory);
+};
\ No newline at end of file
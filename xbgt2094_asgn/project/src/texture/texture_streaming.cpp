@@ -0,0 +1,379 @@
+#include "texture_streaming.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+bool TextureStreaming::enabled = false;
+size_t TextureStreaming::frameBudget = 4 * 1024 * 1024;
+size_t TextureStreaming::residencyBudget = 0;
+uint64_t TextureStreaming::frame = 0;
+std::map<Texture2D*, TextureStreaming::StreamedTexture> TextureStreaming::textures;
+TextureStreamingStats TextureStreaming::stats = {};
+
+glm::vec3 TextureStreaming::lastCameraPosition = glm::vec3(0.0f);
+glm::vec3 TextureStreaming::cameraVelocity = glm::vec3(0.0f);
+bool TextureStreaming::cameraTracked = false;
+
+std::vector<TextureStreaming::ReadJob> TextureStreaming::reads;
+std::future<void> TextureStreaming::reader;
+
+// Touches every page of size bytes at data, so a mapped file's are in memory when they are next copied
+static void readPages(const unsigned char* data, size_t size)
+{
+	static const size_t PAGE_SIZE = 4096;
+	volatile unsigned char sink = 0;
+	for (size_t offset = 0; offset < size; offset += PAGE_SIZE) sink = sink + data[offset];
+}
+
+void TextureStreaming::setEnabled(bool enabled)
+{
+	TextureStreaming::enabled = enabled;
+}
+
+bool TextureStreaming::isEnabled()
+{
+	return enabled;
+}
+
+void TextureStreaming::setFrameBudget(size_t bytes)
+{
+	frameBudget = bytes;
+}
+
+size_t TextureStreaming::getFrameBudget()
+{
+	return frameBudget;
+}
+
+void TextureStreaming::setResidencyBudget(size_t bytes)
+{
+	residencyBudget = bytes;
+}
+
+size_t TextureStreaming::getResidencyBudget()
+{
+	return residencyBudget;
+}
+
+size_t TextureStreaming::getTailLevel(const MipmappedImageView& image)
+{
+	size_t level = 0;
+	while (level + 1 < image.getLevelCount() && std::max(image.width >> level, image.height >> level) > TAIL_SIZE) level++;
+	return level;
+}
+
+size_t TextureStreaming::getFirstLevel(const MipmappedImageView& image, const TextureConfig& cfg)
+{
+	if (!enabled || !cfg.mipmap) return 0;
+	return getTailLevel(image);
+}
+
+bool TextureStreaming::isManaged(const MipmappedImageView& image, const TextureConfig& cfg)
+{
+	if (!cfg.mipmap || getTailLevel(image) == 0) return false;
+	return enabled || residencyBudget > 0;
+}
+
+void TextureStreaming::add(Texture2D* tex, const std::string& path, const MipmappedImageView& image,
+	std::shared_ptr<FileUtils::MappedFile> mapping, MipmappedImage&& levels)
+{
+	if (tex->getBaseLevel() == 0 && residencyBudget == 0) return;
+
+	StreamedTexture& streamed = textures[tex];
+	streamed.path = path;
+	streamed.image = image;
+	streamed.mapping = std::move(mapping);
+	streamed.levels = std::move(levels);	// moving keeps the buffer image points into
+
+	// Levels already in memory need no reading; the load touched the mapped ones it uploaded
+	streamed.readLevel = streamed.mapping ? tex->getBaseLevel() : 0;
+	streamed.reading = false;
+	streamed.wantedLevel = image.getLevelCount();
+	streamed.pendingLevel = image.getLevelCount();
+	streamed.requested = false;
+
+	streamed.tailLevel = getTailLevel(image);
+	streamed.evictedLevel = image.getLevelCount();
+	streamed.lastBound = frame;
+
+	stats.residentBytes += getLevelBytes(tex, streamed);
+}
+
+void TextureStreaming::forget(Texture2D* tex)
+{
+	auto it = textures.find(tex);
+	if (it == textures.end()) return;
+
+	// A read in flight holds its own reference to the mapping, and its result is ignored
+	stats.residentBytes -= getLevelBytes(tex, it->second);
+	textures.erase(it);
+}
+
+size_t TextureStreaming::getLevelsSize(const MipmappedImageView& image, size_t first, size_t last)
+{
+	size_t bytes = 0;
+	for (size_t level = first; level < last; level++) bytes += image.levelSizes[level];
+	return bytes;
+}
+
+void TextureStreaming::readLevels(const MipmappedImageView& image, size_t first, size_t last)
+{
+	for (size_t level = first; level < last; level++) readPages(image.data + image.levelOffsets[level], image.levelSizes[level]);
+}
+
+size_t TextureStreaming::getLevelBytes(Texture2D* tex, const StreamedTexture& streamed)
+{
+	return getLevelsSize(streamed.image, tex->getBaseLevel(), tex->getLevelCount());
+}
+
+size_t TextureStreaming::getResidentBytes(Texture2D* tex)
+{
+	auto it = textures.find(tex);
+	return it != textures.end() ? getLevelBytes(tex, it->second) : 0;
+}
+
+void TextureStreaming::markBound(Texture2D* tex)
+{
+	auto it = textures.find(tex);
+	if (it != textures.end()) it->second.lastBound = frame;
+}
+
+void TextureStreaming::evictLevel(Texture2D* tex, StreamedTexture& streamed)
+{
+	size_t level = tex->getBaseLevel();
+	size_t size = streamed.image.levelSizes[level];
+	tex->dropLevels(level + 1);
+
+	streamed.evictedLevel = std::min(streamed.evictedLevel, level);
+	stats.residentBytes -= size;
+	stats.bytesEvicted += size;
+	stats.evictions++;
+
+	std::cout << "Evicted texture level " << level << " (" << size / 1024 << " KB, unbound for " << frame - streamed.lastBound
+		<< " frames): " << streamed.path << "; " << stats.residentBytes / 1024 << " KB resident" << std::endl;
+}
+
+// Evicts from textures last bound before boundBefore, least recently first, until bytes more fit the budget.
+// Returns false, evicting nothing, when they cannot be made to fit.
+bool TextureStreaming::makeRoom(size_t bytes, uint64_t boundBefore)
+{
+	if (residencyBudget == 0 || stats.residentBytes + bytes <= residencyBudget) return true;
+
+	size_t evictable = 0;
+	for (auto& it : textures)
+	{
+		const StreamedTexture& streamed = it.second;
+		if (streamed.lastBound >= boundBefore) continue;
+		for (size_t level = it.first->getBaseLevel(); level < streamed.tailLevel; level++) evictable += streamed.image.levelSizes[level];
+	}
+	if (stats.residentBytes + bytes > residencyBudget + evictable) return false;
+
+	// One level at a time from the least recently bound texture, the biggest level first among textures
+	// bound in the same frame
+	while (stats.residentBytes + bytes > residencyBudget)
+	{
+		std::pair<Texture2D* const, StreamedTexture>* victim = nullptr;
+		for (auto& it : textures)
+		{
+			const StreamedTexture& streamed = it.second;
+			size_t base = it.first->getBaseLevel();
+			if (streamed.lastBound >= boundBefore || base >= streamed.tailLevel) continue;
+
+			if (!victim || streamed.lastBound < victim->second.lastBound || (streamed.lastBound == victim->second.lastBound &&
+				streamed.image.levelSizes[base] > victim->second.image.levelSizes[victim->first->getBaseLevel()]))
+			{
+				victim = &it;
+			}
+		}
+		evictLevel(victim->first, victim->second);
+	}
+	return true;
+}
+
+void TextureStreaming::beginFrame(const glm::vec3& cameraPosition, float deltaTime)
+{
+	// Smoothed, so a single uneven frame does not throw the prediction off
+	if (cameraTracked && deltaTime > 0.0f)
+	{
+		glm::vec3 velocity = (cameraPosition - lastCameraPosition) / deltaTime;
+		cameraVelocity = glm::mix(cameraVelocity, velocity, 0.25f);
+	}
+	lastCameraPosition = cameraPosition;
+	cameraTracked = true;
+	frame++;
+
+	for (auto& it : textures)
+	{
+		StreamedTexture& streamed = it.second;
+		streamed.wantedLevel = streamed.pendingLevel;
+		streamed.pendingLevel = streamed.image.getLevelCount();
+	}
+}
+
+glm::vec3 TextureStreaming::getPrefetchPosition()
+{
+	return lastCameraPosition + cameraVelocity * PREFETCH_SECONDS;
+}
+
+void TextureStreaming::request(Texture2D* tex, float screenPixels)
+{
+	auto it = textures.find(tex);
+	if (it == textures.end()) return;
+
+	// One texel per pixel: every level halves the texels across
+	StreamedTexture& streamed = it->second;
+	float texels = (float)std::max(streamed.image.width, streamed.image.height);
+	float ratio = texels / std::max(screenPixels, 1.0f);
+	size_t level = ratio > 1.0f ? (size_t)std::floor(std::log2(ratio)) : 0;
+
+	streamed.pendingLevel = std::min(streamed.pendingLevel, std::min(level, streamed.image.getLevelCount() - 1));
+	streamed.requested = true;
+}
+
+// The finest level a texture should end up with. Ones nobody has sized, bound outside the scene's entities,
+// get every level, as does everything once streaming is switched off.
+size_t TextureStreaming::getTargetLevel(const StreamedTexture& streamed)
+{
+	if (!enabled || !streamed.requested) return 0;
+	return std::min(streamed.wantedLevel, streamed.image.getLevelCount() - 1);
+}
+
+void TextureStreaming::finishReads()
+{
+	if (!reader.valid() || reader.wait_for(std::chrono::seconds(0)) != std::future_status::ready) return;
+	reader.get();
+
+	for (const ReadJob& read : reads)
+	{
+		auto it = textures.find(read.tex);
+		if (it == textures.end() || !it->second.reading) continue;
+
+		it->second.readLevel = std::min(it->second.readLevel, read.first);
+		it->second.reading = false;
+	}
+	reads.clear();
+}
+
+void TextureStreaming::startReads()
+{
+	if (reader.valid()) return;
+
+	for (auto& it : textures)
+	{
+		StreamedTexture& streamed = it.second;
+		size_t target = getTargetLevel(streamed);
+		if (streamed.reading || streamed.readLevel <= target) continue;
+
+		// Each level on its own: containers may store them in any order, and pad between them
+		const MipmappedImageView& image = streamed.image;
+		for (size_t level = target; level < streamed.readLevel; level++)
+		{
+			reads.push_back({ it.first, level, level + 1, streamed.mapping, image.data + image.levelOffsets[level], image.levelSizes[level] });
+		}
+		streamed.reading = true;
+	}
+	if (reads.empty()) return;
+
+	// Faulting the pages in here means the GL thread's copy into the upload buffer never waits on the disk
+	std::vector<ReadJob> jobs = reads;
+	reader = std::async(std::launch::async, [jobs]()
+	{
+		for (const ReadJob& job : jobs) readPages(job.data, job.size);
+	});
+}
+
+void TextureStreaming::update()
+{
+	finishReads();
+
+	// A lowered budget, or textures loaded past it. Nothing bound after the last frame began is newer than this.
+	makeRoom(0, frame + 1);
+
+	// Furthest from its target first; textures nobody asked for go last
+	std::vector<std::pair<Texture2D*, StreamedTexture*>> queue;
+	stats.bytesPending = 0;
+	for (auto& it : textures)
+	{
+		StreamedTexture& streamed = it.second;
+		size_t target = getTargetLevel(streamed);
+		size_t base = it.first->getBaseLevel();
+		if (base <= target) continue;
+
+		if (streamed.requested) stats.bytesPending += getLevelsSize(streamed.image, target, base);
+		queue.push_back({ it.first, &streamed });
+	}
+	stats.streaming = (unsigned int)queue.size();
+
+	auto priority = [](const std::pair<Texture2D*, StreamedTexture*>& entry)
+	{
+		size_t missing = entry.first->getBaseLevel() - getTargetLevel(*entry.second);
+		return entry.second->requested ? missing + entry.second->image.getLevelCount() : missing;
+	};
+	std::stable_sort(queue.begin(), queue.end(), [&](const auto& a, const auto& b) { return priority(a) > priority(b); });
+
+	// One level at a time, each from the next coarser one up, so a texture never samples a hole
+	stats.bytesThisFrame = 0;
+	bool uploaded = true;
+	while (uploaded)
+	{
+		uploaded = false;
+		for (auto& entry : queue)
+		{
+			Texture2D* tex = entry.first;
+			StreamedTexture& streamed = *entry.second;
+			size_t base = tex->getBaseLevel();
+			if (base <= getTargetLevel(streamed)) continue;
+
+			// Switched off, the rest goes up now, read or not
+			size_t size = streamed.image.levelSizes[base - 1];
+			if (enabled && streamed.readLevel > base - 1) continue;
+			if (enabled && stats.bytesThisFrame > 0 && stats.bytesThisFrame + size > frameBudget) continue;
+			if (!makeRoom(size, streamed.lastBound)) continue;
+
+			tex->uploadLevels(streamed.image, base - 1, base);
+			stats.bytesThisFrame += size;
+			stats.bytesUploaded += size;
+			stats.residentBytes += size;
+			stats.uploads++;
+			uploaded = true;
+
+			if (base - 1 >= streamed.evictedLevel)
+			{
+				stats.reloads++;
+				std::cout << "Reloaded texture level " << base - 1 << " (" << size / 1024 << " KB): " << streamed.path << std::endl;
+			}
+		}
+	}
+
+	// Fully uploaded textures need their bytes no longer, unless they could be evicted
+	for (auto it = textures.begin(); it != textures.end() && residencyBudget == 0;)
+	{
+		if (it->first->getBaseLevel() == 0 && !it->second.reading)
+		{
+			stats.residentBytes -= getLevelBytes(it->first, it->second);
+			it = textures.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+
+	startReads();
+}
+
+const TextureStreamingStats& TextureStreaming::getStats()
+{
+	return stats;
+}
+
+void TextureStreaming::printStats()
+{
+	std::cout << "Texture streaming: " << stats.streaming << " textures streaming, " << stats.uploads << " levels uploaded ("
+		<< stats.bytesUploaded / 1024 << " KB), " << stats.bytesPending / 1024 << " KB wanted" << std::endl;
+
+	if (residencyBudget == 0) return;
+	std::cout << "Texture residency: " << stats.residentBytes / 1024 << " KB of " << residencyBudget / 1024 << " KB, "
+		<< stats.evictions << " levels evicted (" << stats.bytesEvicted / 1024 << " KB), " << stats.reloads << " reloaded" << std::endl;
+}
\ No newline at end of file
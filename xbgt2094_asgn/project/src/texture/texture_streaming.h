@@ -0,0 +1,143 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "texture2d.h"
+#include "../framework/file_utils.h"
+
+struct TextureStreamingStats
+{
+	unsigned int streaming;		// textures with levels still to upload
+	unsigned int uploads;		// levels uploaded since load
+	size_t bytesUploaded;		// by those uploads
+	size_t bytesThisFrame;		// uploaded by the last update
+	size_t bytesPending;		// levels the requests want that are not uploaded yet
+
+	size_t residentBytes;		// every level on the GPU of the textures managed here
+	unsigned int evictions;		// levels dropped to stay within the residency budget
+	unsigned int reloads;		// dropped levels uploaded again
+	size_t bytesEvicted;
+};
+
+// Mipmapped textures come up with only their small levels, and the finer ones follow a few per frame.
+// Each frame the scene says how many pixels every texture covers on screen, now and where the camera is heading;
+// that picks the finest level worth having. Levels are read on a worker thread, so faulting in a mapped
+// .texcache or container never stalls a frame, and uploaded on the GL thread under a per-frame byte budget,
+// the texture furthest from what it needs first.
+// With a residency budget the resident levels of all those textures are capped: the finest levels of the
+// textures least recently bound through SimpleRenderer go first, and come back through the same uploads when
+// they are wanted again. Levels no bigger than TAIL_SIZE always stay.
+class TextureStreaming
+{
+public:
+	// Off by default, when every level is uploaded at load. Switching it off uploads what is left on the next update.
+	static void setEnabled(bool enabled);
+	static bool isEnabled();
+
+	static void setFrameBudget(size_t bytes);
+	static size_t getFrameBudget();
+
+	// 0, the default, for no cap. Only textures loaded while it is set can drop levels, so set it before loading.
+	static void setResidencyBudget(size_t bytes);
+	static size_t getResidencyBudget();
+
+	// The level uploaded at load: the largest no bigger than TAIL_SIZE, or the first when not streaming or
+	// cfg has no mipmaps. Safe on any thread.
+	static size_t getFirstLevel(const MipmappedImageView& image, const TextureConfig& cfg);
+
+	// Whether a texture with this image and config is managed here, and so must be created resizable
+	static bool isManaged(const MipmappedImageView& image, const TextureConfig& cfg);
+
+	// Bytes of levels [first, last) of image. They need not be next to each other or in order: KTX2 stores the
+	// smallest first.
+	static size_t getLevelsSize(const MipmappedImageView& image, size_t first, size_t last);
+	// Faults in the pages of levels [first, last), one level at a time, as the worker does before they are
+	// uploaded. Safe on any thread.
+	static void readLevels(const MipmappedImageView& image, size_t first, size_t last);
+
+	// Takes over the levels of a managed texture. image points into mapping, or into levels; either is kept
+	// until the last level is uploaded, or for as long as the texture lives with a residency budget.
+	static void add(Texture2D* tex, const std::string& path, const MipmappedImageView& image,
+		std::shared_ptr<FileUtils::MappedFile> mapping, MipmappedImage&& levels);
+	// Drops whatever is left to upload, for a texture about to be deleted
+	static void forget(Texture2D* tex);
+
+	// Call once a frame before any request. Tracks the camera to predict where it will be.
+	static void beginFrame(const glm::vec3& cameraPosition, float deltaTime);
+	// Where the camera is expected to be PREFETCH_SECONDS from now, at its current velocity
+	static glm::vec3 getPrefetchPosition();
+	// tex covers screenPixels pixels across; the finest request of the frame wins
+	static void request(Texture2D* tex, float screenPixels);
+	// Called by SimpleRenderer on every bind, for the least recently used order
+	static void markBound(Texture2D* tex);
+
+	// Bytes of the levels tex has on the GPU; 0 for textures not managed here
+	static size_t getResidentBytes(Texture2D* tex);
+
+	// GL thread only. Evicts down to the residency budget, queues reads for the levels the last frame's requests
+	// want, and uploads read levels within the frame budget, at least one per call so a small budget still makes
+	// progress. An upload only evicts levels of textures bound less recently than its own.
+	static void update();
+
+	static const TextureStreamingStats& getStats();
+	static void printStats();
+
+private:
+	static constexpr int TAIL_SIZE = 64;
+	static constexpr float PREFETCH_SECONDS = 0.5f;
+
+	struct StreamedTexture
+	{
+		std::string path;		// for the log
+		MipmappedImageView image;
+		std::shared_ptr<FileUtils::MappedFile> mapping;
+		MipmappedImage levels;
+
+		size_t readLevel;		// finest level whose bytes have been read in
+		bool reading;
+		size_t wantedLevel;		// from the last frame's requests; getLevelCount() when nothing asked
+		size_t pendingLevel;	// from this frame's requests so far
+		bool requested;			// ever; textures nobody sizes stream in fully, last
+
+		size_t tailLevel;		// never evicted
+		size_t evictedLevel;	// finest level ever evicted; getLevelCount() when none was
+		uint64_t lastBound;		// frame
+	};
+
+	// Levels [first, last) of one texture, read on the worker; one job per level, as levels need not be adjacent
+	struct ReadJob
+	{
+		Texture2D* tex;
+		size_t first, last;
+		std::shared_ptr<FileUtils::MappedFile> mapping;	// keeps the bytes alive should the texture be forgotten
+		const unsigned char* data;
+		size_t size;
+	};
+
+	static bool enabled;
+	static size_t frameBudget;
+	static size_t residencyBudget;
+	static uint64_t frame;
+	static std::map<Texture2D*, StreamedTexture> textures;
+	static TextureStreamingStats stats;
+
+	static glm::vec3 lastCameraPosition;
+	static glm::vec3 cameraVelocity;
+	static bool cameraTracked;
+
+	static std::vector<ReadJob> reads;	// being read by the worker
+	static std::future<void> reader;
+
+	static void finishReads();
+	static void startReads();
+	static size_t getTargetLevel(const StreamedTexture& streamed);
+	static size_t getTailLevel(const MipmappedImageView& image);
+	static size_t getLevelBytes(Texture2D* tex, const StreamedTexture& streamed);
+	static void evictLevel(Texture2D* tex, StreamedTexture& streamed);
+	static bool makeRoom(size_t bytes, uint64_t boundBefore);
+};
\ No newline at end of file
@@ -2,62 +2,834 @@
 #include <glad/glad.h>
 #include <stb_image/stb_image.h>
 #include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include "../framework/bench_utils.h"
+#include "../framework/file_utils.h"
+#include "../framework/job_utils.h"
+#include "../framework/load_arena.h"
+#include "mip_chain.h"
+#include "texture_compressor.h"
+#include "texture_container.h"
+#include "texture_streaming.h"
 
-namespace TextureUtils
+// Everything besides the pixels that decides whether two loads can share a texture
+struct TextureSettings
 {
-	Texture2D* loadTexture2D(const std::string& path, TextureConfig cfg)
+	GLint internalFormat;
+	GLint hWrap;
+	GLint vWrap;
+	GLint textureFilter;
+	bool mipmap;
+	TextureCompression compression;
+	TextureMipFilter mipFilter;
+	float alphaCoverage;
+
+	bool operator<(const TextureSettings& other) const
 	{
-		stbi_set_flip_vertically_on_load(true); // tell stb_image.h to flip loaded texture's on the y-axis.
+		return std::tie(internalFormat, hWrap, vWrap, textureFilter, mipmap, compression, mipFilter, alphaCoverage) <
+			std::tie(other.internalFormat, other.hWrap, other.vWrap, other.textureFilter, other.mipmap, other.compression, other.mipFilter, other.alphaCoverage);
+	}
+};
 
-		Texture2D* tex = 0;
+struct TextureCacheEntry
+{
+	unsigned int references;
+	size_t gpuBytes;
+	size_t uncompressedBytes;
+};
+
+typedef std::pair<std::string, TextureSettings> TexturePathKey;
+typedef std::tuple<uint64_t, size_t, TextureSettings> TextureContentKey;	// hash and size of the file
+
+static std::map<TexturePathKey, Texture2D*> texturesByPath;
+static std::map<TextureContentKey, Texture2D*> texturesByContent;
+static std::map<Texture2D*, TextureCacheEntry> textureEntries;
+static TextureCacheStats textureCacheStats = {};
+
+static Texture2D* addReference(Texture2D* tex)
+{
+	TextureCacheEntry& entry = textureEntries[tex];
+	entry.references++;
+	textureCacheStats.gpuBytesSaved += entry.gpuBytes;
+	return tex;
+}
+
+static TextureSettings getSettings(const TextureConfig& cfg)
+{
+	return { cfg.internalFormat, cfg.hWrap, cfg.vWrap, cfg.textureFilter, cfg.mipmap, cfg.compression, cfg.mipFilter, cfg.alphaCoverage };
+}
+
+static const size_t PACKED_CHANNEL_COUNT = 3;
+
+// Everything one texture is made from: an image file, or a file or constant for each channel when packed
+struct TextureSource
+{
+	std::string path;						// as requested; the channels joined with '|' when packed
+	std::vector<TextureChannel> channels;	// empty unless packed
+	FileUtils::MappedFile files[PACKED_CHANNEL_COUNT];	// only the first unless packed
+};
+
+static std::string joinChannels(const std::vector<TextureChannel>& channels, bool normalise)
+{
+	std::string joined;
+	for (size_t i = 0; i < channels.size(); i++)
+	{
+		if (i > 0) joined += '|';
+
+		if (channels[i].path.empty()) joined += "#" + std::to_string(channels[i].value);
+		else if (normalise) joined += std::filesystem::path(channels[i].path).lexically_normal().generic_string();
+		else joined += channels[i].path;
+	}
+	return joined;
+}
+
+// Packed paths are normalised one channel at a time, so a ".." cannot reach across a '|'
+static TexturePathKey makePathKey(const std::string& path, const std::vector<TextureChannel>& channels, const TextureConfig& cfg)
+{
+	if (!channels.empty()) return TexturePathKey(joinChannels(channels, true), getSettings(cfg));
+	return TexturePathKey(std::filesystem::path(path).lexically_normal().generic_string(), getSettings(cfg));
+}
+
+// Fails if any file is missing, or if a packed source has no file at all
+static bool openSource(TextureSource& source)
+{
+	if (source.channels.empty()) return source.files[0].open(source.path);
+
+	bool anyFile = false;
+	for (size_t c = 0; c < source.channels.size(); c++)
+	{
+		if (source.channels[c].path.empty()) continue;
+		if (!source.files[c].open(source.channels[c].path)) return false;
+		anyFile = true;
+	}
+	return anyFile;
+}
+
+static TextureContentKey makeContentKey(const TextureSource& source, const TextureConfig& cfg)
+{
+	const FileUtils::MappedFile& file = source.files[0];
+	if (source.channels.empty()) return TextureContentKey(FileUtils::hashBytes(file.data(), file.size()), file.size(), getSettings(cfg));
+
+	// Every channel's size and bytes, or its constant, in order; the marker keeps packed keys apart from single files
+	uint64_t hash = FileUtils::hashBytes("packed", 6);
+	size_t size = 0;
+	for (size_t c = 0; c < source.channels.size(); c++)
+	{
+		if (source.channels[c].path.empty())
+		{
+			hash = FileUtils::hashBytes(&source.channels[c].value, 1, hash);
+			continue;
+		}
+
+		uint64_t channelSize = source.files[c].size();
+		hash = FileUtils::hashBytes(&channelSize, sizeof(channelSize), hash);
+		hash = FileUtils::hashBytes(source.files[c].data(), source.files[c].size(), hash);
+		size += source.files[c].size();
+	}
+	return TextureContentKey(hash, size, getSettings(cfg));
+}
+
+static Texture2D* findByPath(const TexturePathKey& pathKey)
+{
+	auto byPath = texturesByPath.find(pathKey);
+	if (byPath == texturesByPath.end()) return 0;
+
+	textureCacheStats.hits++;
+	return addReference(byPath->second);
+}
+
+static Texture2D* findByContent(const TextureContentKey& contentKey, const TexturePathKey& pathKey, const std::string& path, const char* label)
+{
+	auto byContent = texturesByContent.find(contentKey);
+	if (byContent == texturesByContent.end()) return 0;
+
+	texturesByPath[pathKey] = byContent->second;
+	textureCacheStats.contentHits++;
+	std::cout << "Shared texture" << label << ": " << path << " (same contents as an already loaded file)" << std::endl;
+	return addReference(byContent->second);
+}
+
+// Safe on any thread: everything it touches is local or thread-local to stb_image
+static unsigned char* decodeImage(const FileUtils::MappedFile& file, int* width, int* height, double* decodeMs)
+{
+	stbi_set_flip_vertically_on_load_thread(true); // tell stb_image.h to flip loaded texture's on the y-axis.
+
+	auto start = std::chrono::steady_clock::now();
+	int nrChannels;
+	unsigned char* data = stbi_load_from_memory(file.data(), (int)file.size(), width, height, &nrChannels, 4);
+	*decodeMs = BenchUtils::getElapsedMs(start);
+	return data;
+}
+
+// Safe on any thread. Packed sources are built in the buffer of their first decoded file.
+static unsigned char* decodeSource(const TextureSource& source, int* width, int* height, double* decodeMs)
+{
+	if (source.channels.empty()) return decodeImage(source.files[0], width, height, decodeMs);
+
+	unsigned char* channelPixels[PACKED_CHANNEL_COUNT] = {};
+	unsigned char* packed = nullptr;
+	bool failed = false;
+	*decodeMs = 0.0;
+
+	for (size_t c = 0; c < PACKED_CHANNEL_COUNT && !failed; c++)
+	{
+		if (source.channels[c].path.empty()) continue;
+
+		int channelWidth, channelHeight;
+		double channelMs;
+		channelPixels[c] = decodeImage(source.files[c], &channelWidth, &channelHeight, &channelMs);
+		*decodeMs += channelMs;
+
+		if (!channelPixels[c])
+		{
+			failed = true;
+		}
+		else if (!packed)
+		{
+			packed = channelPixels[c];
+			*width = channelWidth;
+			*height = channelHeight;
+		}
+		else if (channelWidth != *width || channelHeight != *height)
+		{
+			std::cout << "Packed channel is " << channelWidth << "x" << channelHeight << " instead of " << *width << "x" << *height
+				<< ": " << source.channels[c].path << std::endl;
+			failed = true;
+		}
+	}
+
+	if (!failed && packed)
+	{
+		size_t pixelCount = (size_t)*width * *height;
+		for (size_t i = 0; i < pixelCount; i++)
+		{
+			// Read every channel before writing, since packed is also one of the sources
+			unsigned char values[PACKED_CHANNEL_COUNT];
+			for (size_t c = 0; c < PACKED_CHANNEL_COUNT; c++)
+			{
+				values[c] = channelPixels[c] ? channelPixels[c][i * 4] : source.channels[c].value;
+			}
+			for (size_t c = 0; c < PACKED_CHANNEL_COUNT; c++)
+			{
+				packed[i * 4 + c] = values[c];
+			}
+			packed[i * 4 + 3] = 255;
+		}
+	}
+
+	for (unsigned char* pixels : channelPixels)
+	{
+		if (pixels && (failed || pixels != packed)) stbi_image_free(pixels);
+	}
+	return failed ? nullptr : packed;
+}
+
+// Packed textures are cooked next to their first file, under a name that depends on all of their channels
+static std::string getCookPath(const TextureSource& source)
+{
+	if (source.channels.empty()) return source.path;
+
+	std::string joined = joinChannels(source.channels, true);
+	char suffix[16];
+	snprintf(suffix, sizeof(suffix), ".%08x", (unsigned int)FileUtils::hashBytes(joined.data(), joined.size()));
+
+	for (const TextureChannel& channel : source.channels)
+	{
+		if (!channel.path.empty()) return channel.path + suffix;
+	}
+	return source.path;
+}
+
+// What gets uploaded for one file: its RGBA8 or block compressed mip chain
+struct TextureImage
+{
+	int width = 0, height = 0;
+	double decodeMs = 0.0;
+	double mipMs = 0.0;
+
+	bool fromCache = false;			// read from the .texcache rather than cooked now
+	bool fromContainer = false;		// a .dds or .ktx2, uploaded as it is
+	bool srgb = false;				// the container says its colour is sRGB
 
-		static int width, height, nrChannels;
-		unsigned char* data = stbi_load(path.c_str(), &width, &height, &nrChannels, 4);
-		if (data)
+	std::shared_ptr<FileUtils::MappedFile> mapping;	// backs view when fromCache or fromContainer
+	MipmappedImage levels;							// backs view when cooked or decoded now
+	MipmappedImageView view = {};		// what gets uploaded; points into the source file for containers
+	TextureCompressionReport report = {};
+};
+
+// Faults a mapping in on this thread, so the GL thread's copy into the upload buffer does not wait on the disk.
+// Levels above firstLevel are left for streaming to read.
+static void touchLevels(const MipmappedImageView& view, size_t firstLevel)
+{
+	static const size_t PAGE_SIZE = 4096;
+	volatile unsigned char sink = 0;
+	for (size_t level = firstLevel; level < view.getLevelCount(); level++)
+	{
+		const unsigned char* data = view.data + view.levelOffsets[level];
+		for (size_t offset = 0; offset < view.levelSizes[level]; offset += PAGE_SIZE) sink = sink + data[offset];
+	}
+}
+
+// Safe on any thread. DDS and KTX2 files are parsed in place. Mipmapped or compressed configs use the cooked
+// .texcache when it matches the file, else decode, build the mip chain, compress it and write it. Returns false
+// when the file could not be read.
+static bool prepareImage(const TextureSource& source, const TextureContentKey& contentKey, const TextureConfig& cfg,
+	unsigned int threadCount, TextureImage& image)
+{
+	if (source.channels.empty() && TextureContainerUtils::isContainerPath(source.path))
+	{
+		// Cooked by another tool, so its levels go up exactly as the file has them. The image keeps a mapping of
+		// its own, which streaming can hold on to after the source is closed.
+		image.mapping = std::make_shared<FileUtils::MappedFile>();
+		if (!image.mapping->open(source.path)) return false;
+		if (!TextureContainerUtils::parse(image.mapping->data(), image.mapping->size(), source.path, image.view, &image.srgb)) return false;
+
+		image.fromContainer = true;
+		image.width = image.view.width;
+		image.height = image.view.height;
+		touchLevels(image.view, TextureStreaming::getFirstLevel(image.view, cfg));
+		return true;
+	}
+
+	std::string cookPath = getCookPath(source);
+	uint64_t sourceHash = std::get<0>(contentKey);
+	uint64_t sourceSize = std::get<1>(contentKey);
+
+	// Compressed textures are always cooked with every level, so a chain serves mipmapped and plain configs alike
+	MipSettings mips = MipChainUtils::getSettings(cfg);
+	bool cooked = cfg.compression != TextureCompression::NONE || cfg.mipmap;
+
+	image.mapping = std::make_shared<FileUtils::MappedFile>();
+	if (cooked && TextureCompressorUtils::loadCache(cookPath, cfg.compression, mips, sourceSize, sourceHash, *image.mapping, image.view))
+	{
+		image.fromCache = true;
+		image.width = image.view.width;
+		image.height = image.view.height;
+		touchLevels(image.view, TextureStreaming::getFirstLevel(image.view, cfg));
+		return true;
+	}
+
+	image.mapping.reset();
+
+	{
+		// The decoded pixels and stb_image's own buffers are scratch for this image only
+		LoadArenaScope arenaScope(LoadArena::forThread());
+
+		unsigned char* pixels = decodeSource(source, &image.width, &image.height, &image.decodeMs);
+		if (!pixels) return false;
+
+		if (cooked)
 		{
-			cfg.internalFormat = GL_RGBA;
-			tex = Texture2D::createColourTexture(width, height, cfg, GL_RGBA, data);
-			std::cout << "Loaded texture: " << path << std::endl;
+			auto start = std::chrono::steady_clock::now();
+			MipChainUtils::generate(pixels, image.width, image.height, mips, image.levels);
+			image.mipMs = BenchUtils::getElapsedMs(start);
 		}
 		else
 		{
-			std::cout << "Failed to load texture: " << path << std::endl;
+			MipChainUtils::createBaseLevel(pixels, image.width, image.height, image.levels);
 		}
+		stbi_image_free(pixels);
+	}
 
-		// Free memory after we send the data to GPU.
-		stbi_image_free(data);
+	if (cfg.compression != TextureCompression::NONE)
+	{
+		MipmappedImage blocks;
+		TextureCompressorUtils::compress(image.levels, cfg.compression, blocks, &image.report, threadCount);
+		image.levels = std::move(blocks);
+	}
+
+	if (cooked) TextureCompressorUtils::saveCache(cookPath, cfg.compression, mips, sourceSize, sourceHash, image.levels);
+	image.view = image.levels.getView();
+	return true;
+}
+
+// GL thread only. Frees the image's levels.
+static Texture2D* uploadImage(const TexturePathKey& pathKey, const TextureContentKey& contentKey, const TextureConfig& cfg,
+	TextureImage& image, const std::string& path, const char* label)
+{
+	// A full mip chain adds a third
+	size_t uncompressedBytes = (size_t)image.width * image.height * 4;
+	if (cfg.mipmap) uncompressedBytes += uncompressedBytes / 3;
+
+	// A container's own colour space wins over the config's
+	TextureConfig uploadCfg = cfg;
+	if (image.srgb) uploadCfg.internalFormat = GL_SRGB_ALPHA;
+
+	// While streaming only the small levels go up now
+	const MipmappedImageView& view = image.view;
+	size_t firstLevel = TextureStreaming::getFirstLevel(view, cfg);
+	Texture2D* tex = Texture2D::createMipmappedTexture(view, uploadCfg, firstLevel, TextureStreaming::isManaged(view, cfg));
+
+	size_t gpuBytes = 0;
+	for (size_t level = 0; level < (cfg.mipmap ? view.getLevelCount() : 1); level++) gpuBytes += view.levelSizes[level];
+
+	std::cout << "Loaded texture" << label << ": " << path;
+	bool compressed = view.format != GL_RGBA8;
+	if (image.fromContainer)
+	{
+		std::cout << " (" << TextureCompressorUtils::getFormatName(view.format) << ", " << view.getLevelCount() << " levels from the container)";
+	}
+	else if (compressed || cfg.mipmap)
+	{
+		std::cout << " (" << TextureCompressorUtils::getFormatName(view.format);
+		if (image.fromCache)
+		{
+			std::cout << ", cached";
+		}
+		else
+		{
+			std::cout << ", mips in " << image.mipMs << " ms";
+			if (compressed) std::cout << ", cooked in " << image.report.encodeMs << " ms, PSNR " << image.report.psnr << " dB";
 
-		return tex;
+			textureCacheStats.cooked++;
+			textureCacheStats.mipMs += image.mipMs;
+			textureCacheStats.compressMs += image.report.encodeMs;
+		}
+		std::cout << ")";
 	}
+	if (tex->getBaseLevel() > 0) std::cout << " streaming from level " << tex->getBaseLevel();
+	std::cout << std::endl;
 
-	Texture2D* loadTexture2D(const std::string& path)
+	// Nothing needs the pixels once they are staged, unless levels are left to stream or may be evicted
+	if (TextureStreaming::isManaged(view, cfg)) TextureStreaming::add(tex, path, view, image.mapping, std::move(image.levels));
+	image.view = {};
+	image.levels = MipmappedImage();
+	image.mapping.reset();
+
+	textureEntries[tex] = { 1, gpuBytes, uncompressedBytes };
+	texturesByPath[pathKey] = tex;
+	texturesByContent[contentKey] = tex;
+
+	textureCacheStats.misses++;
+	textureCacheStats.gpuBytes += gpuBytes;
+	textureCacheStats.gpuBytesUncompressed += uncompressedBytes;
+	return tex;
+}
+
+static const char* getLabel(const TextureConfig& cfg)
+{
+	return cfg.internalFormat == GL_SRGB_ALPHA ? " (sRGBA)" : "";
+}
+
+// Looks the texture up by path, then by file contents, and only decodes and uploads when both miss.
+static Texture2D* loadTexture2DCached(const std::string& path, const std::vector<TextureChannel>& channels, TextureConfig cfg)
+{
+	const char* label = getLabel(cfg);
+	TexturePathKey pathKey = makePathKey(path, channels, cfg);
+
+	if (Texture2D* tex = findByPath(pathKey)) return tex;
+
+	TextureSource source;
+	source.path = path;
+	source.channels = channels;
+	if (!openSource(source))
 	{
-		return loadTexture2D(path, TextureConfig());
+		std::cout << "Failed to load texture" << label << ": " << path << std::endl;
+		return 0;
 	}
 
-	Texture2D* loadTexture2D_sRGBA(const std::string& path, TextureConfig cfg)
+	TextureContentKey contentKey = makeContentKey(source, cfg);
+	if (Texture2D* tex = findByContent(contentKey, pathKey, path, label)) return tex;
+
+	TextureImage image;
+	bool prepared = prepareImage(source, contentKey, cfg, 0, image);
+	textureCacheStats.decodeMs += image.decodeMs;
+
+	if (!prepared)
 	{
-		stbi_set_flip_vertically_on_load(true); // tell stb_image.h to flip loaded texture's on the y-axis.
+		std::cout << "Failed to load texture" << label << ": " << path << std::endl;
+		return 0;
+	}
 
-		Texture2D* tex = 0;
+	return uploadImage(pathKey, contentKey, cfg, image, path, label);
+}
+
+#pragma region Batch
+
+// One distinct file of a batch. Several requests can share a job.
+struct TextureJob
+{
+	size_t request = 0;			// first request that asked for it
+	TexturePathKey pathKey;
+	TextureContentKey contentKey;
+	TextureSource source;
+	bool opened = false;
+
+	size_t alias = 0;				// earlier job with the same contents, or itself
+	Texture2D* cached = nullptr;	// already loaded under another path
+
+	TextureImage image;
+	bool prepared = false;
+	bool decoded = false;
+
+	Texture2D* result = nullptr;
+};
+
+void TextureBatch::add(Texture2D** target, const std::string& path, TextureConfig cfg)
+{
+	cfg.internalFormat = GL_RGBA;
+	requests.push_back({ target, path, cfg, {} });
+}
+
+void TextureBatch::add_sRGBA(Texture2D** target, const std::string& path, TextureConfig cfg)
+{
+	cfg.internalFormat = GL_SRGB_ALPHA;
+	requests.push_back({ target, path, cfg, {} });
+}
+
+void TextureBatch::addPacked(Texture2D** target, const TextureChannel& r, const TextureChannel& g, const TextureChannel& b, TextureConfig cfg)
+{
+	cfg.internalFormat = GL_RGBA;
+	std::vector<TextureChannel> channels = { r, g, b };
+	requests.push_back({ target, joinChannels(channels, false), cfg, channels });
+}
+
+size_t TextureBatch::size() const
+{
+	return requests.size();
+}
+
+void TextureBatch::load(unsigned int threadCount)
+{
+	if (requests.empty()) return;
+	if (threadCount == 0) threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+	auto start = std::chrono::steady_clock::now();
+
+	// Requests already cached, or repeated within the batch, need no job of their own
+	std::vector<size_t> requestJob(requests.size(), SIZE_MAX);
+	std::map<TexturePathKey, size_t> jobByPath;
+	std::vector<size_t> jobRequests;
+
+	for (size_t i = 0; i < requests.size(); i++)
+	{
+		TexturePathKey pathKey = makePathKey(requests[i].path, requests[i].channels, requests[i].cfg);
+		if (texturesByPath.count(pathKey)) continue;
+
+		auto inserted = jobByPath.emplace(pathKey, jobRequests.size());
+		if (inserted.second) jobRequests.push_back(i);
+		requestJob[i] = inserted.first->second;
+	}
+
+	// Constructed in place once; MappedFile cannot move
+	std::vector<TextureJob> jobs(jobRequests.size());
+
+	// Map and hash the files in parallel
+	JobUtils::run(jobs.size(), threadCount, [&](size_t j)
+	{
+		TextureJob& job = jobs[j];
+		const TextureRequest& request = requests[jobRequests[j]];
+
+		job.request = jobRequests[j];
+		job.pathKey = makePathKey(request.path, request.channels, request.cfg);
+		job.source.path = request.path;
+		job.source.channels = request.channels;
+		job.opened = openSource(job.source);
+		if (job.opened) job.contentKey = makeContentKey(job.source, request.cfg);
+	});
+
+	// Files with the same contents as a loaded texture or an earlier job are not decoded
+	std::map<TextureContentKey, size_t> jobByContent;
+	std::vector<size_t> decodeJobs;
 
-		static int width, height, nrChannels;
-		unsigned char* data = stbi_load(path.c_str(), &width, &height, &nrChannels, 4);
-		if (data)
+	for (size_t j = 0; j < jobs.size(); j++)
+	{
+		TextureJob& job = jobs[j];
+		job.alias = j;
+		if (!job.opened) continue;
+
+		if (texturesByContent.count(job.contentKey))
+		{
+			job.cached = texturesByContent[job.contentKey];
+			continue;
+		}
+
+		auto inserted = jobByContent.emplace(job.contentKey, j);
+		job.alias = inserted.first->second;
+		if (inserted.second) decodeJobs.push_back(j);
+	}
+
+	// Workers decode (and cook, for compressed configs) while this thread, which owns the GL context, uploads each
+	// image as soon as it and every image before it are ready, so textures are created in the order they were added.
+	// Files are already spread over the workers, so each cooks its blocks on its own thread.
+	std::mutex mutex;
+	std::condition_variable decodedSignal;
+	std::atomic<size_t> next(0);
+	double decodeMs = 0.0;
+
+	auto decode = [&]()
+	{
+		for (size_t k = next++; k < decodeJobs.size(); k = next++)
+		{
+			TextureJob& job = jobs[decodeJobs[k]];
+			const TextureRequest& request = requests[job.request];
+			job.prepared = prepareImage(job.source, job.contentKey, request.cfg, 1, job.image);
+
+			std::lock_guard<std::mutex> lock(mutex);
+			job.decoded = true;
+			decodedSignal.notify_all();
+		}
+	};
+
+	std::vector<std::thread> workers;
+	for (size_t i = 0; i < std::min<size_t>(threadCount, decodeJobs.size()); i++)
+	{
+		workers.emplace_back(decode);
+	}
+
+	for (size_t j = 0; j < jobs.size(); j++)
+	{
+		TextureJob& job = jobs[j];
+		const TextureRequest& request = requests[job.request];
+		const char* label = getLabel(request.cfg);
+
+		if (!job.opened)
+		{
+			std::cout << "Failed to load texture" << label << ": " << request.path << std::endl;
+			continue;
+		}
+
+		if (job.cached || job.alias != j)
+		{
+			// Shares the texture of a loaded file or of an earlier job in this batch
+			Texture2D* shared = job.cached ? job.cached : jobs[job.alias].result;
+			if (shared)
+			{
+				texturesByPath[job.pathKey] = shared;
+				textureCacheStats.contentHits++;
+				std::cout << "Shared texture" << label << ": " << request.path << " (same contents as an already loaded file)" << std::endl;
+				job.result = addReference(shared);
+			}
+			continue;
+		}
+
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			decodedSignal.wait(lock, [&]() { return job.decoded; });
+		}
+
+		decodeMs += job.image.decodeMs;
+		if (!job.prepared)
+		{
+			std::cout << "Failed to load texture" << label << ": " << request.path << std::endl;
+			continue;
+		}
+
+		job.result = uploadImage(job.pathKey, job.contentKey, request.cfg, job.image, request.path, label);
+	}
+
+	for (std::thread& worker : workers)
+	{
+		worker.join();
+	}
+
+	// Every request holds one reference; the first request of each job already got it on creation
+	for (size_t i = 0; i < requests.size(); i++)
+	{
+		Texture2D* tex = 0;
+		if (requestJob[i] == SIZE_MAX)
 		{
-			cfg.internalFormat = GL_SRGB_ALPHA;
-			tex = Texture2D::createColourTexture(width, height, cfg, GL_RGBA, data);
-			std::cout << "Loaded texture (sRGBA): " << path << std::endl;
+			tex = findByPath(makePathKey(requests[i].path, requests[i].channels, requests[i].cfg));
 		}
 		else
 		{
-			std::cout << "Failed to load texture (sRGBA): " << path << std::endl;
+			TextureJob& job = jobs[requestJob[i]];
+			tex = job.result;
+			if (tex && job.request != i) tex = findByPath(job.pathKey);
+		}
+		*requests[i].target = tex;
+	}
+
+	textureCacheStats.decodeMs += decodeMs;
+	std::cout << "Loaded " << requests.size() << " textures (" << decodeJobs.size() << " decoded) in " << BenchUtils::getElapsedMs(start) << " ms, "
+		<< decodeMs << " ms decoding on " << std::min<size_t>(threadCount, std::max<size_t>(1, decodeJobs.size())) << " threads" << std::endl;
+
+	requests.clear();
+}
+
+#pragma endregion
+
+#pragma region Material Arrays
+
+unsigned int MaterialArrayPacker::add(const std::string& diffuse, const std::string& normal,
+	const TextureChannel& specular, const TextureChannel& ao, const TextureChannel& emissive)
+{
+	materials.push_back({ diffuse, normal, { specular, ao, emissive } });
+	return (unsigned int)materials.size() - 1;
+}
+
+size_t MaterialArrayPacker::size() const
+{
+	return materials.size();
+}
+
+// The size most maps have, the largest of those tied, so as few as possible are resampled
+static std::pair<int, int> getCommonSize(const std::vector<std::pair<int, int>>& sizes)
+{
+	std::map<std::pair<int, int>, unsigned int> counts;
+	for (const auto& size : sizes) counts[size]++;
+
+	std::pair<int, int> common = sizes[0];
+	for (const auto& count : counts)
+	{
+		unsigned int best = counts[common];
+		bool larger = (size_t)count.first.first * count.first.second > (size_t)common.first * common.second;
+		if (count.second > best || (count.second == best && larger)) common = count.first;
+	}
+	return common;
+}
+
+bool MaterialArrayPacker::pack(MaterialArrays& arrays, const TextureConfig& diffuseCfg, const TextureConfig& materialCfg,
+	const TextureConfig& normalCfg, unsigned int threadCount)
+{
+	arrays = {};
+	if (materials.empty()) return false;
+	if (threadCount == 0) threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+	auto start = std::chrono::steady_clock::now();
+
+	// Map i of kind k is source k * count + i, so each kind's layers are together
+	static const size_t KIND_COUNT = 3;
+	const TextureConfig* cfgs[KIND_COUNT] = { &diffuseCfg, &materialCfg, &normalCfg };
+	const char* kindNames[KIND_COUNT] = { "diffuse", "material", "normal" };
+	size_t count = materials.size();
+
+	// Constructed in place once; MappedFile cannot move
+	std::vector<TextureSource> sources(count * KIND_COUNT);
+	for (size_t i = 0; i < count; i++)
+	{
+		sources[i].path = materials[i].diffuse;
+		sources[count + i].channels = materials[i].channels;
+		sources[count + i].path = joinChannels(materials[i].channels, false);
+		sources[2 * count + i].path = materials[i].normal;
+	}
+
+	std::vector<std::vector<unsigned char>> pixels(sources.size());
+	std::vector<std::pair<int, int>> sizes(sources.size());
+	std::vector<char> failed(sources.size(), 0);
+
+	JobUtils::run(sources.size(), threadCount, [&](size_t s)
+	{
+		LoadArenaScope arenaScope(LoadArena::forThread());
+
+		int width = 0, height = 0;
+		double decodeMs;
+		unsigned char* decoded = openSource(sources[s]) ? decodeSource(sources[s], &width, &height, &decodeMs) : nullptr;
+		if (!decoded)
+		{
+			failed[s] = 1;
+			return;
+		}
+
+		pixels[s].assign(decoded, decoded + (size_t)width * height * 4);
+		sizes[s] = { width, height };
+		stbi_image_free(decoded);
+	});
+
+	for (size_t s = 0; s < sources.size(); s++)
+	{
+		if (failed[s])
+		{
+			std::cout << "Failed to load texture for a material array: " << sources[s].path << std::endl;
+			return false;
+		}
+	}
+
+	// Maps of another size are resampled to the common one, then mipmapped as a single texture would be
+	std::pair<int, int> layerSizes[KIND_COUNT];
+	unsigned int resampled = 0;
+	for (size_t k = 0; k < KIND_COUNT; k++)
+	{
+		layerSizes[k] = getCommonSize(std::vector<std::pair<int, int>>(sizes.begin() + k * count, sizes.begin() + (k + 1) * count));
+		for (size_t i = 0; i < count; i++) resampled += sizes[k * count + i] != layerSizes[k];
+	}
+
+	std::vector<MipmappedImage> layers(sources.size());
+	JobUtils::run(sources.size(), threadCount, [&](size_t s)
+	{
+		const TextureConfig& cfg = *cfgs[s / count];
+		std::pair<int, int> size = layerSizes[s / count];
+		MipSettings mips = MipChainUtils::getSettings(cfg);
+
+		std::vector<unsigned char> rgba;
+		MipChainUtils::resample(pixels[s].data(), sizes[s].first, sizes[s].second, size.first, size.second, mips, rgba);
+		pixels[s].clear();
+
+		if (cfg.mipmap) MipChainUtils::generate(rgba.data(), size.first, size.second, mips, layers[s]);
+		else MipChainUtils::createBaseLevel(rgba.data(), size.first, size.second, layers[s]);
+	});
+
+	// One format per array: BC3 for every layer when any one needs alpha
+	GLenum formats[KIND_COUNT];
+	for (size_t k = 0; k < KIND_COUNT; k++)
+	{
+		formats[k] = GL_RGBA8;
+		if (cfgs[k]->compression == TextureCompression::NONE) continue;
+
+		formats[k] = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+		for (size_t i = 0; i < count; i++)
+		{
+			GLenum format = TextureCompressorUtils::chooseFormat(layers[k * count + i], cfgs[k]->compression);
+			if (format != GL_COMPRESSED_RGB_S3TC_DXT1_EXT) formats[k] = format;
 		}
+	}
+
+	JobUtils::run(sources.size(), threadCount, [&](size_t s)
+	{
+		if (formats[s / count] == GL_RGBA8) return;
+
+		MipmappedImage blocks;
+		TextureCompressorUtils::compress(layers[s], formats[s / count], blocks, nullptr, 1);
+		layers[s] = std::move(blocks);
+	});
+
+	TextureArray** targets[KIND_COUNT] = { &arrays.diffuse, &arrays.material, &arrays.normal };
+	std::cout << "Packed " << count << " materials in " << BenchUtils::getElapsedMs(start) << " ms (" << resampled << " maps resampled):";
+	for (size_t k = 0; k < KIND_COUNT; k++)
+	{
+		std::vector<MipmappedImage> kindLayers(std::make_move_iterator(layers.begin() + k * count), std::make_move_iterator(layers.begin() + (k + 1) * count));
+		*targets[k] = TextureArray::create(kindLayers, *cfgs[k]);
+
+		std::cout << " " << kindNames[k] << " " << layerSizes[k].first << "x" << layerSizes[k].second << " "
+			<< TextureCompressorUtils::getFormatName(formats[k]);
+	}
+	std::cout << std::endl;
+
+	materials.clear();
+	return arrays.diffuse && arrays.material && arrays.normal;
+}
+
+#pragma endregion
+
+namespace TextureUtils
+{
+	Texture2D* loadTexture2D(const std::string& path, TextureConfig cfg)
+	{
+		cfg.internalFormat = GL_RGBA;
+		return loadTexture2DCached(path, {}, cfg);
+	}
 
-		// Free memory after we send the data to GPU.
-		stbi_image_free(data);
+	Texture2D* loadTexture2D(const std::string& path)
+	{
+		return loadTexture2D(path, TextureConfig());
+	}
 
-		return tex;
+	Texture2D* loadTexture2D_sRGBA(const std::string& path, TextureConfig cfg)
+	{
+		cfg.internalFormat = GL_SRGB_ALPHA;
+		return loadTexture2DCached(path, {}, cfg);
 	}
 
 	Texture2D* loadTexture2D_sRGBA(const std::string& path)
@@ -65,6 +837,83 @@ namespace TextureUtils
 		return loadTexture2D_sRGBA(path, TextureConfig());
 	}
 
+	Texture2D* loadPackedTexture2D(const TextureChannel& r, const TextureChannel& g, const TextureChannel& b, TextureConfig cfg)
+	{
+		cfg.internalFormat = GL_RGBA;
+		std::vector<TextureChannel> channels = { r, g, b };
+		return loadTexture2DCached(joinChannels(channels, false), channels, cfg);
+	}
+
+	void releaseTexture2D(Texture2D* tex)
+	{
+		auto it = textureEntries.find(tex);
+		if (it == textureEntries.end())
+		{
+			std::cout << "Released a texture that was not loaded through TextureUtils" << std::endl;
+			return;
+		}
+
+		if (it->second.references > 0) it->second.references--;
+	}
+
+	unsigned int getReferenceCount(Texture2D* tex)
+	{
+		auto it = textureEntries.find(tex);
+		return it != textureEntries.end() ? it->second.references : 0;
+	}
+
+	unsigned int evictUnusedTextures()
+	{
+		unsigned int count = 0;
+		for (auto it = textureEntries.begin(); it != textureEntries.end();)
+		{
+			if (it->second.references > 0)
+			{
+				++it;
+				continue;
+			}
+
+			Texture2D* tex = it->first;
+			// Several paths can point at the same texture
+			for (auto path = texturesByPath.begin(); path != texturesByPath.end();)
+			{
+				path = path->second == tex ? texturesByPath.erase(path) : std::next(path);
+			}
+			for (auto content = texturesByContent.begin(); content != texturesByContent.end();)
+			{
+				content = content->second == tex ? texturesByContent.erase(content) : std::next(content);
+			}
+
+			textureCacheStats.gpuBytes -= it->second.gpuBytes;
+			textureCacheStats.gpuBytesUncompressed -= it->second.uncompressedBytes;
+			TextureStreaming::forget(tex);
+			delete tex;
+			it = textureEntries.erase(it);
+			count++;
+		}
+		return count;
+	}
+
+	const TextureCacheStats& getTextureCacheStats()
+	{
+		return textureCacheStats;
+	}
+
+	size_t getCachedTextureCount()
+	{
+		return textureEntries.size();
+	}
+
+	void printTextureCacheStats()
+	{
+		const TextureCacheStats& stats = textureCacheStats;
+		std::cout << "Texture cache: " << textureEntries.size() << " textures, " << stats.hits << " hits, " << stats.contentHits << " content hits, "
+			<< stats.misses << " misses, " << stats.decodeMs << " ms decoding, " << stats.cooked << " cooked with " << stats.mipMs << " ms of mips and "
+			<< stats.compressMs << " ms compressing, "
+			<< stats.gpuBytes / 1024 << " KB on the GPU (" << stats.gpuBytesUncompressed / 1024 << " KB as RGBA8), "
+			<< stats.gpuBytesSaved / 1024 << " KB saved" << std::endl;
+	}
+
 	Texture2D* blackTexture2D()
 	{
 		static unsigned char data[4] = { 0x00, 0x00, 0x00, 0xff };
@@ -98,6 +947,57 @@ namespace TextureUtils
 		return blank;
 	}
 
+	void runDecodeBenchmark(const std::string& assetDirectory)
+	{
+		std::vector<std::string> filePaths = BenchUtils::findImages(assetDirectory);
+
+		// Map everything up front so only decoding is timed
+		std::vector<FileUtils::MappedFile> files(filePaths.size());
+		size_t fileBytes = 0;
+		for (size_t i = 0; i < files.size(); i++)
+		{
+			if (files[i].open(filePaths[i])) fileBytes += files[i].size();
+		}
+
+		unsigned int hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+		std::vector<unsigned int> threadCounts;
+		for (unsigned int threads = 1; threads < hardwareThreads; threads *= 2) threadCounts.push_back(threads);
+		threadCounts.push_back(hardwareThreads);
+
+		BenchUtils::printTitle("Image decode benchmark, %zu files, %.1f MB%s", files.size(), fileBytes / (1024.0 * 1024.0), BenchUtils::getThreadsNote().c_str());
+		printf("%8s %12s %14s %10s %8s\n", "Threads", "Wall ms", "Decode ms", "MPixel/s", "Speedup");
+
+		double baseMs = 0.0;
+		for (unsigned int threads : threadCounts)
+		{
+			std::vector<double> decodeMs(files.size(), 0.0);
+			std::vector<size_t> pixels(files.size(), 0);
+
+			auto start = std::chrono::steady_clock::now();
+			JobUtils::run(files.size(), threads, [&](size_t i)
+			{
+				if (!files[i].isOpen()) return;
+
+				int width, height;
+				unsigned char* data = decodeImage(files[i], &width, &height, &decodeMs[i]);
+				if (data) pixels[i] = (size_t)width * height;
+				stbi_image_free(data);
+			});
+			double wallMs = BenchUtils::getElapsedMs(start);
+
+			double totalDecodeMs = 0.0;
+			size_t totalPixels = 0;
+			for (size_t i = 0; i < files.size(); i++)
+			{
+				totalDecodeMs += decodeMs[i];
+				totalPixels += pixels[i];
+			}
+
+			if (baseMs == 0.0) baseMs = wallMs;
+			printf("%8u %12.1f %14.1f %10.1f %7.2fx\n", threads, wallMs, totalDecodeMs, totalPixels / (wallMs * 1000.0), baseMs / wallMs);
+		}
+	}
+
 	Cubemap* loadCubemap(const std::string& path, const std::string& extension)
 	{
 		Cubemap* cm = 0;
@@ -115,7 +1015,7 @@ namespace TextureUtils
 		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
 
 		bool noError = true;
-		static int width, height, nrChannels;
+		int width, height, nrChannels;
 		for (unsigned int i = 0; i < 6; i++)
 		{
 			std::string filePath = path + suffixes[i] + "." + extension;
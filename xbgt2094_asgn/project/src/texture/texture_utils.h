@@ -3,18 +3,132 @@
 #include <string>
 #include "texture2d.h"
 #include "cubemap.h"
+#include "texture_array.h"
+
+struct TextureCacheStats
+{
+	unsigned int hits;			// same path, colour space and config as a loaded texture
+	unsigned int contentHits;	// different path, but the same file bytes
+	unsigned int misses;		// decoded and uploaded
+	double decodeMs;			// spent in stb_image on misses
+	unsigned int cooked;		// mipmapped or block compressed on load because no .texcache matched
+	double mipMs;				// spent building mip chains while cooking
+	double compressMs;			// spent block compressing while cooking
+	size_t gpuBytes;			// estimated, including mipmaps, of every cached texture
+	size_t gpuBytesUncompressed;	// what gpuBytes would be with every texture as RGBA8
+	size_t gpuBytesSaved;		// what the hits would have uploaded again
+};
+
+// One channel of a packed texture: the red channel of an image file, or a constant where there is no file
+struct TextureChannel
+{
+	std::string path;
+	unsigned char value;
+
+	TextureChannel(const std::string& path) : path(path), value(0) {}
+	TextureChannel(const char* path) : path(path), value(0) {}
+
+	static TextureChannel constant(unsigned char value)
+	{
+		TextureChannel channel("");
+		channel.value = value;
+		return channel;
+	}
+};
+
+// Loads many textures at once: images are decoded on worker threads while the calling thread, which must own
+// the GL context, uploads them in the order they were added. Each target is set when load returns, to null
+// if its file failed, exactly as the single loads would have.
+class TextureBatch
+{
+public:
+	void add(Texture2D** target, const std::string& path, TextureConfig cfg);
+	void add_sRGBA(Texture2D** target, const std::string& path, TextureConfig cfg);
+	// See TextureUtils::loadPackedTexture2D
+	void addPacked(Texture2D** target, const TextureChannel& r, const TextureChannel& g, const TextureChannel& b, TextureConfig cfg);
+
+	// threadCount 0 uses every hardware thread
+	void load(unsigned int threadCount = 0);
+	size_t size() const;
+
+private:
+	struct TextureRequest
+	{
+		Texture2D** target;
+		std::string path;						// the channels joined with '|' when packed
+		TextureConfig cfg;
+		std::vector<TextureChannel> channels;	// empty unless packed
+	};
+
+	std::vector<TextureRequest> requests;
+};
+
+// One TextureArray per kind of map, layer i of each belonging to material i
+struct MaterialArrays
+{
+	TextureArray* diffuse;
+	TextureArray* material;	// specular, AO and emissive in R, G and B, as TextureUtils::loadPackedTexture2D packs them
+	TextureArray* normal;
+};
+
+// Packs the maps of many materials into texture arrays, so entities using them share one set of bindings and
+// tell their maps apart by layer. Maps are decoded on worker threads, resampled to the size most maps of their
+// kind have, then mipmapped and compressed as single textures would be, with one format per array.
+class MaterialArrayPacker
+{
+public:
+	// Returns the layer the material's maps get in every array
+	unsigned int add(const std::string& diffuse, const std::string& normal,
+		const TextureChannel& specular, const TextureChannel& ao, const TextureChannel& emissive);
+	size_t size() const;
+
+	// GL thread only. Each config sets its kind's wrap, filter, mipmaps and compression. Fails, leaving arrays
+	// null, if any map could not be read.
+	bool pack(MaterialArrays& arrays, const TextureConfig& diffuseCfg, const TextureConfig& materialCfg,
+		const TextureConfig& normalCfg, unsigned int threadCount = 0);
+
+private:
+	struct MaterialRequest
+	{
+		std::string diffuse;
+		std::string normal;
+		std::vector<TextureChannel> channels;	// specular, AO and emissive
+	};
+
+	std::vector<MaterialRequest> materials;
+};
 
 namespace TextureUtils
 {
+	// Loaded textures are shared: asking again for the same path, colour space and TextureConfig, or for a
+	// byte-identical file under another path, returns the same Texture2D with one more reference.
+	// Do not delete them; call releaseTexture2D when done and evictUnusedTextures to free what nobody holds.
 	Texture2D* loadTexture2D(const std::string& path, TextureConfig cfg);
 	Texture2D* loadTexture2D(const std::string& path);
 
 	Texture2D* loadTexture2D_sRGBA(const std::string& path, TextureConfig cfg);
 	Texture2D* loadTexture2D_sRGBA(const std::string& path);
 
+	// Packs the red channels of up to three single channel maps into R, G and B of one linear texture, so a
+	// shader reading them all needs one sample. The files must be the same size, and at least one must be
+	// given. Shared and cached like any other texture; cooked results go next to the first file.
+	Texture2D* loadPackedTexture2D(const TextureChannel& r, const TextureChannel& g, const TextureChannel& b, TextureConfig cfg);
+
+	void releaseTexture2D(Texture2D* tex);
+	unsigned int getReferenceCount(Texture2D* tex);
+	unsigned int evictUnusedTextures();
+
+	const TextureCacheStats& getTextureCacheStats();
+	size_t getCachedTextureCount();
+	void printTextureCacheStats();
+
 	Texture2D* blackTexture2D();
 	Texture2D* whiteTexture2D();
 	Texture2D* checkerTexture2D();
 
 	Cubemap* loadCubemap(const std::string& path, const std::string& extension);
+
+	// Decodes every image under assetDirectory with 1, 2, 4... hardware threads and prints the scaling.
+	// Needs no window or GL context.
+	void runDecodeBenchmark(const std::string& assetDirectory);
 }
\ No newline at end of file
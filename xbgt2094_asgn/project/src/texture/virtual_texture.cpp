@@ -0,0 +1,956 @@
+#include "virtual_texture.h"
+#include <stb_image/stb_image.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include "texture_compressor.h"
+#include "../framework/bench_utils.h"
+#include "../framework/job_utils.h"
+
+static const uint32_t VIRTUAL_TEXTURE_VERSION = 1;
+static const char VIRTUAL_TEXTURE_MAGIC[4] = { 'V', 'T', 'E', 'X' };
+
+// File layout: header, then every tile back to back, each tileBytes long
+struct VirtualTextureHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t format;
+	uint32_t width;
+	uint32_t height;
+	uint32_t pageSize;
+	uint32_t border;
+	uint32_t levelCount;
+	uint64_t sourceSize;
+	uint64_t sourceHash;
+};
+
+
+static bool isPowerOfTwo(int n)
+{
+	return n > 0 && (n & (n - 1)) == 0;
+}
+
+static int nextPowerOfTwo(int n)
+{
+	int result = 1;
+	while (result < n) result *= 2;
+	return result;
+}
+
+// Levels down to the first whose pages fit in one, for a power of two size
+static size_t getVirtualLevelCount(int width, int height, int pageSize)
+{
+	size_t levelCount = 1;
+	while (std::max(width, height) > pageSize)
+	{
+		width = std::max(1, width / 2);
+		height = std::max(1, height / 2);
+		levelCount++;
+	}
+	return levelCount;
+}
+
+static int getPageCount(int size, size_t level, int pageSize)
+{
+	return std::max(1, (size >> level) / pageSize);
+}
+
+#pragma region Tile File
+
+VirtualTextureFile::VirtualTextureFile() :
+	format(GL_RGBA8), width(0), height(0), pageSize(0), border(0), tileBytes(0), tiles(nullptr) {}
+
+bool VirtualTextureFile::open(const std::string& path, uint64_t sourceSize, uint64_t sourceHash)
+{
+	if (!file.open(path)) return false;
+	if (parse(file.data(), file.size(), sourceSize, sourceHash)) return true;
+
+	file.close();
+	return false;
+}
+
+bool VirtualTextureFile::parse(const unsigned char* bytes, size_t size, uint64_t sourceSize, uint64_t sourceHash)
+{
+	if (size < sizeof(VirtualTextureHeader)) return false;
+
+	VirtualTextureHeader header;
+	std::memcpy(&header, bytes, sizeof(VirtualTextureHeader));
+
+	if (std::memcmp(header.magic, VIRTUAL_TEXTURE_MAGIC, sizeof(VIRTUAL_TEXTURE_MAGIC)) != 0 ||
+		header.version != VIRTUAL_TEXTURE_VERSION ||
+		(sourceSize != 0 && header.sourceSize != sourceSize) ||
+		(sourceHash != 0 && header.sourceHash != sourceHash) ||
+		!isPowerOfTwo((int)header.width) || !isPowerOfTwo((int)header.height) || !isPowerOfTwo((int)header.pageSize) ||
+		header.levelCount != getVirtualLevelCount((int)header.width, (int)header.height, (int)header.pageSize))
+	{
+		return false;
+	}
+
+	int tileSize = (int)(header.pageSize + 2 * header.border);
+	size_t bytesPerTile = TextureCompressorUtils::getLevelSize(header.format, tileSize, tileSize);
+
+	std::vector<size_t> firstTiles(1, 0);
+	for (uint32_t level = 0; level < header.levelCount; level++)
+	{
+		size_t pageCount = (size_t)getPageCount((int)header.width, level, (int)header.pageSize) * getPageCount((int)header.height, level, (int)header.pageSize);
+		firstTiles.push_back(firstTiles.back() + pageCount);
+	}
+
+	if (size - sizeof(VirtualTextureHeader) < firstTiles.back() * bytesPerTile) return false;
+
+	format = header.format;
+	width = (int)header.width;
+	height = (int)header.height;
+	pageSize = (int)header.pageSize;
+	border = (int)header.border;
+	tileBytes = bytesPerTile;
+	levelFirstTile = firstTiles;
+	tiles = bytes + sizeof(VirtualTextureHeader);
+	return true;
+}
+
+GLenum VirtualTextureFile::getFormat() const
+{
+	return format;
+}
+
+int VirtualTextureFile::getWidth() const
+{
+	return width;
+}
+
+int VirtualTextureFile::getHeight() const
+{
+	return height;
+}
+
+int VirtualTextureFile::getPageSize() const
+{
+	return pageSize;
+}
+
+int VirtualTextureFile::getBorder() const
+{
+	return border;
+}
+
+int VirtualTextureFile::getTileSize() const
+{
+	return pageSize + 2 * border;
+}
+
+size_t VirtualTextureFile::getTileBytes() const
+{
+	return tileBytes;
+}
+
+size_t VirtualTextureFile::getLevelCount() const
+{
+	return levelFirstTile.empty() ? 0 : levelFirstTile.size() - 1;
+}
+
+int VirtualTextureFile::getPagesX(size_t level) const
+{
+	return getPageCount(width, level, pageSize);
+}
+
+int VirtualTextureFile::getPagesY(size_t level) const
+{
+	return getPageCount(height, level, pageSize);
+}
+
+const unsigned char* VirtualTextureFile::getTile(size_t level, int x, int y) const
+{
+	size_t tile = levelFirstTile[level] + (size_t)y * getPagesX(level) + x;
+	return tiles + tile * tileBytes;
+}
+
+std::string VirtualTextureFile::getPath(const std::string& sourcePath)
+{
+	return sourcePath + ".vtex";
+}
+
+bool VirtualTextureFile::bake(const std::string& sourcePath, const std::string& path, TextureCompression compression,
+	const MipSettings& settings, int pageSize, int border)
+{
+	FileUtils::MappedFile source;
+	if (!source.open(sourcePath))
+	{
+		std::cout << "Failed to load virtual texture: " << sourcePath << std::endl;
+		return false;
+	}
+
+	stbi_set_flip_vertically_on_load_thread(true);
+
+	int width, height, channels;
+	unsigned char* rgba = stbi_load_from_memory(source.data(), (int)source.size(), &width, &height, &channels, 4);
+	if (!rgba)
+	{
+		std::cout << "Failed to load virtual texture: " << sourcePath << std::endl;
+		return false;
+	}
+
+	bool baked = bake(rgba, width, height, path, compression, settings, pageSize, border,
+		source.size(), FileUtils::hashBytes(source.data(), source.size()));
+	stbi_image_free(rgba);
+	return baked;
+}
+
+bool VirtualTextureFile::bake(const unsigned char* rgba, int width, int height, const std::string& path, TextureCompression compression,
+	const MipSettings& settings, int pageSize, int border, uint64_t sourceSize, uint64_t sourceHash)
+{
+	// Tiles are compressed whole, so they must be a whole number of blocks
+	int tileSize = pageSize + 2 * border;
+	if (!isPowerOfTwo(pageSize) || pageSize < 4 || border < 0 || tileSize % 4 != 0)
+	{
+		std::cout << "Virtual texture pages must be a power of two of at least 4 texels, and the page size plus twice the border a multiple of 4: " << path << std::endl;
+		return false;
+	}
+
+	MipSettings wrapping = settings;
+	wrapping.wrapX = wrapping.wrapY = true;
+
+	// Pages only tile a power of two evenly at every level
+	int virtualWidth = std::max(pageSize, nextPowerOfTwo(width));
+	int virtualHeight = std::max(pageSize, nextPowerOfTwo(height));
+	std::vector<unsigned char> resized;
+	if (virtualWidth != width || virtualHeight != height)
+	{
+		MipChainUtils::resample(rgba, width, height, virtualWidth, virtualHeight, wrapping, resized);
+		rgba = resized.data();
+	}
+
+	MipmappedImage chain;
+	MipChainUtils::generate(rgba, virtualWidth, virtualHeight, wrapping, chain);
+
+	GLenum format = compression == TextureCompression::NONE ? GL_RGBA8 : TextureCompressorUtils::chooseFormat(chain, compression);
+	size_t tileBytes = TextureCompressorUtils::getLevelSize(format, tileSize, tileSize);
+	size_t levelCount = getVirtualLevelCount(virtualWidth, virtualHeight, pageSize);
+
+	struct TileJob
+	{
+		size_t level;
+		int x, y;
+	};
+	std::vector<TileJob> jobs;
+	for (size_t level = 0; level < levelCount; level++)
+	{
+		for (int y = 0; y < getPageCount(virtualHeight, level, pageSize); y++)
+		{
+			for (int x = 0; x < getPageCount(virtualWidth, level, pageSize); x++)
+			{
+				jobs.push_back({ level, x, y });
+			}
+		}
+	}
+
+	// Each tile is its page and the border around it, wrapping at the level's edges
+	std::vector<unsigned char> tiles(jobs.size() * tileBytes);
+	JobUtils::run(jobs.size(), std::max(1u, std::thread::hardware_concurrency()), [&](size_t index)
+	{
+		const TileJob& job = jobs[index];
+		int levelWidth = std::max(1, virtualWidth >> job.level);
+		int levelHeight = std::max(1, virtualHeight >> job.level);
+		const unsigned char* levelPixels = &chain.data[chain.levelOffsets[job.level]];
+
+		std::vector<unsigned char> tile((size_t)tileSize * tileSize * 4);
+		for (int row = 0; row < tileSize; row++)
+		{
+			int sourceY = ((job.y * pageSize - border + row) % levelHeight + levelHeight) % levelHeight;
+			for (int column = 0; column < tileSize; column++)
+			{
+				int sourceX = ((job.x * pageSize - border + column) % levelWidth + levelWidth) % levelWidth;
+				std::memcpy(&tile[((size_t)row * tileSize + column) * 4], &levelPixels[((size_t)sourceY * levelWidth + sourceX) * 4], 4);
+			}
+		}
+
+		unsigned char* destination = &tiles[index * tileBytes];
+		if (format == GL_RGBA8)
+		{
+			std::memcpy(destination, tile.data(), tileBytes);
+			return;
+		}
+
+		MipmappedImage tileImage, compressed;
+		MipChainUtils::createBaseLevel(tile.data(), tileSize, tileSize, tileImage);
+		TextureCompressorUtils::compress(tileImage, format, compressed, nullptr, 1);
+		std::memcpy(destination, compressed.data.data(), tileBytes);
+	});
+
+	VirtualTextureHeader header;
+	std::memcpy(header.magic, VIRTUAL_TEXTURE_MAGIC, sizeof(VIRTUAL_TEXTURE_MAGIC));
+	header.version = VIRTUAL_TEXTURE_VERSION;
+	header.format = format;
+	header.width = (uint32_t)virtualWidth;
+	header.height = (uint32_t)virtualHeight;
+	header.pageSize = (uint32_t)pageSize;
+	header.border = (uint32_t)border;
+	header.levelCount = (uint32_t)levelCount;
+	header.sourceSize = sourceSize;
+	header.sourceHash = sourceHash;
+
+	std::ofstream file(path, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!file)
+	{
+		std::cout << "Failed to write virtual texture: " << path << std::endl;
+		return false;
+	}
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(tiles.data()), tiles.size());
+
+	return (bool)file;
+}
+
+#pragma endregion
+
+#pragma region Page Manager
+
+VirtualPageManager::VirtualPageManager(const std::vector<int>& pagesX, const std::vector<int>& pagesY, int slotsX, int slotsY) :
+	pagesX(pagesX), pagesY(pagesY), slotsX(slotsX), slotsY(slotsY), pageTableChanged(false), frame(0), stats()
+{
+	slots.assign((size_t)slotsX * slotsY, { NO_PAGE, 0 });
+	for (size_t level = 0; level < pagesX.size(); level++)
+	{
+		pageTable.push_back(std::vector<uint32_t>((size_t)pagesX[level] * pagesY[level], 0));
+	}
+}
+
+uint32_t VirtualPageManager::makeKey(uint32_t level, int x, int y)
+{
+	return (level << 24) | ((uint32_t)y << 12) | (uint32_t)x;
+}
+
+void VirtualPageManager::splitKey(uint32_t key, uint32_t* level, int* x, int* y)
+{
+	*level = key >> 24;
+	*y = (int)((key >> 12) & 0xfff);
+	*x = (int)(key & 0xfff);
+}
+
+void VirtualPageManager::encodeFeedback(uint32_t level, int x, int y, unsigned char* rgba)
+{
+	rgba[0] = (unsigned char)(x & 0xff);
+	rgba[1] = (unsigned char)(y & 0xff);
+	rgba[2] = (unsigned char)(((x >> 8) & 0xf) | (((y >> 8) & 0xf) << 4));
+	rgba[3] = (unsigned char)(level + 1);
+}
+
+bool VirtualPageManager::decodeFeedback(const unsigned char* rgba, uint32_t* level, int* x, int* y)
+{
+	if (rgba[3] == 0) return false;
+
+	*level = rgba[3] - 1u;
+	*x = rgba[0] | ((rgba[2] & 0xf) << 8);
+	*y = rgba[1] | ((rgba[2] >> 4) << 8);
+	return true;
+}
+
+void VirtualPageManager::addFeedback(const unsigned char* rgba, size_t pixelCount)
+{
+	// Neighbouring pixels mostly want the same page, so runs are counted before they are added
+	uint32_t runPixel = 0;
+	unsigned int runLength = 0;
+
+	for (size_t i = 0; i < pixelCount; i++)
+	{
+		uint32_t pixel;
+		std::memcpy(&pixel, rgba + i * 4, 4);
+		if (pixel == runPixel && runLength > 0)
+		{
+			runLength++;
+			continue;
+		}
+
+		uint32_t level;
+		int x, y;
+		if (runLength > 0 && decodeFeedback(reinterpret_cast<const unsigned char*>(&runPixel), &level, &x, &y)) addRequest(level, x, y, runLength);
+
+		runPixel = pixel;
+		runLength = 1;
+	}
+
+	uint32_t level;
+	int x, y;
+	if (runLength > 0 && decodeFeedback(reinterpret_cast<const unsigned char*>(&runPixel), &level, &x, &y)) addRequest(level, x, y, runLength);
+}
+
+void VirtualPageManager::addRequest(uint32_t level, int x, int y, unsigned int count)
+{
+	if (level >= pagesX.size() || x < 0 || y < 0 || x >= pagesX[level] || y >= pagesY[level]) return;
+
+	// Every coarser page covering this one is wanted too, to stand in until it loads
+	for (;;)
+	{
+		requests[makeKey(level, x, y)] += count;
+		if (level + 1 >= pagesX.size()) break;
+
+		level++;
+		x = std::min(x / 2, pagesX[level] - 1);
+		y = std::min(y / 2, pagesY[level] - 1);
+	}
+}
+
+int VirtualPageManager::findSlot()
+{
+	int oldest = -1;
+	for (size_t slot = 0; slot < slots.size(); slot++)
+	{
+		if (slots[slot].page == NO_PAGE) return (int)slot;
+
+		// Pages asked for this frame stay
+		if (slots[slot].lastUsed >= frame) continue;
+		if (oldest < 0 || slots[slot].lastUsed < slots[oldest].lastUsed) oldest = (int)slot;
+	}
+	return oldest;
+}
+
+void VirtualPageManager::update(size_t maxLoads, std::vector<PageLoad>& loads)
+{
+	frame++;
+	loads.clear();
+
+	// The coarsest level is always wanted, so it is loaded before anything else and pinned
+	uint32_t coarsest = (uint32_t)pagesX.size() - 1;
+	for (int y = 0; y < pagesY[coarsest]; y++)
+	{
+		for (int x = 0; x < pagesX[coarsest]; x++)
+		{
+			requests[makeKey(coarsest, x, y)] += 0;
+		}
+	}
+
+	std::vector<std::pair<uint32_t, unsigned int>> missing;
+	for (const auto& request : requests)
+	{
+		auto resident = residentSlots.find(request.first);
+		if (resident == residentSlots.end()) missing.push_back(request);
+		else slots[resident->second].lastUsed = std::max(slots[resident->second].lastUsed, frame);
+	}
+
+	// Coarsest first, so every page has something to fall back to, then the pages covering the most pixels
+	std::sort(missing.begin(), missing.end(), [](const std::pair<uint32_t, unsigned int>& a, const std::pair<uint32_t, unsigned int>& b)
+	{
+		if ((a.first >> 24) != (b.first >> 24)) return (a.first >> 24) > (b.first >> 24);
+		if (a.second != b.second) return a.second > b.second;
+		return a.first < b.first;
+	});
+
+	for (const auto& page : missing)
+	{
+		if (loads.size() >= maxLoads) break;
+
+		int slot = findSlot();
+		if (slot < 0) break;
+
+		if (slots[slot].page != NO_PAGE)
+		{
+			residentSlots.erase(slots[slot].page);
+			stats.evictions++;
+		}
+
+		PageLoad load;
+		splitKey(page.first, &load.level, &load.x, &load.y);
+		load.slot = slot;
+		loads.push_back(load);
+
+		slots[slot].page = page.first;
+		slots[slot].lastUsed = load.level == coarsest ? UINT64_MAX : frame;
+		residentSlots[page.first] = slot;
+		stats.loads++;
+	}
+
+	stats.requested = (unsigned int)requests.size();
+	stats.missing = (unsigned int)(missing.size() - loads.size());
+	stats.resident = (unsigned int)residentSlots.size();
+	requests.clear();
+
+	if (!loads.empty())
+	{
+		buildPageTable();
+		pageTableChanged = true;
+	}
+}
+
+void VirtualPageManager::buildPageTable()
+{
+	for (size_t level = pagesX.size(); level-- > 0;)
+	{
+		std::vector<uint32_t>& entries = pageTable[level];
+		for (int y = 0; y < pagesY[level]; y++)
+		{
+			for (int x = 0; x < pagesX[level]; x++)
+			{
+				uint32_t entry = 0;
+				auto resident = residentSlots.find(makeKey((uint32_t)level, x, y));
+				if (resident != residentSlots.end())
+				{
+					entry = (uint32_t)(resident->second % slotsX) | ((uint32_t)(resident->second / slotsX) << 8) |
+						((uint32_t)level << 16) | (0xffu << 24);
+				}
+				else if (level + 1 < pagesX.size())
+				{
+					int parentX = std::min(x / 2, pagesX[level + 1] - 1);
+					int parentY = std::min(y / 2, pagesY[level + 1] - 1);
+					entry = pageTable[level + 1][(size_t)parentY * pagesX[level + 1] + parentX];
+				}
+				entries[(size_t)y * pagesX[level] + x] = entry;
+			}
+		}
+	}
+}
+
+bool VirtualPageManager::isResident(uint32_t level, int x, int y) const
+{
+	return residentSlots.count(makeKey(level, x, y)) > 0;
+}
+
+int VirtualPageManager::getSlotsX() const
+{
+	return slotsX;
+}
+
+int VirtualPageManager::getSlotsY() const
+{
+	return slotsY;
+}
+
+size_t VirtualPageManager::getLevelCount() const
+{
+	return pagesX.size();
+}
+
+int VirtualPageManager::getPagesX(size_t level) const
+{
+	return pagesX[level];
+}
+
+int VirtualPageManager::getPagesY(size_t level) const
+{
+	return pagesY[level];
+}
+
+const std::vector<uint32_t>& VirtualPageManager::getPageTable(size_t level) const
+{
+	return pageTable[level];
+}
+
+bool VirtualPageManager::takePageTableChanged()
+{
+	bool changed = pageTableChanged;
+	pageTableChanged = false;
+	return changed;
+}
+
+const VirtualTextureStats& VirtualPageManager::getStats() const
+{
+	return stats;
+}
+
+#pragma endregion
+
+#pragma region GPU Cache
+
+VirtualTexture::VirtualTexture() : pages(nullptr), cacheFormat(GL_RGBA8), cacheHandle(0), pageTableHandle(0), feedbackBuffers(), feedbackPixels(), feedbackIndex(0) {}
+
+VirtualTexture::~VirtualTexture()
+{
+	glDeleteTextures(1, &cacheHandle);
+	glDeleteTextures(1, &pageTableHandle);
+	glDeleteBuffers(FEEDBACK_BUFFERS, feedbackBuffers);
+	delete pages;
+}
+
+VirtualTexture* VirtualTexture::load(const std::string& sourcePath, TextureCompression compression, const MipSettings& settings,
+	int slotsX, int slotsY)
+{
+	uint64_t sourceSize, sourceHash;
+	{
+		FileUtils::MappedFile source;
+		if (!source.open(sourcePath))
+		{
+			std::cout << "Failed to load virtual texture: " << sourcePath << std::endl;
+			return nullptr;
+		}
+		sourceSize = source.size();
+		sourceHash = FileUtils::hashBytes(source.data(), source.size());
+	}
+
+	VirtualTexture* tex = new VirtualTexture();
+	std::string path = VirtualTextureFile::getPath(sourcePath);
+	if (!tex->file.open(path, sourceSize, sourceHash))
+	{
+		auto start = std::chrono::steady_clock::now();
+		if (!VirtualTextureFile::bake(sourcePath, path, compression, settings) || !tex->file.open(path, sourceSize, sourceHash))
+		{
+			delete tex;
+			return nullptr;
+		}
+		std::cout << "Baked virtual texture in " << BenchUtils::getElapsedMs(start) << " ms: " << path << std::endl;
+	}
+
+	const VirtualTextureFile& file = tex->file;
+	size_t levelCount = file.getLevelCount();
+	size_t coarsest = levelCount - 1;
+	if ((size_t)file.getPagesX(coarsest) * file.getPagesY(coarsest) > (size_t)slotsX * slotsY || slotsX > 256 || slotsY > 256)
+	{
+		std::cout << "Virtual texture cache of " << slotsX << "x" << slotsY << " pages cannot hold its coarsest level: " << sourcePath << std::endl;
+		delete tex;
+		return nullptr;
+	}
+
+	std::vector<int> pagesX, pagesY;
+	for (size_t level = 0; level < levelCount; level++)
+	{
+		pagesX.push_back(file.getPagesX(level));
+		pagesY.push_back(file.getPagesY(level));
+	}
+	tex->pages = new VirtualPageManager(pagesX, pagesY, slotsX, slotsY);
+
+	// The cache has no mips: pages are already at the level they are sampled at, and their borders cover
+	// bilinear filtering across page edges
+	GLenum format = file.getFormat();
+	if (settings.srgb) format = format == GL_RGBA8 ? GL_SRGB8_ALPHA8 : TextureCompressorUtils::getSrgbFormat(format);
+	tex->cacheFormat = format;
+
+	glGenTextures(1, &tex->cacheHandle);
+	glBindTexture(GL_TEXTURE_2D, tex->cacheHandle);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+	if (file.getFormat() == GL_RGBA8)
+	{
+		glTexImage2D(GL_TEXTURE_2D, 0, format, tex->getCacheWidth(), tex->getCacheHeight(), 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	}
+	else
+	{
+		GLsizei size = (GLsizei)TextureCompressorUtils::getLevelSize(format, tex->getCacheWidth(), tex->getCacheHeight());
+		glCompressedTexImage2D(GL_TEXTURE_2D, 0, format, tex->getCacheWidth(), tex->getCacheHeight(), 0, size, nullptr);
+	}
+
+	// A power of two size gives the page table a complete mip chain down to the coarsest virtual level
+	glGenTextures(1, &tex->pageTableHandle);
+	glBindTexture(GL_TEXTURE_2D, tex->pageTableHandle);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)coarsest);
+	for (size_t level = 0; level < levelCount; level++)
+	{
+		glTexImage2D(GL_TEXTURE_2D, (GLint)level, GL_RGBA8, pagesX[level], pagesY[level], 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glGenBuffers(FEEDBACK_BUFFERS, tex->feedbackBuffers);
+
+	// Nothing has asked yet; this loads the coarsest level
+	tex->update((size_t)pagesX[coarsest] * pagesY[coarsest]);
+
+	std::cout << "Loaded virtual texture: " << sourcePath << " (" << file.getWidth() << "x" << file.getHeight() << ", " << levelCount
+		<< " levels of " << file.getPageSize() << "x" << file.getPageSize() << " pages, "
+		<< TextureCompressorUtils::getFormatName(file.getFormat()) << ", cache of " << slotsX << "x" << slotsY << ")" << std::endl;
+	return tex;
+}
+
+void VirtualTexture::readFeedback(int width, int height)
+{
+	size_t pixelCount = (size_t)width * height;
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, feedbackBuffers[feedbackIndex]);
+	glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)(pixelCount * 4), nullptr, GL_STREAM_READ);
+	glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	feedbackPixels[feedbackIndex] = pixelCount;
+	feedbackIndex = (feedbackIndex + 1) % FEEDBACK_BUFFERS;
+}
+
+void VirtualTexture::update(size_t maxLoads)
+{
+	// The buffer filled next is the one filled longest ago
+	if (feedbackPixels[feedbackIndex] > 0)
+	{
+		size_t pixelCount = feedbackPixels[feedbackIndex];
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, feedbackBuffers[feedbackIndex]);
+		const unsigned char* feedback = (const unsigned char*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr)(pixelCount * 4), GL_MAP_READ_BIT);
+		if (feedback)
+		{
+			pages->addFeedback(feedback, pixelCount);
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		feedbackPixels[feedbackIndex] = 0;
+	}
+
+	pages->update(maxLoads, loads);
+	if (loads.empty()) return;
+
+	int tileSize = file.getTileSize();
+	glBindTexture(GL_TEXTURE_2D, cacheHandle);
+	for (const VirtualPageManager::PageLoad& load : loads)
+	{
+		const unsigned char* tile = file.getTile(load.level, load.x, load.y);
+		int x = (load.slot % pages->getSlotsX()) * tileSize;
+		int y = (load.slot / pages->getSlotsX()) * tileSize;
+
+		if (file.getFormat() == GL_RGBA8) glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, tileSize, tileSize, GL_RGBA, GL_UNSIGNED_BYTE, tile);
+		else glCompressedTexSubImage2D(GL_TEXTURE_2D, 0, x, y, tileSize, tileSize, cacheFormat, (GLsizei)file.getTileBytes(), tile);
+	}
+
+	if (pages->takePageTableChanged()) uploadPageTable();
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void VirtualTexture::uploadPageTable()
+{
+	glBindTexture(GL_TEXTURE_2D, pageTableHandle);
+	for (size_t level = 0; level < pages->getLevelCount(); level++)
+	{
+		glTexSubImage2D(GL_TEXTURE_2D, (GLint)level, 0, 0, pages->getPagesX(level), pages->getPagesY(level), GL_RGBA, GL_UNSIGNED_BYTE,
+			pages->getPageTable(level).data());
+	}
+}
+
+int VirtualTexture::getWidth() const
+{
+	return file.getWidth();
+}
+
+int VirtualTexture::getHeight() const
+{
+	return file.getHeight();
+}
+
+int VirtualTexture::getPageSize() const
+{
+	return file.getPageSize();
+}
+
+int VirtualTexture::getBorder() const
+{
+	return file.getBorder();
+}
+
+int VirtualTexture::getTileSize() const
+{
+	return file.getTileSize();
+}
+
+size_t VirtualTexture::getLevelCount() const
+{
+	return file.getLevelCount();
+}
+
+int VirtualTexture::getCacheWidth() const
+{
+	return pages ? pages->getSlotsX() * file.getTileSize() : 0;
+}
+
+int VirtualTexture::getCacheHeight() const
+{
+	return pages ? pages->getSlotsY() * file.getTileSize() : 0;
+}
+
+unsigned int VirtualTexture::getPageTableHandle() const
+{
+	return pageTableHandle;
+}
+
+unsigned int VirtualTexture::getCacheHandle() const
+{
+	return cacheHandle;
+}
+
+const VirtualTextureStats& VirtualTexture::getStats() const
+{
+	return pages->getStats();
+}
+
+#pragma endregion
+
+#pragma region Benchmark
+
+// Feedback for a view of the texture centred on centre, extent uv across, as a feedback pass of
+// width x height pixels would write it
+static void simulateFeedback(const VirtualTextureFile& file, float centreX, float centreY, float extent, int width, int height,
+	std::vector<unsigned char>& feedback)
+{
+	feedback.resize((size_t)width * height * 4);
+
+	float texelsPerPixel = extent * file.getWidth() / width;
+	int level = (int)std::floor(std::log2(std::max(texelsPerPixel, 1.0f)));
+	level = std::min(level, (int)file.getLevelCount() - 1);
+
+	int levelWidth = std::max(1, file.getWidth() >> level), levelHeight = std::max(1, file.getHeight() >> level);
+	for (int y = 0; y < height; y++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			float u = centreX + ((x + 0.5f) / width - 0.5f) * extent;
+			float v = centreY + ((y + 0.5f) / height - 0.5f) * extent * height / width;
+			u -= std::floor(u);
+			v -= std::floor(v);
+
+			int pageX = std::min((int)(u * levelWidth) / file.getPageSize(), file.getPagesX(level) - 1);
+			int pageY = std::min((int)(v * levelHeight) / file.getPageSize(), file.getPagesY(level) - 1);
+			VirtualPageManager::encodeFeedback((uint32_t)level, pageX, pageY, &feedback[((size_t)y * width + x) * 4]);
+		}
+	}
+}
+
+// Every entry must name a resident page at its level or coarser that covers it, and the slot must hold it
+static bool checkPageTable(const VirtualPageManager& pages, std::vector<VirtualPageManager::PageLoad>& slotPages)
+{
+	for (size_t level = 0; level < pages.getLevelCount(); level++)
+	{
+		const std::vector<uint32_t>& entries = pages.getPageTable(level);
+		for (int y = 0; y < pages.getPagesY(level); y++)
+		{
+			for (int x = 0; x < pages.getPagesX(level); x++)
+			{
+				uint32_t entry = entries[(size_t)y * pages.getPagesX(level) + x];
+				if ((entry >> 24) != 0xff) return false;
+
+				int slot = (int)(entry & 0xff) + (int)((entry >> 8) & 0xff) * pages.getSlotsX();
+				const VirtualPageManager::PageLoad& page = slotPages[slot];
+				uint32_t entryLevel = (entry >> 16) & 0xff;
+				if (page.level != entryLevel || entryLevel < level || !pages.isResident(page.level, page.x, page.y)) return false;
+
+				int coverX = x, coverY = y;
+				for (uint32_t l = (uint32_t)level; l < entryLevel; l++)
+				{
+					coverX = std::min(coverX / 2, pages.getPagesX(l + 1) - 1);
+					coverY = std::min(coverY / 2, pages.getPagesY(l + 1) - 1);
+				}
+				if (coverX != page.x || coverY != page.y) return false;
+			}
+		}
+	}
+	return true;
+}
+
+void VirtualTextureUtils::runBenchmark(const std::string& assetDirectory)
+{
+	std::vector<std::string> filePaths = BenchUtils::findImages(assetDirectory);
+
+	const int PAGE_SIZE = 64, BORDER = 4;
+	const int SLOTS = 6;
+	const int FEEDBACK_WIDTH = 128, FEEDBACK_HEIGHT = 96;
+	const int FRAMES = 240;
+	const size_t LOADS_PER_FRAME = 4;
+	MipSettings settings = { TextureMipFilter::KAISER, false, false, true, true, 0.0f };
+	std::string tilePath = (std::filesystem::temp_directory_path() / "virtual_texture_benchmark.vtex").string();
+
+	BenchUtils::printTitle("Virtual texture benchmark: %dx%d pages, %dx%d slot cache, %zu loads a frame, %d frames",
+		PAGE_SIZE, PAGE_SIZE, SLOTS, SLOTS, LOADS_PER_FRAME, FRAMES);
+	printf("%-48s %11s %7s %9s %6s %7s %9s %12s %6s\n", "File", "Size", "Pages", "Bake ms", "Tiles", "Loads", "Evicted", "Missing/frame", "Table");
+
+	bool allPassed = true;
+	for (const std::string& path : filePaths)
+	{
+		int width, height, channels;
+		stbi_set_flip_vertically_on_load_thread(true);
+		unsigned char* rgba = stbi_load(path.c_str(), &width, &height, &channels, 4);
+		if (!rgba) continue;
+		if (std::max(width, height) < 256)
+		{
+			stbi_image_free(rgba);
+			continue;
+		}
+
+		// Uncompressed, so every tile can be checked texel for texel against the chain
+		auto start = std::chrono::steady_clock::now();
+		bool baked = VirtualTextureFile::bake(rgba, width, height, tilePath, TextureCompression::NONE, settings, PAGE_SIZE, BORDER, 0, 0);
+		double bakeMs = BenchUtils::getElapsedMs(start);
+
+		int virtualWidth = std::max(PAGE_SIZE, nextPowerOfTwo(width)), virtualHeight = std::max(PAGE_SIZE, nextPowerOfTwo(height));
+		std::vector<unsigned char> resized;
+		const unsigned char* pixels = rgba;
+		if (virtualWidth != width || virtualHeight != height)
+		{
+			MipChainUtils::resample(rgba, width, height, virtualWidth, virtualHeight, settings, resized);
+			pixels = resized.data();
+		}
+		MipmappedImage chain;
+		MipChainUtils::generate(pixels, virtualWidth, virtualHeight, settings, chain);
+		stbi_image_free(rgba);
+
+		VirtualTextureFile file;
+		bool tilesMatch = baked && file.open(tilePath);
+		size_t pageCount = 0;
+		for (size_t level = 0; tilesMatch && level < file.getLevelCount(); level++)
+		{
+			int levelWidth = virtualWidth >> level, levelHeight = virtualHeight >> level;
+			const unsigned char* levelPixels = &chain.data[chain.levelOffsets[level]];
+			for (int y = 0; y < file.getPagesY(level); y++)
+			{
+				for (int x = 0; x < file.getPagesX(level); x++)
+				{
+					// The page itself, without its border
+					const unsigned char* tile = file.getTile(level, x, y);
+					for (int row = 0; row < std::min(PAGE_SIZE, levelHeight) && tilesMatch; row++)
+					{
+						const unsigned char* expected = &levelPixels[(((size_t)y * PAGE_SIZE + row) * levelWidth + (size_t)x * PAGE_SIZE) * 4];
+						const unsigned char* actual = &tile[(((size_t)row + BORDER) * file.getTileSize() + BORDER) * 4];
+						tilesMatch = std::memcmp(expected, actual, (size_t)std::min(PAGE_SIZE, levelWidth) * 4) == 0;
+					}
+					pageCount++;
+				}
+			}
+		}
+
+		// A camera zooming in and out while it pans across and around the texture
+		std::vector<int> pagesX, pagesY;
+		for (size_t level = 0; level < file.getLevelCount(); level++)
+		{
+			pagesX.push_back(file.getPagesX(level));
+			pagesY.push_back(file.getPagesY(level));
+		}
+
+		bool tableValid = tilesMatch;
+		unsigned int missingTotal = 0;
+		VirtualTextureStats stats = {};
+		if (tilesMatch)
+		{
+			VirtualPageManager pages(pagesX, pagesY, SLOTS, SLOTS);
+			std::vector<VirtualPageManager::PageLoad> loads, slotPages(SLOTS * SLOTS);
+			std::vector<unsigned char> feedback;
+
+			for (int frame = 0; frame < FRAMES && tableValid; frame++)
+			{
+				float t = frame / (float)FRAMES;
+				float extent = 0.15f + 0.85f * (0.5f + 0.5f * std::cos(t * 6.2832f * 2.0f));
+				simulateFeedback(file, 0.5f + 0.6f * t, 0.5f + 0.25f * std::sin(t * 6.2832f), extent, FEEDBACK_WIDTH, FEEDBACK_HEIGHT, feedback);
+
+				pages.addFeedback(feedback.data(), (size_t)FEEDBACK_WIDTH * FEEDBACK_HEIGHT);
+				pages.update(LOADS_PER_FRAME, loads);
+				for (const VirtualPageManager::PageLoad& load : loads) slotPages[load.slot] = load;
+
+				tableValid = checkPageTable(pages, slotPages);
+				missingTotal += pages.getStats().missing;
+			}
+			stats = pages.getStats();
+		}
+
+		allPassed = allPassed && tilesMatch && tableValid;
+
+		char size[32];
+		snprintf(size, sizeof(size), "%dx%d", width, height);
+		printf("%-48s %11s %7zu %9.1f %6s %7u %9u %12.2f %6s\n", BenchUtils::getRelativePath(path, assetDirectory).c_str(), size,
+			pageCount, bakeMs, tilesMatch ? "ok" : "FAIL", stats.loads, stats.evictions, missingTotal / (double)FRAMES, tableValid ? "ok" : "FAIL");
+	}
+
+	std::error_code error;
+	std::filesystem::remove(tilePath, error);
+	printf("%s\n", allPassed ? "Every tile matched its level and every page table entry its page" : "Some tiles or page tables were wrong");
+}
+
+#pragma endregion
\ No newline at end of file
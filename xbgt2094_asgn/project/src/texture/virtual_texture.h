@@ -0,0 +1,198 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "mip_chain.h"
+#include "../framework/file_utils.h"
+
+// A virtual texture cut into pages on disk (.vtex): every level of its mip chain split into pageSize square pages,
+// down to the first level that fits in one. Each page is stored as a tile with border texels of its neighbours
+// around it, so the cache can filter across page edges, and every tile is the same size, laid out level by level
+// and row by row from the bottom as GL samples them. Edges wrap, as GL_REPEAT samples them.
+class VirtualTextureFile
+{
+public:
+	static const int DEFAULT_PAGE_SIZE = 128;
+	static const int DEFAULT_BORDER = 4;
+
+	VirtualTextureFile();
+
+	// Maps the file and checks it against the source it was baked from: sourceSize and sourceHash, 0 to skip
+	bool open(const std::string& path, uint64_t sourceSize = 0, uint64_t sourceHash = 0);
+	// For bytes already in memory, which must outlive this
+	bool parse(const unsigned char* bytes, size_t size, uint64_t sourceSize = 0, uint64_t sourceHash = 0);
+
+	GLenum getFormat() const;
+	int getWidth() const;
+	int getHeight() const;
+	int getPageSize() const;
+	int getBorder() const;
+	int getTileSize() const;		// pageSize + 2 * border texels across
+	size_t getTileBytes() const;
+	size_t getLevelCount() const;
+	int getPagesX(size_t level) const;
+	int getPagesY(size_t level) const;
+
+	const unsigned char* getTile(size_t level, int x, int y) const;
+
+	// <source>.vtex
+	static std::string getPath(const std::string& sourcePath);
+
+	// Decodes sourcePath, scales it to a power of two no smaller than a page, builds its mips with settings
+	// (whose wrap is ignored: pages always wrap) and writes the tiles to path, block compressed as asked.
+	static bool bake(const std::string& sourcePath, const std::string& path, TextureCompression compression,
+		const MipSettings& settings, int pageSize = DEFAULT_PAGE_SIZE, int border = DEFAULT_BORDER);
+	// The same from RGBA8 pixels already in memory
+	static bool bake(const unsigned char* rgba, int width, int height, const std::string& path, TextureCompression compression,
+		const MipSettings& settings, int pageSize, int border, uint64_t sourceSize, uint64_t sourceHash);
+
+private:
+	FileUtils::MappedFile file;
+	GLenum format;
+	int width, height;
+	int pageSize, border;
+	size_t tileBytes;
+	std::vector<size_t> levelFirstTile;	// index of each level's first tile, plus the tile count at the end
+	const unsigned char* tiles;
+};
+
+struct VirtualTextureStats
+{
+	unsigned int requested;		// distinct pages the last feedback asked for, with the coarser pages they fall back to
+	unsigned int resident;		// pages in the cache
+	unsigned int missing;		// requested but still not in the cache after the last update
+	unsigned int loads;			// since creation
+	unsigned int evictions;
+};
+
+// Decides which pages of a virtual texture live in the cache. Feedback says which pages were sampled, and at
+// what level; every update loads the missing ones coarsest first, then the most sampled, into free slots or
+// over the least recently used page nothing asked for this frame. The coarsest level is loaded first and never
+// leaves, so every texel always has a page to fall back to.
+// Knows nothing of GL, so it can run and be checked without a window.
+class VirtualPageManager
+{
+public:
+	struct PageLoad
+	{
+		uint32_t level;
+		int x, y;
+		int slot;		// slot % slotsX across and slot / slotsX up the cache
+	};
+
+	// pagesX and pagesY per level, finest first. The cache must hold at least the coarsest level.
+	VirtualPageManager(const std::vector<int>& pagesX, const std::vector<int>& pagesY, int slotsX, int slotsY);
+
+	// Feedback pixels are RGBA8 from encodeFeedback; alpha 0 means nothing was sampled there
+	static void encodeFeedback(uint32_t level, int x, int y, unsigned char* rgba);
+	static bool decodeFeedback(const unsigned char* rgba, uint32_t* level, int* x, int* y);
+
+	void addFeedback(const unsigned char* rgba, size_t pixelCount);
+	void addRequest(uint32_t level, int x, int y, unsigned int count = 1);
+
+	// Turns this frame's requests into at most maxLoads loads, each into a slot that is free or whose page was
+	// evicted for it; the caller must fill them before the page table is next used. Clears the requests.
+	void update(size_t maxLoads, std::vector<PageLoad>& loads);
+
+	bool isResident(uint32_t level, int x, int y) const;
+	int getSlotsX() const;
+	int getSlotsY() const;
+	size_t getLevelCount() const;
+	int getPagesX(size_t level) const;
+	int getPagesY(size_t level) const;
+
+	// One entry per page of level, row by row from the bottom: the finest resident page covering it, as RGBA8
+	// with the slot's column, row and level in r, g and b, and a 255 once anything covers it
+	const std::vector<uint32_t>& getPageTable(size_t level) const;
+	// True once after any update that changed the table
+	bool takePageTableChanged();
+
+	const VirtualTextureStats& getStats() const;
+
+private:
+	struct Slot
+	{
+		uint32_t page;		// key, or NO_PAGE
+		uint64_t lastUsed;	// frame; pinned pages never get old
+	};
+
+	static const uint32_t NO_PAGE = 0xffffffffu;
+
+	std::vector<int> pagesX, pagesY;
+	int slotsX, slotsY;
+	std::vector<Slot> slots;
+	std::unordered_map<uint32_t, int> residentSlots;		// page key to slot
+	std::unordered_map<uint32_t, unsigned int> requests;	// page key to feedback count, this frame
+	std::vector<std::vector<uint32_t>> pageTable;
+	bool pageTableChanged;
+	uint64_t frame;
+	VirtualTextureStats stats;
+
+	// level in the top 8 bits, then 12 bits each of y and x
+	static uint32_t makeKey(uint32_t level, int x, int y);
+	static void splitKey(uint32_t key, uint32_t* level, int* x, int* y);
+
+	int findSlot();
+	void buildPageTable();
+};
+
+// A virtual texture on the GPU: a cache texture of slotsX x slotsY tiles, filled from the mapped .vtex, and a
+// page table texture with a level per virtual level, texelFetch'd with the page and level a texel wants.
+// Feedback from a low resolution pass of the page and level every pixel wants is read back through a pixel
+// buffer two frames late, so reading it never waits on the GPU.
+class VirtualTexture
+{
+public:
+	~VirtualTexture();
+
+	// Bakes the .vtex next to sourcePath when it is missing or stale. GL thread only.
+	static VirtualTexture* load(const std::string& sourcePath, TextureCompression compression, const MipSettings& settings,
+		int slotsX = 8, int slotsY = 8);
+
+	// Queues a copy of the feedback in the bound read framebuffer, width x height RGBA8 pixels
+	void readFeedback(int width, int height);
+	// Reads the feedback queued two frames ago, if there is any, and loads up to maxLoads pages into the cache
+	void update(size_t maxLoads);
+
+	int getWidth() const;
+	int getHeight() const;
+	int getPageSize() const;
+	int getBorder() const;
+	int getTileSize() const;
+	size_t getLevelCount() const;
+	int getCacheWidth() const;
+	int getCacheHeight() const;
+	unsigned int getPageTableHandle() const;
+	unsigned int getCacheHandle() const;
+	const VirtualTextureStats& getStats() const;
+
+private:
+	static const int FEEDBACK_BUFFERS = 2;
+
+	VirtualTextureFile file;
+	VirtualPageManager* pages;
+	GLenum cacheFormat;			// the file's format, or its sRGB variant
+	unsigned int cacheHandle;
+	unsigned int pageTableHandle;
+
+	unsigned int feedbackBuffers[FEEDBACK_BUFFERS];
+	size_t feedbackPixels[FEEDBACK_BUFFERS];	// queued in each buffer; 0 while empty
+	int feedbackIndex;							// the buffer readFeedback fills next
+
+	std::vector<VirtualPageManager::PageLoad> loads;
+
+	VirtualTexture();
+
+	void uploadPageTable();
+};
+
+class VirtualTextureUtils
+{
+public:
+	// Bakes every texture under assetDirectory to tiles, checks each tile against the mip chain it was cut from,
+	// then flies a simulated camera over each one, feeding the page manager feedback built on the CPU, and prints
+	// loads, evictions and how long pages stay missing. Checks the page table after every frame. Needs no window.
+	static void runBenchmark(const std::string& assetDirectory);
+};
\ No newline at end of file